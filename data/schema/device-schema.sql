@@ -6,7 +6,8 @@ CREATE TABLE device_%deviceid_directories (
 CREATE TABLE device_%deviceid_subdirectories (
   directory INTEGER NOT NULL,
   path TEXT NOT NULL,
-  mtime INTEGER NOT NULL
+  mtime INTEGER NOT NULL,
+  snapshot BLOB
 );
 
 CREATE TABLE device_%deviceid_songs (
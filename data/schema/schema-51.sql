@@ -0,0 +1,31 @@
+CREATE TABLE song_changes (
+  song_id INTEGER PRIMARY KEY,
+  version INTEGER NOT NULL
+);
+
+CREATE INDEX idx_song_changes_version ON song_changes (version);
+
+INSERT INTO song_changes (song_id, version) SELECT ROWID, 1 FROM songs;
+
+CREATE TABLE library_sync (
+  library_id TEXT NOT NULL
+);
+
+INSERT INTO library_sync (library_id) VALUES (lower(hex(randomblob(16))));
+
+CREATE TRIGGER song_changes_insert AFTER INSERT ON songs
+BEGIN
+  INSERT OR REPLACE INTO song_changes (song_id, version) VALUES (new.ROWID, (SELECT IFNULL(MAX(version), 0) + 1 FROM song_changes));
+END;
+
+CREATE TRIGGER song_changes_update AFTER UPDATE ON songs
+BEGIN
+  INSERT OR REPLACE INTO song_changes (song_id, version) VALUES (new.ROWID, (SELECT IFNULL(MAX(version), 0) + 1 FROM song_changes));
+END;
+
+CREATE TRIGGER song_changes_delete AFTER DELETE ON songs
+BEGIN
+  INSERT OR REPLACE INTO song_changes (song_id, version) VALUES (old.ROWID, (SELECT IFNULL(MAX(version), 0) + 1 FROM song_changes));
+END;
+
+UPDATE schema_version SET version=51;
@@ -0,0 +1,8 @@
+CREATE TABLE fingerprints (
+  filename TEXT PRIMARY KEY NOT NULL,
+  mtime INTEGER NOT NULL,
+  filesize INTEGER NOT NULL,
+  fingerprint TEXT NOT NULL
+);
+
+UPDATE schema_version SET version=52;
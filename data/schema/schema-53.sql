@@ -0,0 +1,3 @@
+ALTER TABLE %allsubdirectoriestables ADD COLUMN snapshot BLOB;
+
+UPDATE schema_version SET version=53;
@@ -55,6 +55,10 @@ class _MessageHandlerBase : public QObject {
   // After this is true, messages cannot be sent to the handler any more.
   bool is_device_closed() const { return is_device_closed_; }
 
+signals:
+  // Emitted when a reply arrives for a request sent with SendRequest().
+  void ReplyArrived();
+
  protected slots:
   void WriteMessage(const QByteArray& data);
   void DeviceReadyRead();
@@ -108,6 +112,10 @@ class AbstractMessageHandler : public _MessageHandlerBase {
   // reply on the socket.  Used on the worker side.
   void SendReply(const MessageType& request, MessageType* reply);
 
+  // The number of requests sent with SendRequest() that haven't been replied
+  // to yet.
+  int pending_reply_count() const { return pending_replies_.count(); }
+
  protected:
   // Called when a message is received from the socket.
   virtual void MessageArrived(const MessageType& message) {}
@@ -166,6 +174,7 @@ bool AbstractMessageHandler<MT>::RawMessageArrived(const QByteArray& data) {
   if (reply) {
     // This is a reply to a message that we created earlier.
     reply->SetReply(message);
+    emit ReplyArrived();
   } else {
     MessageArrived(message);
   }
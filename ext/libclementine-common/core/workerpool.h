@@ -75,6 +75,12 @@ class WorkerPool : public _WorkerPoolBase {
   // 1 <= (processors / 2) <= 2.
   void SetWorkerCount(int count);
 
+  // Sets how many requests each worker is given before it has replied to
+  // them.  Keeping a few in flight hides the round trip to the worker.  The
+  // rest wait in the pool's queue and go to whichever worker has the fewest
+  // outstanding requests.  Defaults to 4.
+  void SetMaxPendingRequests(int count);
+
   // Sets the prefix to use for the local server (on unix this is a named pipe
   // in /tmp).  Defaults to QApplication::applicationName().  A random number
   // is appended to this name when creating each server.
@@ -137,8 +143,9 @@ class WorkerPool : public _WorkerPoolBase {
   // thread
   ReplyType* NewReply(MessageType* message);
 
-  // Returns the next handler, or NULL if there isn't one.  Must be called from
-  // my thread.
+  // Returns the handler with the fewest pending requests, or NULL if there
+  // isn't one or they all have as many as they're allowed.  Must be called
+  // from my thread.
   HandlerType* NextHandler() const;
 
  private:
@@ -147,6 +154,7 @@ class WorkerPool : public _WorkerPoolBase {
   QString executable_path_;
 
   int worker_count_;
+  int max_pending_requests_;
   mutable int next_worker_;
   QList<Worker> workers_;
 
@@ -158,7 +166,10 @@ class WorkerPool : public _WorkerPoolBase {
 
 template <typename HandlerType>
 WorkerPool<HandlerType>::WorkerPool(QObject* parent)
-    : _WorkerPoolBase(parent), next_worker_(0), next_id_(0) {
+    : _WorkerPoolBase(parent),
+      max_pending_requests_(4),
+      next_worker_(0),
+      next_id_(0) {
   worker_count_ = qBound(1, QThread::idealThreadCount() / 2, 2);
   local_server_name_ = qApp->applicationName().toLower();
 
@@ -199,6 +210,12 @@ void WorkerPool<HandlerType>::SetWorkerCount(int count) {
   worker_count_ = count;
 }
 
+template <typename HandlerType>
+void WorkerPool<HandlerType>::SetMaxPendingRequests(int count) {
+  Q_ASSERT(workers_.isEmpty());
+  max_pending_requests_ = count;
+}
+
 template <typename HandlerType>
 void WorkerPool<HandlerType>::SetLocalServerName(
     const QString& local_server_name) {
@@ -311,6 +328,8 @@ void WorkerPool<HandlerType>::NewConnection() {
 
   // Create the handler.
   worker->handler_ = new HandlerType(worker->local_socket_, this);
+  connect(worker->handler_, SIGNAL(ReplyArrived()),
+          SLOT(SendQueuedMessages()), Qt::QueuedConnection);
 
   SendQueuedMessages();
 }
@@ -380,8 +399,8 @@ void WorkerPool<HandlerType>::SendQueuedMessages() {
     HandlerType* handler = NextHandler();
     if (!handler) {
       // No available handlers - put the message on the front of the queue.
+      // It's sent when a worker replies to one of its requests or connects.
       message_queue_.prepend(reply);
-      qLog(Debug) << "No available handlers to process request";
       break;
     }
 
@@ -391,17 +410,26 @@ void WorkerPool<HandlerType>::SendQueuedMessages() {
 
 template <typename HandlerType>
 HandlerType* WorkerPool<HandlerType>::NextHandler() const {
+  int best_index = -1;
+  int best_pending = max_pending_requests_;
+
+  // Start after the worker that was used last, so workers with the same
+  // number of pending requests take turns.
   for (int i = 0; i < workers_.count(); ++i) {
     const int worker_index = (next_worker_ + i) % workers_.count();
+    const HandlerType* handler = workers_[worker_index].handler_;
 
-    if (workers_[worker_index].handler_ &&
-        !workers_[worker_index].handler_->is_device_closed()) {
-      next_worker_ = (worker_index + 1) % workers_.count();
-      return workers_[worker_index].handler_;
+    if (handler && !handler->is_device_closed() &&
+        handler->pending_reply_count() < best_pending) {
+      best_index = worker_index;
+      best_pending = handler->pending_reply_count();
     }
   }
 
-  return NULL;
+  if (best_index == -1) return NULL;
+
+  next_worker_ = (best_index + 1) % workers_.count();
+  return workers_[best_index].handler_;
 }
 
 #endif  // WORKERPOOL_H
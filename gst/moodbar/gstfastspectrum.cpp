@@ -22,9 +22,14 @@
 #include <cstring>
 #include <cmath>
 
+#include <QMap>
 #include <QMutex>
 #include <QMutexLocker>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "gstfastspectrum.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_fastspectrum_debug);
@@ -46,6 +51,13 @@ GST_DEBUG_CATEGORY_STATIC (gst_fastspectrum_debug);
 #define DEFAULT_INTERVAL		(GST_SECOND / 10)
 #define DEFAULT_BANDS			128
 
+/* FFTs are queued up and run this many at a time */
+#define FFT_BATCH			8
+
+/* Each queued FFT's input and output is padded to a multiple of this many
+ * bytes, so they all have the same alignment and can share one plan */
+#define FFT_ALIGNMENT			64
+
 enum {
   PROP_0,
   PROP_INTERVAL,
@@ -113,6 +125,7 @@ gst_fastspectrum_class_init (GstFastSpectrumClass * klass)
   gst_caps_unref (caps);
 
   klass->fftw_lock = new QMutex;
+  klass->plans = new QMap<guint, GstFastSpectrumPlans>;
 }
 
 static void
@@ -126,45 +139,89 @@ gst_fastspectrum_init (GstFastSpectrum * spectrum)
   g_mutex_init (&spectrum->lock);
 }
 
+/* Distance between the queued FFT inputs, in floats */
+static guint
+gst_fastspectrum_input_stride (guint nfft)
+{
+  const guint align = FFT_ALIGNMENT / sizeof (float);
+  return (nfft + align - 1) / align * align;
+}
+
+/* Distance between the queued FFT outputs, in complex values */
+static guint
+gst_fastspectrum_output_stride (guint nfft)
+{
+  const guint align = FFT_ALIGNMENT / sizeof (fftwf_complex);
+  return (nfft / 2 + 1 + align - 1) / align * align;
+}
+
+/* Returns the plans for this FFT size, creating them the first time.  The
+ * planner isn't thread safe, but the plans can be executed from any thread
+ * at the same time, so each size is only planned once for the whole
+ * process. */
+static GstFastSpectrumPlans
+gst_fastspectrum_get_plans (GstFastSpectrumClass * klass, guint nfft)
+{
+  QMutexLocker l(klass->fftw_lock);
+
+  QMap<guint, GstFastSpectrumPlans>::const_iterator it =
+      klass->plans->constFind (nfft);
+  if (it != klass->plans->constEnd ())
+    return it.value ();
+
+  const int n = nfft;
+  const int istride = gst_fastspectrum_input_stride (nfft);
+  const int ostride = gst_fastspectrum_output_stride (nfft);
+
+  // The plans are made on arrays with the same alignment as the ones they
+  // will be executed on.
+  float* in = reinterpret_cast<float*>(
+      fftwf_malloc (sizeof (float) * istride * FFT_BATCH));
+  fftwf_complex* out = reinterpret_cast<fftwf_complex*>(
+      fftwf_malloc (sizeof (fftwf_complex) * ostride * FFT_BATCH));
+
+  GstFastSpectrumPlans plans;
+  plans.single = fftwf_plan_dft_r2c_1d (n, in, out, FFTW_ESTIMATE);
+  plans.batch = fftwf_plan_many_dft_r2c (1, &n, FFT_BATCH,
+      in, NULL, 1, istride, out, NULL, 1, ostride, FFTW_ESTIMATE);
+
+  fftwf_free (in);
+  fftwf_free (out);
+
+  klass->plans->insert (nfft, plans);
+  return plans;
+}
+
 static void
 gst_fastspectrum_alloc_channel_data (GstFastSpectrum * spectrum)
 {
   guint bands = spectrum->bands;
   guint nfft = 2 * bands - 2;
 
-  spectrum->input_ring_buffer = new double[nfft];
-  spectrum->fft_input = reinterpret_cast<double*>(
-      fftw_malloc(sizeof(double) * nfft));
-  spectrum->fft_output =reinterpret_cast<fftw_complex*>(
-      fftw_malloc(sizeof(fftw_complex) * (nfft/2+1)));
+  spectrum->input_ring_buffer = new float[nfft];
+  spectrum->fft_input = reinterpret_cast<float*>(fftwf_malloc (
+      sizeof (float) * gst_fastspectrum_input_stride (nfft) * FFT_BATCH));
+  spectrum->fft_output = reinterpret_cast<fftwf_complex*>(fftwf_malloc (
+      sizeof (fftwf_complex) * gst_fastspectrum_output_stride (nfft) *
+      FFT_BATCH));
+  spectrum->fft_pending = 0;
 
-  spectrum->spect_magnitude = new double[bands]{};
+  // Rounded up to a multiple of 4 for the SSE2 code.
+  spectrum->spect_magnitude = new float[(bands + 3) & ~3]{};
 
   GstFastSpectrumClass* klass = reinterpret_cast<GstFastSpectrumClass*>(
       G_OBJECT_GET_CLASS(spectrum));
-  {
-    QMutexLocker l(klass->fftw_lock);
-    spectrum->plan = fftw_plan_dft_r2c_1d(
-        nfft,
-        spectrum->fft_input,
-        spectrum->fft_output,
-        FFTW_ESTIMATE);
-  }
+  spectrum->plans = gst_fastspectrum_get_plans (klass, nfft);
+
   spectrum->channel_data_initialised = true;
 }
 
 static void
 gst_fastspectrum_free_channel_data (GstFastSpectrum * spectrum)
 {
-  GstFastSpectrumClass* klass = reinterpret_cast<GstFastSpectrumClass*>(
-      G_OBJECT_GET_CLASS(spectrum));
   if (spectrum->channel_data_initialised) {
-    {
-      QMutexLocker l(klass->fftw_lock);
-      fftw_destroy_plan(spectrum->plan);
-    }
-    fftw_free(spectrum->fft_input);
-    fftw_free(spectrum->fft_output);
+    fftwf_free(spectrum->fft_input);
+    fftwf_free(spectrum->fft_output);
     delete[] spectrum->input_ring_buffer;
     delete[] spectrum->spect_magnitude;
 
@@ -177,6 +234,7 @@ gst_fastspectrum_flush (GstFastSpectrum * spectrum)
 {
   spectrum->num_frames = 0;
   spectrum->num_fft = 0;
+  spectrum->fft_pending = 0;
 
   spectrum->accumulated_error = 0;
 }
@@ -276,47 +334,53 @@ gst_fastspectrum_stop (GstBaseTransform * trans)
 /* mixing data readers */
 
 static void
-input_data_mixed_float(const guint8* _in, double* out, guint len,
-                       double max_value, guint op, guint nfft)
+input_data_mixed_float (const guint8 * _in, float * out, guint len,
+    float scale)
 {
-  guint j, ip = 0;
-  gfloat *in = (gfloat *) _in;
-
-  for (j = 0; j < len; j++) {
-    out[op] = in[ip++];
-    op = (op + 1) % nfft;
-  }
+  memcpy (out, _in, len * sizeof (float));
 }
 
 static void
-input_data_mixed_double (const guint8 * _in, double* out, guint len,
-    double max_value, guint op, guint nfft)
+input_data_mixed_double (const guint8 * _in, float * out, guint len,
+    float scale)
 {
-  guint j, ip = 0;
-  gdouble *in = (gdouble *) _in;
-
-  for (j = 0; j < len; j++) {
-    out[op] = in[ip++];
-    op = (op + 1) % nfft;
+  guint j = 0;
+  const gdouble *in = (const gdouble *) _in;
+
+#ifdef __SSE2__
+  for (; j + 4 <= len; j += 4) {
+    const __m128 lo = _mm_cvtpd_ps (_mm_loadu_pd (in + j));
+    const __m128 hi = _mm_cvtpd_ps (_mm_loadu_pd (in + j + 2));
+    _mm_storeu_ps (out + j, _mm_movelh_ps (lo, hi));
   }
+#endif
+
+  for (; j < len; j++)
+    out[j] = in[j];
 }
 
 static void
-input_data_mixed_int32_max (const guint8 * _in, double* out, guint len,
-    double max_value, guint op, guint nfft)
+input_data_mixed_int32_max (const guint8 * _in, float * out, guint len,
+    float scale)
 {
-  guint j, ip = 0;
-  gint32 *in = (gint32 *) _in;
-
-  for (j = 0; j < len; j++) {
-    out[op] = in[ip++] / max_value;
-    op = (op + 1) % nfft;
+  guint j = 0;
+  const gint32 *in = (const gint32 *) _in;
+
+#ifdef __SSE2__
+  const __m128 s = _mm_set1_ps (scale);
+  for (; j + 4 <= len; j += 4) {
+    const __m128i v = _mm_loadu_si128 ((const __m128i *) (in + j));
+    _mm_storeu_ps (out + j, _mm_mul_ps (_mm_cvtepi32_ps (v), s));
   }
+#endif
+
+  for (; j < len; j++)
+    out[j] = in[j] * scale;
 }
 
 static void
-input_data_mixed_int24_max (const guint8 * _in, double* out, guint len,
-    double max_value, guint op, guint nfft)
+input_data_mixed_int24_max (const guint8 * _in, float * out, guint len,
+    float scale)
 {
   guint j;
 
@@ -329,23 +393,33 @@ input_data_mixed_int24_max (const guint8 * _in, double* out, guint len,
     if (value & 0x00800000)
       value |= 0xff000000;
 
-    out[op] = value / max_value;
-    op = (op + 1) % nfft;
+    out[j] = value * scale;
     _in += 3;
   }
 }
 
 static void
-input_data_mixed_int16_max (const guint8 * _in, double * out, guint len,
-    double max_value, guint op, guint nfft)
+input_data_mixed_int16_max (const guint8 * _in, float * out, guint len,
+    float scale)
 {
-  guint j, ip = 0;
-  gint16 *in = (gint16 *) _in;
-
-  for (j = 0; j < len; j++) {
-    out[op] = in[ip++] / max_value;
-    op = (op + 1) % nfft;
+  guint j = 0;
+  const gint16 *in = (const gint16 *) _in;
+
+#ifdef __SSE2__
+  const __m128 s = _mm_set1_ps (scale);
+  for (; j + 8 <= len; j += 8) {
+    const __m128i v = _mm_loadu_si128 ((const __m128i *) (in + j));
+    // Put each sample in the top half of a 32 bit lane, then shift it back
+    // down to sign extend it.
+    const __m128i lo = _mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 16);
+    const __m128i hi = _mm_srai_epi32 (_mm_unpackhi_epi16 (v, v), 16);
+    _mm_storeu_ps (out + j, _mm_mul_ps (_mm_cvtepi32_ps (lo), s));
+    _mm_storeu_ps (out + j + 4, _mm_mul_ps (_mm_cvtepi32_ps (hi), s));
   }
+#endif
+
+  for (; j < len; j++)
+    out[j] = in[j] * scale;
 }
 
 static gboolean
@@ -383,28 +457,84 @@ gst_fastspectrum_setup (GstAudioFilter * base, const GstAudioInfo * info)
   return TRUE;
 }
 
+/* Adds the power of each band in output to magnitudes */
+static void
+gst_fastspectrum_add_magnitudes (const fftwf_complex * output,
+    float * magnitudes, guint bands, float scale)
+{
+  const float *out = reinterpret_cast<const float*>(output);
+  guint i = 0;
+
+#ifdef __SSE2__
+  const __m128 s = _mm_set1_ps (scale);
+  for (; i + 4 <= bands; i += 4) {
+    const __m128 a = _mm_loadu_ps (out + 2 * i);
+    const __m128 b = _mm_loadu_ps (out + 2 * i + 4);
+    const __m128 a2 = _mm_mul_ps (a, a);
+    const __m128 b2 = _mm_mul_ps (b, b);
+    const __m128 re = _mm_shuffle_ps (a2, b2, _MM_SHUFFLE (2, 0, 2, 0));
+    const __m128 im = _mm_shuffle_ps (a2, b2, _MM_SHUFFLE (3, 1, 3, 1));
+    const __m128 val = _mm_mul_ps (_mm_add_ps (re, im), s);
+    _mm_storeu_ps (magnitudes + i,
+        _mm_add_ps (_mm_loadu_ps (magnitudes + i), val));
+  }
+#endif
+
+  for (; i < bands; i++) {
+    float val = out[2 * i] * out[2 * i];
+    val += out[2 * i + 1] * out[2 * i + 1];
+    magnitudes[i] += val * scale;
+  }
+}
+
+/* Runs all the queued FFTs and adds their results to spect_magnitude */
 static void
-gst_fastspectrum_run_fft (GstFastSpectrum * spectrum, guint input_pos)
+gst_fastspectrum_run_ffts (GstFastSpectrum * spectrum)
 {
   guint i;
   guint bands = spectrum->bands;
   guint nfft = 2 * bands - 2;
+  guint istride = gst_fastspectrum_input_stride (nfft);
+  guint ostride = gst_fastspectrum_output_stride (nfft);
+
+  if (spectrum->fft_pending == FFT_BATCH) {
+    fftwf_execute_dft_r2c (spectrum->plans.batch, spectrum->fft_input,
+        spectrum->fft_output);
+  } else {
+    for (i = 0; i < spectrum->fft_pending; i++) {
+      fftwf_execute_dft_r2c (spectrum->plans.single,
+          spectrum->fft_input + i * istride,
+          spectrum->fft_output + i * ostride);
+    }
+  }
 
-  for (i = 0; i < nfft; i++)
-    spectrum->fft_input[i] =
-        spectrum->input_ring_buffer[(input_pos + i) % nfft];
-
-  // Should be safe to execute the same plan multiple times in parallel.
-  fftw_execute(spectrum->plan);
-
-  gdouble val;
   /* Calculate magnitude in db */
-  for (i = 0; i < bands; i++) {
-    val = spectrum->fft_output[i][0] * spectrum->fft_output[i][0];
-    val += spectrum->fft_output[i][1] * spectrum->fft_output[i][1];
-    val /= nfft * nfft;
-    spectrum->spect_magnitude[i] += val;
+  const float scale = 1.0f / (float (nfft) * nfft);
+  for (i = 0; i < spectrum->fft_pending; i++) {
+    gst_fastspectrum_add_magnitudes (spectrum->fft_output + i * ostride,
+        spectrum->spect_magnitude, bands, scale);
   }
+
+  spectrum->fft_pending = 0;
+}
+
+/* Queues an FFT of the last nfft frames, and runs the queue if it's full */
+static void
+gst_fastspectrum_queue_fft (GstFastSpectrum * spectrum, guint input_pos)
+{
+  guint bands = spectrum->bands;
+  guint nfft = 2 * bands - 2;
+  float *in = spectrum->fft_input +
+      spectrum->fft_pending * gst_fastspectrum_input_stride (nfft);
+
+  /* input_pos is the oldest frame in the ring buffer */
+  memcpy (in, spectrum->input_ring_buffer + input_pos,
+      (nfft - input_pos) * sizeof (float));
+  memcpy (in + nfft - input_pos, spectrum->input_ring_buffer,
+      input_pos * sizeof (float));
+
+  if (++spectrum->fft_pending == FFT_BATCH)
+    gst_fastspectrum_run_ffts (spectrum);
 }
 
 static GstFlowReturn
@@ -414,14 +544,14 @@ gst_fastspectrum_transform_ip (GstBaseTransform * trans, GstBuffer * buffer)
   guint rate = GST_AUDIO_FILTER_RATE (spectrum);
   guint bps = GST_AUDIO_FILTER_BPS (spectrum);
   guint bpf = GST_AUDIO_FILTER_BPF (spectrum);
-  double max_value = (1UL << ((bps << 3) - 1)) - 1;
+  float scale = 1.0 / ((1UL << ((bps << 3) - 1)) - 1);
   guint bands = spectrum->bands;
   guint nfft = 2 * bands - 2;
   guint input_pos;
   GstMapInfo map;
   const guint8 *data;
   gsize size;
-  guint fft_todo, msg_todo, block_size;
+  guint fft_todo, msg_todo, block_size, first_block;
   gboolean have_full_interval;
   GstFastSpectrumInputData input_data;
 
@@ -485,8 +615,15 @@ gst_fastspectrum_transform_ip (GstBaseTransform * trans, GstBuffer * buffer)
     if (block_size > fft_todo)
       block_size = fft_todo;
 
-    /* Move the current frames into our ringbuffers */
-    input_data(data, spectrum->input_ring_buffer, block_size, max_value, input_pos, nfft);
+    /* Move the current frames into our ringbuffers, wrapping around the end
+     * if necessary */
+    first_block = MIN (block_size, nfft - input_pos);
+    input_data (data, spectrum->input_ring_buffer + input_pos, first_block,
+        scale);
+    if (first_block < block_size) {
+      input_data (data + first_block * bpf, spectrum->input_ring_buffer,
+          block_size - first_block, scale);
+    }
 
     data += block_size * bpf;
     size -= block_size * bpf;
@@ -503,7 +640,7 @@ gst_fastspectrum_transform_ip (GstBaseTransform * trans, GstBuffer * buffer)
      * the interval and we haven't run a FFT, then run an FFT */
     if ((spectrum->num_frames % nfft == 0) ||
         (have_full_interval && !spectrum->num_fft)) {
-      gst_fastspectrum_run_fft (spectrum, input_pos);
+      gst_fastspectrum_queue_fft (spectrum, input_pos);
       spectrum->num_fft++;
     }
 
@@ -521,6 +658,8 @@ gst_fastspectrum_transform_ip (GstBaseTransform * trans, GstBuffer * buffer)
       }
       spectrum->accumulated_error += spectrum->error_per_interval;
 
+      gst_fastspectrum_run_ffts (spectrum);
+
       if (spectrum->output_callback) {
         // Calculate average
         for (guint i = 0; i < spectrum->bands; i++) {
@@ -530,7 +669,7 @@ gst_fastspectrum_transform_ip (GstBaseTransform * trans, GstBuffer * buffer)
         spectrum->output_callback(spectrum->spect_magnitude, spectrum->bands);
 
         // Reset spectrum accumulators
-        memset(spectrum->spect_magnitude, 0, spectrum->bands * sizeof(double));
+        memset(spectrum->spect_magnitude, 0, spectrum->bands * sizeof(float));
       }
 
       if (GST_CLOCK_TIME_IS_VALID (spectrum->message_ts))
@@ -24,6 +24,7 @@
 //     instead, simplifies this code a lot).
 //   - Send output via a callback instead of GST messages (less overhead).
 //   - Removed all properties except interval and band.
+//   - Works in single precision, and runs several FFTs at once.
 
 
 #ifndef GST_MOODBAR_FASTSPECTRUM_H_
@@ -31,6 +32,8 @@
 
 #include <functional>
 
+#include <QtContainerFwd>
+
 #include <gst/gst.h>
 #include <gst/audio/gstaudiofilter.h>
 #include <fftw3.h>
@@ -45,10 +48,18 @@ G_BEGIN_DECLS
 
 class QMutex;
 
-typedef void (*GstFastSpectrumInputData)(const guint8* in, double* out,
-    guint len, double max_value, guint op, guint nfft);
+/* Converts len frames to floats in the range -1..1 */
+typedef void (*GstFastSpectrumInputData)(const guint8* in, float* out,
+    guint len, float scale);
+
+typedef std::function<void(const float* magnitudes, int size)> OutputCallback;
 
-typedef std::function<void(double* magnitudes, int size)> OutputCallback;
+/* FFTW plans for one FFT size, shared by every element that uses it.  They
+ * are always executed on the element's own arrays. */
+struct GstFastSpectrumPlans {
+  fftwf_plan single;
+  fftwf_plan batch;
+};
 
 struct GstFastSpectrum {
   GstAudioFilter parent;
@@ -67,11 +78,12 @@ struct GstFastSpectrum {
 
   /* <private> */
   bool channel_data_initialised;
-  double* input_ring_buffer;
-  double* fft_input;
-  fftw_complex* fft_output;
-  double* spect_magnitude;
-  fftw_plan plan;
+  float* input_ring_buffer;
+  float* fft_input;             /* a batch of FFT inputs, one per stride */
+  fftwf_complex* fft_output;
+  float* spect_magnitude;
+  GstFastSpectrumPlans plans;
+  guint fft_pending;            /* inputs in fft_input not yet transformed */
 
   guint input_pos;
   guint64 error_per_interval;
@@ -87,8 +99,9 @@ struct GstFastSpectrum {
 struct GstFastSpectrumClass {
   GstAudioFilterClass parent_class;
 
-  // Static lock for creating & destroying FFTW plans.
+  // Static lock for creating FFTW plans, and the plans for each FFT size.
   QMutex* fftw_lock;
+  QMap<guint, GstFastSpectrumPlans>* plans;
 };
 
 GType gst_fastspectrum_get_type (void);
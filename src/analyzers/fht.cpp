@@ -23,8 +23,15 @@
 #include <math.h>
 #include <string.h>
 #include "fht.h"
-
-FHT::FHT(int n) : m_buf(0), m_tab(0), m_log(0) {
+#include "fhtkernels.h"
+
+FHT::FHT(int n, Kernel kernel)
+    : m_buf(0),
+      m_tab(0),
+      m_twiddle(0),
+      m_log(0),
+      m_kernel(kernelSupported(kernel) ? kernel : KernelScalar),
+      m_kernels(FHTKernels::get(m_kernel)) {
   if (n < 3) {
     m_num = 0;
     m_exp2 = -1;
@@ -35,16 +42,31 @@ FHT::FHT(int n) : m_buf(0), m_tab(0), m_log(0) {
   if (n > 3) {
     m_buf = new float[m_num];
     m_tab = new float[m_num * 2];
+    m_twiddle = new float[m_num * 2];
     makeCasTable();
+    makeTwiddleTable();
   }
 }
 
 FHT::~FHT() {
   delete[] m_buf;
   delete[] m_tab;
+  delete[] m_twiddle;
   delete[] m_log;
 }
 
+bool FHT::kernelSupported(Kernel kernel) {
+  return FHTKernels::supported(kernel);
+}
+
+FHT::Kernel FHT::bestKernel() {
+  static const Kernel sBest = kernelSupported(KernelAVX2)
+                                  ? KernelAVX2
+                                  : kernelSupported(KernelSSE2) ? KernelSSE2
+                                                                : KernelScalar;
+  return sBest;
+}
+
 void FHT::makeCasTable(void) {
   float d, *costab, *sintab;
   int ul, ndiv2 = m_num / 2;
@@ -59,6 +81,19 @@ void FHT::makeCasTable(void) {
   }
 }
 
+void FHT::makeTwiddleTable() {
+  float* costab = m_twiddle;
+  float* sintab = m_twiddle + m_num;
+
+  for (int ndiv2 = 8; ndiv2 < m_num; ndiv2 *= 2) {
+    const int step = m_num / ndiv2;
+    for (int i = 0; i < ndiv2; i++) {
+      costab[ndiv2 - 8 + i] = m_tab[i * step];
+      sintab[ndiv2 - 8 + i] = m_tab[i * step + 1];
+    }
+  }
+}
+
 float* FHT::copy(float* d, float* s) {
   return static_cast<float*>(memcpy(d, s, m_num * sizeof(float)));
 }
@@ -67,12 +102,10 @@ float* FHT::clear(float* d) {
   return static_cast<float*>(memset(d, 0, m_num * sizeof(float)));
 }
 
-void FHT::scale(float* p, float d) {
-  for (int i = 0; i < (m_num / 2); i++) *p++ *= d;
-}
+void FHT::scale(float* p, float d) { m_kernels->scale(p, d, m_num / 2); }
 
 void FHT::ewma(float* d, float* s, float w) {
-  for (int i = 0; i < (m_num / 2); i++, d++, s++) *d = *d * w + *s * (1 - w);
+  m_kernels->ewma(d, s, w, m_num / 2);
 }
 
 void FHT::logSpectrum(float* out, float* p) {
@@ -110,24 +143,17 @@ void FHT::semiLogSpectrum(float* p) {
 
 void FHT::spectrum(float* p) {
   power2(p);
-  for (int i = 0; i < (m_num / 2); i++, p++)
-    *p = static_cast<float>(sqrt(*p * .5));
+  m_kernels->sqrtHalf(p, m_num / 2);
 }
 
 void FHT::power(float* p) {
   power2(p);
-  for (int i = 0; i < (m_num / 2); i++) *p++ *= .5;
+  m_kernels->scale(p, .5, m_num / 2);
 }
 
 void FHT::power2(float* p) {
-  int i;
-  float* q;
   _transform(p, m_num, 0);
-
-  *p = (*p * *p), *p += *p, p++;
-
-  for (i = 1, q = p + m_num - 2; i < (m_num / 2); i++, --q)
-    *p = (*p * *p) + (*q * *q), p++;
+  m_kernels->power2(p, m_num);
 }
 
 void FHT::transform(float* p) {
@@ -170,37 +196,15 @@ void FHT::_transform(float* p, int n, int k) {
     return;
   }
 
-  int i, j, ndiv2 = n / 2;
-  float a, *t1, *t2, *t3, *t4, *ptab, *pp;
-
-  for (i = 0, t1 = m_buf, t2 = m_buf + ndiv2, pp = &p[k]; i < ndiv2; i++)
-    *t1++ = *pp++, *t2++ = *pp++;
+  int ndiv2 = n / 2;
 
+  m_kernels->deinterleave(p + k, m_buf, m_buf + ndiv2, ndiv2);
   memcpy(p + k, m_buf, sizeof(float) * n);
 
   _transform(p, ndiv2, k);
   _transform(p, ndiv2, k + ndiv2);
 
-  j = m_num / ndiv2 - 1;
-  t1 = m_buf;
-  t2 = t1 + ndiv2;
-  t3 = p + k + ndiv2;
-  ptab = m_tab;
-  pp = p + k;
-
-  a = *ptab++ * *t3++;
-  a += *ptab * *pp;
-  ptab += j;
-
-  *t1++ = *pp + a;
-  *t2++ = *pp++ - a;
-
-  for (i = 1, t4 = p + k + n; i < ndiv2; i++, ptab += j) {
-    a = *ptab++ * *t3++;
-    a += *ptab * *--t4;
-
-    *t1++ = *pp + a;
-    *t2++ = *pp++ - a;
-  }
+  m_kernels->butterfly(p + k, m_twiddle + ndiv2 - 8,
+                       m_twiddle + m_num + ndiv2 - 8, m_buf, ndiv2);
   memcpy(p + k, m_buf, sizeof(float) * n);
 }
@@ -23,6 +23,8 @@
 #ifndef ANALYZERS_FHT_H_
 #define ANALYZERS_FHT_H_
 
+struct FHTKernels;
+
 /**
  * Implementation of the Hartley Transform after Bracewell's discrete
  * algorithm. The algorithm is subject to US patent No. 4,646,256 (1987)
@@ -32,11 +34,32 @@
  * [1] Computer in Physics, Vol. 9, No. 4, Jul/Aug 1995 pp 373-379
  */
 class FHT {
+ public:
+  /**
+   * Implementations of the inner loops.  They all give the same results, but
+   * the SIMD ones are only available on CPUs that support them.
+   */
+  enum Kernel { KernelScalar, KernelSSE2, KernelAVX2 };
+
+  /**
+   * Whether the running CPU can use @p kernel.
+   */
+  static bool kernelSupported(Kernel kernel);
+
+  /**
+   * The fastest kernel the running CPU supports.
+   */
+  static Kernel bestKernel();
+
+ private:
   int m_exp2;
   int m_num;
   float* m_buf;
   float* m_tab;
+  float* m_twiddle;
   int* m_log;
+  Kernel m_kernel;
+  const FHTKernels* m_kernels;
 
   /**
    * Create a table of "cas" (cosine and sine) values.
@@ -45,6 +68,13 @@ class FHT {
    */
   void makeCasTable();
 
+  /**
+   * Copy the cas values used by each level of _transform() into contiguous
+   * cosine and sine arrays, so the SIMD kernels can load them directly.
+   * Level @f$n@f$ starts at offset @f$n/2 - 8@f$, cosines first.
+   */
+  void makeTwiddleTable();
+
   /**
    * Recursive in-place Hartley transform. For internal use only!
    */
@@ -56,11 +86,12 @@ class FHT {
   * should be at least 3. Values of more than 3 need a trigonometry table.
   * @see makeCasTable()
   */
-  explicit FHT(int);
+  explicit FHT(int, Kernel kernel = bestKernel());
 
   ~FHT();
   inline int sizeExp() const { return m_exp2; }
   inline int size() const { return m_num; }
+  inline Kernel kernel() const { return m_kernel; }
   float* copy(float*, float*);
   float* clear(float*);
   void scale(float*, float);
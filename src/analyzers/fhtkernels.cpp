@@ -0,0 +1,322 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fhtkernels.h"
+
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// The scalar kernels do exactly what FHT always did, including the double
+// precision sqrt in sqrtHalf.  Rounding the double result to float gives the
+// same answer as a float sqrt, which is what lets the SIMD kernels match.
+
+void scaleScalar(float* p, float d, int count) {
+  for (int i = 0; i < count; i++) p[i] *= d;
+}
+
+void ewmaScalar(float* d, const float* s, float w, int count) {
+  for (int i = 0; i < count; i++) d[i] = d[i] * w + s[i] * (1 - w);
+}
+
+void sqrtHalfScalar(float* p, int count) {
+  for (int i = 0; i < count; i++) p[i] = static_cast<float>(sqrt(p[i] * .5));
+}
+
+void power2Tail(float* p, int num, int from) {
+  for (int i = from; i < num / 2; i++)
+    p[i] = (p[i] * p[i]) + (p[num - i] * p[num - i]);
+}
+
+void power2Scalar(float* p, int num) {
+  *p = (*p * *p), *p += *p;
+  power2Tail(p, num, 1);
+}
+
+void deinterleaveTail(const float* src, float* even, float* odd, int half,
+                      int from) {
+  for (int i = from; i < half; i++) {
+    even[i] = src[2 * i];
+    odd[i] = src[2 * i + 1];
+  }
+}
+
+void deinterleaveScalar(const float* src, float* even, float* odd, int half) {
+  deinterleaveTail(src, even, odd, half, 0);
+}
+
+void butterflyTail(const float* p, const float* costab, const float* sintab,
+                   float* out, int half, int from) {
+  for (int i = from; i < half; i++) {
+    float a = costab[i] * p[half + i];
+    a += sintab[i] * p[2 * half - i];
+
+    out[i] = p[i] + a;
+    out[half + i] = p[i] - a;
+  }
+}
+
+void butterflyScalar(const float* p, const float* costab, const float* sintab,
+                     float* out, int half) {
+  // The first sine term pairs with p[0] rather than p[2 * half].
+  float a = costab[0] * p[half];
+  a += sintab[0] * p[0];
+  out[0] = p[0] + a;
+  out[half] = p[0] - a;
+
+  butterflyTail(p, costab, sintab, out, half, 1);
+}
+
+const FHTKernels kScalarKernels = {scaleScalar,        ewmaScalar,
+                                   sqrtHalfScalar,     power2Scalar,
+                                   deinterleaveScalar, butterflyScalar};
+
+#ifdef HAVE_X86_KERNELS
+
+#define SSE2_FUNCTION __attribute__((target("sse2")))
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+
+SSE2_FUNCTION inline __m128 reverse4(__m128 v) {
+  return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+SSE2_FUNCTION void scaleSSE2(float* p, float d, int count) {
+  const __m128 dv = _mm_set1_ps(d);
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    _mm_storeu_ps(p + i, _mm_mul_ps(_mm_loadu_ps(p + i), dv));
+  }
+  scaleScalar(p + i, d, count - i);
+}
+
+SSE2_FUNCTION void ewmaSSE2(float* d, const float* s, float w, int count) {
+  const __m128 wv = _mm_set1_ps(w);
+  const __m128 rv = _mm_set1_ps(1 - w);
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128 dv = _mm_mul_ps(_mm_loadu_ps(d + i), wv);
+    const __m128 sv = _mm_mul_ps(_mm_loadu_ps(s + i), rv);
+    _mm_storeu_ps(d + i, _mm_add_ps(dv, sv));
+  }
+  ewmaScalar(d + i, s + i, w, count - i);
+}
+
+SSE2_FUNCTION void sqrtHalfSSE2(float* p, int count) {
+  const __m128 half = _mm_set1_ps(.5f);
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    _mm_storeu_ps(p + i, _mm_sqrt_ps(_mm_mul_ps(_mm_loadu_ps(p + i), half)));
+  }
+  sqrtHalfScalar(p + i, count - i);
+}
+
+SSE2_FUNCTION void power2SSE2(float* p, int num) {
+  *p = (*p * *p), *p += *p;
+
+  // p[num - i] is read backwards.  The values written are all below num / 2
+  // and the ones read are all above it, so they never overlap.
+  int i = 1;
+  for (; i + 4 <= num / 2; i += 4) {
+    const __m128 a = _mm_loadu_ps(p + i);
+    const __m128 b = reverse4(_mm_loadu_ps(p + num - i - 3));
+    _mm_storeu_ps(p + i, _mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)));
+  }
+  power2Tail(p, num, i);
+}
+
+SSE2_FUNCTION void deinterleaveSSE2(const float* src, float* even, float* odd,
+                                    int half) {
+  int i = 0;
+  for (; i + 4 <= half; i += 4) {
+    const __m128 a = _mm_loadu_ps(src + 2 * i);
+    const __m128 b = _mm_loadu_ps(src + 2 * i + 4);
+    _mm_storeu_ps(even + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(odd + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+  deinterleaveTail(src, even, odd, half, i);
+}
+
+SSE2_FUNCTION void butterflySSE2(const float* p, const float* costab,
+                                 const float* sintab, float* out, int half) {
+  float a = costab[0] * p[half];
+  a += sintab[0] * p[0];
+  out[0] = p[0] + a;
+  out[half] = p[0] - a;
+
+  int i = 1;
+  for (; i + 4 <= half; i += 4) {
+    const __m128 c = _mm_mul_ps(_mm_loadu_ps(costab + i),
+                                _mm_loadu_ps(p + half + i));
+    const __m128 s = _mm_mul_ps(_mm_loadu_ps(sintab + i),
+                                reverse4(_mm_loadu_ps(p + 2 * half - i - 3)));
+    const __m128 av = _mm_add_ps(c, s);
+    const __m128 pv = _mm_loadu_ps(p + i);
+    _mm_storeu_ps(out + i, _mm_add_ps(pv, av));
+    _mm_storeu_ps(out + half + i, _mm_sub_ps(pv, av));
+  }
+  butterflyTail(p, costab, sintab, out, half, i);
+}
+
+// The AVX2 kernels deliberately avoid FMA, which would round differently
+// from the scalar code.  They clear the upper halves of the registers before
+// handing the remainder to the SSE2 or scalar code, which would otherwise
+// pay a large penalty for mixing the two encodings.
+
+AVX2_FUNCTION inline __m256 reverse8(__m256 v) {
+  v = _mm256_permute2f128_ps(v, v, 1);
+  return _mm256_permute_ps(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+// Shuffles work within each 128 bit lane, so deinterleaving two vectors
+// leaves the 64 bit pairs in the order 0, 2, 1, 3.
+AVX2_FUNCTION inline __m256 orderPairs(__m256 v) {
+  return _mm256_castpd_ps(
+      _mm256_permute4x64_pd(_mm256_castps_pd(v), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+AVX2_FUNCTION void scaleAVX2(float* p, float d, int count) {
+  const __m256 dv = _mm256_set1_ps(d);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm256_storeu_ps(p + i, _mm256_mul_ps(_mm256_loadu_ps(p + i), dv));
+  }
+  _mm256_zeroupper();
+  scaleSSE2(p + i, d, count - i);
+}
+
+AVX2_FUNCTION void ewmaAVX2(float* d, const float* s, float w, int count) {
+  const __m256 wv = _mm256_set1_ps(w);
+  const __m256 rv = _mm256_set1_ps(1 - w);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256 dv = _mm256_mul_ps(_mm256_loadu_ps(d + i), wv);
+    const __m256 sv = _mm256_mul_ps(_mm256_loadu_ps(s + i), rv);
+    _mm256_storeu_ps(d + i, _mm256_add_ps(dv, sv));
+  }
+  _mm256_zeroupper();
+  ewmaSSE2(d + i, s + i, w, count - i);
+}
+
+AVX2_FUNCTION void sqrtHalfAVX2(float* p, int count) {
+  const __m256 half = _mm256_set1_ps(.5f);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm256_storeu_ps(
+        p + i, _mm256_sqrt_ps(_mm256_mul_ps(_mm256_loadu_ps(p + i), half)));
+  }
+  _mm256_zeroupper();
+  sqrtHalfSSE2(p + i, count - i);
+}
+
+AVX2_FUNCTION void power2AVX2(float* p, int num) {
+  *p = (*p * *p), *p += *p;
+
+  int i = 1;
+  for (; i + 8 <= num / 2; i += 8) {
+    const __m256 a = _mm256_loadu_ps(p + i);
+    const __m256 b = reverse8(_mm256_loadu_ps(p + num - i - 7));
+    _mm256_storeu_ps(p + i,
+                     _mm256_add_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b)));
+  }
+  _mm256_zeroupper();
+  power2Tail(p, num, i);
+}
+
+AVX2_FUNCTION void deinterleaveAVX2(const float* src, float* even, float* odd,
+                                    int half) {
+  int i = 0;
+  for (; i + 8 <= half; i += 8) {
+    const __m256 a = _mm256_loadu_ps(src + 2 * i);
+    const __m256 b = _mm256_loadu_ps(src + 2 * i + 8);
+
+    _mm256_storeu_ps(
+        even + i, orderPairs(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))));
+    _mm256_storeu_ps(
+        odd + i, orderPairs(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+  }
+  _mm256_zeroupper();
+  deinterleaveSSE2(src + 2 * i, even + i, odd + i, half - i);
+}
+
+AVX2_FUNCTION void butterflyAVX2(const float* p, const float* costab,
+                                 const float* sintab, float* out, int half) {
+  float a = costab[0] * p[half];
+  a += sintab[0] * p[0];
+  out[0] = p[0] + a;
+  out[half] = p[0] - a;
+
+  int i = 1;
+  for (; i + 8 <= half; i += 8) {
+    const __m256 c = _mm256_mul_ps(_mm256_loadu_ps(costab + i),
+                                   _mm256_loadu_ps(p + half + i));
+    const __m256 s =
+        _mm256_mul_ps(_mm256_loadu_ps(sintab + i),
+                      reverse8(_mm256_loadu_ps(p + 2 * half - i - 7)));
+    const __m256 av = _mm256_add_ps(c, s);
+    const __m256 pv = _mm256_loadu_ps(p + i);
+    _mm256_storeu_ps(out + i, _mm256_add_ps(pv, av));
+    _mm256_storeu_ps(out + half + i, _mm256_sub_ps(pv, av));
+  }
+  _mm256_zeroupper();
+  butterflyTail(p, costab, sintab, out, half, i);
+}
+
+const FHTKernels kSSE2Kernels = {scaleSSE2,        ewmaSSE2,
+                                 sqrtHalfSSE2,     power2SSE2,
+                                 deinterleaveSSE2, butterflySSE2};
+
+const FHTKernels kAVX2Kernels = {scaleAVX2,        ewmaAVX2,
+                                 sqrtHalfAVX2,     power2AVX2,
+                                 deinterleaveAVX2, butterflyAVX2};
+
+#endif  // HAVE_X86_KERNELS
+
+}  // namespace
+
+bool FHTKernels::supported(FHT::Kernel kernel) {
+  switch (kernel) {
+    case FHT::KernelScalar:
+      return true;
+#ifdef HAVE_X86_KERNELS
+    case FHT::KernelSSE2:
+      return __builtin_cpu_supports("sse2");
+    case FHT::KernelAVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+const FHTKernels* FHTKernels::get(FHT::Kernel kernel) {
+  if (!supported(kernel)) return &kScalarKernels;
+
+  switch (kernel) {
+#ifdef HAVE_X86_KERNELS
+    case FHT::KernelSSE2:
+      return &kSSE2Kernels;
+    case FHT::KernelAVX2:
+      return &kAVX2Kernels;
+#endif
+    default:
+      return &kScalarKernels;
+  }
+}
@@ -0,0 +1,64 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ANALYZERS_FHTKERNELS_H_
+#define ANALYZERS_FHTKERNELS_H_
+
+#include "fht.h"
+
+/**
+ * The inner loops of FHT.  There is a scalar version of each, plus SSE2 and
+ * AVX2 versions on x86 that produce the same floats a lane at a time.  The
+ * SIMD versions are compiled with target attributes, so the rest of the
+ * program doesn't need building with extra instruction sets.
+ */
+struct FHTKernels {
+  /** @f$p_i = p_i d@f$ */
+  void (*scale)(float* p, float d, int count);
+
+  /** @f$d_i = d_i w + s_i (1 - w)@f$ */
+  void (*ewma)(float* d, const float* s, float w, int count);
+
+  /** @f$p_i = \sqrt{p_i / 2}@f$ */
+  void (*sqrtHalf)(float* p, int count);
+
+  /**
+   * Turns the first half of a transformed data set of @p num values into
+   * doubled power values.  The second half is left as it was.
+   */
+  void (*power2)(float* p, int num);
+
+  /**
+   * Copies the even values of @p src into @p even and the odd ones into
+   * @p odd.  @p src holds @p half * 2 values.
+   */
+  void (*deinterleave)(const float* src, float* even, float* odd, int half);
+
+  /**
+   * Combines the two half-size transforms in @p p into @p out.
+   */
+  void (*butterfly)(const float* p, const float* costab, const float* sintab,
+                    float* out, int half);
+
+  static bool supported(FHT::Kernel kernel);
+
+  /**
+   * Returns the scalar kernels if @p kernel isn't supported.
+   */
+  static const FHTKernels* get(FHT::Kernel kernel);
+};
+
+#endif  // ANALYZERS_FHTKERNELS_H_
@@ -43,12 +43,17 @@
 #include <QSqlQuery>
 #include <QtDebug>
 #include <QThread>
+#include <QTime>
 #include <QUrl>
 #include <QVariant>
 
 const char* Database::kDatabaseFilename = "clementine.db";
-const int Database::kSchemaVersion = 49;
+const int Database::kSchemaVersion = 53;
 const char* Database::kMagicAllSongsTables = "%allsongstables";
+const char* Database::kMagicAllSubdirectoriesTables =
+    "%allsubdirectoriestables";
+
+const int Database::kLockStatsIntervalMsec = 10 * 60 * 1000;  // 10 minutes
 
 int Database::sNextConnectionId = 1;
 QMutex Database::sNextConnectionIdMutex;
@@ -212,6 +217,10 @@ Database::Database(Application* app, QObject* parent,
     : QObject(parent),
       app_(app),
       mutex_(QMutex::Recursive),
+      wal_enabled_(0),
+      wal_checked_(false),
+      lock_stats_timer_(new QTimer(this)),
+      logged_lock_count_(0),
       injected_database_name_(database_name),
       query_hash_(0),
       startup_schema_version_(-1) {
@@ -226,10 +235,32 @@ Database::Database(Application* app, QObject* parent,
   attached_databases_["jamendo"] = AttachedDatabase(
       directory_ + "/jamendo.db", ":/schema/jamendo.sql", false);
 
+  lock_stats_timer_->setInterval(kLockStatsIntervalMsec);
+  connect(lock_stats_timer_, SIGNAL(timeout()), SLOT(LogLockStats()));
+  lock_stats_timer_->start();
+
   QMutexLocker l(&mutex_);
   Connect();
 }
 
+Database::~Database() { LogLockStats(); }
+
+void Database::LogLockStats() {
+  const LockStats stats = lock_stats();
+  const int lock_count =
+      stats.write_locks + stats.concurrent_reads + stats.serialised_reads;
+  if (lock_count == logged_lock_count_) return;
+  logged_lock_count_ = lock_count;
+
+  qLog(Debug) << "Database writes:" << stats.write_locks << "locks,"
+              << stats.contended_write_locks << "contended, waited"
+              << stats.write_wait_msec << "ms in total and"
+              << stats.max_write_wait_msec << "ms at most";
+  qLog(Debug) << "Database reads:" << stats.concurrent_reads << "concurrent,"
+              << stats.serialised_reads << "serialised, waited"
+              << stats.read_wait_msec << "ms in total";
+}
+
 QSqlDatabase Database::Connect() {
   QMutexLocker l(&connect_mutex_);
 
@@ -240,8 +271,7 @@ QSqlDatabase Database::Connect() {
     }
   }
 
-  const QString connection_id = QString("%1_thread_%2").arg(connection_id_).arg(
-      reinterpret_cast<quint64>(QThread::currentThread()));
+  const QString connection_id = ConnectionName("thread");
 
   // Try to find an existing connection for this thread
   QSqlDatabase db = QSqlDatabase::database(connection_id);
@@ -264,17 +294,12 @@ QSqlDatabase Database::Connect() {
   // Find Sqlite3 functions in the Qt plugin.
   StaticInit();
 
-  {
-    QSqlQuery set_fts_tokenizer("SELECT fts3_tokenizer(:name, :pointer)", db);
-    set_fts_tokenizer.bindValue(":name", "unicode");
-    set_fts_tokenizer.bindValue(
-        ":pointer", QByteArray(reinterpret_cast<const char*>(&sFTSTokenizer),
-                               sizeof(&sFTSTokenizer)));
-    if (!set_fts_tokenizer.exec()) {
-      qLog(Warning) << "Couldn't register FTS3 tokenizer";
-    }
-    // Implicit invocation of ~QSqlQuery() when leaving the scope
-    // to release any remaining database locks!
+  RegisterFtsTokenizer(db);
+
+  // In-memory databases are private to their connection, so there's nothing
+  // to gain from WAL there.
+  if (injected_database_name_ != ":memory:") {
+    EnableWal(db, "main");
   }
 
   if (db.tables().count() == 0) {
@@ -297,6 +322,9 @@ QSqlDatabase Database::Connect() {
       qFatal("Couldn't attach external database '%s'",
              key.toAscii().constData());
     }
+    if (wal_enabled() && !attached_databases_[key].is_temporary_) {
+      EnableWal(db, key);
+    }
   }
 
   if (startup_schema_version_ == -1) {
@@ -323,6 +351,171 @@ QSqlDatabase Database::Connect() {
   return db;
 }
 
+QSqlDatabase Database::ConnectForRead() {
+  if (!CanReadConcurrently()) return Connect();
+  return ConnectReadOnly();
+}
+
+QSqlDatabase Database::ConnectReadOnly() {
+  // Make sure the schema has been created or updated by a writable connection
+  // first.
+  Connect();
+
+  QMutexLocker l(&connect_mutex_);
+
+  const QString connection_id = ConnectionName("reader_thread");
+
+  QSqlDatabase db = QSqlDatabase::database(connection_id);
+  if (db.isOpen()) {
+    return db;
+  }
+
+  db = QSqlDatabase::addDatabase("QSQLITE", connection_id);
+  if (!injected_database_name_.isNull())
+    db.setDatabaseName(injected_database_name_);
+  else
+    db.setDatabaseName(directory_ + "/" + kDatabaseFilename);
+  db.setConnectOptions("QSQLITE_OPEN_READONLY");
+
+  if (!db.open()) {
+    app_->AddError("Database: " + db.lastError().text());
+    return db;
+  }
+
+  RegisterFtsTokenizer(db);
+
+  for (const QString& key : attached_databases_.keys()) {
+    QString filename = attached_databases_[key].filename_;
+    if (!injected_database_name_.isNull()) filename = injected_database_name_;
+
+    QSqlQuery q(db);
+    q.prepare("ATTACH DATABASE :filename AS :alias");
+    q.bindValue(":filename", filename);
+    q.bindValue(":alias", key);
+    if (!q.exec()) {
+      qLog(Warning) << "Couldn't attach external database" << key
+                    << "to a read-only connection";
+    }
+  }
+
+  return db;
+}
+
+QString Database::ConnectionName(const QString& kind) const {
+  return QString("%1_%2_%3").arg(connection_id_).arg(kind).arg(
+      reinterpret_cast<quint64>(QThread::currentThread()));
+}
+
+void Database::RegisterFtsTokenizer(QSqlDatabase& db) {
+  QSqlQuery set_fts_tokenizer("SELECT fts3_tokenizer(:name, :pointer)", db);
+  set_fts_tokenizer.bindValue(":name", "unicode");
+  set_fts_tokenizer.bindValue(
+      ":pointer", QByteArray(reinterpret_cast<const char*>(&sFTSTokenizer),
+                             sizeof(&sFTSTokenizer)));
+  if (!set_fts_tokenizer.exec()) {
+    qLog(Warning) << "Couldn't register FTS3 tokenizer";
+  }
+  // Implicit invocation of ~QSqlQuery() when leaving the scope
+  // to release any remaining database locks!
+}
+
+void Database::EnableWal(QSqlDatabase& db, const QString& schema) {
+  QSqlQuery q(QString("PRAGMA %1.journal_mode = WAL").arg(schema), db);
+  const bool wal = q.next() && q.value(0).toString() == "wal";
+
+  // The journal mode is stored in the database file, so the first
+  // connection's answer holds for all the others.
+  if (schema == "main" && !wal_checked_) {
+    wal_checked_ = true;
+    if (!wal) {
+      qLog(Warning) << "Couldn't switch the database to WAL mode, readers"
+                    << "will wait for writers";
+    }
+    wal_enabled_.fetchAndStoreOrdered(wal ? 1 : 0);
+  }
+}
+
+bool Database::CanReadConcurrently() {
+  if (!wal_enabled()) return false;
+
+  // If this thread is in the middle of a write transaction then the read has
+  // to see its uncommitted changes, so it must use the writable connection.
+  const QString connection_id = ConnectionName("thread");
+  if (!QSqlDatabase::contains(connection_id)) return true;
+
+  QSqlDatabase db = QSqlDatabase::database(connection_id, false);
+  if (!db.isOpen()) return true;
+
+  QVariant handle = db.driver()->handle();
+  if (!handle.isValid() || qstrcmp(handle.typeName(), "sqlite3*") != 0) {
+    return false;
+  }
+  sqlite3* connection = *static_cast<sqlite3**>(handle.data());
+  return connection && sqlite3_get_autocommit(connection);
+}
+
+Database::LockStats::LockStats()
+    : write_locks(0),
+      contended_write_locks(0),
+      write_wait_msec(0),
+      max_write_wait_msec(0),
+      concurrent_reads(0),
+      serialised_reads(0),
+      read_wait_msec(0) {}
+
+Database::LockStats Database::lock_stats() const {
+  QMutexLocker l(&lock_stats_mutex_);
+  return lock_stats_;
+}
+
+void Database::LockForWrite() {
+  if (mutex_.tryLock()) {
+    QMutexLocker l(&lock_stats_mutex_);
+    lock_stats_.write_locks++;
+    return;
+  }
+
+  QTime time;
+  time.start();
+  mutex_.lock();
+  const qint64 waited = time.elapsed();
+
+  QMutexLocker l(&lock_stats_mutex_);
+  lock_stats_.write_locks++;
+  lock_stats_.contended_write_locks++;
+  lock_stats_.write_wait_msec += waited;
+  lock_stats_.max_write_wait_msec =
+      qMax(lock_stats_.max_write_wait_msec, waited);
+}
+
+Database::WriteLocker::WriteLocker(Database* db) : db_(db) {
+  db_->LockForWrite();
+}
+
+Database::WriteLocker::~WriteLocker() { db_->mutex_.unlock(); }
+
+Database::ReadLocker::ReadLocker(Database* db)
+    : db_(db), locked_(!db->CanReadConcurrently()) {
+  if (!locked_) {
+    QMutexLocker l(&db_->lock_stats_mutex_);
+    db_->lock_stats_.concurrent_reads++;
+    return;
+  }
+
+  QTime time;
+  time.start();
+  db_->mutex_.lock();
+  const qint64 waited = time.elapsed();
+
+  QMutexLocker l(&db_->lock_stats_mutex_);
+  db_->lock_stats_.serialised_reads++;
+  db_->lock_stats_.read_wait_msec += waited;
+}
+
+Database::ReadLocker::~ReadLocker() {
+  if (locked_) db_->mutex_.unlock();
+}
+
 void Database::UpdateMainSchema(QSqlDatabase* db) {
   // Get the database's schema version
   int schema_version = 0;
@@ -528,6 +721,18 @@ void Database::ExecSongTablesCommands(QSqlDatabase& db,
         if (CheckErrors(query))
           qFatal("Unable to update music library database");
       }
+    } else if (command.contains(kMagicAllSubdirectoriesTables)) {
+      // The same for the library's subdirectories table and the ones
+      // belonging to each device.
+      for (const QString& table : SubdirectoriesTables(db)) {
+        qLog(Info) << "Updating" << table << "for"
+                   << kMagicAllSubdirectoriesTables;
+        QString new_command(command);
+        new_command.replace(kMagicAllSubdirectoriesTables, table);
+        QSqlQuery query(db.exec(new_command));
+        if (CheckErrors(query))
+          qFatal("Unable to update music library database");
+      }
     } else {
       QSqlQuery query(db.exec(command));
       if (CheckErrors(query)) qFatal("Unable to update music library database");
@@ -535,6 +740,16 @@ void Database::ExecSongTablesCommands(QSqlDatabase& db,
   }
 }
 
+QStringList Database::SubdirectoriesTables(QSqlDatabase& db) const {
+  QStringList ret;
+  for (const QString& table : db.tables()) {
+    if (table == "subdirectories" || table.endsWith("_subdirectories")) {
+      ret << table;
+    }
+  }
+  return ret;
+}
+
 QStringList Database::SongsTables(QSqlDatabase& db, int schema_version) const {
   QStringList ret;
 
@@ -24,15 +24,19 @@
 #ifndef CORE_DATABASE_H_
 #define CORE_DATABASE_H_
 
+#include <QAtomicInt>
 #include <QMap>
 #include <QMutex>
 #include <QObject>
 #include <QSqlDatabase>
 #include <QSqlError>
 #include <QStringList>
+#include <QTimer>
 
 #include <sqlite3.h>
 
+#include <boost/noncopyable.hpp>
+
 #include "gtest/gtest_prod.h"
 
 extern "C" {
@@ -49,6 +53,7 @@ class Database : public QObject {
  public:
   Database(Application* app, QObject* parent = nullptr,
            const QString& database_name = QString());
+  ~Database();
 
   struct AttachedDatabase {
     AttachedDatabase() {}
@@ -61,14 +66,62 @@ class Database : public QObject {
     bool is_temporary_;
   };
 
+  // Counters describing how long callers have waited for the database.
+  // Times are in milliseconds.
+  struct LockStats {
+    LockStats();
+
+    int write_locks;
+    int contended_write_locks;
+    qint64 write_wait_msec;
+    qint64 max_write_wait_msec;
+
+    int concurrent_reads;
+    int serialised_reads;
+    qint64 read_wait_msec;
+  };
+
+  // Takes the writer lock for the lifetime of the object, recording how long
+  // the caller had to wait for it.  Use this instead of locking Mutex()
+  // directly.
+  class WriteLocker : boost::noncopyable {
+   public:
+    explicit WriteLocker(Database* db);
+    ~WriteLocker();
+
+   private:
+    Database* db_;
+  };
+
+  // Use around queries that only read from the database.  When the database
+  // is in WAL mode, and this thread isn't inside a write transaction, no lock
+  // is taken at all and ConnectForRead() returns this thread's read-only
+  // connection.  Otherwise this behaves like a WriteLocker.
+  class ReadLocker : boost::noncopyable {
+   public:
+    explicit ReadLocker(Database* db);
+    ~ReadLocker();
+
+   private:
+    Database* db_;
+    bool locked_;
+  };
+
   static const int kSchemaVersion;
   static const char* kDatabaseFilename;
   static const char* kMagicAllSongsTables;
+  static const char* kMagicAllSubdirectoriesTables;
+  // How often the lock stats are logged, if anything has used the database.
+  static const int kLockStatsIntervalMsec;
 
   QSqlDatabase Connect();
+  QSqlDatabase ConnectForRead();
   bool CheckErrors(const QSqlQuery& query);
   QMutex* Mutex() { return &mutex_; }
 
+  bool wal_enabled() const { return wal_enabled_ != 0; }
+  LockStats lock_stats() const;
+
   void RecreateAttachedDb(const QString& database_name);
   void ExecSchemaCommands(QSqlDatabase& db, const QString& schema,
                           int schema_version, bool in_transaction = false);
@@ -89,6 +142,9 @@ class Database : public QObject {
  public slots:
   void DoBackup();
 
+ private slots:
+  void LogLockStats();
+
  private:
   void UpdateMainSchema(QSqlDatabase* db);
 
@@ -101,10 +157,19 @@ class Database : public QObject {
   void UpdateDatabaseSchema(int version, QSqlDatabase& db);
   void UrlEncodeFilenameColumn(const QString& table, QSqlDatabase& db);
   QStringList SongsTables(QSqlDatabase& db, int schema_version) const;
+  QStringList SubdirectoriesTables(QSqlDatabase& db) const;
   bool IntegrityCheck(QSqlDatabase db);
   void BackupFile(const QString& filename);
   bool OpenDatabase(const QString& filename, sqlite3** connection) const;
 
+  QString ConnectionName(const QString& kind) const;
+  QSqlDatabase ConnectReadOnly();
+  void RegisterFtsTokenizer(QSqlDatabase& db);
+  void EnableWal(QSqlDatabase& db, const QString& schema);
+  bool CanReadConcurrently();
+
+  void LockForWrite();
+
   Application* app_;
 
   // Alias -> filename
@@ -114,6 +179,18 @@ class Database : public QObject {
   QMutex connect_mutex_;
   QMutex mutex_;
 
+  // Set when the main database is in WAL mode, so readers don't block on
+  // writers.  Never true for in-memory databases.  Decided once by the first
+  // connection, under connect_mutex_, but read by every thread.
+  QAtomicInt wal_enabled_;
+  bool wal_checked_;
+
+  mutable QMutex lock_stats_mutex_;
+  LockStats lock_stats_;
+  QTimer* lock_stats_timer_;
+  // The number of locks taken as of the last time the stats were logged.
+  int logged_lock_count_;
+
   // This ID makes the QSqlDatabase name unique to the object as well as the
   // thread
   int connection_id_;
@@ -0,0 +1,261 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "inotifyfslistener.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <QFile>
+#include <QSocketNotifier>
+
+#include "core/logging.h"
+#include "library/directorysnapshot.h"
+
+const int InotifyFSListener::kBatchInterval = 500;  // msec
+const int InotifyFSListener::kPollInterval = 60000;  // msec
+
+// IN_MODIFY is left out on purpose: it fires for every write while a file is
+// being copied, and IN_CLOSE_WRITE says the same thing once it's finished.
+const quint32 InotifyFSListener::kEventMask =
+    IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE |
+    IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+InotifyFSListener::InotifyFSListener(QObject* parent)
+    : FileSystemWatcherInterface(parent),
+      fd_(-1),
+      notifier_(nullptr),
+      queued_events_(0),
+      batch_timer_(this),
+      poll_timer_(this) {
+  batch_timer_.setSingleShot(true);
+  batch_timer_.setInterval(kBatchInterval);
+  connect(&batch_timer_, SIGNAL(timeout()), SLOT(EmitBatch()));
+
+  poll_timer_.setInterval(kPollInterval);
+  connect(&poll_timer_, SIGNAL(timeout()), SLOT(Poll()));
+}
+
+InotifyFSListener::~InotifyFSListener() {
+  delete notifier_;
+  if (fd_ != -1) close(fd_);
+}
+
+void InotifyFSListener::Init() {
+  fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd_ == -1) {
+    qLog(Warning) << "Couldn't start inotify, polling directories instead:"
+                  << strerror(errno);
+    return;
+  }
+
+  notifier_ = new QSocketNotifier(fd_, QSocketNotifier::Read, this);
+  connect(notifier_, SIGNAL(activated(int)), SLOT(ReadEvents()));
+}
+
+void InotifyFSListener::AddPath(const QString& path) {
+  if (wds_by_path_.contains(path) || polled_.contains(path)) return;
+
+  if (fd_ != -1) {
+    if (AddWatch(path)) return;
+
+    if (errno != ENOSPC && errno != ENOMEM) {
+      qLog(Warning) << "Couldn't watch" << path << ":" << strerror(errno);
+      return;
+    }
+  }
+
+  StartPolling(path);
+}
+
+void InotifyFSListener::RemovePath(const QString& path) {
+  pending_.remove(path);
+  RemoveWatch(path);
+
+  if (polled_.remove(path) && polled_.isEmpty()) poll_timer_.stop();
+}
+
+void InotifyFSListener::Clear() {
+  for (int wd : paths_by_wd_.uniqueKeys()) {
+    inotify_rm_watch(fd_, wd);
+  }
+  paths_by_wd_.clear();
+  wds_by_path_.clear();
+  polled_.clear();
+  pending_.clear();
+  queued_events_ = 0;
+
+  batch_timer_.stop();
+  poll_timer_.stop();
+}
+
+bool InotifyFSListener::AddWatch(const QString& path) {
+  const int wd =
+      inotify_add_watch(fd_, QFile::encodeName(path).constData(), kEventMask);
+  if (wd == -1) return false;
+
+  paths_by_wd_.insert(wd, path);
+  wds_by_path_[path] = wd;
+  return true;
+}
+
+void InotifyFSListener::RemoveWatch(const QString& path) {
+  QHash<QString, int>::iterator it = wds_by_path_.find(path);
+  if (it == wds_by_path_.end()) return;
+
+  const int wd = it.value();
+  wds_by_path_.erase(it);
+  paths_by_wd_.remove(wd, path);
+  if (!paths_by_wd_.contains(wd)) inotify_rm_watch(fd_, wd);
+}
+
+void InotifyFSListener::StartPolling(const QString& path) {
+  if (polled_.isEmpty()) {
+    if (fd_ != -1) {
+      qLog(Warning) << "Ran out of inotify watches after" << watch_count()
+                    << "directories, polling the rest every"
+                    << kPollInterval / 1000 << "seconds instead."
+                    << "Raising fs.inotify.max_user_watches will avoid this.";
+    }
+    poll_timer_.start();
+  }
+
+  polled_[path] = Fingerprint(path);
+}
+
+void InotifyFSListener::ReadEvents() {
+  // Aligned as inotify(7) recommends, and big enough for a few hundred events.
+  char buffer[16384]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+
+  while (true) {
+    const ssize_t length = read(fd_, buffer, sizeof(buffer));
+    if (length == -1 && errno == EINTR) continue;
+
+    // The descriptor is non-blocking, so this is EAGAIN once the queue is
+    // empty.
+    if (length <= 0) break;
+
+    const char* p = buffer;
+    while (p < buffer + length) {
+      const struct inotify_event* event =
+          reinterpret_cast<const struct inotify_event*>(p);
+      p += sizeof(struct inotify_event) + event->len;
+      ++queued_events_;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        // Events were dropped, so any directory might have changed.
+        qLog(Warning) << "The inotify queue overflowed, rescanning every"
+                      << "watched directory";
+        for (const QString& path : wds_by_path_.keys()) {
+          Queue(path);
+        }
+        continue;
+      }
+
+      const QList<QString> paths = paths_by_wd_.values(event->wd);
+
+      if (event->mask & IN_IGNORED) {
+        // The kernel dropped the watch because the directory was deleted or
+        // unmounted.  Its parent reports the deletion.
+        for (const QString& path : paths) {
+          wds_by_path_.remove(path);
+        }
+        paths_by_wd_.remove(event->wd);
+        continue;
+      }
+
+      for (const QString& path : paths) {
+        Queue(path);
+
+        // The watch follows the directory to its new name, so stop using it.
+        // Rescanning the old parent will add the new path if it's still in
+        // the library.
+        if (event->mask & IN_MOVE_SELF) RemoveWatch(path);
+      }
+    }
+  }
+}
+
+void InotifyFSListener::Queue(const QString& path) {
+  pending_.insert(path);
+
+  // Not restarted, so a directory that keeps changing is still reported every
+  // kBatchInterval.
+  if (!batch_timer_.isActive()) batch_timer_.start();
+}
+
+void InotifyFSListener::EmitBatch() {
+  qLog(Debug) << queued_events_ << "filesystem events in" << pending_.count()
+              << "directories," << watch_count() << "directories watched,"
+              << polled_count() << "polled";
+
+  const QSet<QString> paths = pending_;
+  pending_.clear();
+  queued_events_ = 0;
+
+  for (const QString& path : paths) {
+    emit PathChanged(path);
+  }
+}
+
+void InotifyFSListener::Poll() {
+  bool watches_left = fd_ != -1;
+
+  QHash<QString, quint64>::iterator it = polled_.begin();
+  while (it != polled_.end()) {
+    const quint64 fingerprint = Fingerprint(it.key());
+    if (fingerprint != it.value()) {
+      it.value() = fingerprint;
+      ++queued_events_;
+      Queue(it.key());
+    }
+
+    // Give the directory a watch again if some have been freed up.
+    if (watches_left && AddWatch(it.key())) {
+      it = polled_.erase(it);
+    } else {
+      watches_left = watches_left && errno != ENOSPC && errno != ENOMEM;
+      ++it;
+    }
+  }
+
+  if (polled_.isEmpty()) {
+    qLog(Info) << "Every directory is watched by inotify again";
+    poll_timer_.stop();
+  }
+}
+
+quint64 InotifyFSListener::Fingerprint(const QString& path) {
+  // Summed so the order the children are listed in doesn't matter.
+  quint64 ret = 0;
+  for (const DirectorySnapshot::Child& child :
+       DirectorySnapshot::List(path)) {
+    quint64 hash = qHash(child.path);
+    hash = hash * 31 + child.stat.inode;
+
+    // Subdirectories are watched or polled themselves, so only adding or
+    // removing them matters here.
+    if (!child.is_dir) {
+      hash = hash * 31 + child.stat.size;
+      hash = hash * 31 + child.stat.mtime_nsec;
+    }
+    ret += hash;
+  }
+  return ret;
+}
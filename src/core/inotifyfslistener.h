@@ -0,0 +1,96 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_INOTIFYFSLISTENER_H_
+#define CORE_INOTIFYFSLISTENER_H_
+
+#include <QHash>
+#include <QMultiHash>
+#include <QSet>
+#include <QTimer>
+
+#include "filesystemwatcherinterface.h"
+
+class QSocketNotifier;
+
+// Watches directories with inotify directly instead of through
+// QFileSystemWatcher.  Only the events that can change what's in the library
+// are requested, and everything that happens in one directory within
+// kBatchInterval is reported by a single PathChanged.
+//
+// If the kernel runs out of watches (fs.inotify.max_user_watches) the
+// remaining directories are polled every kPollInterval instead, by comparing
+// the stat of their children, and are given watches again once some are
+// freed up.
+class InotifyFSListener : public FileSystemWatcherInterface {
+  Q_OBJECT
+
+ public:
+  explicit InotifyFSListener(QObject* parent = nullptr);
+  ~InotifyFSListener();
+
+  void Init();
+  void AddPath(const QString& path);
+  void RemovePath(const QString& path);
+  void Clear();
+
+  // The number of directories watched by inotify and the number being polled
+  // because there weren't enough watches.
+  int watch_count() const { return wds_by_path_.count(); }
+  int polled_count() const { return polled_.count(); }
+
+  // The number of events received since the last batch was reported.
+  int queued_event_count() const { return queued_events_; }
+
+ private slots:
+  void ReadEvents();
+  void EmitBatch();
+  void Poll();
+
+ private:
+  static const int kBatchInterval;
+  static const int kPollInterval;
+  static const quint32 kEventMask;
+
+  // Returns false and leaves errno set if the kernel refused the watch.
+  bool AddWatch(const QString& path);
+  void RemoveWatch(const QString& path);
+  void StartPolling(const QString& path);
+  void Queue(const QString& path);
+
+  // Changes whenever a file in path is added, removed or written to.
+  static quint64 Fingerprint(const QString& path);
+
+  int fd_;
+  QSocketNotifier* notifier_;
+
+  // inotify gives two paths to the same directory the same descriptor, so
+  // more than one path can share a watch.
+  QMultiHash<int, QString> paths_by_wd_;
+  QHash<QString, int> wds_by_path_;
+
+  // Directories that couldn't be given a watch, and their fingerprints when
+  // they were last polled.
+  QHash<QString, quint64> polled_;
+
+  QSet<QString> pending_;
+  int queued_events_;
+
+  QTimer batch_timer_;
+  QTimer poll_timer_;
+};
+
+#endif  // CORE_INOTIFYFSLISTENER_H_
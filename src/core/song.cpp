@@ -135,6 +135,9 @@ const QString Song::kFtsBindSpec =
     Utilities::Prepend(":", Song::kFtsColumns).join(", ");
 const QString Song::kFtsUpdateSpec =
     Utilities::Updateify(Song::kFtsColumns).join(", ");
+const QString Song::kFtsSourceColumnSpec =
+    "title, album, artist, albumartist, composer, performer, grouping, genre, "
+    "comment";
 
 const QString Song::kManuallyUnsetCover = "(unset)";
 const QString Song::kEmbeddedCover = "(embedded)";
@@ -291,6 +294,8 @@ bool Song::is_compilation() const {
   return (d->compilation_ || d->sampler_ || d->forced_compilation_on_) &&
          !d->forced_compilation_off_;
 }
+bool Song::compilation() const { return d->compilation_; }
+bool Song::sampler() const { return d->sampler_; }
 float Song::rating() const { return d->rating_; }
 int Song::playcount() const { return d->playcount_; }
 int Song::skipcount() const { return d->skipcount_; }
@@ -891,72 +896,80 @@ void Song::MergeFromSimpleMetaBundle(const Engine::SimpleMetaBundle& bundle) {
 }
 
 void Song::BindToQuery(QSqlQuery* query) const {
+  BindToQuery(query, QString());
+}
+
+void Song::BindToQuery(QSqlQuery* query, const QString& suffix) const {
 #define strval(x) (x.isNull() ? "" : x)
 #define intval(x) (x <= 0 ? -1 : x)
 #define notnullintval(x) (x == -1 ? QVariant() : x)
 
   // Remember to bind these in the same order as kBindSpec
 
-  query->bindValue(":title", strval(d->title_));
-  query->bindValue(":album", strval(d->album_));
-  query->bindValue(":artist", strval(d->artist_));
-  query->bindValue(":albumartist", strval(d->albumartist_));
-  query->bindValue(":composer", strval(d->composer_));
-  query->bindValue(":track", intval(d->track_));
-  query->bindValue(":disc", intval(d->disc_));
-  query->bindValue(":bpm", intval(d->bpm_));
-  query->bindValue(":year", intval(d->year_));
-  query->bindValue(":genre", strval(d->genre_));
-  query->bindValue(":comment", strval(d->comment_));
-  query->bindValue(":compilation", d->compilation_ ? 1 : 0);
+  query->bindValue(":title" + suffix, strval(d->title_));
+  query->bindValue(":album" + suffix, strval(d->album_));
+  query->bindValue(":artist" + suffix, strval(d->artist_));
+  query->bindValue(":albumartist" + suffix, strval(d->albumartist_));
+  query->bindValue(":composer" + suffix, strval(d->composer_));
+  query->bindValue(":track" + suffix, intval(d->track_));
+  query->bindValue(":disc" + suffix, intval(d->disc_));
+  query->bindValue(":bpm" + suffix, intval(d->bpm_));
+  query->bindValue(":year" + suffix, intval(d->year_));
+  query->bindValue(":genre" + suffix, strval(d->genre_));
+  query->bindValue(":comment" + suffix, strval(d->comment_));
+  query->bindValue(":compilation" + suffix, d->compilation_ ? 1 : 0);
 
-  query->bindValue(":bitrate", intval(d->bitrate_));
-  query->bindValue(":samplerate", intval(d->samplerate_));
+  query->bindValue(":bitrate" + suffix, intval(d->bitrate_));
+  query->bindValue(":samplerate" + suffix, intval(d->samplerate_));
 
-  query->bindValue(":directory", notnullintval(d->directory_id_));
+  query->bindValue(":directory" + suffix, notnullintval(d->directory_id_));
 
   if (Application::kIsPortable &&
       Utilities::UrlOnSameDriveAsClementine(d->url_)) {
-    query->bindValue(":filename", Utilities::GetRelativePathToClementineBin(
-                                      d->url_).toEncoded());
+    query->bindValue(
+        ":filename" + suffix,
+        Utilities::GetRelativePathToClementineBin(d->url_).toEncoded());
   } else {
-    query->bindValue(":filename", d->url_.toEncoded());
+    query->bindValue(":filename" + suffix, d->url_.toEncoded());
   }
 
-  query->bindValue(":mtime", notnullintval(d->mtime_));
-  query->bindValue(":ctime", notnullintval(d->ctime_));
-  query->bindValue(":filesize", notnullintval(d->filesize_));
+  query->bindValue(":mtime" + suffix, notnullintval(d->mtime_));
+  query->bindValue(":ctime" + suffix, notnullintval(d->ctime_));
+  query->bindValue(":filesize" + suffix, notnullintval(d->filesize_));
 
-  query->bindValue(":sampler", d->sampler_ ? 1 : 0);
-  query->bindValue(":art_automatic", d->art_automatic_);
-  query->bindValue(":art_manual", d->art_manual_);
+  query->bindValue(":sampler" + suffix, d->sampler_ ? 1 : 0);
+  query->bindValue(":art_automatic" + suffix, d->art_automatic_);
+  query->bindValue(":art_manual" + suffix, d->art_manual_);
 
-  query->bindValue(":filetype", d->filetype_);
-  query->bindValue(":playcount", d->playcount_);
-  query->bindValue(":lastplayed", intval(d->lastplayed_));
-  query->bindValue(":rating", intval(d->rating_));
+  query->bindValue(":filetype" + suffix, d->filetype_);
+  query->bindValue(":playcount" + suffix, d->playcount_);
+  query->bindValue(":lastplayed" + suffix, intval(d->lastplayed_));
+  query->bindValue(":rating" + suffix, intval(d->rating_));
 
-  query->bindValue(":forced_compilation_on", d->forced_compilation_on_ ? 1 : 0);
-  query->bindValue(":forced_compilation_off",
+  query->bindValue(":forced_compilation_on" + suffix,
+                   d->forced_compilation_on_ ? 1 : 0);
+  query->bindValue(":forced_compilation_off" + suffix,
                    d->forced_compilation_off_ ? 1 : 0);
 
-  query->bindValue(":effective_compilation", is_compilation() ? 1 : 0);
+  query->bindValue(":effective_compilation" + suffix,
+                   is_compilation() ? 1 : 0);
 
-  query->bindValue(":skipcount", d->skipcount_);
-  query->bindValue(":score", d->score_);
+  query->bindValue(":skipcount" + suffix, d->skipcount_);
+  query->bindValue(":score" + suffix, d->score_);
 
-  query->bindValue(":beginning", d->beginning_);
-  query->bindValue(":length", intval(length_nanosec()));
+  query->bindValue(":beginning" + suffix, d->beginning_);
+  query->bindValue(":length" + suffix, intval(length_nanosec()));
 
-  query->bindValue(":cue_path", d->cue_path_);
-  query->bindValue(":unavailable", d->unavailable_ ? 1 : 0);
-  query->bindValue(":effective_albumartist", this->effective_albumartist());
+  query->bindValue(":cue_path" + suffix, d->cue_path_);
+  query->bindValue(":unavailable" + suffix, d->unavailable_ ? 1 : 0);
+  query->bindValue(":effective_albumartist" + suffix,
+                   this->effective_albumartist());
 
-  query->bindValue(":etag", strval(d->etag_));
+  query->bindValue(":etag" + suffix, strval(d->etag_));
 
-  query->bindValue(":performer", strval(d->performer_));
-  query->bindValue(":grouping", strval(d->grouping_));
-  query->bindValue(":lyrics", strval(d->lyrics_));
+  query->bindValue(":performer" + suffix, strval(d->performer_));
+  query->bindValue(":grouping" + suffix, strval(d->grouping_));
+  query->bindValue(":lyrics" + suffix, strval(d->lyrics_));
 
 #undef intval
 #undef notnullintval
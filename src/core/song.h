@@ -78,6 +78,9 @@ class Song {
   static const QString kFtsColumnSpec;
   static const QString kFtsBindSpec;
   static const QString kFtsUpdateSpec;
+  // The columns of the songs table that kFtsColumns are filled from, in the
+  // same order.
+  static const QString kFtsSourceColumnSpec;
 
   static const QString kManuallyUnsetCover;
   static const QString kEmbeddedCover;
@@ -147,6 +150,9 @@ class Song {
 
   // Save
   void BindToQuery(QSqlQuery* query) const;
+  // Binds to placeholders named like kBindSpec with suffix appended to each
+  // name, so several songs can be bound to one multi-row statement.
+  void BindToQuery(QSqlQuery* query, const QString& suffix) const;
   void BindToFtsQuery(QSqlQuery* query) const;
 #ifdef HAVE_LIBLASTFM
   void ToLastFM(lastfm::Track* track, bool prefer_album_artist) const;
@@ -179,6 +185,9 @@ class Song {
   const QString& genre() const;
   const QString& comment() const;
   bool is_compilation() const;
+  // The flags is_compilation() is derived from.
+  bool compilation() const;
+  bool sampler() const;
   float rating() const;
   int playcount() const;
   int skipcount() const;
@@ -57,6 +57,17 @@ TagReaderReply* TagReaderClient::ReadFile(const QString& filename) {
   return worker_pool_->SendMessageWithReply(&message);
 }
 
+TagReaderReply* TagReaderClient::ReadFiles(const QStringList& filenames) {
+  pb::tagreader::Message message;
+  pb::tagreader::ReadFilesRequest* req = message.mutable_read_files_request();
+
+  for (const QString& filename : filenames) {
+    req->add_filenames(DataCommaSizeFromQString(filename));
+  }
+
+  return worker_pool_->SendMessageWithReply(&message);
+}
+
 TagReaderReply* TagReaderClient::SaveFile(const QString& filename,
                                           const Song& metadata) {
   pb::tagreader::Message message;
@@ -151,6 +162,45 @@ void TagReaderClient::ReadFileBlocking(const QString& filename, Song* song) {
   reply->deleteLater();
 }
 
+void TagReaderClient::WaitForReadFile(TagReaderReply* reply, Song* song) {
+  Q_ASSERT(QThread::currentThread() != thread());
+
+  if (reply->WaitForFinished() && song) {
+    song->InitFromProtobuf(reply->message().read_file_response().metadata());
+  }
+
+  // The handler has forgotten about the reply by the time it's finished, so
+  // it can be deleted straight away.  deleteLater() would never run on a
+  // thread pool thread.
+  delete reply;
+}
+
+bool TagReaderClient::WaitForReadFiles(TagReaderReply* reply,
+                                       SongList* songs) {
+  Q_ASSERT(QThread::currentThread() != thread());
+
+  const bool success = reply->WaitForFinished();
+
+  if (songs) {
+    const pb::tagreader::ReadFilesRequest& request =
+        reply->request_message().read_files_request();
+    const pb::tagreader::ReadFilesResponse& response =
+        reply->message().read_files_response();
+
+    for (int i = 0; i < request.filenames_size(); ++i) {
+      Song song;
+      if (success && i < response.metadata_size()) {
+        song.InitFromProtobuf(response.metadata(i));
+      }
+      *songs << song;
+    }
+  }
+
+  // See WaitForReadFile().
+  delete reply;
+  return success;
+}
+
 bool TagReaderClient::SaveFileBlocking(const QString& filename,
                                        const Song& metadata) {
   Q_ASSERT(QThread::currentThread() != thread());
@@ -219,7 +269,10 @@ QImage TagReaderClient::LoadEmbeddedArtBlocking(const QString& filename) {
         reply->message().load_embedded_art_response().data();
     ret.loadFromData(QByteArray(data_str.data(), data_str.size()));
   }
-  reply->deleteLater();
+
+  // This is called from the album cover loader's thread pool, where
+  // deleteLater() would never run.  See WaitForReadFile().
+  delete reply;
 
   return ret;
 }
@@ -45,6 +45,8 @@ class TagReaderClient : public QObject {
   void Start();
 
   ReplyType* ReadFile(const QString& filename);
+  // Reads the tags of several files with one request to a worker.
+  ReplyType* ReadFiles(const QStringList& filenames);
   ReplyType* SaveFile(const QString& filename, const Song& metadata);
   ReplyType* UpdateSongStatistics(const Song& metadata);
   ReplyType* UpdateSongRating(const Song& metadata);
@@ -64,6 +66,18 @@ class TagReaderClient : public QObject {
   bool IsMediaFileBlocking(const QString& filename);
   QImage LoadEmbeddedArtBlocking(const QString& filename);
 
+  // Waits for a reply returned by ReadFile() and deletes it.  song may be
+  // nullptr if the result isn't wanted any more.  Like the functions above
+  // this must NOT be called from the TagReaderClient's thread, but unlike
+  // them it's safe to use from threads without an event loop.
+  void WaitForReadFile(ReplyType* reply, Song* song);
+  // The same for a reply returned by ReadFiles().  songs, if not nullptr, is
+  // given one song for each file in the order they were requested.  Files
+  // that couldn't be read give invalid songs.  Returns false if the whole
+  // request failed, for example because the worker crashed on one of the
+  // files, in which case every song is invalid.
+  bool WaitForReadFiles(ReplyType* reply, SongList* songs);
+
   // TODO(David Sansome): Make this not a singleton
   static TagReaderClient* Instance() { return sInstance; }
 
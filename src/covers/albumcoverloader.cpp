@@ -24,11 +24,15 @@
 #include <QPainter>
 #include <QDir>
 #include <QCoreApplication>
+#include <QFutureWatcher>
+#include <QImageReader>
+#include <QStringList>
 #include <QUrl>
 #include <QNetworkReply>
 
 #include "config.h"
 #include "core/closure.h"
+#include "core/concurrentrun.h"
 #include "core/logging.h"
 #include "core/network.h"
 #include "core/tagreaderclient.h"
@@ -39,9 +43,43 @@
 AlbumCoverLoader::AlbumCoverLoader(QObject* parent)
     : QObject(parent),
       stop_requested_(false),
+      thumbnails_(Utilities::GetConfigPath(Utilities::Path_CacheRoot) +
+                  "/albumcoverthumbnails"),
+      pending_decodes_(0),
       next_id_(1),
       network_(new NetworkAccessManager(this)),
-      connected_spotify_(false) {}
+      connected_spotify_(false) {
+  // This keeps one of the decode workers busy for a while, so it's counted
+  // with the decodes.
+  pending_decodes_++;
+  QFuture<void> future = ConcurrentRun::Run<void>(
+      &decode_pool_, std::bind(&AlbumCoverLoader::CleanUpCaches, this));
+  QFutureWatcher<void>* watcher = new QFutureWatcher<void>(this);
+  watcher->setFuture(future);
+  connect(watcher, SIGNAL(finished()), SLOT(CleanUpFinished()));
+}
+
+void AlbumCoverLoader::CleanUpCaches() {
+  thumbnails_.Prune(AlbumCoverThumbnailCache::kMaxSize);
+
+  // The library view kept its own cache of covers here before the thumbnail
+  // cache replaced it.
+  const QString pixmap_cache =
+      Utilities::GetConfigPath(Utilities::Path_CacheRoot) + "/pixmapcache";
+  if (QFile::exists(pixmap_cache)) {
+    if (Utilities::RemoveRecursive(pixmap_cache)) {
+      qLog(Info) << "Removed the old pixmap cache" << pixmap_cache;
+    } else {
+      qLog(Warning) << "Couldn't remove the old pixmap cache" << pixmap_cache;
+    }
+  }
+}
+
+void AlbumCoverLoader::CleanUpFinished() {
+  sender()->deleteLater();
+  pending_decodes_--;
+  ProcessTasks();
+}
 
 QString AlbumCoverLoader::ImageCacheDir() {
   return Utilities::GetConfigPath(Utilities::Path_AlbumCovers);
@@ -68,6 +106,39 @@ void AlbumCoverLoader::CancelTasks(const QSet<quint64>& ids) {
   }
 }
 
+void AlbumCoverLoader::PrioritiseTasks(const QList<quint64>& ids) {
+  const QSet<quint64> id_set = QSet<quint64>::fromList(ids);
+
+  QMutexLocker l(&mutex_);
+  int next = 0;
+  for (int i = 0; i < tasks_.count(); ++i) {
+    if (id_set.contains(tasks_[i].id)) {
+      tasks_.move(i, next++);
+    }
+  }
+}
+
+QString AlbumCoverLoader::TaskKey(const Task& task) {
+  // Embedded images would have to be compared by value, so they're never
+  // shared.
+  if (!task.embedded_image.isNull()) return QString();
+
+  QStringList key;
+  key << task.art_automatic << task.art_manual;
+  if (task.art_automatic == Song::kEmbeddedCover ||
+      task.art_manual == Song::kEmbeddedCover) {
+    key << task.song_filename;
+  }
+
+  const AlbumCoverLoaderOptions& options = task.options;
+  key << QString::number(options.desired_height_)
+      << QString::number(options.scale_output_image_)
+      << QString::number(options.pad_output_image_)
+      << QString::number(options.load_original_image_)
+      << QString::number(options.default_output_image_.cacheKey());
+  return key.join("\n");
+}
+
 quint64 AlbumCoverLoader::LoadImageAsync(const AlbumCoverLoaderOptions& options,
                                          const QString& art_automatic,
                                          const QString& art_manual,
@@ -80,6 +151,7 @@ quint64 AlbumCoverLoader::LoadImageAsync(const AlbumCoverLoaderOptions& options,
   task.song_filename = song_filename;
   task.embedded_image = embedded_image;
   task.state = State_TryingManual;
+  task.key = TaskKey(task);
 
   {
     QMutexLocker l(&mutex_);
@@ -93,7 +165,10 @@ quint64 AlbumCoverLoader::LoadImageAsync(const AlbumCoverLoaderOptions& options,
 }
 
 void AlbumCoverLoader::ProcessTasks() {
-  while (!stop_requested_) {
+  // Only take as many tasks as there are decode workers, so tasks that are
+  // prioritised later can still overtake the rest of the queue.
+  while (!stop_requested_ &&
+         pending_decodes_ < decode_pool_.maxThreadCount()) {
     // Get the next task
     Task task;
     {
@@ -102,6 +177,17 @@ void AlbumCoverLoader::ProcessTasks() {
       task = tasks_.dequeue();
     }
 
+    // If the same image is being loaded already, wait for that instead.
+    if (!task.key.isEmpty()) {
+      QMap<QString, QList<quint64>>::iterator it =
+          loading_keys_.find(task.key);
+      if (it != loading_keys_.end()) {
+        it->append(task.id);
+        continue;
+      }
+      loading_keys_.insert(task.key, QList<quint64>());
+    }
+
     ProcessTask(&task);
   }
 }
@@ -115,9 +201,8 @@ void AlbumCoverLoader::ProcessTask(Task* task) {
   }
 
   if (result.loaded_success) {
-    QImage scaled = ScaleAndPad(task->options, result.image);
-    emit ImageLoaded(task->id, scaled);
-    emit ImageLoaded(task->id, scaled, result.image);
+    TaskFinished(*task, ScaleAndPad(task->options, result.image),
+                 result.image);
     return;
   }
 
@@ -131,18 +216,32 @@ void AlbumCoverLoader::NextState(Task* task) {
     ProcessTask(task);
   } else {
     // Give up
-    emit ImageLoaded(task->id, task->options.default_output_image_);
-    emit ImageLoaded(task->id, task->options.default_output_image_,
-                     task->options.default_output_image_);
+    TaskFinished(*task, task->options.default_output_image_,
+                 task->options.default_output_image_);
+  }
+}
+
+void AlbumCoverLoader::TaskFinished(const Task& task, const QImage& scaled,
+                                    const QImage& original) {
+  QList<quint64> ids;
+  ids << task.id;
+  if (!task.key.isEmpty()) {
+    ids << loading_keys_.take(task.key);
+  }
+
+  for (quint64 id : ids) {
+    emit ImageLoaded(id, scaled);
+    emit ImageLoaded(id, scaled, original);
   }
 }
 
 AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(
     const Task& task) {
   // An image embedded in the song itself takes priority
-  if (!task.embedded_image.isNull())
-    return TryLoadResult(false, true,
-                         ScaleAndPad(task.options, task.embedded_image));
+  if (!task.embedded_image.isNull()) {
+    StartDecode(task);
+    return TryLoadResult(true, false, QImage());
+  }
 
   QString filename;
   switch (task.state) {
@@ -158,13 +257,8 @@ AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(
     return TryLoadResult(false, true, task.options.default_output_image_);
 
   if (filename == Song::kEmbeddedCover && !task.song_filename.isEmpty()) {
-    const QImage taglib_image =
-        TagReaderClient::Instance()->LoadEmbeddedArtBlocking(
-            task.song_filename);
-
-    if (!taglib_image.isNull())
-      return TryLoadResult(false, true,
-                           ScaleAndPad(task.options, taglib_image));
+    StartDecode(task);
+    return TryLoadResult(true, false, QImage());
   }
 
   if (filename.toLower().startsWith("http://") ||
@@ -198,10 +292,105 @@ AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(
     return TryLoadResult(true, false, QImage());
   }
 
-  QImage image(filename);
-  return TryLoadResult(
-      false, !image.isNull(),
-      image.isNull() ? task.options.default_output_image_ : image);
+  if (filename.isEmpty() || filename == Song::kEmbeddedCover) {
+    return TryLoadResult(false, false, task.options.default_output_image_);
+  }
+
+  StartDecode(task);
+  return TryLoadResult(true, false, QImage());
+}
+
+void AlbumCoverLoader::StartDecode(const Task& task) {
+  pending_decodes_++;
+
+  QFuture<DecodeResult> future =
+      ConcurrentRun::Run<DecodeResult>(&decode_pool_, [this, task]() {
+        return DecodeImage(task, &thumbnails_);
+      });
+  QFutureWatcher<DecodeResult>* watcher =
+      new QFutureWatcher<DecodeResult>(this);
+  watcher->setFuture(future);
+  NewClosure(watcher, SIGNAL(finished()), [this, watcher, task]() {
+    watcher->deleteLater();
+    DecodeFinished(task, watcher->result());
+  });
+}
+
+void AlbumCoverLoader::DecodeFinished(Task task, const DecodeResult& result) {
+  pending_decodes_--;
+
+  if (result.original.isNull()) {
+    NextState(&task);
+  } else {
+    TaskFinished(task, result.scaled, result.original);
+  }
+
+  // A worker is free, so start the next task.
+  ProcessTasks();
+}
+
+AlbumCoverLoader::DecodeResult AlbumCoverLoader::DecodeImage(
+    const Task& task, const AlbumCoverThumbnailCache* thumbnails) {
+  DecodeResult result;
+
+  if (!task.embedded_image.isNull()) {
+    result.original = ScaleAndPad(task.options, task.embedded_image);
+    result.scaled = ScaleAndPad(task.options, result.original);
+    return result;
+  }
+
+  const QString& filename = task.state == State_TryingAuto
+                                ? task.art_automatic
+                                : task.art_manual;
+  const bool embedded = filename == Song::kEmbeddedCover;
+
+  // Thumbnails of embedded art are kept under the song's filename.
+  const QString& source = embedded ? task.song_filename : filename;
+  const bool cacheable = AlbumCoverThumbnailCache::IsCacheable(task.options);
+  if (cacheable) {
+    const QImage thumbnail = thumbnails->Load(source, task.options);
+    if (!thumbnail.isNull()) {
+      result.original = thumbnail;
+      result.scaled = thumbnail;
+      return result;
+    }
+  }
+
+  if (embedded) {
+    const QImage taglib_image =
+        TagReaderClient::Instance()->LoadEmbeddedArtBlocking(
+            task.song_filename);
+    result.original = ScaleAndPad(task.options, taglib_image);
+  } else {
+    result.original = ReadImage(task.options, filename);
+  }
+
+  if (!result.original.isNull()) {
+    result.scaled = ScaleAndPad(task.options, result.original);
+    if (cacheable) {
+      thumbnails->Save(source, task.options, result.scaled);
+    }
+  }
+  return result;
+}
+
+QImage AlbumCoverLoader::ReadImage(const AlbumCoverLoaderOptions& options,
+                                   const QString& filename) {
+  QImageReader reader(filename);
+
+  if (options.scale_output_image_ && !options.load_original_image_ &&
+      reader.supportsOption(QImageIOHandler::ScaledSize)) {
+    // Some formats, like JPEG, can be decoded straight to a smaller size much
+    // faster than decoding the whole image and scaling it afterwards.
+    const QSize size = reader.size();
+    const QSize desired(options.desired_height_, options.desired_height_);
+    if (size.isValid() &&
+        (size.width() > desired.width() || size.height() > desired.height())) {
+      reader.setScaledSize(size.scaled(desired, Qt::KeepAspectRatio));
+    }
+  }
+
+  return reader.read();
 }
 
 void AlbumCoverLoader::SpotifyImageLoaded(const QString& id,
@@ -209,9 +398,7 @@ void AlbumCoverLoader::SpotifyImageLoaded(const QString& id,
   if (!remote_spotify_tasks_.contains(id)) return;
 
   Task task = remote_spotify_tasks_.take(id);
-  QImage scaled = ScaleAndPad(task.options, image);
-  emit ImageLoaded(task.id, scaled);
-  emit ImageLoaded(task.id, scaled, image);
+  TaskFinished(task, ScaleAndPad(task.options, image), image);
 }
 
 void AlbumCoverLoader::RemoteFetchFinished(QNetworkReply* reply) {
@@ -224,7 +411,8 @@ void AlbumCoverLoader::RemoteFetchFinished(QNetworkReply* reply) {
       reply->attribute(QNetworkRequest::RedirectionTargetAttribute);
   if (redirect.isValid()) {
     if (++task.redirects > kMaxRedirects) {
-      return;  // Give up.
+      NextState(&task);  // Give up.
+      return;
     }
     QNetworkRequest request = reply->request();
     request.setUrl(redirect.toUrl());
@@ -240,9 +428,7 @@ void AlbumCoverLoader::RemoteFetchFinished(QNetworkReply* reply) {
     // Try to load the image
     QImage image;
     if (image.load(reply, 0)) {
-      QImage scaled = ScaleAndPad(task.options, image);
-      emit ImageLoaded(task.id, scaled);
-      emit ImageLoaded(task.id, scaled, image);
+      TaskFinished(task, ScaleAndPad(task.options, image), image);
       return;
     }
   }
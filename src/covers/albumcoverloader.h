@@ -22,12 +22,14 @@
 #define COVERS_ALBUMCOVERLOADER_H_
 
 #include "albumcoverloaderoptions.h"
+#include "albumcoverthumbnailcache.h"
 #include "core/song.h"
 
 #include <QImage>
 #include <QMutex>
 #include <QObject>
 #include <QQueue>
+#include <QThreadPool>
 #include <QUrl>
 
 class NetworkAccessManager;
@@ -54,6 +56,10 @@ class AlbumCoverLoader : public QObject {
   void CancelTask(quint64 id);
   void CancelTasks(const QSet<quint64>& ids);
 
+  // Moves the tasks with these ids to the front of the queue, for covers that
+  // are on screen.
+  void PrioritiseTasks(const QList<quint64>& ids);
+
   static QPixmap TryLoadPixmap(const QString& automatic, const QString& manual,
                                const QString& filename = QString());
   static QImage ScaleAndPad(const AlbumCoverLoaderOptions& options,
@@ -67,6 +73,7 @@ class AlbumCoverLoader : public QObject {
   void ProcessTasks();
   void RemoteFetchFinished(QNetworkReply* reply);
   void SpotifyImageLoaded(const QString& url, const QImage& image);
+  void CleanUpFinished();
 
  protected:
   enum State { State_TryingManual, State_TryingAuto, };
@@ -83,6 +90,10 @@ class AlbumCoverLoader : public QObject {
     QImage embedded_image;
     State state;
     int redirects;
+
+    // Identifies the image this task will load.  Tasks with the same key
+    // share one load, empty keys are never shared.
+    QString key;
   };
 
   struct TryLoadResult {
@@ -94,14 +105,43 @@ class AlbumCoverLoader : public QObject {
     QImage image;
   };
 
+  struct DecodeResult {
+    QImage scaled;
+    QImage original;
+  };
+
+  static QString TaskKey(const Task& task);
+
   void ProcessTask(Task* task);
   void NextState(Task* task);
   TryLoadResult TryLoadImage(const Task& task);
+  void TaskFinished(const Task& task, const QImage& scaled,
+                    const QImage& original);
+
+  // Loads local files and embedded art on decode_pool_.
+  void StartDecode(const Task& task);
+  void DecodeFinished(Task task, const DecodeResult& result);
+  static DecodeResult DecodeImage(const Task& task,
+                                  const AlbumCoverThumbnailCache* thumbnails);
+  static QImage ReadImage(const AlbumCoverLoaderOptions& options,
+                          const QString& filename);
+
+  // Prunes the thumbnail cache and removes the library view's old pixmap
+  // cache.  Runs on decode_pool_.
+  void CleanUpCaches();
 
   bool stop_requested_;
 
   QMutex mutex_;
   QQueue<Task> tasks_;
+  // Keys of the tasks being loaded, and the ids of other tasks waiting for
+  // the same image.  Only used on the loader's thread.
+  QMap<QString, QList<quint64>> loading_keys_;
+  // Declared before decode_pool_, which waits for the workers using it when
+  // it's destroyed.
+  AlbumCoverThumbnailCache thumbnails_;
+  QThreadPool decode_pool_;
+  int pending_decodes_;
   QMap<QNetworkReply*, Task> remote_tasks_;
   QMap<QString, Task> remote_spotify_tasks_;
   quint64 next_id_;
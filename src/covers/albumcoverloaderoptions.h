@@ -26,11 +26,16 @@ struct AlbumCoverLoaderOptions {
   AlbumCoverLoaderOptions()
       : desired_height_(120),
         scale_output_image_(true),
-        pad_output_image_(true) {}
+        pad_output_image_(true),
+        load_original_image_(false) {}
 
   int desired_height_;
   bool scale_output_image_;
   bool pad_output_image_;
+  // If this is false, scaled images may be decoded straight to the output
+  // size or loaded from the thumbnail cache, and the original image passed to
+  // ImageLoaded may be the scaled one.
+  bool load_original_image_;
   QImage default_output_image_;
 };
 
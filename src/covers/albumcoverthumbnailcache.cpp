@@ -0,0 +1,132 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "albumcoverthumbnailcache.h"
+
+#include <utime.h>
+
+#include <algorithm>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+
+#include "core/logging.h"
+
+const qint64 AlbumCoverThumbnailCache::kMaxSize = 100000000;  // ~100MB
+const int AlbumCoverThumbnailCache::kTouchIntervalSecs = 60 * 60 * 24;
+
+AlbumCoverThumbnailCache::AlbumCoverThumbnailCache(const QString& directory)
+    : directory_(directory) {}
+
+bool AlbumCoverThumbnailCache::IsCacheable(
+    const AlbumCoverLoaderOptions& options) {
+  return options.scale_output_image_ && !options.load_original_image_;
+}
+
+QString AlbumCoverThumbnailCache::ThumbnailPath(
+    const QString& source, const AlbumCoverLoaderOptions& options) const {
+  const QFileInfo info(source);
+  if (!info.exists()) return QString();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(info.absoluteFilePath().toUtf8());
+  hash.addData(QByteArray::number(info.size()));
+  hash.addData(QByteArray::number(info.lastModified().toTime_t()));
+  hash.addData(QByteArray::number(options.desired_height_));
+  hash.addData(QByteArray::number(options.pad_output_image_));
+
+  // Spread the files over subdirectories so none of them gets too big.
+  const QString name = hash.result().toHex();
+  return directory_ + "/" + name.left(2) + "/" + name.mid(2) + ".png";
+}
+
+QImage AlbumCoverThumbnailCache::Load(
+    const QString& source, const AlbumCoverLoaderOptions& options) const {
+  const QString path = ThumbnailPath(source, options);
+  if (path.isEmpty()) return QImage();
+
+  const QFileInfo info(path);
+  if (!info.exists()) return QImage();
+
+  QImage ret(path, "PNG");
+  if (!ret.isNull() &&
+      info.lastModified().secsTo(QDateTime::currentDateTime()) >
+          kTouchIntervalSecs) {
+    utime(QFile::encodeName(path).constData(), nullptr);
+  }
+  return ret;
+}
+
+void AlbumCoverThumbnailCache::Save(const QString& source,
+                                    const AlbumCoverLoaderOptions& options,
+                                    const QImage& thumbnail) const {
+  const QString path = ThumbnailPath(source, options);
+  if (path.isEmpty() || thumbnail.isNull()) return;
+
+  QDir().mkpath(QFileInfo(path).path());
+
+  // Write to a file of our own and move it into place, so other threads
+  // never read a half-written thumbnail.
+  const QString temp_path =
+      path + QString(".%1.tmp").arg(quintptr(QThread::currentThreadId()));
+  if (!thumbnail.save(temp_path, "PNG")) {
+    qLog(Warning) << "Couldn't write thumbnail" << temp_path;
+    QFile::remove(temp_path);
+    return;
+  }
+
+  if (!QFile::rename(temp_path, path)) {
+    // Another thread saved the same thumbnail first.
+    QFile::remove(temp_path);
+  }
+}
+
+void AlbumCoverThumbnailCache::Prune(qint64 max_size) const {
+  QFileInfoList files;
+  qint64 total_size = 0;
+
+  QDirIterator it(directory_, QStringList() << "*.png", QDir::Files,
+                  QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    it.next();
+    files << it.fileInfo();
+    total_size += it.fileInfo().size();
+  }
+
+  if (total_size <= max_size) return;
+
+  std::sort(files.begin(), files.end(),
+            [](const QFileInfo& a, const QFileInfo& b) {
+    return a.lastModified() < b.lastModified();
+  });
+
+  int removed = 0;
+  for (const QFileInfo& info : files) {
+    if (total_size <= max_size) break;
+    if (QFile::remove(info.filePath())) {
+      total_size -= info.size();
+      removed++;
+    }
+  }
+
+  qLog(Debug) << "Removed" << removed << "least recently used album cover"
+              << "thumbnails";
+}
@@ -0,0 +1,67 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COVERS_ALBUMCOVERTHUMBNAILCACHE_H_
+#define COVERS_ALBUMCOVERTHUMBNAILCACHE_H_
+
+#include <QImage>
+#include <QString>
+
+#include "albumcoverloaderoptions.h"
+
+// Keeps album covers on disk already scaled and padded to the sizes they're
+// shown at, so they don't have to be decoded from the full size image again.
+//
+// Thumbnails are named after a hash of the source file's path, size and
+// modification time and of the options they were made with.  Changing the
+// art_automatic or art_manual path, or the file itself, means the old
+// thumbnail is never found again, and it's removed when the cache is pruned.
+// Loading a thumbnail updates its modification time, so the cache is pruned
+// in least recently used order.
+//
+// All methods are thread-safe.
+class AlbumCoverThumbnailCache {
+ public:
+  explicit AlbumCoverThumbnailCache(const QString& directory);
+
+  static const qint64 kMaxSize;
+
+  // Only images that are scaled without keeping the original are cached.
+  static bool IsCacheable(const AlbumCoverLoaderOptions& options);
+
+  // Returns a null image if there is no thumbnail of source for these options.
+  QImage Load(const QString& source,
+              const AlbumCoverLoaderOptions& options) const;
+  void Save(const QString& source, const AlbumCoverLoaderOptions& options,
+            const QImage& thumbnail) const;
+
+  // Removes the least recently used thumbnails until the cache is smaller
+  // than max_size.
+  void Prune(qint64 max_size) const;
+
+ private:
+  // Returns an empty string if source doesn't exist.
+  QString ThumbnailPath(const QString& source,
+                        const AlbumCoverLoaderOptions& options) const;
+
+  // A thumbnail's modification time is only updated if it's older than this,
+  // so loading the same thumbnail over and over doesn't write to the disk.
+  static const int kTouchIntervalSecs;
+
+  QString directory_;
+};
+
+#endif  // COVERS_ALBUMCOVERTHUMBNAILCACHE_H_
@@ -43,6 +43,7 @@ FilesystemDevice::FilesystemDevice(const QUrl& url, DeviceLister* lister,
                     DeviceManager::Role_FriendlyName).toString());
   watcher_->set_backend(backend_);
   watcher_->set_task_manager(app_->task_manager());
+  backend_->set_detect_compilations(true);
 
   connect(backend_, SIGNAL(DirectoryDiscovered(Directory, SubdirectoryList)),
           watcher_, SLOT(AddDirectory(Directory, SubdirectoryList)));
@@ -58,8 +59,6 @@ FilesystemDevice::FilesystemDevice(const QUrl& url, DeviceLister* lister,
           SLOT(AddOrUpdateSubdirs(SubdirectoryList)));
   connect(watcher_, SIGNAL(SubdirsMTimeUpdated(SubdirectoryList)), backend_,
           SLOT(AddOrUpdateSubdirs(SubdirectoryList)));
-  connect(watcher_, SIGNAL(CompilationsNeedUpdating()), backend_,
-          SLOT(UpdateCompilations()));
   connect(watcher_, SIGNAL(ScanStarted(int)), SIGNAL(TaskStarted(int)));
 }
 
@@ -18,18 +18,22 @@
 #ifndef BUFFERCONSUMER_H
 #define BUFFERCONSUMER_H
 
-#include <gst/gstbuffer.h>
+#include "bufferring.h"
 
 class GstEnginePipeline;
 
+// Something that wants the audio data being played.  Pipelines push a
+// reference to each buffer into the consumer's ring from the streaming
+// thread, and the consumer polls the ring from its own thread whenever it
+// wants more.  If the ring fills up the oldest buffers are thrown away.
 class BufferConsumer {
  public:
   virtual ~BufferConsumer() {}
 
-  // This is called in some unspecified GStreamer thread.
-  // Ownership of the buffer is transferred to the BufferConsumer and it should
-  // gst_buffer_unref it.
-  virtual void ConsumeBuffer(GstBuffer* buffer, int pipeline_id) = 0;
+  BufferRing* buffers() { return &buffers_; }
+
+ private:
+  BufferRing buffers_;
 };
 
 #endif  // BUFFERCONSUMER_H
@@ -0,0 +1,93 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bufferring.h"
+
+const int BufferRing::kDefaultCapacity = 32;
+
+BufferRing::BufferRing(int capacity)
+    : size_(RoundUpToPowerOfTwo(capacity)),
+      mask_(size_ - 1),
+      slots_(new Slot[size_]),
+      head_(0),
+      tail_(0),
+      writing_(0),
+      overruns_(0) {}
+
+BufferRing::~BufferRing() {
+  Clear();
+  delete[] slots_;
+}
+
+int BufferRing::RoundUpToPowerOfTwo(int value) {
+  int ret = 1;
+  while (ret < value) ret <<= 1;
+  return ret;
+}
+
+bool BufferRing::Push(GstBuffer* buffer, int pipeline_id) {
+  // Only one streaming thread may write at a time.  This is normally the
+  // only one, but a pipeline that's stopping can overlap with the next.
+  if (!writing_.testAndSetAcquire(0, 1)) {
+    overruns_.ref();
+    return false;
+  }
+
+  const uint head = head_;
+  while (true) {
+    const uint tail = tail_.fetchAndAddAcquire(0);
+    if (head - tail < uint(size_)) break;
+
+    // The ring is full, so take the oldest buffer back unless the reader gets
+    // to it first.
+    GstBuffer* oldest = slots_[tail & mask_].buffer;
+    if (tail_.testAndSetOrdered(tail, tail + 1)) {
+      gst_buffer_unref(oldest);
+      overruns_.ref();
+      break;
+    }
+  }
+
+  gst_buffer_ref(buffer);
+  slots_[head & mask_].buffer = buffer;
+  slots_[head & mask_].pipeline_id = pipeline_id;
+
+  // Publish the slot to the reader.
+  head_.fetchAndStoreRelease(head + 1);
+  writing_.fetchAndStoreRelease(0);
+  return true;
+}
+
+GstBuffer* BufferRing::Pop(int* pipeline_id) {
+  while (true) {
+    const uint tail = tail_.fetchAndAddAcquire(0);
+    if (tail == uint(head_.fetchAndAddAcquire(0))) return nullptr;
+
+    // The writer might throw this buffer away while we're reading the slot,
+    // in which case tail_ will have moved and we try the next one.
+    const Slot slot = slots_[tail & mask_];
+    if (tail_.testAndSetOrdered(tail, tail + 1)) {
+      if (pipeline_id) *pipeline_id = slot.pipeline_id;
+      return slot.buffer;
+    }
+  }
+}
+
+void BufferRing::Clear() {
+  while (GstBuffer* buffer = Pop(nullptr)) {
+    gst_buffer_unref(buffer);
+  }
+}
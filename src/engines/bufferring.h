@@ -0,0 +1,79 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BUFFERRING_H
+#define BUFFERRING_H
+
+#include <QAtomicInt>
+
+#include <gst/gstbuffer.h>
+
+// A fixed-size queue of GstBuffers handed from GStreamer's streaming threads
+// to one reader, which takes them out at its own rate.  Nothing is locked or
+// allocated when a buffer is pushed.  If the reader falls behind, or stops
+// reading altogether, the oldest buffer is thrown away to make room, so the
+// ring always holds the most recent data.  If two streaming threads push at
+// the same moment the second buffer is dropped.
+class BufferRing {
+ public:
+  static const int kDefaultCapacity;
+
+  explicit BufferRing(int capacity = kDefaultCapacity);
+  ~BufferRing();
+
+  // Called from a streaming thread.  Takes a reference to the buffer and
+  // returns true, or returns false if another thread was pushing.
+  bool Push(GstBuffer* buffer, int pipeline_id);
+
+  // Called from the reader's thread.  Returns the oldest buffer, or nullptr
+  // if the ring is empty.  The caller owns the returned reference.
+  GstBuffer* Pop(int* pipeline_id);
+
+  // Unrefs every buffer in the ring.  Called from the reader's thread.
+  void Clear();
+
+  // The number of buffers the reader never got, because they were thrown away
+  // to make room or pushed while another thread was pushing.
+  int overruns() const { return overruns_; }
+
+ private:
+  Q_DISABLE_COPY(BufferRing)
+
+  struct Slot {
+    GstBuffer* buffer;
+    int pipeline_id;
+  };
+
+  static int RoundUpToPowerOfTwo(int value);
+
+  // The size is a power of two so the counters below keep mapping to the
+  // same slots when they wrap around.
+  const int size_;
+  const uint mask_;
+  Slot* slots_;
+
+  // Counts of the buffers ever written and ever taken out.  They only go up,
+  // and the slot is the count & mask_.  head_ is only changed by the writer.
+  // tail_ is advanced by the reader, or by the writer when it throws away the
+  // oldest buffer, so both claim a slot with a compare-and-swap.
+  QAtomicInt head_;
+  QAtomicInt tail_;
+
+  QAtomicInt writing_;
+  QAtomicInt overruns_;
+};
+
+#endif  // BUFFERRING_H
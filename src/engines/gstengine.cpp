@@ -243,31 +243,38 @@ Engine::State GstEngine::state() const {
   }
 }
 
-void GstEngine::ConsumeBuffer(GstBuffer* buffer, int pipeline_id) {
-  // Schedule this to run in the GUI thread.  The buffer gets added to the
-  // queue and unreffed by UpdateScope.
-  if (!QMetaObject::invokeMethod(this, "AddBufferToScope",
-                                 Q_ARG(GstBuffer*, buffer),
-                                 Q_ARG(int, pipeline_id))) {
-    qLog(Warning) << "Failed to invoke AddBufferToScope on GstEngine";
-  }
-}
+void GstEngine::TakeNewBuffers() {
+  // Only the newest buffer from the current pipeline is drawn, so anything
+  // older that queued up since the last frame is thrown away.
+  int pipeline_id = -1;
+  while (GstBuffer* buf = buffers()->Pop(&pipeline_id)) {
+    if (!current_pipeline_ || current_pipeline_->id() != pipeline_id) {
+      gst_buffer_unref(buf);
+      continue;
+    }
 
-void GstEngine::AddBufferToScope(GstBuffer* buf, int pipeline_id) {
-  if (!current_pipeline_ || current_pipeline_->id() != pipeline_id) {
-    gst_buffer_unref(buf);
-    return;
-  }
+    if (latest_buffer_ != nullptr) {
+      gst_buffer_unref(latest_buffer_);
+    }
 
-  if (latest_buffer_ != nullptr) {
-    gst_buffer_unref(latest_buffer_);
+    latest_buffer_ = buf;
+    have_new_buffer_ = true;
   }
+}
 
-  latest_buffer_ = buf;
-  have_new_buffer_ = true;
+void GstEngine::LogBufferOverruns() {
+  // The analyzer's ring overruns whenever the analyzer is hidden, so these
+  // are only interesting while it's visible.
+  qLog(Debug) << "Analyzer buffer overruns:" << buffers()->overruns();
+  for (int i = 0; i < buffer_consumers_.count(); ++i) {
+    qLog(Debug) << "Buffer consumer" << i
+                << "overruns:" << buffer_consumers_[i]->buffers()->overruns();
+  }
 }
 
 const Engine::Scope& GstEngine::scope(int chunk_length) {
+  TakeNewBuffers();
+
   // the new buffer could have a different size
   if (have_new_buffer_) {
     if (latest_buffer_ != nullptr) {
@@ -524,6 +531,7 @@ void GstEngine::Stop(bool stop_after) {
 
   current_pipeline_.reset();
   BufferingFinished();
+  LogBufferOverruns();
   emit StateChanged(Engine::Empty);
 }
 
@@ -92,9 +92,6 @@ class GstEngine : public Engine::Base, public BufferConsumer {
 
   GstElement* CreateElement(const QString& factoryName, GstElement* bin = 0);
 
-  // BufferConsumer
-  void ConsumeBuffer(GstBuffer* buffer, int pipeline_id);
-
  public slots:
   void StartPreloading(const QUrl& url, bool force_stop_at_end,
                        qint64 beginning_nanosec, qint64 end_nanosec);
@@ -134,7 +131,6 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   void HandlePipelineError(int pipeline_id, const QString& message, int domain,
                            int error_code);
   void NewMetaData(int pipeline_id, const Engine::SimpleMetaBundle& bundle);
-  void AddBufferToScope(GstBuffer* buf, int pipeline_id);
   void FadeoutFinished();
   void FadeoutPauseFinished();
   void SeekNow();
@@ -170,6 +166,10 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   std::shared_ptr<GstEnginePipeline> CreatePipeline(const QUrl& url,
                                                     qint64 end_nanosec);
 
+  // Moves buffers queued by the pipelines into latest_buffer_.
+  void TakeNewBuffers();
+  // Logs how many buffers each consumer has missed so far.
+  void LogBufferOverruns();
   void UpdateScope(int chunk_length);
 
   int AddBackgroundStream(std::shared_ptr<GstEnginePipeline> pipeline);
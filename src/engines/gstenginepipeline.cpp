@@ -19,6 +19,7 @@
 
 #include <QCoreApplication>
 #include <QDir>
+#include <QThread>
 #include <QUuid>
 
 #include "bufferconsumer.h"
@@ -777,16 +778,18 @@ GstPadProbeReturn GstEnginePipeline::HandoffCallback(GstPad*,
   GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
   GstBuffer* buf = gst_pad_probe_info_get_buffer(info);
 
-  QList<BufferConsumer*> consumers;
-  {
-    QMutexLocker l(&instance->buffer_consumers_mutex_);
-    consumers = instance->buffer_consumers_;
-  }
-
-  for (BufferConsumer* consumer : consumers) {
-    gst_buffer_ref(buf);
-    consumer->ConsumeBuffer(buf, instance->id());
+  // Hand the buffer to every consumer without locking or allocating.
+  // RemoveBufferConsumer waits for handoffs_in_progress_ to reach zero before
+  // returning, so a consumer can't be deleted while it's being pushed to.
+  instance->handoffs_in_progress_.ref();
+  for (int i = 0; i < kMaxBufferConsumers; ++i) {
+    BufferConsumer* consumer =
+        instance->buffer_consumers_[i].fetchAndAddAcquire(0);
+    if (consumer) {
+      consumer->buffers()->Push(buf, instance->id());
+    }
   }
+  instance->handoffs_in_progress_.deref();
 
   // Calculate the end time of this buffer so we can stop playback if it's
   // after the end time of this song.
@@ -1131,17 +1134,34 @@ void GstEnginePipeline::timerEvent(QTimerEvent* e) {
 
 void GstEnginePipeline::AddBufferConsumer(BufferConsumer* consumer) {
   QMutexLocker l(&buffer_consumers_mutex_);
-  buffer_consumers_ << consumer;
+  for (int i = 0; i < kMaxBufferConsumers; ++i) {
+    if (buffer_consumers_[i].testAndSetOrdered(nullptr, consumer)) return;
+  }
+  qLog(Warning) << "Too many buffer consumers, ignoring" << consumer;
 }
 
 void GstEnginePipeline::RemoveBufferConsumer(BufferConsumer* consumer) {
   QMutexLocker l(&buffer_consumers_mutex_);
-  buffer_consumers_.removeAll(consumer);
+  for (int i = 0; i < kMaxBufferConsumers; ++i) {
+    buffer_consumers_[i].testAndSetOrdered(consumer, nullptr);
+  }
+  WaitForHandoffs();
 }
 
 void GstEnginePipeline::RemoveAllBufferConsumers() {
   QMutexLocker l(&buffer_consumers_mutex_);
-  buffer_consumers_.clear();
+  for (int i = 0; i < kMaxBufferConsumers; ++i) {
+    buffer_consumers_[i].fetchAndStoreOrdered(nullptr);
+  }
+  WaitForHandoffs();
+}
+
+void GstEnginePipeline::WaitForHandoffs() {
+  // Pushing a buffer never blocks, so this only spins for as long as it takes
+  // the streaming thread to finish the handoff it's in the middle of.
+  while (handoffs_in_progress_.fetchAndAddAcquire(0) != 0) {
+    QThread::yieldCurrentThread();
+  }
 }
 
 void GstEnginePipeline::SetNextUrl(const QUrl& url, qint64 beginning_nanosec,
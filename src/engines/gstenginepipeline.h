@@ -20,6 +20,8 @@
 
 #include <memory>
 
+#include <QAtomicInt>
+#include <QAtomicPointer>
 #include <QBasicTimer>
 #include <QFuture>
 #include <QMutex>
@@ -163,6 +165,9 @@ signals:
   // a src pad immediately and we can link it after everything's created.
   void MaybeLinkDecodeToAudio();
 
+  // Returns once no streaming thread is pushing to the buffer consumers.
+  void WaitForHandoffs();
+
  private slots:
   void FaderTimelineFinished();
 
@@ -189,8 +194,11 @@ signals:
   QString sink_;
   QVariant device_;
 
-  // These get called when there is a new audio buffer available
-  QList<BufferConsumer*> buffer_consumers_;
+  // These get fed each new audio buffer.  The streaming thread only reads
+  // the slots, so it never waits for the thread adding or removing consumers.
+  static const int kMaxBufferConsumers = 8;
+  QAtomicPointer<BufferConsumer> buffer_consumers_[kMaxBufferConsumers];
+  QAtomicInt handoffs_in_progress_;
   QMutex buffer_consumers_mutex_;
   qint64 segment_start_;
   bool segment_start_received_;
@@ -110,6 +110,36 @@ int GlobalSearch::SearchAsync(const QString& query) {
   return id;
 }
 
+bool GlobalSearch::CanLoadMoreResults(int id) const {
+  if (pending_search_providers_.contains(id)) return false;
+
+  for (SearchProvider* provider : providers_.keys()) {
+    if (is_provider_usable(provider) && provider->HasMoreResults(id)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool GlobalSearch::LoadMoreResultsAsync(int id) {
+  if (pending_search_providers_.contains(id)) return false;
+
+  QList<SearchProvider*> providers;
+  for (SearchProvider* provider : providers_.keys()) {
+    if (is_provider_usable(provider) && provider->HasMoreResults(id)) {
+      providers << provider;
+    }
+  }
+  if (providers.isEmpty()) return false;
+
+  // Finishing these counts the same way as finishing the search itself.
+  pending_search_providers_[id] = providers.count();
+  for (SearchProvider* provider : providers) {
+    provider->LoadMoreResultsAsync(id);
+  }
+  return true;
+}
+
 void GlobalSearch::CancelSearch(int id) {
   QMap<int, DelayedSearch>::iterator it;
   for (it = delayed_searches_.begin(); it != delayed_searches_.end(); ++it) {
@@ -46,6 +46,10 @@ class GlobalSearch : public QObject {
   bool SetProviderEnabled(const SearchProvider* provider, bool enabled);
 
   int SearchAsync(const QString& query);
+  // Providers can hold back some of their results until the user asks for
+  // more.  These return false while the search is still running.
+  bool CanLoadMoreResults(int id) const;
+  bool LoadMoreResultsAsync(int id);
   int LoadArtAsync(const SearchProvider::Result& result);
   MimeData* LoadTracks(const SearchProvider::ResultList& results);
   QStringList GetSuggestions(int count);
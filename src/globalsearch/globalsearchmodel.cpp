@@ -25,6 +25,7 @@ GlobalSearchModel::GlobalSearchModel(GlobalSearch* engine, QObject* parent)
     : QStandardItemModel(parent),
       engine_(engine),
       proxy_(nullptr),
+      search_id_(-1),
       use_pretty_covers_(true),
       artist_icon_(":/icons/22x22/x-clementine-artist.png"),
       album_icon_(":/icons/22x22/x-clementine-album.png") {
@@ -267,6 +268,18 @@ QMimeData* GlobalSearchModel::mimeData(const QModelIndexList& indexes) const {
   return engine_->LoadTracks(GetChildResults(indexes));
 }
 
+bool GlobalSearchModel::canFetchMore(const QModelIndex& parent) const {
+  // More results are added wherever they belong in the tree, so only ask for
+  // them when the bottom of the whole list is reached.
+  if (parent.isValid() || search_id_ == -1) return false;
+  return engine_->CanLoadMoreResults(search_id_);
+}
+
+void GlobalSearchModel::fetchMore(const QModelIndex& parent) {
+  if (parent.isValid() || search_id_ == -1) return;
+  engine_->LoadMoreResultsAsync(search_id_);
+}
+
 namespace {
 void GatherResults(const QStandardItem* parent,
                    QMap<SearchProvider*, SearchProvider::ResultList>* results) {
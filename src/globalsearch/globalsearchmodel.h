@@ -52,6 +52,10 @@ class GlobalSearchModel : public QStandardItemModel {
   }
   void SetGroupBy(const LibraryModel::Grouping& grouping, bool regroup_now);
 
+  // The search whose results are in the model.  When the view is scrolled to
+  // the bottom the model asks the engine for more results for it.
+  void set_search_id(int id) { search_id_ = id; }
+
   void Clear();
 
   SearchProvider::ResultList GetChildResults(const QModelIndexList& indexes)
@@ -61,6 +65,8 @@ class GlobalSearchModel : public QStandardItemModel {
 
   // QAbstractItemModel
   QMimeData* mimeData(const QModelIndexList& indexes) const;
+  bool canFetchMore(const QModelIndex& parent) const;
+  void fetchMore(const QModelIndex& parent);
 
  public slots:
   void AddResults(const SearchProvider::ResultList& results);
@@ -75,6 +81,7 @@ class GlobalSearchModel : public QStandardItemModel {
  private:
   GlobalSearch* engine_;
   QSortFilterProxyModel* proxy_;
+  int search_id_;
 
   LibraryModel::Grouping group_by_;
 
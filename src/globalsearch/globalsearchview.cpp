@@ -293,6 +293,7 @@ void GlobalSearchView::TextEdited(const QString& text) {
   } else {
     last_search_id_ = engine_->SearchAsync(trimmed);
   }
+  back_model_->set_search_id(last_search_id_);
 }
 
 void GlobalSearchView::AddResults(int id,
@@ -23,8 +23,11 @@
 #include "library/sqlrow.h"
 #include "playlist/songmimedata.h"
 
+#include <QMap>
 #include <QStack>
 
+const int LibrarySearchProvider::kResultsPerPage = 100;
+
 LibrarySearchProvider::LibrarySearchProvider(LibraryBackendInterface* backend,
                                              const QString& name,
                                              const QString& id,
@@ -44,23 +47,97 @@ LibrarySearchProvider::LibrarySearchProvider(LibraryBackendInterface* backend,
 
 SearchProvider::ResultList LibrarySearchProvider::Search(int id,
                                                          const QString& query) {
+  bool more = false;
+  ResultList ret = FindResults(query, 0, &more);
+
+  QMutexLocker l(&mutex_);
+  if (id > last_search_.id_) {
+    last_search_.id_ = id;
+    last_search_.query_ = query;
+    last_search_.loaded_ = kResultsPerPage;
+    last_search_.more_ = more;
+  }
+
+  return ret;
+}
+
+bool LibrarySearchProvider::HasMoreResults(int id) const {
+  QMutexLocker l(&mutex_);
+  return last_search_.id_ == id && last_search_.more_;
+}
+
+SearchProvider::ResultList LibrarySearchProvider::LoadMoreResults(int id) {
+  QString query;
+  int offset = 0;
+  {
+    QMutexLocker l(&mutex_);
+    if (last_search_.id_ != id || !last_search_.more_) return ResultList();
+    query = last_search_.query_;
+    offset = last_search_.loaded_;
+  }
+
+  bool more = false;
+  ResultList ret = FindResults(query, offset, &more);
+
+  QMutexLocker l(&mutex_);
+  if (last_search_.id_ == id) {
+    last_search_.loaded_ = offset + kResultsPerPage;
+    last_search_.more_ = more;
+  }
+
+  return ret;
+}
+
+SearchProvider::ResultList LibrarySearchProvider::FindResults(
+    const QString& query, int offset, bool* more) {
   QueryOptions options;
   options.set_filter(query);
 
+  const int limit = offset + kResultsPerPage;
+  ResultList ret;
+
+  // The song cache can rank the songs and find the best few without looking
+  // at the rest, so only those ever get loaded from the database.
+  LibraryBackend* library = qobject_cast<LibraryBackend*>(backend_);
+  QVector<int> ids;
+  if (library &&
+      library->song_cache()->FindBestSongs(options, limit, &ids, more)) {
+    ids = ids.mid(offset);
+
+    QMap<int, Song> songs;
+    for (const Song& song : library->GetSongsById(ids.toList())) {
+      songs[song.id()] = song;
+    }
+
+    // Keep the order they were ranked in.
+    for (int id : ids) {
+      if (!songs.contains(id)) continue;
+      Result result(this);
+      result.metadata_ = songs[id];
+      ret << result;
+    }
+    return ret;
+  }
+
   LibraryQuery q(options);
   q.SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
+  q.SetLimit(limit + 1);
 
   if (!backend_->ExecQuery(&q)) {
+    *more = false;
     return ResultList();
   }
 
-  // Build the result list
-  ResultList ret;
-  while (q.Next()) {
+  // Skip the rows that were returned already without loading them.
+  int skipped = 0;
+  while (skipped < offset && q.Next()) ++skipped;
+
+  while (ret.count() < kResultsPerPage && q.Next()) {
     Result result(this);
     result.metadata_.InitFromQuery(q, true);
     ret << result;
   }
+  *more = q.Next();
 
   return ret;
 }
@@ -20,6 +20,8 @@
 
 #include "searchprovider.h"
 
+#include <QMutex>
+
 class LibraryBackendInterface;
 
 class LibrarySearchProvider : public BlockingSearchProvider {
@@ -29,12 +31,38 @@ class LibrarySearchProvider : public BlockingSearchProvider {
                         bool enabled_by_default, Application* app,
                         QObject* parent = nullptr);
 
+  // Results are returned this many at a time.  If the library keeps a song
+  // cache these are the most relevant songs, otherwise they're in no
+  // particular order.
+  static const int kResultsPerPage;
+
   ResultList Search(int id, const QString& query);
+  bool HasMoreResults(int id) const;
+  ResultList LoadMoreResults(int id);
   MimeData* LoadTracks(const ResultList& results);
   QStringList GetSuggestions(int count);
 
  private:
+  // Returns up to kResultsPerPage results, skipping the first offset.  Sets
+  // more to true if there might be others after them.
+  ResultList FindResults(const QString& query, int offset, bool* more);
+
+ private:
+  struct LoadedSearch {
+    LoadedSearch() : id_(-1), loaded_(0), more_(false) {}
+
+    int id_;
+    QString query_;
+    int loaded_;
+    bool more_;
+  };
+
   LibraryBackendInterface* backend_;
+
+  // Only the most recent search can load more results.  Search() and
+  // LoadMoreResults() run in worker threads.
+  mutable QMutex mutex_;
+  LoadedSearch last_search_;
 };
 
 #endif  // LIBRARYSEARCHPROVIDER_H
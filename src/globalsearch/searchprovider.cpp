@@ -77,9 +77,17 @@ BlockingSearchProvider::BlockingSearchProvider(Application* app,
     : SearchProvider(app, parent) {}
 
 void BlockingSearchProvider::SearchAsync(int id, const QString& query) {
-  QFuture<ResultList> future =
-      QtConcurrent::run(this, &BlockingSearchProvider::Search, id, query);
+  WatchSearch(id, QtConcurrent::run(this, &BlockingSearchProvider::Search, id,
+                                    query));
+}
+
+void BlockingSearchProvider::LoadMoreResultsAsync(int id) {
+  WatchSearch(id, QtConcurrent::run(
+                      this, &BlockingSearchProvider::LoadMoreResults, id));
+}
 
+void BlockingSearchProvider::WatchSearch(int id,
+                                         const QFuture<ResultList>& future) {
   BoundFutureWatcher<ResultList, int>* watcher =
       new BoundFutureWatcher<ResultList, int>(id);
   watcher->setFuture(future);
@@ -18,6 +18,7 @@
 #ifndef SEARCHPROVIDER_H
 #define SEARCHPROVIDER_H
 
+#include <QFuture>
 #include <QIcon>
 #include <QMetaType>
 #include <QObject>
@@ -124,6 +125,15 @@ class SearchProvider : public QObject {
   // SearchFinished exactly once, using this ID.
   virtual void SearchAsync(int id, const QString& query) = 0;
 
+  // Returns true if the provider held back some results for this search that
+  // can be loaded with LoadMoreResultsAsync.
+  virtual bool HasMoreResults(int id) const { return false; }
+
+  // Starts loading the next page of results for a search that was started
+  // with SearchAsync.  Must emit ResultsAvailable zero or more times and then
+  // SearchFinished exactly once, using this ID.
+  virtual void LoadMoreResultsAsync(int id) { emit SearchFinished(id); }
+
   // Starts loading an icon for a result that was previously emitted by
   // ResultsAvailable.  Must emit ArtLoaded exactly once with this ID.
   virtual void LoadArtAsync(int id, const Result& result);
@@ -205,6 +215,12 @@ class BlockingSearchProvider : public SearchProvider {
   void SearchAsync(int id, const QString& query);
   virtual ResultList Search(int id, const QString& query) = 0;
 
+  void LoadMoreResultsAsync(int id);
+  virtual ResultList LoadMoreResults(int id) { return ResultList(); }
+
+ private:
+  void WatchSearch(int id, const QFuture<ResultList>& future);
+
  private slots:
   void BlockingSearchFinished();
 };
@@ -18,6 +18,7 @@
 #ifndef DIRECTORY_H
 #define DIRECTORY_H
 
+#include <QByteArray>
 #include <QList>
 #include <QString>
 #include <QMetaType>
@@ -45,6 +46,10 @@ struct Subdirectory {
   int directory_id;
   QString path;
   uint mtime;
+
+  // A serialised DirectorySnapshot of the files in this subdirectory, taken
+  // when it was last scanned.
+  QByteArray snapshot;
 };
 Q_DECLARE_METATYPE(Subdirectory)
 
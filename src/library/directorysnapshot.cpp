@@ -0,0 +1,155 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "directorysnapshot.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QIODevice>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#include "core/timeconstants.h"
+
+const quint8 DirectorySnapshot::kVersion = 1;
+
+#ifdef Q_OS_UNIX
+namespace {
+
+qint64 MtimeNsec(const struct stat& st) {
+#if defined(Q_OS_LINUX)
+  return qint64(st.st_mtim.tv_sec) * kNsecPerSec + st.st_mtim.tv_nsec;
+#elif defined(Q_OS_MAC)
+  return qint64(st.st_mtimespec.tv_sec) * kNsecPerSec +
+         st.st_mtimespec.tv_nsec;
+#else
+  return qint64(st.st_mtime) * kNsecPerSec;
+#endif
+}
+
+}  // namespace
+#endif
+
+QList<DirectorySnapshot::Child> DirectorySnapshot::List(const QString& path) {
+  QList<Child> ret;
+
+#ifdef Q_OS_UNIX
+  DIR* dir = opendir(QFile::encodeName(path).constData());
+  if (!dir) return ret;
+
+  const int fd = dirfd(dir);
+  while (struct dirent* entry = readdir(dir)) {
+    const char* name = entry->d_name;
+    if (qstrcmp(name, ".") == 0 || qstrcmp(name, "..") == 0) continue;
+
+    // Like QDir, this follows symlinks and skips broken ones, sockets, fifos
+    // and devices.
+    struct stat st;
+    if (fstatat(fd, name, &st, 0) != 0) continue;
+    if (!S_ISDIR(st.st_mode) && !S_ISREG(st.st_mode)) continue;
+
+    Child child;
+    child.path = path + "/" + QFile::decodeName(name);
+    child.is_dir = S_ISDIR(st.st_mode);
+    child.is_hidden = name[0] == '.';
+    child.stat.inode = st.st_ino;
+    child.stat.size = st.st_size;
+    child.stat.mtime_nsec = MtimeNsec(st);
+    ret << child;
+  }
+  closedir(dir);
+#else
+  // There are no inode numbers here, so the size and mtime have to do.
+  QDirIterator it(
+      path, QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot);
+  while (it.hasNext()) {
+    it.next();
+    const QFileInfo info(it.fileInfo());
+
+    Child child;
+    child.path = it.filePath();
+    child.is_dir = info.isDir();
+    child.is_hidden = info.isHidden();
+    child.stat.size = info.size();
+    child.stat.mtime_nsec =
+        info.lastModified().toMSecsSinceEpoch() * kNsecPerMsec;
+    ret << child;
+  }
+#endif
+
+  return ret;
+}
+
+void DirectorySnapshot::Insert(const QString& filename, const Stat& stat) {
+  files_[filename] = stat;
+}
+
+bool DirectorySnapshot::IsUnchanged(const QString& filename,
+                                    const Stat& stat) const {
+  QHash<QString, Stat>::const_iterator it = files_.constFind(filename);
+  return it != files_.constEnd() && it.value() == stat;
+}
+
+QByteArray DirectorySnapshot::Serialize() const {
+  QByteArray ret;
+  QDataStream s(&ret, QIODevice::WriteOnly);
+  s << kVersion << quint32(files_.count());
+
+  for (QHash<QString, Stat>::const_iterator it = files_.constBegin();
+       it != files_.constEnd(); ++it) {
+    s << it.key().toUtf8() << it.value().inode << it.value().size
+      << it.value().mtime_nsec;
+  }
+  return ret;
+}
+
+DirectorySnapshot DirectorySnapshot::Deserialize(const QByteArray& data) {
+  DirectorySnapshot ret;
+  if (data.isEmpty()) return ret;
+
+  QDataStream s(data);
+  quint8 version = 0;
+  quint32 count = 0;
+  s >> version >> count;
+  if (version != kVersion) return ret;
+
+  // The count comes from the disk, so only reserve space for as many entries
+  // as could actually fit in the rest of the data.  Each one is at least a
+  // 32 bit filename length and three 64 bit numbers.
+  const qint64 min_entry_size = sizeof(quint32) + 3 * sizeof(quint64);
+  const qint64 remaining = data.size() - s.device()->pos();
+  if (count > remaining / min_entry_size) return ret;
+
+  ret.files_.reserve(count);
+  for (quint32 i = 0; i < count && s.status() == QDataStream::Ok; ++i) {
+    QByteArray filename;
+    Stat stat;
+    s >> filename >> stat.inode >> stat.size >> stat.mtime_nsec;
+    ret.files_[QString::fromUtf8(filename)] = stat;
+  }
+
+  // Don't trust any of a snapshot that was cut short.
+  if (s.status() != QDataStream::Ok) return DirectorySnapshot();
+  return ret;
+}
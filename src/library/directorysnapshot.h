@@ -0,0 +1,80 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DIRECTORYSNAPSHOT_H
+#define DIRECTORYSNAPSHOT_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+// The inode, size and modification time of each file in one directory, as
+// they were when the directory was last scanned.  A file whose stat tuple
+// still matches hasn't been written to or replaced since then, so its tags
+// don't need reading again.
+//
+// Snapshots are stored with each Subdirectory row in the database by
+// Serialize() and read back by Deserialize().
+class DirectorySnapshot {
+ public:
+  struct Stat {
+    Stat() : inode(0), size(0), mtime_nsec(0) {}
+
+    bool operator==(const Stat& other) const {
+      return inode == other.inode && size == other.size &&
+             mtime_nsec == other.mtime_nsec;
+    }
+    bool operator!=(const Stat& other) const { return !(*this == other); }
+
+    quint64 inode;
+    qint64 size;
+    qint64 mtime_nsec;
+  };
+
+  // One file or directory found by List().
+  struct Child {
+    Child() : is_dir(false), is_hidden(false) {}
+
+    QString path;
+    bool is_dir;
+    bool is_hidden;
+    Stat stat;
+  };
+
+  // Lists the files and directories directly inside path, following symlinks,
+  // with a single pass over the directory that stats each child once.
+  static QList<Child> List(const QString& path);
+
+  void Insert(const QString& filename, const Stat& stat);
+
+  // Returns true if the file was in the snapshot with exactly this stat tuple.
+  bool IsUnchanged(const QString& filename, const Stat& stat) const;
+
+  bool is_empty() const { return files_.isEmpty(); }
+  int count() const { return files_.count(); }
+
+  QByteArray Serialize() const;
+  static DirectorySnapshot Deserialize(const QByteArray& data);
+
+ private:
+  static const quint8 kVersion;
+
+  // Keyed by the name of the file within the directory.
+  QHash<QString, Stat> files_;
+};
+
+#endif  // DIRECTORYSNAPSHOT_H
@@ -48,6 +48,7 @@ Library::Library(Application* app, QObject* parent)
 
   backend_->Init(app->database(), kSongsTable, kDirsTable, kSubdirsTable,
                  kFtsTable);
+  backend_->set_detect_compilations(true);
 
   using smart_playlists::Generator;
   using smart_playlists::GeneratorPtr;
@@ -156,8 +157,6 @@ void Library::Init() {
           SLOT(AddOrUpdateSubdirs(SubdirectoryList)));
   connect(watcher_, SIGNAL(SubdirsMTimeUpdated(SubdirectoryList)), backend_,
           SLOT(AddOrUpdateSubdirs(SubdirectoryList)));
-  connect(watcher_, SIGNAL(CompilationsNeedUpdating()), backend_,
-          SLOT(UpdateCompilations()));
   connect(app_->playlist_manager(), SIGNAL(CurrentSongChanged(Song)),
           SLOT(CurrentSongChanged(Song)));
   connect(app_->player(), SIGNAL(Stopped()), SLOT(Stopped()));
@@ -184,6 +183,8 @@ void Library::ReloadSettings() {
   save_statistics_in_files_ =
       s.value("save_statistics_in_file", false).toBool();
   save_ratings_in_files_ = s.value("save_ratings_in_file", false).toBool();
+
+  backend_->SetSongCacheEnabledAsync(s.value("song_cache", true).toBool());
 }
 
 void Library::WriteAllSongsStatisticsToFiles() {
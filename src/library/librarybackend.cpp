@@ -30,10 +30,13 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QSettings>
+#include <QTime>
 #include <QVariant>
 #include <QtDebug>
 
 const char* LibraryBackend::kSettingsGroup = "LibraryBackend";
+const int LibraryBackend::kAddOrUpdateChunkSize = 2000;
+const int LibraryBackend::kMaxBoundValuesPerQuery = 999;
 
 const char* LibraryBackend::kNewScoreSql =
     "case when playcount <= 0 then (%1 * 100 + score) / 2"
@@ -44,7 +47,18 @@ const char* LibraryBackend::kNewScoreSql =
 LibraryBackend::LibraryBackend(QObject* parent)
     : LibraryBackendInterface(parent),
       save_statistics_in_file_(false),
-      save_ratings_in_file_(false) {}
+      save_ratings_in_file_(false),
+      detect_compilations_(false),
+      song_cache_enabled_(false) {
+  // These are connected directly so the cache is updated as soon as the
+  // change is committed, whichever thread made it.
+  connect(this, SIGNAL(SongsDiscovered(SongList)),
+          SLOT(AddToSongCache(SongList)), Qt::DirectConnection);
+  connect(this, SIGNAL(SongsDeleted(SongList)),
+          SLOT(RemoveFromSongCache(SongList)), Qt::DirectConnection);
+  connect(this, SIGNAL(DatabaseReset()), SLOT(LoadSongCache()),
+          Qt::DirectConnection);
+}
 
 void LibraryBackend::Init(Database* db, const QString& songs_table,
                           const QString& dirs_table,
@@ -93,10 +107,71 @@ void LibraryBackend::UpdateSongsRatingAsync(const QList<int>& ids,
                              Q_ARG(float, rating));
 }
 
+void LibraryBackend::SetSongCacheEnabledAsync(bool enabled) {
+  metaObject()->invokeMethod(this, "SetSongCacheEnabled",
+                             Qt::QueuedConnection, Q_ARG(bool, enabled));
+}
+
+void LibraryBackend::SetSongCacheEnabled(bool enabled) {
+  if (enabled == song_cache_enabled_) return;
+  song_cache_enabled_ = enabled;
+
+  if (enabled) {
+    LoadSongCache();
+  } else {
+    song_cache_.Clear();
+  }
+}
+
+void LibraryBackend::LoadSongCache() {
+  if (!song_cache_enabled_) return;
+
+  QTime time;
+  time.start();
+
+  // The load has to start before the query does, so changes committed after
+  // the query's snapshot was taken reach the cache and win over the rows it
+  // returns.  Writers don't need to be held up for the rest of it.
+  const int load_id = song_cache_.BeginLoad();
+
+  Database::ReadLocker l(db_);
+  QSqlDatabase db(db_->ConnectForRead());
+
+  QSqlQuery q(db);
+  q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec +
+                    " FROM %1 WHERE unavailable = 0").arg(songs_table_));
+  q.setForwardOnly(true);
+  q.exec();
+  if (db_->CheckErrors(q)) {
+    song_cache_.Clear();
+    return;
+  }
+
+  int count = 0;
+  while (q.next()) {
+    Song song;
+    song.InitFromQuery(q, true);
+    song_cache_.LoadSong(load_id, song);
+    ++count;
+  }
+  song_cache_.EndLoad(load_id);
+
+  qLog(Debug) << "Loaded" << count << "songs from" << songs_table_
+              << "into the song cache in" << time.elapsed() << "ms";
+}
+
+void LibraryBackend::AddToSongCache(const SongList& songs) {
+  song_cache_.AddOrUpdateSongs(songs);
+}
+
+void LibraryBackend::RemoveFromSongCache(const SongList& songs) {
+  song_cache_.RemoveSongs(songs);
+}
+
 void LibraryBackend::LoadDirectories() {
   DirectoryList dirs = GetAllDirectories();
 
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   for (const Directory& dir : dirs) {
@@ -106,7 +181,7 @@ void LibraryBackend::LoadDirectories() {
 
 void LibraryBackend::ChangeDirPath(int id, const QString& old_path,
                                    const QString& new_path) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
   ScopedTransaction t(&db);
 
@@ -148,11 +223,14 @@ void LibraryBackend::ChangeDirPath(int id, const QString& old_path,
   if (db_->CheckErrors(q)) return;
 
   t.Commit();
+
+  // Every filename in the directory changed.
+  LoadSongCache();
 }
 
 DirectoryList LibraryBackend::GetAllDirectories() {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  Database::ReadLocker l(db_);
+  QSqlDatabase db(db_->ConnectForRead());
 
   DirectoryList ret;
 
@@ -171,14 +249,14 @@ DirectoryList LibraryBackend::GetAllDirectories() {
 }
 
 SubdirectoryList LibraryBackend::SubdirsInDirectory(int id) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db = db_->Connect();
+  Database::ReadLocker l(db_);
+  QSqlDatabase db = db_->ConnectForRead();
   return SubdirsInDirectory(id, db);
 }
 
 SubdirectoryList LibraryBackend::SubdirsInDirectory(int id, QSqlDatabase& db) {
   QSqlQuery q(QString(
-                  "SELECT path, mtime FROM %1"
+                  "SELECT path, mtime, snapshot FROM %1"
                   " WHERE directory = :dir").arg(subdirs_table_),
               db);
   q.bindValue(":dir", id);
@@ -191,6 +269,7 @@ SubdirectoryList LibraryBackend::SubdirsInDirectory(int id, QSqlDatabase& db) {
     subdir.directory_id = id;
     subdir.path = q.value(0).toString();
     subdir.mtime = q.value(1).toUInt();
+    subdir.snapshot = q.value(2).toByteArray();
     subdirs << subdir;
   }
 
@@ -198,8 +277,8 @@ SubdirectoryList LibraryBackend::SubdirsInDirectory(int id, QSqlDatabase& db) {
 }
 
 void LibraryBackend::UpdateTotalSongCount() {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  Database::ReadLocker l(db_);
+  QSqlDatabase db(db_->ConnectForRead());
 
   QSqlQuery q(QString("SELECT COUNT(*) FROM %1 WHERE unavailable = 0")
                   .arg(songs_table_),
@@ -222,7 +301,7 @@ void LibraryBackend::AddDirectory(const QString& path) {
     qLog(Debug) << "db_path" << db_path;
   }
 
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery q(QString(
@@ -241,7 +320,7 @@ void LibraryBackend::AddDirectory(const QString& path) {
 }
 
 void LibraryBackend::RemoveDirectory(const Directory& dir) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   // Remove songs first
@@ -269,8 +348,8 @@ void LibraryBackend::RemoveDirectory(const Directory& dir) {
 }
 
 SongList LibraryBackend::FindSongsInDirectory(int id) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  Database::ReadLocker l(db_);
+  QSqlDatabase db(db_->ConnectForRead());
 
   QSqlQuery q(
       QString("SELECT ROWID, " + Song::kColumnSpec +
@@ -290,7 +369,7 @@ SongList LibraryBackend::FindSongsInDirectory(int id) {
 }
 
 void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
   QSqlQuery find_query(
       QString(
@@ -298,12 +377,13 @@ void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
           " WHERE directory = :id AND path = :path").arg(subdirs_table_),
       db);
   QSqlQuery add_query(QString(
-                          "INSERT INTO %1 (directory, path, mtime)"
-                          " VALUES (:id, :path, :mtime)").arg(subdirs_table_),
+                          "INSERT INTO %1 (directory, path, mtime, snapshot)"
+                          " VALUES (:id, :path, :mtime, :snapshot)")
+                          .arg(subdirs_table_),
                       db);
   QSqlQuery update_query(
       QString(
-          "UPDATE %1 SET mtime = :mtime"
+          "UPDATE %1 SET mtime = :mtime, snapshot = :snapshot"
           " WHERE directory = :id AND path = :path").arg(subdirs_table_),
       db);
   QSqlQuery delete_query(
@@ -329,6 +409,7 @@ void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
 
       if (find_query.next()) {
         update_query.bindValue(":mtime", subdir.mtime);
+        update_query.bindValue(":snapshot", subdir.snapshot);
         update_query.bindValue(":id", subdir.directory_id);
         update_query.bindValue(":path", subdir.path);
         update_query.exec();
@@ -337,6 +418,7 @@ void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
         add_query.bindValue(":id", subdir.directory_id);
         add_query.bindValue(":path", subdir.path);
         add_query.bindValue(":mtime", subdir.mtime);
+        add_query.bindValue(":snapshot", subdir.snapshot);
         add_query.exec();
         db_->CheckErrors(add_query);
       }
@@ -346,98 +428,232 @@ void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
 }
 
 void LibraryBackend::AddOrUpdateSongs(const SongList& songs) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
-
-  QSqlQuery check_dir(
-      QString("SELECT ROWID FROM %1 WHERE ROWID = :id").arg(dirs_table_), db);
-  QSqlQuery add_song(QString("INSERT INTO %1 (" + Song::kColumnSpec +
-                             ")"
-                             " VALUES (" +
-                             Song::kBindSpec + ")").arg(songs_table_),
-                     db);
-  QSqlQuery update_song(QString("UPDATE %1 SET " + Song::kUpdateSpec +
-                                " WHERE ROWID = :id").arg(songs_table_),
-                        db);
-  QSqlQuery add_song_fts(
-      QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec +
-              ")"
-              " VALUES (:id, " +
-              Song::kFtsBindSpec + ")").arg(fts_table_),
-      db);
-  QSqlQuery update_song_fts(QString("UPDATE %1 SET " + Song::kFtsUpdateSpec +
-                                    " WHERE ROWID = :id").arg(fts_table_),
-                            db);
+  // Commit large lists in several transactions, so the database mutex is
+  // released regularly and other threads don't have to wait for the whole
+  // import to finish.
+  for (int i = 0; i < songs.count(); i += kAddOrUpdateChunkSize) {
+    AddOrUpdateSongsChunk(songs.mid(i, kAddOrUpdateChunkSize));
+  }
 
-  ScopedTransaction transaction(&db);
+  UpdateTotalSongCountAsync();
+}
 
+void LibraryBackend::AddOrUpdateSongsChunk(const SongList& songs) {
   SongList added_songs;
   SongList deleted_songs;
+  SongList compilation_added_songs;
+  SongList compilation_deleted_songs;
 
-  for (const Song& song : songs) {
-    // Do a sanity check first - make sure the song's directory still exists
+  {
+    Database::WriteLocker l(db_);
+    QSqlDatabase db(db_->Connect());
+    ScopedTransaction transaction(&db);
+
+    // Do a sanity check first - make sure the songs' directories still exist.
     // This is to fix a possible race condition when a directory is removed
     // while LibraryWatcher is scanning it.
+    QSet<int> directory_ids;
     if (!dirs_table_.isEmpty()) {
-      check_dir.bindValue(":id", song.directory_id());
-      check_dir.exec();
-      if (db_->CheckErrors(check_dir)) continue;
+      QSqlQuery q(db);
+      q.prepare(QString("SELECT ROWID FROM %1").arg(dirs_table_));
+      q.exec();
+      if (db_->CheckErrors(q)) return;
 
-      if (!check_dir.next()) continue;  // Directory didn't exist
+      while (q.next()) {
+        directory_ids.insert(q.value(0).toInt());
+      }
     }
 
-    if (song.id() == -1) {
-      // Create
+    SongList new_songs;
+    SongList updated_songs;
+    QStringList updated_ids;
+    for (const Song& song : songs) {
+      if (!dirs_table_.isEmpty() &&
+          !directory_ids.contains(song.directory_id())) {
+        continue;  // Directory didn't exist
+      }
 
-      // Insert the row and create a new ID
-      song.BindToQuery(&add_song);
-      add_song.exec();
-      if (db_->CheckErrors(add_song)) continue;
+      if (song.id() == -1) {
+        new_songs << song;
+      } else {
+        updated_songs << song;
+        updated_ids << QString::number(song.id());
+      }
+    }
 
-      // Get the new ID
-      const int id = add_song.lastInsertId().toInt();
+    if (!updated_songs.isEmpty() &&
+        !UpdateSongs(updated_songs, updated_ids, db, &added_songs,
+                     &deleted_songs)) {
+      return;
+    }
 
-      // Add to the FTS index
-      add_song_fts.bindValue(":id", id);
-      song.BindToFtsQuery(&add_song_fts);
-      add_song_fts.exec();
-      if (db_->CheckErrors(add_song_fts)) continue;
+    if (!new_songs.isEmpty() && !InsertSongs(new_songs, db, &added_songs)) {
+      return;
+    }
 
-      Song copy(song);
-      copy.set_id(id);
-      added_songs << copy;
-    } else {
-      // Get the previous song data first
-      Song old_song(GetSongById(song.id()));
-      if (!old_song.is_valid()) continue;
-
-      // Update
-      song.BindToQuery(&update_song);
-      update_song.bindValue(":id", song.id());
-      update_song.exec();
-      if (db_->CheckErrors(update_song)) continue;
-
-      song.BindToFtsQuery(&update_song_fts);
-      update_song_fts.bindValue(":id", song.id());
-      update_song_fts.exec();
-      if (db_->CheckErrors(update_song_fts)) continue;
-
-      deleted_songs << old_song;
-      added_songs << song;
+    if (detect_compilations_) {
+      // Songs might have been moved out of albums as well as into them.
+      UpdateCompilations(db, AlbumsOf(added_songs) + AlbumsOf(deleted_songs),
+                         &compilation_deleted_songs,
+                         &compilation_added_songs);
     }
-  }
 
-  transaction.Commit();
+    transaction.Commit();
+  }
 
   if (!deleted_songs.isEmpty()) emit SongsDeleted(deleted_songs);
 
   if (!added_songs.isEmpty()) emit SongsDiscovered(added_songs);
 
-  UpdateTotalSongCountAsync();
+  EmitCompilationsChanged(compilation_deleted_songs, compilation_added_songs);
+}
+
+bool LibraryBackend::UpdateSongs(const SongList& songs, const QStringList& ids,
+                                 QSqlDatabase& db, SongList* added_songs,
+                                 SongList* deleted_songs) {
+  // Get the previous song data first
+  QHash<int, Song> old_songs;
+  for (const Song& old_song : GetSongsById(ids, db)) {
+    old_songs[old_song.id()] = old_song;
+  }
+
+  QSqlQuery update_song(db);
+  update_song.prepare(QString("UPDATE %1 SET " + Song::kUpdateSpec +
+                              " WHERE ROWID = :id").arg(songs_table_));
+
+  QStringList updated_ids;
+  for (const Song& song : songs) {
+    if (!old_songs.contains(song.id())) continue;
+
+    song.BindToQuery(&update_song);
+    update_song.bindValue(":id", song.id());
+    update_song.exec();
+    if (db_->CheckErrors(update_song)) continue;
+
+    updated_ids << QString::number(song.id());
+    deleted_songs->append(old_songs[song.id()]);
+    added_songs->append(song);
+  }
+
+  if (updated_ids.isEmpty()) return true;
+
+  // Update the FTS index for all the songs at once
+  const QString in = updated_ids.join(",");
+
+  QSqlQuery remove_fts(db);
+  remove_fts.prepare(
+      QString("DELETE FROM %1 WHERE ROWID IN (%2)").arg(fts_table_, in));
+  remove_fts.exec();
+  if (db_->CheckErrors(remove_fts)) return false;
+
+  QSqlQuery add_fts(db);
+  add_fts.prepare(QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec +
+                          ")"
+                          " SELECT ROWID, " +
+                          Song::kFtsSourceColumnSpec +
+                          " FROM %2 WHERE ROWID IN (%3)")
+                      .arg(fts_table_, songs_table_, in));
+  add_fts.exec();
+  return !db_->CheckErrors(add_fts);
+}
+
+bool LibraryBackend::InsertSongs(const SongList& songs, QSqlDatabase& db,
+                                 SongList* added_songs) {
+  // Give the new songs IDs following on from the highest one in the table.
+  // That's what SQLite would have picked anyway, and it means we know the IDs
+  // of songs inserted with a multi-row statement.
+  QSqlQuery max_id(db);
+  max_id.prepare(QString("SELECT MAX(ROWID) FROM %1").arg(songs_table_));
+  max_id.exec();
+  if (db_->CheckErrors(max_id) || !max_id.next()) return false;
+
+  const int first_id = max_id.value(0).toInt() + 1;
+  int next_id = first_id;
+
+  // Stay under SQLite's limit on the number of bound values in one statement
+  const int max_rows =
+      qMax(1, kMaxBoundValuesPerQuery / (Song::kColumns.count() + 1));
+
+  QSqlQuery add_songs(db);
+  int prepared_rows = 0;
+
+  for (int i = 0; i < songs.count(); i += max_rows) {
+    const int rows = qMin(max_rows, songs.count() - i);
+    if (rows != prepared_rows) {
+      add_songs.prepare(MultiRowInsertSql(rows));
+      prepared_rows = rows;
+    }
+
+    for (int row = 0; row < rows; ++row) {
+      const QString suffix = QString("_%1").arg(row);
+      add_songs.bindValue(":id" + suffix, next_id + row);
+      songs[i + row].BindToQuery(&add_songs, suffix);
+    }
+    add_songs.exec();
+
+    if (!db_->CheckErrors(add_songs)) {
+      for (int row = 0; row < rows; ++row) {
+        Song copy(songs[i + row]);
+        copy.set_id(next_id++);
+        added_songs->append(copy);
+      }
+      continue;
+    }
+
+    // One of the songs is invalid.  Go back and insert them one at a time so
+    // we only lose the bad ones.
+    QSqlQuery add_song(db);
+    add_song.prepare(MultiRowInsertSql(1));
+    prepared_rows = 0;
+
+    for (int row = 0; row < rows; ++row) {
+      const Song& song = songs[i + row];
+      add_song.bindValue(":id_0", next_id);
+      song.BindToQuery(&add_song, "_0");
+      add_song.exec();
+      if (db_->CheckErrors(add_song)) continue;
+
+      Song copy(song);
+      copy.set_id(next_id++);
+      added_songs->append(copy);
+    }
+  }
+
+  if (next_id == first_id) return true;
+
+  // Now add all the new songs to the FTS index in one go
+  QSqlQuery add_fts(db);
+  add_fts.prepare(QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec +
+                          ")"
+                          " SELECT ROWID, " +
+                          Song::kFtsSourceColumnSpec +
+                          " FROM %2 WHERE ROWID >= :first AND ROWID < :last")
+                      .arg(fts_table_, songs_table_));
+  add_fts.bindValue(":first", first_id);
+  add_fts.bindValue(":last", next_id);
+  add_fts.exec();
+  return !db_->CheckErrors(add_fts);
+}
+
+QString LibraryBackend::MultiRowInsertSql(int rows) const {
+  QStringList values;
+  for (int row = 0; row < rows; ++row) {
+    const QString suffix = QString("_%1").arg(row);
+
+    QStringList placeholders;
+    placeholders << ":id" + suffix;
+    for (const QString& column : Song::kColumns) {
+      placeholders << ":" + column + suffix;
+    }
+    values << "(" + placeholders.join(", ") + ")";
+  }
+
+  return QString("INSERT INTO %1 (ROWID, " + Song::kColumnSpec + ") VALUES " +
+                 values.join(", ")).arg(songs_table_);
 }
 
 void LibraryBackend::UpdateMTimesOnly(const SongList& songs) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery q(QString("UPDATE %1 SET mtime = :mtime WHERE ROWID = :id")
@@ -455,7 +671,7 @@ void LibraryBackend::UpdateMTimesOnly(const SongList& songs) {
 }
 
 void LibraryBackend::DeleteSongs(const SongList& songs) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery remove(
@@ -473,16 +689,24 @@ void LibraryBackend::DeleteSongs(const SongList& songs) {
     remove_fts.exec();
     db_->CheckErrors(remove_fts);
   }
+
+  SongList compilation_added_songs;
+  SongList compilation_deleted_songs;
+  if (detect_compilations_) {
+    UpdateCompilations(db, AlbumsOf(songs), &compilation_deleted_songs,
+                       &compilation_added_songs);
+  }
   transaction.Commit();
 
   emit SongsDeleted(songs);
+  EmitCompilationsChanged(compilation_deleted_songs, compilation_added_songs);
 
   UpdateTotalSongCountAsync();
 }
 
 void LibraryBackend::MarkSongsUnavailable(const SongList& songs,
                                           bool unavailable) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery remove(QString("UPDATE %1 SET unavailable = %2 WHERE ROWID = :id")
@@ -496,9 +720,28 @@ void LibraryBackend::MarkSongsUnavailable(const SongList& songs,
     remove.exec();
     db_->CheckErrors(remove);
   }
+
+  SongList compilation_added_songs;
+  SongList compilation_deleted_songs;
+  if (detect_compilations_) {
+    UpdateCompilations(db, AlbumsOf(songs), &compilation_deleted_songs,
+                       &compilation_added_songs);
+  }
   transaction.Commit();
 
   emit SongsDeleted(songs);
+
+  if (!unavailable) {
+    // SongsDeleted() took these out of the cache, put them back.
+    SongList available(songs);
+    for (Song& song : available) {
+      song.set_unavailable(false);
+    }
+    song_cache_.AddOrUpdateSongs(available);
+  }
+
+  EmitCompilationsChanged(compilation_deleted_songs, compilation_added_songs);
+
   UpdateTotalSongCountAsync();
 }
 
@@ -508,7 +751,7 @@ QStringList LibraryBackend::GetAll(const QString& column,
   query.SetColumnSpec("DISTINCT " + column);
   query.AddCompilationRequirement(false);
 
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   if (!ExecQuery(&query)) return QStringList();
 
   QStringList ret;
@@ -528,7 +771,7 @@ QStringList LibraryBackend::GetAllArtistsWithAlbums(const QueryOptions& opt) {
   query.AddCompilationRequirement(false);
   query.AddWhere("album", "", "!=");
 
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   if (!ExecQuery(&query)) return QStringList();
 
   QStringList ret;
@@ -567,7 +810,7 @@ SongList LibraryBackend::GetSongs(const QString& artist, const QString& album,
 
 SongList LibraryBackend::ExecLibraryQuery(LibraryQuery* query) {
   query->SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   if (!ExecQuery(query)) return SongList();
 
   SongList ret;
@@ -580,14 +823,14 @@ SongList LibraryBackend::ExecLibraryQuery(LibraryQuery* query) {
 }
 
 Song LibraryBackend::GetSongById(int id) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  Database::ReadLocker l(db_);
+  QSqlDatabase db(db_->ConnectForRead());
   return GetSongById(id, db);
 }
 
 SongList LibraryBackend::GetSongsById(const QList<int>& ids) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  Database::ReadLocker l(db_);
+  QSqlDatabase db(db_->ConnectForRead());
 
   QStringList str_ids;
   for (int id : ids) {
@@ -598,8 +841,8 @@ SongList LibraryBackend::GetSongsById(const QList<int>& ids) {
 }
 
 SongList LibraryBackend::GetSongsById(const QStringList& ids) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  Database::ReadLocker l(db_);
+  QSqlDatabase db(db_->ConnectForRead());
 
   return GetSongsById(ids, db);
 }
@@ -607,8 +850,8 @@ SongList LibraryBackend::GetSongsById(const QStringList& ids) {
 SongList LibraryBackend::GetSongsByForeignId(const QStringList& ids,
                                              const QString& table,
                                              const QString& column) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  Database::ReadLocker l(db_);
+  QSqlDatabase db(db_->ConnectForRead());
 
   QString in = ids.join(",");
 
@@ -702,7 +945,7 @@ SongList LibraryBackend::GetCompilationSongs(const QString& album,
   query.AddCompilationRequirement(true);
   query.AddWhere("album", album);
 
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   if (!ExecQuery(&query)) return SongList();
 
   SongList ret;
@@ -714,44 +957,18 @@ SongList LibraryBackend::GetCompilationSongs(const QString& album,
   return ret;
 }
 
-void LibraryBackend::UpdateCompilations() {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
-
-  // Look for albums that have songs by more than one 'effective album artist'
-  // in the same
-  // directory
-
-  QSqlQuery q(
+void LibraryBackend::UpdateCompilations(QSqlDatabase& db,
+                                        const QSet<QString>& albums,
+                                        SongList* deleted_songs,
+                                        SongList* added_songs) {
+  // Look at each album's songs (there's an index on album) for songs by more
+  // than one 'effective album artist' in the same directory
+  QSqlQuery album_songs(
       QString(
-          "SELECT effective_albumartist, album, filename, sampler "
-          "FROM %1 WHERE unavailable = 0 ORDER BY album").arg(songs_table_),
+          "SELECT effective_albumartist, filename, sampler"
+          " FROM %1 WHERE album = :album AND unavailable = 0")
+          .arg(songs_table_),
       db);
-  q.exec();
-  if (db_->CheckErrors(q)) return;
-
-  QMap<QString, CompilationInfo> compilation_info;
-  while (q.next()) {
-    QString artist = q.value(0).toString();
-    QString album = q.value(1).toString();
-    QString filename = q.value(2).toString();
-    bool sampler = q.value(3).toBool();
-
-    // Ignore songs that don't have an album field set
-    if (album.isEmpty()) continue;
-
-    // Find the directory the song is in
-    int last_separator = filename.lastIndexOf('/');
-    if (last_separator == -1) continue;
-
-    CompilationInfo& info = compilation_info[album];
-    info.artists.insert(artist);
-    info.directories.insert(filename.left(last_separator));
-    if (sampler)
-      info.has_samplers = true;
-    else
-      info.has_not_samplers = true;
-  }
 
   // Now mark the songs that we think are in compilations
   QSqlQuery update(
@@ -770,16 +987,31 @@ void LibraryBackend::UpdateCompilations() {
           .arg(songs_table_),
       db);
 
-  SongList deleted_songs;
-  SongList added_songs;
-
-  ScopedTransaction transaction(&db);
+  for (const QString& album : albums) {
+    // Ignore songs that don't have an album field set
+    if (album.isEmpty()) continue;
 
-  QMap<QString, CompilationInfo>::const_iterator it =
-      compilation_info.constBegin();
-  for (; it != compilation_info.constEnd(); ++it) {
-    const CompilationInfo& info = it.value();
-    QString album(it.key());
+    album_songs.bindValue(":album", album);
+    album_songs.exec();
+    if (db_->CheckErrors(album_songs)) return;
+
+    CompilationInfo info;
+    while (album_songs.next()) {
+      QString artist = album_songs.value(0).toString();
+      QString filename = album_songs.value(1).toString();
+      bool sampler = album_songs.value(2).toBool();
+
+      // Find the directory the song is in
+      int last_separator = filename.lastIndexOf('/');
+      if (last_separator == -1) continue;
+
+      info.artists.insert(artist);
+      info.directories.insert(filename.left(last_separator));
+      if (sampler)
+        info.has_samplers = true;
+      else
+        info.has_not_samplers = true;
+    }
 
     // If there were more 'effective album artists' than there were directories
     // for this album,
@@ -787,21 +1019,30 @@ void LibraryBackend::UpdateCompilations() {
 
     if (info.artists.count() > info.directories.count()) {
       if (info.has_not_samplers)
-        UpdateCompilations(find_songs, update, deleted_songs, added_songs,
+        UpdateCompilations(find_songs, update, *deleted_songs, *added_songs,
                            album, 1);
     } else {
       if (info.has_samplers)
-        UpdateCompilations(find_songs, update, deleted_songs, added_songs,
+        UpdateCompilations(find_songs, update, *deleted_songs, *added_songs,
                            album, 0);
     }
   }
+}
 
-  transaction.Commit();
-
-  if (!deleted_songs.isEmpty()) {
-    emit SongsDeleted(deleted_songs);
-    emit SongsDiscovered(added_songs);
+QSet<QString> LibraryBackend::AlbumsOf(const SongList& songs) {
+  QSet<QString> ret;
+  for (const Song& song : songs) {
+    ret.insert(song.album());
   }
+  return ret;
+}
+
+void LibraryBackend::EmitCompilationsChanged(const SongList& deleted_songs,
+                                             const SongList& added_songs) {
+  if (deleted_songs.isEmpty()) return;
+
+  emit SongsDeleted(deleted_songs);
+  emit SongsDiscovered(added_songs);
 }
 
 void LibraryBackend::UpdateCompilations(QSqlQuery& find_songs,
@@ -818,7 +1059,7 @@ void LibraryBackend::UpdateCompilations(QSqlQuery& find_songs,
     Song song;
     song.InitFromQuery(find_songs, true);
     deleted_songs << song;
-    song.set_sampler(true);
+    song.set_sampler(sampler);
     added_songs << song;
   }
 
@@ -847,7 +1088,7 @@ LibraryBackend::AlbumList LibraryBackend::GetAlbums(const QString& artist,
     query.AddWhere("artist", artist);
   }
 
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   if (!ExecQuery(&query)) return ret;
 
   QString last_album;
@@ -884,7 +1125,7 @@ LibraryBackend::Album LibraryBackend::GetAlbumArt(const QString& artist,
   query.AddWhere("artist", artist);
   query.AddWhere("album", album);
 
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   if (!ExecQuery(&query)) return ret;
 
   if (query.Next()) {
@@ -907,7 +1148,7 @@ void LibraryBackend::UpdateManualAlbumArtAsync(const QString& artist,
 void LibraryBackend::UpdateManualAlbumArt(const QString& artist,
                                           const QString& album,
                                           const QString& art) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   // Get the songs before they're updated
@@ -958,7 +1199,7 @@ void LibraryBackend::UpdateManualAlbumArt(const QString& artist,
 
 void LibraryBackend::ForceCompilation(const QString& album,
                                       const QList<QString>& artists, bool on) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
   SongList deleted_songs, added_songs;
 
@@ -1013,12 +1254,14 @@ void LibraryBackend::ForceCompilation(const QString& album,
 }
 
 bool LibraryBackend::ExecQuery(LibraryQuery* q) {
-  return !db_->CheckErrors(q->Exec(db_->Connect(), songs_table_, fts_table_));
+  if (song_cache_.Execute(q)) return true;
+  return !db_->CheckErrors(
+      q->Exec(db_->ConnectForRead(), songs_table_, fts_table_));
 }
 
 SongList LibraryBackend::FindSongs(const smart_playlists::Search& search) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  Database::ReadLocker l(db_);
+  QSqlDatabase db(db_->ConnectForRead());
 
   // Build the query
   QString sql = search.ToSql(songs_table());
@@ -1038,6 +1281,30 @@ SongList LibraryBackend::FindSongs(const smart_playlists::Search& search) {
   return ret;
 }
 
+QVector<int> LibraryBackend::FindSongIds(
+    const smart_playlists::Search& search, const QString& value_column,
+    QVector<double>* values) {
+  Database::ReadLocker l(db_);
+  QSqlDatabase db(db_->ConnectForRead());
+
+  const bool with_values = values && !value_column.isEmpty();
+  const QString columns =
+      with_values ? "ROWID, " + value_column : QString("ROWID");
+
+  QSqlQuery query(search.ToCandidatesSql(songs_table(), columns), db);
+  query.exec();
+
+  QVector<int> ret;
+  if (values) values->clear();
+  if (db_->CheckErrors(query)) return ret;
+
+  while (query.next()) {
+    ret << query.value(0).toInt();
+    if (with_values) *values << query.value(1).toDouble();
+  }
+  return ret;
+}
+
 SongList LibraryBackend::GetAllSongs() {
   // Get all the songs!
   return FindSongs(smart_playlists::Search(
@@ -1049,7 +1316,7 @@ SongList LibraryBackend::GetAllSongs() {
 void LibraryBackend::IncrementPlayCount(int id) {
   if (id == -1) return;
 
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery q(QString(
@@ -1072,7 +1339,7 @@ void LibraryBackend::IncrementSkipCount(int id, float progress) {
   if (id == -1) return;
   progress = qBound(0.0f, progress, 1.0f);
 
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery q(QString(
@@ -1092,7 +1359,7 @@ void LibraryBackend::IncrementSkipCount(int id, float progress) {
 void LibraryBackend::ResetStatistics(int id) {
   if (id == -1) return;
 
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery q(QString(
@@ -1120,7 +1387,7 @@ void LibraryBackend::UpdateSongsRating(const QList<int>& id_list,
                                        float rating) {
   if (id_list.isEmpty()) return;
 
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QStringList id_str_list;
@@ -1141,7 +1408,7 @@ void LibraryBackend::UpdateSongsRating(const QList<int>& id_list,
 
 void LibraryBackend::DeleteAll() {
   {
-    QMutexLocker l(db_->Mutex());
+    Database::WriteLocker l(db_);
     QSqlDatabase db(db_->Connect());
     ScopedTransaction t(&db);
 
@@ -24,6 +24,7 @@
 
 #include "directory.h"
 #include "libraryquery.h"
+#include "librarysongcache.h"
 #include "core/song.h"
 
 class Database;
@@ -121,6 +122,12 @@ class LibraryBackend : public LibraryBackendInterface {
  public:
   static const char* kSettingsGroup;
 
+  // AddOrUpdateSongs() commits this many songs per transaction.
+  static const int kAddOrUpdateChunkSize;
+
+  // SQLite's default SQLITE_MAX_VARIABLE_NUMBER.
+  static const int kMaxBoundValuesPerQuery;
+
   Q_INVOKABLE LibraryBackend(QObject* parent = nullptr);
   void Init(Database* db, const QString& songs_table, const QString& dirs_table,
             const QString& subdirs_table, const QString& fts_table);
@@ -178,8 +185,24 @@ class LibraryBackend : public LibraryBackendInterface {
   bool ExecQuery(LibraryQuery* q);
   SongList ExecLibraryQuery(LibraryQuery* query);
   SongList FindSongs(const smart_playlists::Search& search);
+  // Returns the IDs of every song that matches a smart playlist search,
+  // ignoring its sort order and limit.  If values isn't null it's set to the
+  // given column of each of those songs.
+  QVector<int> FindSongIds(const smart_playlists::Search& search,
+                           const QString& value_column = QString(),
+                           QVector<double>* values = nullptr);
   SongList GetAllSongs();
 
+  // Marks songs as being on a compilation when their album has songs by more
+  // artists than it has directories.  Only the albums touched by each change
+  // are checked.  Should be called before any songs are added.
+  void set_detect_compilations(bool detect) { detect_compilations_ = detect; }
+
+  // Keeps an in-memory copy of the columns the library view groups and
+  // filters by, so that most browsing queries don't touch the database.
+  void SetSongCacheEnabledAsync(bool enabled);
+  const LibrarySongCache* song_cache() const { return &song_cache_; }
+
   void IncrementPlayCountAsync(int id);
   void IncrementSkipCountAsync(int id, float progress);
   void ResetStatisticsAsync(int id);
@@ -196,7 +219,6 @@ class LibraryBackend : public LibraryBackendInterface {
   void DeleteSongs(const SongList& songs);
   void MarkSongsUnavailable(const SongList& songs, bool unavailable = true);
   void AddOrUpdateSubdirs(const SubdirectoryList& subdirs);
-  void UpdateCompilations();
   void UpdateManualAlbumArt(const QString& artist, const QString& album,
                             const QString& art);
   void ForceCompilation(const QString& album, const QList<QString>& artists,
@@ -206,6 +228,7 @@ class LibraryBackend : public LibraryBackendInterface {
   void ResetStatistics(int id);
   void UpdateSongRating(int id, float rating);
   void UpdateSongsRating(const QList<int>& id_list, float rating);
+  void SetSongCacheEnabled(bool enabled);
 
 signals:
   void DirectoryDiscovered(const Directory& dir,
@@ -220,6 +243,11 @@ signals:
 
   void TotalSongCountUpdated(int total);
 
+ private slots:
+  void AddToSongCache(const SongList& songs);
+  void RemoveFromSongCache(const SongList& songs);
+  void LoadSongCache();
+
  private:
   struct CompilationInfo {
     CompilationInfo() : has_samplers(false), has_not_samplers(false) {}
@@ -233,9 +261,28 @@ signals:
 
   static const char* kNewScoreSql;
 
+  void AddOrUpdateSongsChunk(const SongList& songs);
+  bool UpdateSongs(const SongList& songs, const QStringList& ids,
+                   QSqlDatabase& db, SongList* added_songs,
+                   SongList* deleted_songs);
+  bool InsertSongs(const SongList& songs, QSqlDatabase& db,
+                   SongList* added_songs);
+  // Returns an INSERT statement for the given number of songs.  The
+  // placeholders for each row are suffixed with "_<row>", and the ROWID is
+  // bound to ":id_<row>".
+  QString MultiRowInsertSql(int rows) const;
+
+  static QSet<QString> AlbumsOf(const SongList& songs);
+  // Checks whether each of the albums is a compilation, and updates the
+  // sampler flag of their songs if it's changed.  The old and new versions of
+  // the songs that were changed are added to deleted_songs and added_songs.
+  void UpdateCompilations(QSqlDatabase& db, const QSet<QString>& albums,
+                          SongList* deleted_songs, SongList* added_songs);
   void UpdateCompilations(QSqlQuery& find_songs, QSqlQuery& update,
                           SongList& deleted_songs, SongList& added_songs,
                           const QString& album, int sampler);
+  void EmitCompilationsChanged(const SongList& deleted_songs,
+                               const SongList& added_songs);
   AlbumList GetAlbums(const QString& artist, bool compilation = false,
                       const QueryOptions& opt = QueryOptions());
   SubdirectoryList SubdirsInDirectory(int id, QSqlDatabase& db);
@@ -251,6 +298,10 @@ signals:
   QString fts_table_;
   bool save_statistics_in_file_;
   bool save_ratings_in_file_;
+  bool detect_compilations_;
+
+  bool song_cache_enabled_;
+  LibrarySongCache song_cache_;
 };
 
 #endif  // LIBRARYBACKEND_H
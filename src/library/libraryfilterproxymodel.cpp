@@ -0,0 +1,41 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "libraryfilterproxymodel.h"
+#include "librarymodel.h"
+
+LibraryFilterProxyModel::LibraryFilterProxyModel(QObject* parent)
+    : QSortFilterProxyModel(parent), library_model_(nullptr) {}
+
+void LibraryFilterProxyModel::SetLibraryModel(LibraryModel* model) {
+  if (library_model_) {
+    disconnect(library_model_, SIGNAL(FilterChanged()), this,
+               SLOT(FilterChanged()));
+  }
+
+  library_model_ = model;
+  setSourceModel(model);
+  connect(model, SIGNAL(FilterChanged()), SLOT(FilterChanged()));
+}
+
+bool LibraryFilterProxyModel::filterAcceptsRow(
+    int source_row, const QModelIndex& source_parent) const {
+  if (!library_model_) return true;
+  return library_model_->IsVisible(
+      library_model_->index(source_row, 0, source_parent));
+}
+
+void LibraryFilterProxyModel::FilterChanged() { invalidateFilter(); }
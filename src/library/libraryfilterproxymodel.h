@@ -0,0 +1,45 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARYFILTERPROXYMODEL_H
+#define LIBRARYFILTERPROXYMODEL_H
+
+#include <QSortFilterProxyModel>
+
+class LibraryModel;
+
+// Sorts a LibraryModel and hides the items that its filter says aren't
+// visible.  The filter is re-applied whenever the model changes it in place.
+class LibraryFilterProxyModel : public QSortFilterProxyModel {
+  Q_OBJECT
+
+ public:
+  explicit LibraryFilterProxyModel(QObject* parent = nullptr);
+
+  void SetLibraryModel(LibraryModel* model);
+
+ protected:
+  // QSortFilterProxyModel
+  bool filterAcceptsRow(int source_row, const QModelIndex& source_parent) const;
+
+ private slots:
+  void FilterChanged();
+
+ private:
+  LibraryModel* library_model_;
+};
+
+#endif  // LIBRARYFILTERPROXYMODEL_H
@@ -23,17 +23,17 @@
 #include <QFutureWatcher>
 #include <QIODevice>
 #include <QMetaEnum>
-#include <QNetworkCacheMetaData>
-#include <QNetworkDiskCache>
 #include <QPixmapCache>
 #include <QSettings>
 #include <QStringList>
+#include <QTime>
 #include <QUrl>
 #include <QtConcurrentRun>
 
 #include "librarybackend.h"
 #include "libraryitem.h"
 #include "librarydirectorymodel.h"
+#include "librarysongcache.h"
 #include "libraryview.h"
 #include "sqlrow.h"
 #include "core/application.h"
@@ -62,7 +62,6 @@ const char* LibraryModel::kSmartPlaylistsSettingsGroup =
     "SerialisedSmartPlaylists";
 const int LibraryModel::kSmartPlaylistsVersion = 4;
 const int LibraryModel::kPrettyCoverSize = 32;
-const qint64 LibraryModel::kIconCacheSize = 100000000;  //~100MB
 typedef QFuture<LibraryModel::QueryResult> RootQueryFuture;
 typedef QFutureWatcher<LibraryModel::QueryResult> RootQueryWatcher;
 
@@ -84,11 +83,12 @@ LibraryModel::LibraryModel(LibraryBackend* backend, Application* app,
       show_smart_playlists_(false),
       show_various_artists_(true),
       total_song_count_(0),
+      tree_has_all_songs_(true),
+      filter_in_place_(false),
       artist_icon_(":/icons/22x22/x-clementine-artist.png"),
       album_icon_(":/icons/22x22/x-clementine-album.png"),
       playlists_dir_icon_(IconLoader::Load("folder-sound")),
       playlist_icon_(":/icons/22x22/x-clementine-albums.png"),
-      icon_cache_(new QNetworkDiskCache(this)),
       init_task_id_(-1),
       use_pretty_covers_(false),
       show_dividers_(true) {
@@ -105,10 +105,6 @@ LibraryModel::LibraryModel(LibraryBackend* backend, Application* app,
   connect(app_->album_cover_loader(), SIGNAL(ImageLoaded(quint64, QImage)),
           SLOT(AlbumArtLoaded(quint64, QImage)));
 
-  icon_cache_->setCacheDirectory(
-      Utilities::GetConfigPath(Utilities::Path_CacheRoot) + "/pixmapcache");
-  icon_cache_->setMaximumCacheSize(LibraryModel::kIconCacheSize);
-
   no_cover_icon_ = QPixmap(":nocover.png")
                        .scaled(kPrettyCoverSize, kPrettyCoverSize,
                                Qt::KeepAspectRatio, Qt::SmoothTransformation);
@@ -163,10 +159,35 @@ void LibraryModel::Init(bool async) {
 }
 
 void LibraryModel::SongsDiscovered(const SongList& songs) {
+  // If the filter is being applied in place, find out which of the new songs
+  // match it before they're added, so the others are hidden straight away.
+  bool filter_changed = false;
+  if (filter_in_place_) {
+    QVector<int> ids;
+    for (const Song& song : songs) {
+      ids << song.id();
+    }
+
+    QVector<int> matching;
+    backend_->song_cache()->FindSongs(query_options_, &ids, &matching);
+    const QSet<int> matching_set = matching.toList().toSet();
+
+    for (const Song& song : songs) {
+      if (!matching_set.contains(song.id())) continue;
+
+      if (!filter_id_set_.contains(song.id())) {
+        filter_ids_ << song.id();
+        filter_id_set_ << song.id();
+      }
+      AddVisibleContainers(song);
+      filter_changed = true;
+    }
+  }
+
   for (const Song& song : songs) {
     // Sanity check to make sure we don't add songs that are outside the user's
     // filter
-    if (!query_options_.Matches(song)) continue;
+    if (!tree_has_all_songs_ && !query_options_.Matches(song)) continue;
 
     // Hey, we've already got that one!
     if (song_nodes_.contains(song.id())) continue;
@@ -192,48 +213,7 @@ void LibraryModel::SongsDiscovered(const SongList& songs) {
       } else {
         // Otherwise find the proper container at this level based on the
         // item's key
-        QString key;
-        switch (type) {
-          case GroupBy_Album:
-            key = song.album();
-            break;
-          case GroupBy_Artist:
-            key = song.artist();
-            break;
-          case GroupBy_Composer:
-            key = song.composer();
-            break;
-          case GroupBy_Performer:
-            key = song.performer();
-            break;
-          case GroupBy_Disc:
-            key = song.disc();
-            break;
-          case GroupBy_Grouping:
-            key = song.grouping();
-            break;
-          case GroupBy_Genre:
-            key = song.genre();
-            break;
-          case GroupBy_AlbumArtist:
-            key = song.effective_albumartist();
-            break;
-          case GroupBy_Year:
-            key = QString::number(qMax(0, song.year()));
-            break;
-          case GroupBy_YearAlbum:
-            key = PrettyYearAlbum(qMax(0, song.year()), song.album());
-            break;
-          case GroupBy_FileType:
-            key = song.filetype();
-            break;
-          case GroupBy_Bitrate:
-            key = song.bitrate();
-            break;
-          case GroupBy_None:
-            qLog(Error) << "GroupBy_None";
-            break;
-        }
+        const QString key = ContainerKey(type, song);
 
         // Does it exist already?
         if (!container_nodes_[i].contains(key)) {
@@ -256,6 +236,11 @@ void LibraryModel::SongsDiscovered(const SongList& songs) {
     song_nodes_[song.id()] =
         ItemFromSong(GroupBy_None, true, false, container, song, -1);
   }
+
+  if (filter_changed) {
+    UpdateVisibleDividers();
+    emit FilterChanged();
+  }
 }
 
 void LibraryModel::SongsSlightlyChanged(const SongList& songs) {
@@ -468,27 +453,19 @@ QVariant LibraryModel::AlbumIcon(const QModelIndex& index) {
     return cached_pixmap;
   }
 
-  // Try to load it from the disk cache
-  std::unique_ptr<QIODevice> cache(icon_cache_->data(QUrl(cache_key)));
-  if (cache) {
-    QImage cached_pixmap;
-    if (cached_pixmap.load(cache.get(), "XPM")) {
-      QPixmapCache::insert(cache_key, QPixmap::fromImage(cached_pixmap));
-      return QPixmap::fromImage(cached_pixmap);
-    }
-  }
-
   // Maybe we're loading a pixmap already?
   if (pending_cache_keys_.contains(cache_key)) {
     return no_cover_icon_;
   }
 
-  // No art is cached and we're not loading it already.  Load art for the first
-  // Song in the album.
+  // Not loaded yet, and we're not loading it already.  Load art for the first
+  // Song in the album - the cover loader keeps scaled copies on disk.
   SongList songs = GetChildSongs(index);
   if (!songs.isEmpty()) {
     const quint64 id = app_->album_cover_loader()->LoadImageAsync(
         cover_loader_options_, songs.first());
+    // The icon is being drawn, so load it before anything that isn't.
+    app_->album_cover_loader()->PrioritiseTasks(QList<quint64>() << id);
     pending_art_[id] = ItemAndCacheKey(item, cache_key);
     pending_cache_keys_.insert(cache_key);
   }
@@ -512,19 +489,6 @@ void LibraryModel::AlbumArtLoaded(quint64 id, const QImage& image) {
     QPixmapCache::insert(cache_key, QPixmap::fromImage(image));
   }
 
-  // if not already in the disk cache
-  std::unique_ptr<QIODevice> cached_img(icon_cache_->data(QUrl(cache_key)));
-  if (!cached_img) {
-    QNetworkCacheMetaData item_metadata;
-    item_metadata.setSaveToDisk(true);
-    item_metadata.setUrl(QUrl(cache_key));
-    QIODevice* cache = icon_cache_->prepare(item_metadata);
-    if (cache) {
-      image.save(cache, "XPM");
-      icon_cache_->insert(cache);
-    }
-  }
-
   const QModelIndex index = ItemToIndex(item);
   emit dataChanged(index, index);
 }
@@ -638,7 +602,7 @@ bool LibraryModel::HasCompilations(const LibraryQuery& query) {
   q.AddCompilationRequirement(true);
   q.SetLimit(1);
 
-  QMutexLocker l(backend_->db()->Mutex());
+  Database::ReadLocker l(backend_->db());
   if (!backend_->ExecQuery(&q)) return false;
 
   return q.Next();
@@ -653,7 +617,7 @@ LibraryModel::QueryResult LibraryModel::RunQuery(LibraryItem* parent) {
 
   // Initialise the query.  child_type says what type of thing we want (artists,
   // songs, etc.)
-  LibraryQuery q(query_options_);
+  LibraryQuery q(TreeQueryOptions());
   InitQuery(child_type, &q);
 
   // Walk up through the item's parents adding filters as necessary
@@ -675,7 +639,7 @@ LibraryModel::QueryResult LibraryModel::RunQuery(LibraryItem* parent) {
   }
 
   // Execute the query
-  QMutexLocker l(backend_->db()->Mutex());
+  Database::ReadLocker l(backend_->db());
   if (!backend_->ExecQuery(&q)) return result;
 
   while (q.Next()) {
@@ -735,6 +699,7 @@ void LibraryModel::ResetAsyncQueryFinished() {
   root_->lazy_loaded = true;
 
   PostQuery(root_, result, false);
+  if (filter_in_place_) UpdateVisibleDividers();
 
   if (init_task_id_ != -1) {
     app_->task_manager()->SetTaskFinished(init_task_id_);
@@ -759,8 +724,10 @@ void LibraryModel::BeginReset() {
   root_->compilation_artist_node_ = nullptr;
   root_->lazy_loaded = false;
 
-  // Smart playlists?
-  if (show_smart_playlists_ && query_options_.filter().isEmpty())
+  // Smart playlists?  They're hidden rather than left out when the filter is
+  // applied in place.
+  if (show_smart_playlists_ &&
+      (tree_has_all_songs_ || query_options_.filter().isEmpty()))
     CreateSmartPlaylists();
 }
 
@@ -769,6 +736,7 @@ void LibraryModel::Reset() {
 
   // Populate top level
   LazyPopulate(root_, false);
+  if (filter_in_place_) UpdateVisibleDividers();
 
   endResetModel();
 }
@@ -992,19 +960,13 @@ LibraryItem* LibraryModel::ItemFromSong(GroupBy type, bool signal,
       break;
 
     case GroupBy_Composer:
-      item->key = s.composer();
     case GroupBy_Performer:
-      item->key = s.performer();
     case GroupBy_Disc:
-      item->key = s.disc();
     case GroupBy_Grouping:
-      item->key = s.grouping();
     case GroupBy_Genre:
-      if (item->key.isNull()) item->key = s.genre();
     case GroupBy_Album:
-      if (item->key.isNull()) item->key = s.album();
     case GroupBy_AlbumArtist:
-      if (item->key.isNull()) item->key = s.effective_albumartist();
+      item->key = ContainerKey(type, s);
       item->display_text = TextOrUnknown(item->key);
       item->sort_text = SortTextForArtist(item->key);
       break;
@@ -1184,8 +1146,10 @@ void LibraryModel::GetChildSongs(LibraryItem* item, QList<QUrl>* urls,
       qSort(children.begin(), children.end(),
             std::bind(&LibraryModel::CompareItems, this, _1, _2));
 
-      for (LibraryItem* child : children)
-        GetChildSongs(child, urls, songs, song_ids);
+      // Songs hidden by the filter aren't part of the selection.
+      for (LibraryItem* child : children) {
+        if (IsVisible(child)) GetChildSongs(child, urls, songs, song_ids);
+      }
       break;
     }
 
@@ -1219,19 +1183,262 @@ SongList LibraryModel::GetChildSongs(const QModelIndex& index) const {
 
 void LibraryModel::SetFilterAge(int age) {
   query_options_.set_max_age(age);
-  ResetAsync();
+  ApplyFilter();
 }
 
 void LibraryModel::SetFilterText(const QString& text) {
   query_options_.set_filter(text);
-  ResetAsync();
+  ApplyFilter();
 }
 
 void LibraryModel::SetFilterQueryMode(QueryOptions::QueryMode query_mode) {
   query_options_.set_query_mode(query_mode);
+  ApplyFilter();
+}
+
+void LibraryModel::ApplyFilter() {
+  if (FilterInPlace()) return;
+
+  // The filter needs FTS or one of the special query modes, so the tree has
+  // to be rebuilt from a filtered query.
+  ClearFilterInPlace();
+  tree_has_all_songs_ =
+      query_options_.query_mode() == QueryOptions::QueryMode_All &&
+      query_options_.filter().isEmpty() && query_options_.max_age() == -1;
   ResetAsync();
 }
 
+bool LibraryModel::FilterInPlace() {
+  if (query_options_.query_mode() != QueryOptions::QueryMode_All) {
+    return false;
+  }
+
+  if (query_options_.filter().isEmpty() && query_options_.max_age() == -1) {
+    // Show everything
+    const bool was_filtering = filter_in_place_;
+    ClearFilterInPlace();
+
+    if (!tree_has_all_songs_) {
+      tree_has_all_songs_ = true;
+      ResetAsync();
+    } else if (was_filtering) {
+      emit FilterChanged();
+    }
+    return true;
+  }
+
+  QTime time;
+  time.start();
+
+  // If the new filter is narrower than the last one, only the songs that
+  // matched the last one need testing.
+  const bool refine =
+      filter_in_place_ &&
+      LibrarySongCache::IsRefinement(filter_options_, query_options_);
+
+  QVector<int> ids;
+  if (!backend_->song_cache()->FindSongs(
+          query_options_, refine ? &filter_ids_ : nullptr, &ids)) {
+    return false;
+  }
+
+  filter_in_place_ = true;
+  filter_options_ = query_options_;
+  filter_ids_ = ids;
+  filter_id_set_.clear();
+  filter_id_set_.reserve(ids.count());
+  for (int id : ids) {
+    filter_id_set_.insert(id);
+  }
+  UpdateVisibleContainers();
+
+  if (!tree_has_all_songs_) {
+    // The tree was built from a filtered query, so it has to be rebuilt once
+    // with every song in it.
+    tree_has_all_songs_ = true;
+    ResetAsync();
+  } else {
+    UpdateVisibleDividers();
+    emit FilterChanged();
+  }
+
+  qLog(Debug) << "Filtered" << ids.count() << "songs in place in"
+              << time.elapsed() << "ms" << (refine ? "(refined)" : "");
+  return true;
+}
+
+void LibraryModel::ClearFilterInPlace() {
+  filter_in_place_ = false;
+  filter_options_ = QueryOptions();
+  filter_ids_.clear();
+  filter_id_set_.clear();
+  visible_containers_.clear();
+  visible_dividers_.clear();
+}
+
+QueryOptions LibraryModel::TreeQueryOptions() const {
+  if (tree_has_all_songs_) return QueryOptions();
+  return query_options_;
+}
+
+QStringList LibraryModel::ContainerColumns(GroupBy type) {
+  // The columns ContainerKey() needs from each song.
+  switch (type) {
+    case GroupBy_Artist:
+      return QStringList() << "artist";
+    case GroupBy_Album:
+      return QStringList() << "album";
+    case GroupBy_Composer:
+      return QStringList() << "composer";
+    case GroupBy_Performer:
+      return QStringList() << "performer";
+    case GroupBy_Disc:
+      return QStringList() << "disc";
+    case GroupBy_Grouping:
+      return QStringList() << "grouping";
+    case GroupBy_Genre:
+      return QStringList() << "genre";
+    case GroupBy_AlbumArtist:
+      return QStringList() << "effective_albumartist";
+    case GroupBy_Year:
+      return QStringList() << "year";
+    case GroupBy_YearAlbum:
+      return QStringList() << "year"
+                           << "album";
+    case GroupBy_FileType:
+      return QStringList() << "filetype";
+    case GroupBy_Bitrate:
+      return QStringList() << "bitrate";
+    case GroupBy_None:
+      break;
+  }
+  return QStringList();
+}
+
+QString LibraryModel::ContainerKey(GroupBy type, const Song& song) {
+  // These have to be the same as the keys ItemFromQuery() gives containers.
+  switch (type) {
+    case GroupBy_Artist:
+      return song.artist();
+    case GroupBy_Album:
+      return song.album();
+    case GroupBy_Composer:
+      return song.composer();
+    case GroupBy_Performer:
+      return song.performer();
+    case GroupBy_Disc:
+      return QString::number(song.disc());
+    case GroupBy_Grouping:
+      return song.grouping();
+    case GroupBy_Genre:
+      return song.genre();
+    case GroupBy_AlbumArtist:
+      return song.effective_albumartist();
+    case GroupBy_Year:
+      return QString::number(qMax(0, song.year()));
+    case GroupBy_YearAlbum:
+      return PrettyYearAlbum(qMax(0, song.year()), song.album());
+    case GroupBy_FileType:
+      return song.TextForFiletype();
+    case GroupBy_Bitrate:
+      return QString::number(qMax(0, song.bitrate()));
+    case GroupBy_None:
+      qLog(Error) << "GroupBy_None";
+      break;
+  }
+  return QString();
+}
+
+QString LibraryModel::ContainerPath(const LibraryItem* item) const {
+  QString path = item->key;
+  for (const LibraryItem* parent = item->parent;
+       parent && parent->type == LibraryItem::Type_Container;
+       parent = parent->parent) {
+    path.prepend(parent->key + QChar(0));
+  }
+  return path;
+}
+
+void LibraryModel::UpdateVisibleContainers() {
+  visible_containers_.clear();
+
+  QStringList columns;
+  bool has_artist_level = false;
+  for (int i = 0; i < 3; ++i) {
+    if (group_by_[i] == GroupBy_None) break;
+
+    for (const QString& column : ContainerColumns(group_by_[i])) {
+      if (!columns.contains(column)) columns << column;
+    }
+    if (IsArtistGroupBy(group_by_[i])) has_artist_level = true;
+  }
+  if (columns.isEmpty()) return;
+  if (has_artist_level) columns << "effective_compilation";
+
+  // Songs that share all of these values are in the same containers, so each
+  // combination only needs to be looked at once.
+  for (const Song& song :
+       backend_->song_cache()->DistinctSongs(columns, filter_ids_)) {
+    AddVisibleContainers(song);
+  }
+}
+
+void LibraryModel::AddVisibleContainers(const Song& song) {
+  QString path;
+  for (int i = 0; i < 3; ++i) {
+    const GroupBy type = group_by_[i];
+    if (type == GroupBy_None) break;
+
+    QString key;
+    if (IsArtistGroupBy(type) && song.is_compilation()) {
+      // Compilations are only shown under the Various artists node
+      if (!show_various_artists_) return;
+      key = tr("Various artists");
+    } else {
+      key = ContainerKey(type, song);
+    }
+
+    if (i != 0) path.append(QChar(0));
+    path.append(key);
+    visible_containers_.insert(path);
+  }
+}
+
+void LibraryModel::UpdateVisibleDividers() {
+  visible_dividers_.clear();
+  for (LibraryItem* item : root_->children) {
+    if (item->type != LibraryItem::Type_Container &&
+        item->type != LibraryItem::Type_Song) {
+      continue;
+    }
+    if (IsVisible(item)) {
+      visible_dividers_.insert(DividerKey(group_by_[0], item));
+    }
+  }
+}
+
+bool LibraryModel::IsVisible(const QModelIndex& index) const {
+  return IsVisible(IndexToItem(index));
+}
+
+bool LibraryModel::IsVisible(const LibraryItem* item) const {
+  if (!filter_in_place_) return true;
+
+  switch (item->type) {
+    case LibraryItem::Type_Song:
+      return filter_id_set_.contains(item->metadata.id());
+    case LibraryItem::Type_Container:
+      return visible_containers_.contains(ContainerPath(item));
+    case LibraryItem::Type_Divider:
+      return visible_dividers_.contains(item->key);
+    case LibraryItem::Type_PlaylistContainer:
+    case LibraryItem::Type_SmartPlaylist:
+      return query_options_.filter().isEmpty();
+    default:
+      return true;
+  }
+}
+
 bool LibraryModel::canFetchMore(const QModelIndex& parent) const {
   if (!parent.isValid()) return false;
 
@@ -1241,6 +1448,7 @@ bool LibraryModel::canFetchMore(const QModelIndex& parent) const {
 
 void LibraryModel::SetGroupBy(const Grouping& g) {
   group_by_ = g;
+  if (filter_in_place_) UpdateVisibleContainers();
 
   ResetAsync();
   emit GroupingChanged(g);
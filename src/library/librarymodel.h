@@ -20,7 +20,8 @@
 
 #include <QAbstractItemModel>
 #include <QIcon>
-#include <QNetworkDiskCache>
+#include <QSet>
+#include <QVector>
 
 #include "libraryitem.h"
 #include "libraryquery.h"
@@ -57,7 +58,6 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   static const char* kSmartPlaylistsArray;
   static const int kSmartPlaylistsVersion;
   static const int kPrettyCoverSize;
-  static const qint64 kIconCacheSize;
 
   enum Role {
     Role_Type = Qt::UserRole + 1,
@@ -138,6 +138,9 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   // Might be accurate
   int total_song_count() const { return total_song_count_; }
 
+  // False if the item is in the tree but is hidden by the filter.
+  bool IsVisible(const QModelIndex& index) const;
+
   // Smart playlists
   smart_playlists::GeneratorPtr CreateGenerator(const QModelIndex& index) const;
   void AddGenerator(smart_playlists::GeneratorPtr gen);
@@ -172,6 +175,10 @@ signals:
   void TotalSongCountUpdated(int count);
   void GroupingChanged(const LibraryModel::Grouping& g);
 
+  // Emitted when the filter changed the visibility of items without
+  // resetting the model.
+  void FilterChanged();
+
  public slots:
   void SetFilterAge(int age);
   void SetFilterText(const QString& text);
@@ -209,6 +216,24 @@ signals:
 
   void BeginReset();
 
+  // Applies the filter in query_options_, in place if possible, otherwise by
+  // resetting the model with a filtered query.
+  void ApplyFilter();
+  bool FilterInPlace();
+  void ClearFilterInPlace();
+
+  // The options the tree is built with.  When the filter is applied in place
+  // the tree holds every song.
+  QueryOptions TreeQueryOptions() const;
+
+  // Work out which containers and dividers hold songs matching the filter.
+  static QStringList ContainerColumns(GroupBy type);
+  static QString ContainerKey(GroupBy type, const Song& song);
+  QString ContainerPath(const LibraryItem* item) const;
+  void UpdateVisibleContainers();
+  void AddVisibleContainers(const Song& song);
+  void UpdateVisibleDividers();
+
   // Functions for working with queries and creating items.
   // When the model is reset or when a node is lazy-loaded the Library
   // constructs a database query to populate the items.  Filters are added
@@ -249,6 +274,7 @@ signals:
   QVariant AlbumIcon(const QModelIndex& index);
   QVariant data(const LibraryItem* item, int role) const;
   bool CompareItems(const LibraryItem* a, const LibraryItem* b) const;
+  bool IsVisible(const LibraryItem* item) const;
 
  private:
   LibraryBackend* backend_;
@@ -263,6 +289,19 @@ signals:
   QueryOptions query_options_;
   Grouping group_by_;
 
+  // Text and age filters are applied in place when the backend's song cache
+  // can evaluate them: the tree holds every song, and only the items that
+  // contain a song in filter_ids_ are visible.  A narrower filter only tests
+  // the songs that matched the last one.
+  bool tree_has_all_songs_;
+  bool filter_in_place_;
+  QueryOptions filter_options_;
+  QVector<int> filter_ids_;
+  QSet<int> filter_id_set_;
+  // Paths of container keys from the top level down, joined with '\0'.
+  QSet<QString> visible_containers_;
+  QSet<QString> visible_dividers_;
+
   // Keyed on database ID
   QMap<int, LibraryItem*> song_nodes_;
 
@@ -283,8 +322,6 @@ signals:
   QIcon playlists_dir_icon_;
   QIcon playlist_icon_;
 
-  QNetworkDiskCache* icon_cache_;
-
   int init_task_id_;
 
   bool use_pretty_covers_;
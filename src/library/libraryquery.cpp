@@ -21,11 +21,19 @@
 #include <QtDebug>
 #include <QDateTime>
 #include <QSqlError>
+#include <QSqlRecord>
 
 QueryOptions::QueryOptions() : max_age_(-1), query_mode_(QueryMode_All) {}
 
 LibraryQuery::LibraryQuery(const QueryOptions& options)
-    : include_unavailable_(false), join_with_fts_(false), limit_(-1) {
+    : include_unavailable_(false),
+      join_with_fts_(false),
+      limit_(-1),
+      compilation_requirement_(-1),
+      untagged_only_(false),
+      ctime_cutoff_(-1),
+      has_cached_results_(false),
+      cached_result_index_(-1) {
   if (!options.filter().isEmpty()) {
     // We need to munge the filter text a little bit to get it to work as
     // expected with sqlite's FTS3:
@@ -74,6 +82,7 @@ LibraryQuery::LibraryQuery(const QueryOptions& options)
 
     where_clauses_ << "ctime > ?";
     bound_values_ << cutoff;
+    ctime_cutoff_ = cutoff;
   }
 
   // TODO: currently you cannot use any QueryMode other than All and fts at the
@@ -91,6 +100,7 @@ LibraryQuery::LibraryQuery(const QueryOptions& options)
 
   if (options.query_mode() == QueryOptions::QueryMode_Untagged) {
     where_clauses_ << "(artist = '' OR album = '' OR title ='')";
+    untagged_only_ = true;
   }
 }
 
@@ -106,6 +116,8 @@ QString LibraryQuery::GetInnerQuery() {
 
 void LibraryQuery::AddWhere(const QString& column, const QVariant& value,
                             const QString& op) {
+  conditions_ << Condition(column, value, op);
+
   // ignore 'literal' for IN
   if (!op.compare("IN", Qt::CaseInsensitive)) {
     QStringList final;
@@ -136,6 +148,7 @@ void LibraryQuery::AddCompilationRequirement(bool compilation) {
   // more details.
   where_clauses_ << QString("+effective_compilation = %1")
                         .arg(compilation ? 1 : 0);
+  compilation_requirement_ = compilation ? 1 : 0;
 }
 
 QSqlQuery LibraryQuery::Exec(QSqlDatabase db, const QString& songs_table,
@@ -177,9 +190,36 @@ QSqlQuery LibraryQuery::Exec(QSqlDatabase db, const QString& songs_table,
   return query_;
 }
 
-bool LibraryQuery::Next() { return query_.next(); }
+bool LibraryQuery::Next() {
+  if (has_cached_results_) {
+    return ++cached_result_index_ < cached_results_.count();
+  }
+  return query_.next();
+}
+
+QVariant LibraryQuery::Value(int column) const {
+  if (has_cached_results_) {
+    return cached_results_[cached_result_index_].value(column);
+  }
+  return query_.value(column);
+}
 
-QVariant LibraryQuery::Value(int column) const { return query_.value(column); }
+int LibraryQuery::ColumnCount() const {
+  if (has_cached_results_) {
+    if (cached_result_index_ < 0 ||
+        cached_result_index_ >= cached_results_.count()) {
+      return 0;
+    }
+    return cached_results_[cached_result_index_].count();
+  }
+  return query_.record().count();
+}
+
+void LibraryQuery::SetCachedResults(const QList<QVariantList>& rows) {
+  has_cached_results_ = true;
+  cached_results_ = rows;
+  cached_result_index_ = -1;
+}
 
 bool QueryOptions::Matches(const Song& song) const {
   if (max_age_ != -1) {
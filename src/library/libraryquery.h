@@ -90,10 +90,28 @@ class LibraryQuery {
                  const QString& fts_table);
   bool Next();
   QVariant Value(int column) const;
+  int ColumnCount() const;
+
+  // Makes Next() and Value() return these rows instead of running the query.
+  // Used when LibrarySongCache can answer the query itself.
+  void SetCachedResults(const QList<QVariantList>& rows);
 
   operator const QSqlQuery&() const { return query_; }
 
  private:
+  friend class LibrarySongCache;
+
+  // A WHERE fragment added through AddWhere(), kept so the query can be
+  // evaluated without SQL.
+  struct Condition {
+    Condition(const QString& column, const QVariant& value, const QString& op)
+        : column_(column), value_(value), op_(op) {}
+
+    QString column_;
+    QVariant value_;
+    QString op_;
+  };
+
   QString GetInnerQuery();
 
   bool include_unavailable_;
@@ -105,7 +123,16 @@ class LibraryQuery {
   int limit_;
   bool duplicates_only_;
 
+  QList<Condition> conditions_;
+  int compilation_requirement_;  // -1 if there isn't one
+  bool untagged_only_;
+  int ctime_cutoff_;  // -1 if there isn't one
+
   QSqlQuery query_;
+
+  bool has_cached_results_;
+  QList<QVariantList> cached_results_;
+  int cached_result_index_;
 };
 
 #endif  // LIBRARYQUERY_H
@@ -93,6 +93,7 @@ void LibrarySettingsPage::Save() {
   s.beginGroup(LibraryWatcher::kSettingsGroup);
   s.setValue("startup_scan", ui_->startup_scan->isChecked());
   s.setValue("monitor", ui_->monitor->isChecked());
+  s.setValue("parallel_scan", ui_->parallel_scan->isChecked());
 
   QString filter_text = ui_->cover_art_patterns->text();
   QStringList filters = filter_text.split(',', QString::SkipEmptyParts);
@@ -133,6 +134,7 @@ void LibrarySettingsPage::Load() {
   s.beginGroup(LibraryWatcher::kSettingsGroup);
   ui_->startup_scan->setChecked(s.value("startup_scan", true).toBool());
   ui_->monitor->setChecked(s.value("monitor", true).toBool());
+  ui_->parallel_scan->setChecked(s.value("parallel_scan", false).toBool());
 
   QStringList filters =
       s.value("cover_art_patterns", QStringList() << "front"
@@ -0,0 +1,808 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "librarysongcache.h"
+#include "libraryquery.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <QDateTime>
+#include <QRegExp>
+#include <QSet>
+#include <QStringList>
+
+LibrarySongCache::LibrarySongCache()
+    : ready_(false), load_id_(0), next_load_id_(1) {}
+
+QHash<QString, LibrarySongCache::Column> LibrarySongCache::ColumnNames() {
+  QHash<QString, Column> columns;
+  columns["title"] = Column_Title;
+  columns["album"] = Column_Album;
+  columns["artist"] = Column_Artist;
+  columns["albumartist"] = Column_AlbumArtist;
+  columns["effective_albumartist"] = Column_EffectiveAlbumArtist;
+  columns["composer"] = Column_Composer;
+  columns["performer"] = Column_Performer;
+  columns["grouping"] = Column_Grouping;
+  columns["genre"] = Column_Genre;
+  columns["comment"] = Column_Comment;
+  columns["art_automatic"] = Column_ArtAutomatic;
+  columns["art_manual"] = Column_ArtManual;
+  columns["year"] = Column_Year;
+  columns["disc"] = Column_Disc;
+  columns["bitrate"] = Column_Bitrate;
+  columns["filetype"] = Column_Filetype;
+  columns["ctime"] = Column_Ctime;
+  columns["compilation"] = Column_Compilation;
+  columns["sampler"] = Column_Sampler;
+  columns["effective_compilation"] = Column_EffectiveCompilation;
+  columns["filename"] = Column_Filename;
+  return columns;
+}
+
+bool LibrarySongCache::ColumnByName(const QString& name, Column* column) {
+  static const QHash<QString, Column> sColumns = ColumnNames();
+
+  QHash<QString, Column>::const_iterator it =
+      sColumns.constFind(name.trimmed().toLower());
+  if (it == sColumns.constEnd()) return false;
+  *column = it.value();
+  return true;
+}
+
+void LibrarySongCache::Reset(const SongList& songs) {
+  QWriteLocker l(&lock_);
+
+  ClearLocked();
+  ids_.reserve(songs.count());
+  for (const Song& song : songs) {
+    AddOrUpdateSong(song);
+  }
+  ready_ = true;
+}
+
+void LibrarySongCache::Clear() {
+  QWriteLocker l(&lock_);
+  ClearLocked();
+  ready_ = false;
+}
+
+int LibrarySongCache::BeginLoad() {
+  QWriteLocker l(&lock_);
+  ClearLocked();
+  ready_ = false;
+  load_id_ = next_load_id_++;
+  return load_id_;
+}
+
+void LibrarySongCache::LoadSong(int load_id, const Song& song) {
+  QWriteLocker l(&lock_);
+  if (load_id != load_id_ || changed_during_load_.contains(song.id())) return;
+  AddOrUpdateSong(song);
+}
+
+void LibrarySongCache::EndLoad(int load_id) {
+  QWriteLocker l(&lock_);
+  if (load_id != load_id_) return;
+  load_id_ = 0;
+  changed_during_load_.clear();
+  ready_ = true;
+}
+
+void LibrarySongCache::ClearLocked() {
+  strings_.clear();
+  string_ids_.clear();
+  for (int i = 0; i < Column_Filename; ++i) {
+    columns_[i].clear();
+  }
+  filenames_.clear();
+  ids_.clear();
+  rows_by_id_.clear();
+
+  load_id_ = 0;
+  changed_during_load_.clear();
+}
+
+bool LibrarySongCache::is_ready() const {
+  QReadLocker l(&lock_);
+  return ready_;
+}
+
+int LibrarySongCache::song_count() const {
+  QReadLocker l(&lock_);
+  return ids_.count();
+}
+
+int LibrarySongCache::Intern(const QString& value) {
+  QHash<QString, int>::const_iterator it = string_ids_.constFind(value);
+  if (it != string_ids_.constEnd()) return it.value();
+
+  const int id = strings_.count();
+  strings_ << value;
+  string_ids_.insert(value, id);
+  return id;
+}
+
+void LibrarySongCache::AddOrUpdateSongs(const SongList& songs) {
+  QWriteLocker l(&lock_);
+  if (!ready_ && !load_id_) return;
+  for (const Song& song : songs) {
+    if (load_id_) changed_during_load_.insert(song.id());
+    AddOrUpdateSong(song);
+  }
+}
+
+void LibrarySongCache::RemoveSongs(const SongList& songs) {
+  QWriteLocker l(&lock_);
+  if (!ready_ && !load_id_) return;
+  for (const Song& song : songs) {
+    if (load_id_) changed_during_load_.insert(song.id());
+    QHash<int, int>::iterator it = rows_by_id_.find(song.id());
+    if (it != rows_by_id_.end()) {
+      RemoveRow(it.value());
+    }
+  }
+}
+
+void LibrarySongCache::AddOrUpdateSong(const Song& song) {
+  if (song.id() == -1) return;
+
+  QHash<int, int>::const_iterator it = rows_by_id_.constFind(song.id());
+  int row = -1;
+  if (it != rows_by_id_.constEnd()) {
+    row = it.value();
+  }
+
+  if (song.is_unavailable()) {
+    if (row != -1) RemoveRow(row);
+    return;
+  }
+
+  if (row == -1) {
+    row = ids_.count();
+    ids_ << song.id();
+    rows_by_id_[song.id()] = row;
+    for (int i = 0; i < Column_Filename; ++i) {
+      columns_[i].resize(row + 1);
+    }
+    filenames_.resize(row + 1);
+  }
+
+  columns_[Column_Title][row] = Intern(song.title());
+  columns_[Column_Album][row] = Intern(song.album());
+  columns_[Column_Artist][row] = Intern(song.artist());
+  columns_[Column_AlbumArtist][row] = Intern(song.albumartist());
+  columns_[Column_EffectiveAlbumArtist][row] =
+      Intern(song.effective_albumartist());
+  columns_[Column_Composer][row] = Intern(song.composer());
+  columns_[Column_Performer][row] = Intern(song.performer());
+  columns_[Column_Grouping][row] = Intern(song.grouping());
+  columns_[Column_Genre][row] = Intern(song.genre());
+  columns_[Column_Comment][row] = Intern(song.comment());
+  columns_[Column_ArtAutomatic][row] = Intern(song.art_automatic());
+  columns_[Column_ArtManual][row] = Intern(song.art_manual());
+
+  columns_[Column_Year][row] = song.year();
+  columns_[Column_Disc][row] = song.disc();
+  columns_[Column_Bitrate][row] = song.bitrate();
+  columns_[Column_Filetype][row] = song.filetype();
+  columns_[Column_Ctime][row] = song.ctime();
+  columns_[Column_Compilation][row] = song.compilation() ? 1 : 0;
+  columns_[Column_Sampler][row] = song.sampler() ? 1 : 0;
+  columns_[Column_EffectiveCompilation][row] = song.is_compilation() ? 1 : 0;
+
+  filenames_[row] = song.url().toEncoded();
+}
+
+void LibrarySongCache::RemoveRow(int row) {
+  // Move the last row into this one's place so the columns stay packed.
+  const int last = ids_.count() - 1;
+  rows_by_id_.remove(ids_[row]);
+
+  if (row != last) {
+    ids_[row] = ids_[last];
+    rows_by_id_[ids_[row]] = row;
+    for (int i = 0; i < Column_Filename; ++i) {
+      columns_[i][row] = columns_[i][last];
+    }
+    filenames_[row] = filenames_[last];
+  }
+
+  ids_.resize(last);
+  for (int i = 0; i < Column_Filename; ++i) {
+    columns_[i].resize(last);
+  }
+  filenames_.resize(last);
+}
+
+QVariant LibrarySongCache::Value(Column column, int row) const {
+  if (column == Column_Filename) return filenames_[row];
+  if (IsStringColumn(column)) return strings_[columns_[column][row]];
+  if (column == Column_Ctime) return uint(columns_[column][row]);
+  return columns_[column][row];
+}
+
+bool LibrarySongCache::LessThan(Column column, int left, int right) const {
+  if (column == Column_Filename) return filenames_[left] < filenames_[right];
+  if (IsStringColumn(column)) {
+    return strings_[columns_[column][left]] <
+           strings_[columns_[column][right]];
+  }
+  if (column == Column_Ctime) {
+    return uint(columns_[column][left]) < uint(columns_[column][right]);
+  }
+  return columns_[column][left] < columns_[column][right];
+}
+
+bool LibrarySongCache::Execute(LibraryQuery* query) const {
+  if (query->join_with_fts_ || query->duplicates_only_ ||
+      query->include_unavailable_) {
+    return false;
+  }
+
+  // Work out which columns are wanted.
+  QString spec = query->column_spec_.trimmed();
+  bool distinct = false;
+  if (spec.startsWith("DISTINCT ", Qt::CaseInsensitive)) {
+    distinct = true;
+    spec = spec.mid(9);
+  }
+
+  QList<Column> columns;
+  for (const QString& name : spec.split(',')) {
+    Column column;
+    if (!ColumnByName(name, &column)) return false;
+    columns << column;
+  }
+
+  bool ordered = false;
+  Column order_by = Column_Title;
+  if (!query->order_by_.isEmpty()) {
+    QString name = query->order_by_.trimmed();
+    if (name.endsWith(" ASC", Qt::CaseInsensitive)) name.chop(4);
+    if (!ColumnByName(name, &order_by)) return false;
+    ordered = true;
+  }
+
+  // Turn the WHERE fragments into comparisons against the column vectors.
+  // String values are compared by their interned ID.
+  struct Comparison {
+    Column column;
+    int value;
+    bool equal;
+  };
+
+  QReadLocker l(&lock_);
+  if (!ready_) return false;
+
+  QList<Comparison> comparisons;
+  bool impossible = false;
+  for (const LibraryQuery::Condition& condition : query->conditions_) {
+    Comparison comparison;
+    if (!ColumnByName(condition.column_, &comparison.column)) return false;
+    if (comparison.column == Column_Filename) return false;
+
+    if (condition.op_ == "=") {
+      comparison.equal = true;
+    } else if (condition.op_ == "!=") {
+      comparison.equal = false;
+    } else {
+      return false;
+    }
+
+    if (IsStringColumn(comparison.column)) {
+      QHash<QString, int>::const_iterator it =
+          string_ids_.constFind(condition.value_.toString());
+      if (it == string_ids_.constEnd()) {
+        // No song has this value, so an equality test can never match and
+        // an inequality test always will.
+        if (comparison.equal) impossible = true;
+        continue;
+      }
+      comparison.value = it.value();
+    } else {
+      comparison.value = condition.value_.toInt();
+    }
+    comparisons << comparison;
+  }
+
+  QList<QVariantList> results;
+  if (impossible) {
+    query->SetCachedResults(results);
+    return true;
+  }
+
+  const int empty_string_id = string_ids_.value(QString(), -1);
+  const int count = ids_.count();
+
+  QVector<int> rows;
+  for (int row = 0; row < count; ++row) {
+    if (query->compilation_requirement_ != -1 &&
+        columns_[Column_EffectiveCompilation][row] !=
+            query->compilation_requirement_) {
+      continue;
+    }
+
+    if (query->ctime_cutoff_ != -1 &&
+        uint(columns_[Column_Ctime][row]) <= uint(query->ctime_cutoff_)) {
+      continue;
+    }
+
+    if (query->untagged_only_ &&
+        columns_[Column_Artist][row] != empty_string_id &&
+        columns_[Column_Album][row] != empty_string_id &&
+        columns_[Column_Title][row] != empty_string_id) {
+      continue;
+    }
+
+    bool match = true;
+    for (const Comparison& comparison : comparisons) {
+      const bool equal = columns_[comparison.column][row] == comparison.value;
+      if (equal != comparison.equal) {
+        match = false;
+        break;
+      }
+    }
+    if (match) rows << row;
+  }
+
+  if (ordered) {
+    std::stable_sort(rows.begin(), rows.end(), [this, order_by](int a, int b) {
+      return LessThan(order_by, a, b);
+    });
+  }
+
+  QSet<QByteArray> seen;
+  for (int row : rows) {
+    if (query->limit_ != -1 && results.count() >= query->limit_) break;
+
+    if (distinct) {
+      // Interned strings and integers both fit in an int, so the key is just
+      // the selected cells packed together.
+      QByteArray key;
+      for (Column column : columns) {
+        if (column == Column_Filename) {
+          key.append(filenames_[row]);
+          key.append('\0');
+        } else {
+          const int value = columns_[column][row];
+          key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+      }
+      if (seen.contains(key)) continue;
+      seen.insert(key);
+    }
+
+    QVariantList values;
+    for (Column column : columns) {
+      values << Value(column, row);
+    }
+    results << values;
+  }
+
+  query->SetCachedResults(results);
+  return true;
+}
+
+const LibrarySongCache::Column
+    LibrarySongCache::kFtsColumns[LibrarySongCache::kFtsColumnCount] = {
+        Column_Title,       Column_Album,    Column_Artist,
+        Column_AlbumArtist, Column_Composer, Column_Performer,
+        Column_Grouping,    Column_Genre,    Column_Comment};
+
+namespace {
+
+// How much a match in each of the FTS columns adds to a song's score, in the
+// same order as kFtsColumns.  A whole word counts twice as much as a prefix.
+const int kFtsColumnWeights[] = {8, 4, 6, 5, 2, 2, 1, 1, 1};
+
+// Strips any accent from a lower case character, the same way the FTS
+// tokenizer in Database does.
+inline QChar Decompose(const QChar& c) {
+  if (c.decompositionTag() == QChar::NoDecomposition) return c;
+  return c.decomposition()[0];
+}
+
+}  // namespace
+
+bool LibrarySongCache::NormaliseWord(const QString& word,
+                                     QString* normalised) {
+  normalised->clear();
+  for (const QChar& character : word) {
+    const QChar c = character.toLower();
+
+    // The tokenizer would split this word in two, making it a phrase.
+    if (!c.isLetterOrNumber()) return false;
+    normalised->append(Decompose(c));
+  }
+  return !normalised->isEmpty();
+}
+
+LibrarySongCache::Match LibrarySongCache::MatchWord(const QString& text,
+                                                    const FilterTerm& term) {
+  const int length = text.length();
+  const int term_length = term.text.length();
+
+  Match ret = Match_None;
+  int i = 0;
+  while (i < length) {
+    // Compare the next word in the text with the term, a character at a time.
+    const int start = i;
+    int matched = 0;
+    bool mismatch = false;
+    for (; i < length; ++i) {
+      const QChar c = text.at(i).toLower();
+      if (!c.isLetterOrNumber()) break;
+      if (mismatch || (term.prefix && matched == term_length)) continue;
+
+      if (matched < term_length && Decompose(c) == term.text.at(matched)) {
+        ++matched;
+      } else {
+        mismatch = true;
+      }
+    }
+
+    if (!mismatch && matched == term_length) {
+      // Keep looking if only the start of the word matched - a later word
+      // might match completely.
+      if (i - start == term_length) return Match_Word;
+      ret = Match_Prefix;
+    }
+
+    // Skip to the start of the next word.
+    while (i < length && !text.at(i).toLower().isLetterOrNumber()) ++i;
+  }
+  return ret;
+}
+
+bool LibrarySongCache::ParseFilter(const QString& filter,
+                                   QList<FilterTerm>* terms) {
+  // This follows the way LibraryQuery turns the filter into an FTS query,
+  // giving up on anything FTS would parse as more than a list of words.
+  for (QString token :
+       filter.split(QRegExp("\\s+"), QString::SkipEmptyParts)) {
+    token.remove('(');
+    token.remove(')');
+    token.remove('"');
+    token.replace('-', ' ');
+
+    Column column = ColumnCount;
+    if (token.contains(':')) {
+      const QString name = token.section(':', 0, 0);
+      if (Song::kFtsColumns.contains("fts" + name, Qt::CaseInsensitive)) {
+        if (!ColumnByName(name, &column)) return false;
+        token = token.section(':', 1, -1);
+      }
+      token.replace(':', ' ');
+      token = token.trimmed();
+    } else if (token.endsWith(' ')) {
+      // LibraryQuery would put the * on its own.
+      return false;
+    }
+
+    const QStringList words = token.split(' ', QString::SkipEmptyParts);
+    if (words.isEmpty()) return false;
+
+    // A column only applies to the word that follows it, and only the last
+    // word gets the *.
+    for (int i = 0; i < words.count(); ++i) {
+      FilterTerm term;
+      term.column = i == 0 ? column : ColumnCount;
+      term.prefix = i == words.count() - 1;
+      if (!NormaliseWord(words[i], &term.text)) return false;
+      *terms << term;
+    }
+  }
+  return true;
+}
+
+bool LibrarySongCache::IsRefinement(const QueryOptions& previous,
+                                    const QueryOptions& next) {
+  if (previous.query_mode() != QueryOptions::QueryMode_All ||
+      next.query_mode() != QueryOptions::QueryMode_All) {
+    return false;
+  }
+
+  // A shorter maximum age can only remove songs.
+  if (next.max_age() != previous.max_age() &&
+      (next.max_age() == -1 ||
+       (previous.max_age() != -1 && next.max_age() > previous.max_age()))) {
+    return false;
+  }
+
+  QList<FilterTerm> previous_terms;
+  QList<FilterTerm> next_terms;
+  if (!ParseFilter(previous.filter(), &previous_terms) ||
+      !ParseFilter(next.filter(), &next_terms)) {
+    return false;
+  }
+
+  // Each of the previous words has to be implied by one of the new ones.
+  for (const FilterTerm& p : previous_terms) {
+    bool implied = false;
+    for (const FilterTerm& n : next_terms) {
+      if (p.column != ColumnCount && p.column != n.column) continue;
+      if (p.prefix ? n.text.startsWith(p.text)
+                   : !n.prefix && n.text == p.text) {
+        implied = true;
+        break;
+      }
+    }
+    if (!implied) return false;
+  }
+  return true;
+}
+
+int LibrarySongCache::MatchRow(int row, const QList<FilterTerm>& terms,
+                               bool score,
+                               QVector<QVector<qint8>>* matches) const {
+  int ret = 0;
+  for (int t = 0; t < terms.count(); ++t) {
+    const FilterTerm& term = terms[t];
+    int best = 0;
+    for (int c = 0; c < kFtsColumnCount; ++c) {
+      const Column column = kFtsColumns[c];
+      if (term.column != ColumnCount && term.column != column) continue;
+
+      const int string_id = columns_[column][row];
+      qint8& match = (*matches)[t][string_id];
+      if (match == Match_Untested) {
+        match = MatchWord(strings_[string_id], term);
+      }
+      if (match == Match_None) continue;
+      if (!score) {
+        best = 1;
+        break;
+      }
+      best = qMax(best, kFtsColumnWeights[c] * match);
+    }
+    if (best == 0) return 0;
+    ret += best;
+  }
+  return qMax(ret, 1);
+}
+
+bool LibrarySongCache::FindSongs(const QueryOptions& options,
+                                 const QVector<int>* within,
+                                 QVector<int>* ids) const {
+  if (options.query_mode() != QueryOptions::QueryMode_All) return false;
+
+  QList<FilterTerm> terms;
+  if (!ParseFilter(options.filter(), &terms)) return false;
+
+  int cutoff = -1;
+  if (options.max_age() != -1) {
+    cutoff = QDateTime::currentDateTime().toTime_t() - options.max_age();
+  }
+
+  QReadLocker l(&lock_);
+  if (!ready_) return false;
+
+  QVector<QVector<qint8>> matches(terms.count());
+  for (QVector<qint8>& term_matches : matches) {
+    term_matches.fill(Match_Untested, strings_.count());
+  }
+
+  auto row_matches = [&](int row) {
+    if (cutoff != -1 &&
+        uint(columns_[Column_Ctime][row]) <= uint(cutoff)) {
+      return false;
+    }
+    return MatchRow(row, terms, false, &matches) != 0;
+  };
+
+  ids->clear();
+  if (within) {
+    for (int id : *within) {
+      QHash<int, int>::const_iterator it = rows_by_id_.constFind(id);
+      if (it != rows_by_id_.constEnd() && row_matches(it.value())) {
+        *ids << id;
+      }
+    }
+  } else {
+    const int count = ids_.count();
+    for (int row = 0; row < count; ++row) {
+      if (row_matches(row)) *ids << ids_[row];
+    }
+  }
+  return true;
+}
+
+bool LibrarySongCache::FindBestSongs(const QueryOptions& options, int count,
+                                     QVector<int>* ids, bool* more) const {
+  if (options.query_mode() != QueryOptions::QueryMode_All) return false;
+
+  QList<FilterTerm> terms;
+  if (!ParseFilter(options.filter(), &terms)) return false;
+
+  int cutoff = -1;
+  if (options.max_age() != -1) {
+    cutoff = QDateTime::currentDateTime().toTime_t() - options.max_age();
+  }
+
+  // The score of a song that matches every term as a whole word in the best
+  // column it's allowed to.  Nothing can beat that.
+  int best_score = 0;
+  for (const FilterTerm& term : terms) {
+    int best = 0;
+    for (int c = 0; c < kFtsColumnCount; ++c) {
+      if (term.column != ColumnCount && term.column != kFtsColumns[c]) {
+        continue;
+      }
+      best = qMax(best, kFtsColumnWeights[c] * Match_Word);
+    }
+    best_score += best;
+  }
+  best_score = qMax(best_score, 1);
+
+  QReadLocker l(&lock_);
+  if (!ready_) return false;
+
+  QVector<QVector<qint8>> matches(terms.count());
+  for (QVector<qint8>& term_matches : matches) {
+    term_matches.fill(Match_Untested, strings_.count());
+  }
+
+  // Keeps the best count songs seen so far in a heap with the worst of them
+  // at the front.  Ties go to the song that was seen first.
+  typedef QPair<int, int> ScoredRow;  // score, row
+  auto better = [](const ScoredRow& left, const ScoredRow& right) {
+    if (left.first != right.first) return left.first > right.first;
+    return left.second < right.second;
+  };
+  std::vector<ScoredRow> heap;
+  heap.reserve(qMax(count, 0));
+
+  *more = false;
+  const int rows = ids_.count();
+  for (int row = 0; row < rows; ++row) {
+    if (cutoff != -1 &&
+        uint(columns_[Column_Ctime][row]) <= uint(cutoff)) {
+      continue;
+    }
+
+    const int score = MatchRow(row, terms, true, &matches);
+    if (score == 0) continue;
+
+    const ScoredRow scored(score, row);
+    if (int(heap.size()) < count) {
+      heap.push_back(scored);
+      std::push_heap(heap.begin(), heap.end(), better);
+    } else {
+      *more = true;
+      if (count <= 0 || !better(scored, heap.front())) continue;
+      std::pop_heap(heap.begin(), heap.end(), better);
+      heap.back() = scored;
+      std::push_heap(heap.begin(), heap.end(), better);
+    }
+
+    // Nothing later can displace any of these.
+    if (count > 0 && int(heap.size()) == count &&
+        heap.front().first == best_score) {
+      *more = *more || row != rows - 1;
+      break;
+    }
+  }
+
+  std::sort_heap(heap.begin(), heap.end(), better);
+
+  ids->clear();
+  ids->reserve(heap.size());
+  for (const ScoredRow& scored : heap) {
+    *ids << ids_[scored.second];
+  }
+  return true;
+}
+
+SongList LibrarySongCache::DistinctSongs(const QStringList& column_names,
+                                         const QVector<int>& ids) const {
+  QList<Column> columns;
+  for (const QString& name : column_names) {
+    Column column;
+    if (!ColumnByName(name, &column) || column == Column_Filename) {
+      return SongList();
+    }
+    columns << column;
+  }
+
+  QReadLocker l(&lock_);
+  if (!ready_) return SongList();
+
+  SongList ret;
+  QSet<QByteArray> seen;
+  for (int id : ids) {
+    QHash<int, int>::const_iterator it = rows_by_id_.constFind(id);
+    if (it == rows_by_id_.constEnd()) continue;
+    const int row = it.value();
+
+    QByteArray key;
+    for (Column column : columns) {
+      const int value = columns_[column][row];
+      key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    if (seen.contains(key)) continue;
+    seen.insert(key);
+
+    Song song;
+    for (Column column : columns) {
+      const int value = columns_[column][row];
+      switch (column) {
+        case Column_Title:
+          song.set_title(strings_[value]);
+          break;
+        case Column_Album:
+          song.set_album(strings_[value]);
+          break;
+        case Column_Artist:
+          song.set_artist(strings_[value]);
+          break;
+        case Column_AlbumArtist:
+        case Column_EffectiveAlbumArtist:
+          song.set_albumartist(strings_[value]);
+          break;
+        case Column_Composer:
+          song.set_composer(strings_[value]);
+          break;
+        case Column_Performer:
+          song.set_performer(strings_[value]);
+          break;
+        case Column_Grouping:
+          song.set_grouping(strings_[value]);
+          break;
+        case Column_Genre:
+          song.set_genre(strings_[value]);
+          break;
+        case Column_Comment:
+          song.set_comment(strings_[value]);
+          break;
+        case Column_ArtAutomatic:
+          song.set_art_automatic(strings_[value]);
+          break;
+        case Column_ArtManual:
+          song.set_art_manual(strings_[value]);
+          break;
+        case Column_Year:
+          song.set_year(value);
+          break;
+        case Column_Disc:
+          song.set_disc(value);
+          break;
+        case Column_Bitrate:
+          song.set_bitrate(value);
+          break;
+        case Column_Filetype:
+          song.set_filetype(Song::FileType(value));
+          break;
+        case Column_Ctime:
+          song.set_ctime(value);
+          break;
+        case Column_Compilation:
+        case Column_EffectiveCompilation:
+          song.set_compilation(value);
+          break;
+        case Column_Sampler:
+          song.set_sampler(value);
+          break;
+        case Column_Filename:
+        case ColumnCount:
+          break;
+      }
+    }
+    ret << song;
+  }
+  return ret;
+}
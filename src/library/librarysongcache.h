@@ -0,0 +1,210 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARYSONGCACHE_H
+#define LIBRARYSONGCACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+#include "core/song.h"
+
+class LibraryQuery;
+struct QueryOptions;
+
+// An in-memory copy of the columns of a songs table that the library view
+// groups and filters by.  Each column is stored in its own vector, and
+// strings are interned so every distinct artist, album, genre etc. is held
+// only once.  Unavailable songs are not stored.
+//
+// Execute() answers LibraryQuerys that only select, filter and sort on these
+// columns without touching SQLite.  Anything else - FTS filters, the
+// duplicates view, unavailable songs or columns that aren't cached - is
+// refused, and the caller should run the query against the database instead.
+//
+// FindSongs() evaluates a library filter string the way the FTS table would,
+// so the library view can hide songs that don't match without running a new
+// query.  FindBestSongs() does the same but ranks the matches, so global
+// search can show the most relevant songs first without loading the rest.
+//
+// The cache is empty and refuses every query until Reset() is called with the
+// contents of the table, or it is loaded a row at a time with BeginLoad().
+// After that AddOrUpdateSongs() and RemoveSongs() keep it up to date.  All
+// methods are thread-safe.
+class LibrarySongCache {
+ public:
+  LibrarySongCache();
+
+  // Replaces the contents of the cache and starts answering queries.
+  void Reset(const SongList& songs);
+  // Empties the cache and stops answering queries.
+  void Clear();
+
+  // Like Reset(), but takes the songs one at a time so the whole table never
+  // has to be in memory at once.  BeginLoad() empties the cache and returns
+  // an ID to pass to the other two, which do nothing if another load has
+  // started since.  Changes passed to AddOrUpdateSongs() or RemoveSongs()
+  // during the load win over the rows loaded after them, so the table can be
+  // read while it's still being written to.
+  int BeginLoad();
+  void LoadSong(int load_id, const Song& song);
+  void EndLoad(int load_id);
+
+  void AddOrUpdateSongs(const SongList& songs);
+  void RemoveSongs(const SongList& songs);
+
+  bool is_ready() const;
+  int song_count() const;
+
+  // Returns false if the query can't be answered from the cache.  Otherwise
+  // sets the query's results and returns true.
+  bool Execute(LibraryQuery* query) const;
+
+  // Sets ids to the IDs of the songs that match the filter text and age in
+  // options.  If within isn't null only those songs are tested.  Returns false
+  // if the filter can only be evaluated by FTS, or the cache isn't ready.
+  bool FindSongs(const QueryOptions& options, const QVector<int>* within,
+                 QVector<int>* ids) const;
+
+  // Like FindSongs(), but scores each match by which columns it was found in
+  // and whether whole words matched, and sets ids to the IDs of the best count
+  // songs, best first.  more is set to true if other songs might match too.
+  // Scanning stops early once count songs have the best possible score.
+  bool FindBestSongs(const QueryOptions& options, int count, QVector<int>* ids,
+                     bool* more) const;
+
+  // Returns one song for each distinct combination of values of the named
+  // columns among the given songs.  Only those columns are set on each song.
+  // The effective_ columns set the fields they are derived from.
+  SongList DistinctSongs(const QStringList& columns,
+                         const QVector<int>& ids) const;
+
+  // Returns true if every song matching next also matches previous, so the
+  // results for next can be found by testing only the results for previous.
+  static bool IsRefinement(const QueryOptions& previous,
+                           const QueryOptions& next);
+
+ private:
+  enum Column {
+    // Interned strings
+    Column_Title,
+    Column_Album,
+    Column_Artist,
+    Column_AlbumArtist,
+    Column_EffectiveAlbumArtist,
+    Column_Composer,
+    Column_Performer,
+    Column_Grouping,
+    Column_Genre,
+    Column_Comment,
+    Column_ArtAutomatic,
+    Column_ArtManual,
+
+    // Integers
+    Column_Year,
+    Column_Disc,
+    Column_Bitrate,
+    Column_Filetype,
+    Column_Ctime,
+    Column_Compilation,
+    Column_Sampler,
+    Column_EffectiveCompilation,
+
+    // Stored as-is, since it's unique to each song
+    Column_Filename,
+
+    ColumnCount
+  };
+
+  static const int kFirstIntegerColumn = Column_Year;
+
+  // The columns of the FTS table, in the order they're tested.
+  static const int kFtsColumnCount = 9;
+  static const Column kFtsColumns[kFtsColumnCount];
+
+  // How well a string matched a FilterTerm, best last.  0 means the string
+  // hasn't been tested yet.
+  enum Match {
+    Match_None = -1,
+    Match_Untested = 0,
+    Match_Prefix = 1,
+    Match_Word = 2
+  };
+
+  // One word of a filter.  column is ColumnCount if the word can be in any of
+  // the FTS columns.  Only the last word of each token in the filter is a
+  // prefix, the others have to match whole words.
+  struct FilterTerm {
+    Column column;
+    QString text;
+    bool prefix;
+  };
+
+  static bool ParseFilter(const QString& filter, QList<FilterTerm>* terms);
+  static bool NormaliseWord(const QString& word, QString* normalised);
+  static Match MatchWord(const QString& text, const FilterTerm& term);
+
+  static QHash<QString, Column> ColumnNames();
+  static bool ColumnByName(const QString& name, Column* column);
+  static bool IsStringColumn(Column column) {
+    return column < kFirstIntegerColumn;
+  }
+
+  // Returns 0 if the song in row doesn't match every term, otherwise its
+  // score.  If score is false it returns 1 as soon as it knows the song
+  // matches.  matches remembers which strings match which terms, so each
+  // string is only tested once per term however many songs share it.  The
+  // caller must hold lock_.
+  int MatchRow(int row, const QList<FilterTerm>& terms, bool score,
+               QVector<QVector<qint8>>* matches) const;
+
+  void ClearLocked();
+  int Intern(const QString& value);
+  void AddOrUpdateSong(const Song& song);
+  void RemoveRow(int row);
+
+  // The caller must hold lock_.
+  QVariant Value(Column column, int row) const;
+  bool LessThan(Column column, int left, int right) const;
+
+  mutable QReadWriteLock lock_;
+  bool ready_;
+
+  // The ID of the load in progress, or 0 if there isn't one, and the songs
+  // that have changed since it started.
+  int load_id_;
+  int next_load_id_;
+  QSet<int> changed_during_load_;
+
+  QVector<QString> strings_;
+  QHash<QString, int> string_ids_;
+
+  // One vector per column.  String columns hold indexes into strings_,
+  // integer columns hold the values themselves.
+  QVector<int> columns_[Column_Filename];
+  QVector<QByteArray> filenames_;
+
+  QVector<int> ids_;
+  QHash<int, int> rows_by_id_;
+};
+
+#endif  // LIBRARYSONGCACHE_H
@@ -17,16 +17,21 @@
 
 #include "librarywatcher.h"
 
+#include "directorysnapshot.h"
 #include "librarybackend.h"
+#include "core/concurrentrun.h"
 #include "core/filesystemwatcherinterface.h"
 #include "core/logging.h"
 #include "core/tagreaderclient.h"
 #include "core/taskmanager.h"
+#include "core/timeconstants.h"
 #include "core/utilities.h"
 #include "playlistparsers/cueparser.h"
 
 #include <QDateTime>
-#include <QDirIterator>
+#include <QDir>
+#include <QFileInfo>
+#include <QFuture>
 #include <QtDebug>
 #include <QThread>
 #include <QDateTime>
@@ -46,6 +51,9 @@
 QStringList LibraryWatcher::sValidImages;
 
 const char* LibraryWatcher::kSettingsGroup = "LibraryWatcher";
+const int LibraryWatcher::kScanBatchSize = 1000;
+const int LibraryWatcher::kMaxPendingTagReads = 32;
+const int LibraryWatcher::kTagReadBatchSize = 8;
 
 LibraryWatcher::LibraryWatcher(QObject* parent)
     : QObject(parent),
@@ -55,6 +63,7 @@ LibraryWatcher::LibraryWatcher(QObject* parent)
       stop_requested_(false),
       scan_on_startup_(true),
       monitor_(true),
+      parallel_scan_(false),
       rescan_timer_(new QTimer(this)),
       rescan_paused_(false),
       total_watches_(0),
@@ -62,6 +71,8 @@ LibraryWatcher::LibraryWatcher(QObject* parent)
   rescan_timer_->setInterval(1000);
   rescan_timer_->setSingleShot(true);
 
+  scan_thread_pool_.setMaxThreadCount(QThread::idealThreadCount());
+
   if (sValidImages.isEmpty()) {
     sValidImages << "jpg"
                  << "png"
@@ -77,7 +88,8 @@ LibraryWatcher::LibraryWatcher(QObject* parent)
 LibraryWatcher::ScanTransaction::ScanTransaction(LibraryWatcher* watcher,
                                                  int dir, bool incremental,
                                                  bool ignores_mtime)
-    : progress_(0),
+    : parent_(nullptr),
+      progress_(0),
       progress_max_(0),
       dir_(dir),
       incremental_(incremental),
@@ -95,10 +107,31 @@ LibraryWatcher::ScanTransaction::ScanTransaction(LibraryWatcher* watcher,
   emit watcher_->ScanStarted(task_id_);
 }
 
+LibraryWatcher::ScanTransaction::ScanTransaction(ScanTransaction* parent)
+    : parent_(parent),
+      task_id_(parent->task_id_),
+      progress_(0),
+      progress_max_(0),
+      dir_(parent->dir_),
+      incremental_(parent->incremental_),
+      ignores_mtime_(parent->ignores_mtime_),
+      watcher_(parent->watcher_),
+      cached_songs_dirty_(true),
+      known_subdirs_dirty_(true) {}
+
 LibraryWatcher::ScanTransaction::~ScanTransaction() {
+  // Child transactions hand their results to the parent instead
+  if (parent_) return;
+
   // If we're stopping then don't commit the transaction
   if (watcher_->stop_requested_) return;
 
+  CommitScanResults();
+
+  watcher_->task_manager_->SetTaskFinished(task_id_);
+}
+
+void LibraryWatcher::ScanTransaction::CommitScanResults() {
   if (!new_songs.isEmpty()) emit watcher_->NewOrUpdatedSongs(new_songs);
 
   if (!touched_songs.isEmpty()) emit watcher_->SongsMTimeUpdated(touched_songs);
@@ -112,76 +145,136 @@ LibraryWatcher::ScanTransaction::~ScanTransaction() {
   if (!touched_subdirs.isEmpty())
     emit watcher_->SubdirsMTimeUpdated(touched_subdirs);
 
-  watcher_->task_manager_->SetTaskFinished(task_id_);
-
   if (watcher_->monitor_) {
     // Watch the new subdirectories
     for (const Subdirectory& subdir : new_subdirs) {
       watcher_->AddWatch(watcher_->watched_dirs_[dir_], subdir.path);
     }
   }
+
+  new_songs.clear();
+  touched_songs.clear();
+  deleted_songs.clear();
+  readded_songs.clear();
+  new_subdirs.clear();
+  touched_subdirs.clear();
+}
+
+void LibraryWatcher::ScanTransaction::TakeResults(ScanTransaction* child) {
+  new_songs << child->new_songs;
+  touched_songs << child->touched_songs;
+  deleted_songs << child->deleted_songs;
+  readded_songs << child->readded_songs;
+  new_subdirs << child->new_subdirs;
+  touched_subdirs << child->touched_subdirs;
+
+  child->new_songs.clear();
+  child->touched_songs.clear();
+  child->deleted_songs.clear();
+  child->readded_songs.clear();
+  child->new_subdirs.clear();
+  child->touched_subdirs.clear();
+}
+
+int LibraryWatcher::ScanTransaction::pending_song_count() const {
+  return new_songs.count() + touched_songs.count() + deleted_songs.count() +
+         readded_songs.count();
 }
 
 void LibraryWatcher::ScanTransaction::AddToProgress(int n) {
+  if (parent_) {
+    parent_->AddToProgress(n);
+    return;
+  }
+
+  QMutexLocker l(&mutex_);
   progress_ += n;
   watcher_->task_manager_->SetTaskProgress(task_id_, progress_, progress_max_);
 }
 
 void LibraryWatcher::ScanTransaction::AddToProgressMax(int n) {
+  if (parent_) {
+    parent_->AddToProgressMax(n);
+    return;
+  }
+
+  QMutexLocker l(&mutex_);
   progress_max_ += n;
   watcher_->task_manager_->SetTaskProgress(task_id_, progress_, progress_max_);
 }
 
 SongList LibraryWatcher::ScanTransaction::FindSongsInSubdirectory(
     const QString& path) {
+  if (parent_) return parent_->FindSongsInSubdirectory(path);
+
+  QMutexLocker l(&mutex_);
   if (cached_songs_dirty_) {
-    cached_songs_ = watcher_->backend_->FindSongsInDirectory(dir_);
+    cached_songs_.clear();
+    for (const Song& song : watcher_->backend_->FindSongsInDirectory(dir_)) {
+      cached_songs_[song.url().toLocalFile().section('/', 0, -2)] << song;
+    }
     cached_songs_dirty_ = false;
   }
 
-  // TODO: Make this faster
-  SongList ret;
-  for (const Song& song : cached_songs_) {
-    if (song.url().toLocalFile().section('/', 0, -2) == path) ret << song;
-  }
-  return ret;
+  return cached_songs_.value(path);
 }
 
 void LibraryWatcher::ScanTransaction::SetKnownSubdirs(
     const SubdirectoryList& subdirs) {
+  if (parent_) {
+    parent_->SetKnownSubdirs(subdirs);
+    return;
+  }
+
+  QMutexLocker l(&mutex_);
+  IndexKnownSubdirs(subdirs);
+}
+
+void LibraryWatcher::ScanTransaction::IndexKnownSubdirs(
+    const SubdirectoryList& subdirs) {
   known_subdirs_ = subdirs;
+  known_subdirs_by_parent_.clear();
+  seen_subdirs_.clear();
+
+  for (const Subdirectory& subdir : subdirs) {
+    if (subdir.mtime == 0) continue;
+
+    const QString parent_path =
+        subdir.path.left(subdir.path.lastIndexOf(QDir::separator()));
+    known_subdirs_by_parent_[parent_path] << subdir;
+    seen_subdirs_.insert(subdir.path);
+  }
+
   known_subdirs_dirty_ = false;
 }
 
-bool LibraryWatcher::ScanTransaction::HasSeenSubdir(const QString& path) {
+void LibraryWatcher::ScanTransaction::EnsureKnownSubdirs() {
   if (known_subdirs_dirty_)
-    SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
+    IndexKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
+}
 
-  for (const Subdirectory& subdir : known_subdirs_) {
-    if (subdir.path == path && subdir.mtime != 0) return true;
-  }
-  return false;
+bool LibraryWatcher::ScanTransaction::HasSeenSubdir(const QString& path) {
+  if (parent_) return parent_->HasSeenSubdir(path);
+
+  QMutexLocker l(&mutex_);
+  EnsureKnownSubdirs();
+  return seen_subdirs_.contains(path);
 }
 
 SubdirectoryList LibraryWatcher::ScanTransaction::GetImmediateSubdirs(
     const QString& path) {
-  if (known_subdirs_dirty_)
-    SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
+  if (parent_) return parent_->GetImmediateSubdirs(path);
 
-  SubdirectoryList ret;
-  for (const Subdirectory& subdir : known_subdirs_) {
-    if (subdir.path.left(subdir.path.lastIndexOf(QDir::separator())) == path &&
-        subdir.mtime != 0) {
-      ret << subdir;
-    }
-  }
-
-  return ret;
+  QMutexLocker l(&mutex_);
+  EnsureKnownSubdirs();
+  return known_subdirs_by_parent_.value(path);
 }
 
 SubdirectoryList LibraryWatcher::ScanTransaction::GetAllSubdirs() {
-  if (known_subdirs_dirty_)
-    SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
+  if (parent_) return parent_->GetAllSubdirs();
+
+  QMutexLocker l(&mutex_);
+  EnsureKnownSubdirs();
   return known_subdirs_;
 }
 
@@ -202,16 +295,16 @@ void LibraryWatcher::AddDirectory(const Directory& dir,
     ScanTransaction transaction(this, dir.id, true);
     transaction.SetKnownSubdirs(subdirs);
     transaction.AddToProgressMax(subdirs.count());
-    for (const Subdirectory& subdir : subdirs) {
-      if (stop_requested_) return;
 
-      if (scan_on_startup_) ScanSubdirectory(subdir.path, subdir, &transaction);
+    if (scan_on_startup_) ScanSubdirectories(subdirs, &transaction);
+    if (stop_requested_) return;
 
-      if (monitor_) AddWatch(dir, subdir.path);
+    if (monitor_) {
+      for (const Subdirectory& subdir : subdirs) {
+        AddWatch(dir, subdir.path);
+      }
     }
   }
-
-  emit CompilationsNeedUpdating();
 }
 
 void LibraryWatcher::ScanSubdirectory(const QString& path,
@@ -242,6 +335,13 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
   QStringList files_on_disk;
   SubdirectoryList my_new_subdirs;
 
+  // The stat tuples of the files seen on the last scan of this directory, and
+  // the ones we're about to see.
+  const DirectorySnapshot old_snapshot =
+      DirectorySnapshot::Deserialize(subdir.snapshot);
+  DirectorySnapshot new_snapshot;
+  QHash<QString, DirectorySnapshot::Stat> file_stats;
+
   // If a directory is moved then only its parent gets a changed notification,
   // so we need to look and see if any of our children don't exist any more.
   // If one has been removed, "rescan" it to get the deleted songs
@@ -257,32 +357,30 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
   // think might be music.  While we're here, we also look for new
   // subdirectories
   // and possible album artwork.
-  QDirIterator it(
-      path, QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot);
-  while (it.hasNext()) {
+  for (const DirectorySnapshot::Child& child : DirectorySnapshot::List(path)) {
     if (stop_requested_) return;
 
-    QString child(it.next());
-    QFileInfo child_info(child);
-
-    if (child_info.isDir()) {
-      if (!child_info.isHidden() && !t->HasSeenSubdir(child)) {
+    if (child.is_dir) {
+      if (!child.is_hidden && !t->HasSeenSubdir(child.path)) {
         // We haven't seen this subdirectory before - add it to a list and
         // later we'll tell the backend about it and scan it.
         Subdirectory new_subdir;
         new_subdir.directory_id = -1;
-        new_subdir.path = child;
-        new_subdir.mtime = child_info.lastModified().toTime_t();
+        new_subdir.path = child.path;
+        new_subdir.mtime = child.stat.mtime_nsec / kNsecPerSec;
         my_new_subdirs << new_subdir;
       }
     } else {
-      QString ext_part(ExtensionPart(child));
-      QString dir_part(DirectoryPart(child));
-
-      if (sValidImages.contains(ext_part))
-        album_art[dir_part] << child;
-      else if (!child_info.isHidden())
-        files_on_disk << child;
+      QString ext_part(ExtensionPart(child.path));
+      QString dir_part(DirectoryPart(child.path));
+
+      if (sValidImages.contains(ext_part)) {
+        album_art[dir_part] << child.path;
+      } else if (!child.is_hidden) {
+        files_on_disk << child.path;
+        file_stats[child.path] = child.stat;
+        new_snapshot.Insert(FileNamePart(child.path), child.stat);
+      }
     }
   }
 
@@ -291,11 +389,78 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
   // Ask the database for a list of files in this directory
   SongList songs_in_db = t->FindSongsInSubdirectory(path);
 
+  // Files that aren't in the database yet and don't have a cue sheet will
+  // definitely need their tags read.  Keep a few of those reads queued in the
+  // tag reader at all times, so its workers are busy while we're looking at
+  // the rest of the directory.
+  QStringList files_to_read;
+  for (const QString& file : files_on_disk) {
+    Song unused;
+    if (!FindSongByPath(songs_in_db, file, &unused) &&
+        GetMtimeForCue(NoExtensionPart(file) + ".cue") == 0) {
+      files_to_read << file;
+    }
+  }
+
+  // The files are read in batches, so a single round trip to the worker
+  // covers several of them.
+  QHash<TagReaderReply*, QStringList> pending_batches;
+  QHash<QString, TagReaderReply*> pending_reads;
+  QHash<QString, Song> read_songs;
+  int next_file_to_read = 0;
+
+  // Waits for the batch that file is in, and returns its tags.  The tags of
+  // the other files in the batch are kept in read_songs until they're needed.
+  auto take_read_song = [&](const QString& file, Song* song) {
+    TagReaderReply* reply = pending_reads.value(file);
+    if (reply) {
+      const QStringList batch = pending_batches.take(reply);
+      TagReaderClient* client = TagReaderClient::Instance();
+      SongList songs;
+      const bool success = client->WaitForReadFiles(reply, &songs);
+
+      for (int i = 0; i < batch.count(); ++i) {
+        // A file that crashes the worker fails the whole batch, so read each
+        // file on its own if that happened.  Otherwise the healthy files next
+        // to a bad one would never be added.
+        if (!success) {
+          songs[i] = Song();
+          client->WaitForReadFile(client->ReadFile(batch[i]), &songs[i]);
+        }
+
+        pending_reads.remove(batch[i]);
+        read_songs[batch[i]] = songs[i];
+      }
+    }
+
+    if (!read_songs.contains(file)) return false;
+    *song = read_songs.take(file);
+    return true;
+  };
+
   QSet<QString> cues_processed;
 
   // Now compare the list from the database with the list of files on disk
   for (const QString& file : files_on_disk) {
-    if (stop_requested_) return;
+    while (pending_reads.count() < kMaxPendingTagReads &&
+           next_file_to_read < files_to_read.count()) {
+      const QStringList batch =
+          files_to_read.mid(next_file_to_read, kTagReadBatchSize);
+      next_file_to_read += batch.count();
+
+      TagReaderReply* reply = TagReaderClient::Instance()->ReadFiles(batch);
+      pending_batches[reply] = batch;
+      for (const QString& batch_file : batch) {
+        pending_reads[batch_file] = reply;
+      }
+    }
+
+    if (stop_requested_) {
+      for (TagReaderReply* reply : pending_batches.keys()) {
+        TagReaderClient::Instance()->WaitForReadFiles(reply, nullptr);
+      }
+      return;
+    }
 
     // associated cue
     QString matching_cue = NoExtensionPart(file) + ".cue";
@@ -306,14 +471,14 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
 
       // The song is in the database and still on disk.
       // Check the mtime to see if it's been changed since it was added.
-      QFileInfo file_info(file);
+      const DirectorySnapshot::Stat& file_stat = file_stats[file];
+      const uint file_mtime = file_stat.mtime_nsec / kNsecPerSec;
 
-      if (!file_info.exists()) {
-        // Partially fixes race condition - if file was removed between being
-        // added to the list and now.
-        files_on_disk.removeAll(file);
-        continue;
-      }
+      // A file whose inode, size and mtime are all the same as on the last
+      // scan hasn't been touched since, so there's no need to read its tags
+      // again even if we're ignoring mtimes.
+      const bool stat_unchanged =
+          old_snapshot.IsUnchanged(FileNamePart(file), file_stat);
 
       // cue sheet's path from library (if any)
       QString song_cue = matching_song.cue_path();
@@ -325,21 +490,23 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
       // watch out for cue songs which have their mtime equal to
       // qMax(media_file_mtime, cue_sheet_mtime)
       bool changed =
-          (matching_song.mtime() !=
-           qMax(file_info.lastModified().toTime_t(), song_cue_mtime)) ||
+          (matching_song.mtime() != qMax(file_mtime, song_cue_mtime)) ||
           cue_deleted || cue_added;
+      if (t->ignores_mtime() && !stat_unchanged) changed = true;
 
       // Also want to look to see whether the album art has changed
       QString image = ImageForSong(file, album_art);
-      if ((matching_song.art_automatic().isEmpty() && !image.isEmpty()) ||
+      const bool art_changed =
+          (matching_song.art_automatic().isEmpty() && !image.isEmpty()) ||
           (!matching_song.art_automatic().isEmpty() &&
            !matching_song.has_embedded_cover() &&
-           !QFile::exists(matching_song.art_automatic()))) {
+           !QFile::exists(matching_song.art_automatic()));
+      if (art_changed && (!stat_unchanged || matching_song.has_cue())) {
         changed = true;
       }
 
       // the song's changed - reread the metadata from file
-      if (t->ignores_mtime() || changed) {
+      if (changed) {
         qLog(Debug) << file << "changed";
 
         // if cue associated...
@@ -350,6 +517,11 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
           UpdateNonCueAssociatedSong(file, matching_song, image, cue_deleted,
                                      t);
         }
+      } else if (art_changed) {
+        // Only the album art has changed, and the tags are the same as the
+        // ones we've already got.
+        Song song(matching_song);
+        PreserveUserSetData(file, image, matching_song, &song, t);
       }
 
       // nothing has changed - mark the song available without re-scanning
@@ -357,8 +529,11 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
 
     } else {
       // The song is on disk but not in the DB
-      SongList song_list =
-          ScanNewFile(file, path, matching_cue, &cues_processed);
+      Song read_song;
+      const bool was_read = take_read_song(file, &read_song);
+      SongList song_list = ScanNewFile(file, path, matching_cue,
+                                       &cues_processed,
+                                       was_read ? &read_song : nullptr);
 
       if (song_list.isEmpty()) {
         continue;
@@ -377,6 +552,12 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
     }
   }
 
+  // Every file that was read should have been used by now, but don't leave
+  // any replies behind if one wasn't.
+  for (TagReaderReply* reply : pending_batches.keys()) {
+    TagReaderClient::Instance()->WaitForReadFiles(reply, nullptr);
+  }
+
   // Look for deleted songs
   for (const Song& song : songs_in_db) {
     if (!song.is_unavailable() &&
@@ -392,6 +573,7 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
   updated_subdir.mtime =
       path_info.exists() ? path_info.lastModified().toTime_t() : 0;
   updated_subdir.path = path;
+  updated_subdir.snapshot = new_snapshot.Serialize();
 
   if (subdir.directory_id == -1)
     t->new_subdirs << updated_subdir;
@@ -402,10 +584,7 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
 
   // Recurse into the new subdirs that we found
   t->AddToProgressMax(my_new_subdirs.count());
-  for (const Subdirectory& my_new_subdir : my_new_subdirs) {
-    if (stop_requested_) return;
-    ScanSubdirectory(my_new_subdir.path, my_new_subdir, t, true);
-  }
+  ScanSubdirectories(my_new_subdirs, t, true);
 }
 
 void LibraryWatcher::UpdateCueAssociatedSongs(const QString& file,
@@ -413,9 +592,6 @@ void LibraryWatcher::UpdateCueAssociatedSongs(const QString& file,
                                               const QString& matching_cue,
                                               const QString& image,
                                               ScanTransaction* t) {
-  QFile cue(matching_cue);
-  cue.open(QIODevice::ReadOnly);
-
   SongList old_sections = backend_->GetSongsByUrl(QUrl::fromLocalFile(file));
 
   QHash<quint64, Song> sections_map;
@@ -426,7 +602,7 @@ void LibraryWatcher::UpdateCueAssociatedSongs(const QString& file,
   QSet<int> used_ids;
 
   // update every song that's in the cue and library
-  for (Song cue_song : cue_parser_->Load(&cue, matching_cue, path)) {
+  for (Song cue_song : LoadCue(matching_cue, path)) {
     cue_song.set_directory_id(t->dir());
 
     Song matching = sections_map[cue_song.beginning_nanosec()];
@@ -476,7 +652,8 @@ void LibraryWatcher::UpdateNonCueAssociatedSong(const QString& file,
 
 SongList LibraryWatcher::ScanNewFile(const QString& file, const QString& path,
                                      const QString& matching_cue,
-                                     QSet<QString>* cues_processed) {
+                                     QSet<QString>* cues_processed,
+                                     const Song* read_song) {
   SongList song_list;
 
   uint matching_cue_mtime = GetMtimeForCue(matching_cue);
@@ -485,13 +662,10 @@ SongList LibraryWatcher::ScanNewFile(const QString& file, const QString& path,
     // don't process the same cue many times
     if (cues_processed->contains(matching_cue)) return song_list;
 
-    QFile cue(matching_cue);
-    cue.open(QIODevice::ReadOnly);
-
     // Ignore FILEs pointing to other media files. Also, watch out for incorrect
     // media files. Playlist parser for CUEs considers every entry in sheet
     // valid and we don't want invalid media getting into library!
-    for (const Song& cue_song : cue_parser_->Load(&cue, matching_cue, path)) {
+    for (const Song& cue_song : LoadCue(matching_cue, path)) {
       if (cue_song.url().toLocalFile() == file) {
         if (TagReaderClient::Instance()->IsMediaFileBlocking(file)) {
           song_list << cue_song;
@@ -506,7 +680,11 @@ SongList LibraryWatcher::ScanNewFile(const QString& file, const QString& path,
     // it's a normal media file
   } else {
     Song song;
-    TagReaderClient::Instance()->ReadFileBlocking(file, &song);
+    if (read_song) {
+      song = *read_song;
+    } else {
+      TagReaderClient::Instance()->ReadFileBlocking(file, &song);
+    }
 
     if (song.is_valid()) {
       song_list << song;
@@ -516,6 +694,17 @@ SongList LibraryWatcher::ScanNewFile(const QString& file, const QString& path,
   return song_list;
 }
 
+SongList LibraryWatcher::LoadCue(const QString& matching_cue,
+                                 const QString& path) {
+  QFile cue(matching_cue);
+  cue.open(QIODevice::ReadOnly);
+
+  // The parser isn't reentrant, and parallel scans get here from several
+  // threads at once.
+  QMutexLocker l(&cue_parser_mutex_);
+  return cue_parser_->Load(&cue, matching_cue, path);
+}
+
 void LibraryWatcher::PreserveUserSetData(const QString& file,
                                          const QString& image,
                                          const Song& matching_song, Song* out,
@@ -629,8 +818,6 @@ void LibraryWatcher::RescanPathsNow() {
   }
 
   rescan_queue_.clear();
-
-  emit CompilationsNeedUpdating();
 }
 
 QString LibraryWatcher::PickBestImage(const QStringList& images) {
@@ -704,6 +891,7 @@ void LibraryWatcher::ReloadSettings() {
   s.beginGroup(kSettingsGroup);
   scan_on_startup_ = s.value("startup_scan", true).toBool();
   monitor_ = s.value("monitor", true).toBool();
+  parallel_scan_ = s.value("parallel_scan", false).toBool();
 
   best_image_filters_.clear();
   QStringList filters =
@@ -755,12 +943,62 @@ void LibraryWatcher::PerformScan(bool incremental, bool ignore_mtimes) {
     SubdirectoryList subdirs(transaction.GetAllSubdirs());
     transaction.AddToProgressMax(subdirs.count());
 
-    for (const Subdirectory& subdir : subdirs) {
-      if (stop_requested_) return;
+    ScanSubdirectories(subdirs, &transaction);
+    if (stop_requested_) return;
+  }
+}
 
-      ScanSubdirectory(subdir.path, subdir, &transaction);
-    }
+void LibraryWatcher::ScanSubdirectories(const SubdirectoryList& subdirs,
+                                        ScanTransaction* t,
+                                        bool force_noincremental) {
+  // Workers scan the subdirs they discover themselves.  They must never wait
+  // on jobs queued in their own pool, since every thread in it might be
+  // doing the same.
+  if (parallel_scan_ && subdirs.count() > 1 && !t->has_parent()) {
+    ScanSubdirectoriesInParallel(subdirs, t, force_noincremental);
+    return;
   }
 
-  emit CompilationsNeedUpdating();
+  for (const Subdirectory& subdir : subdirs) {
+    if (stop_requested_) return;
+
+    ScanSubdirectory(subdir.path, subdir, t, force_noincremental);
+  }
+}
+
+void LibraryWatcher::ScanSubdirectoriesInParallel(
+    const SubdirectoryList& subdirs, ScanTransaction* t,
+    bool force_noincremental) {
+  // Fill the transaction's caches before starting the workers, so they only
+  // ever read from them and don't open database connections of their own.
+  t->FindSongsInSubdirectory(QString());
+  t->GetAllSubdirs();
+
+  // Every subdirectory gets its own child transaction so the workers never
+  // share a result list.
+  QList<ScanTransaction*> children;
+  QList<QFuture<void>> futures;
+  for (const Subdirectory& subdir : subdirs) {
+    ScanTransaction* child = new ScanTransaction(t);
+    children << child;
+    futures << ConcurrentRun::Run<void>(
+                   &scan_thread_pool_,
+                   std::bind(&LibraryWatcher::ScanSubdirectory, this,
+                             subdir.path, subdir, child, force_noincremental));
+  }
+
+  // Merge the results in the same order as the subdirs, committing them in
+  // batches as we go so the database sees a consistent sequence of writes.
+  for (int i = 0; i < children.count(); ++i) {
+    futures[i].waitForFinished();
+
+    if (!stop_requested_) {
+      t->TakeResults(children[i]);
+      if (!t->has_parent() && t->pending_song_count() >= kScanBatchSize) {
+        t->CommitScanResults();
+      }
+    }
+
+    delete children[i];
+  }
 }
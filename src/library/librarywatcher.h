@@ -20,11 +20,15 @@
 
 #include "directory.h"
 #include "core/song.h"
+#include "core/tagreaderclient.h"
 
 #include <QHash>
+#include <QMutex>
 #include <QObject>
 #include <QStringList>
 #include <QMap>
+#include <QSet>
+#include <QThreadPool>
 
 class QFileSystemWatcher;
 class QTimer;
@@ -42,6 +46,16 @@ class LibraryWatcher : public QObject {
 
   static const char* kSettingsGroup;
 
+  // The number of new or changed songs a parallel scan accumulates before it
+  // commits them to the backend.
+  static const int kScanBatchSize;
+
+  // The number of tag reads each scanning thread keeps queued in the tag
+  // reader workers.
+  static const int kMaxPendingTagReads;
+  // Files are sent to the tag reader in groups of this many.
+  static const int kTagReadBatchSize;
+
   void set_backend(LibraryBackend* backend) { backend_ = backend; }
   void set_task_manager(TaskManager* task_manager) {
     task_manager_ = task_manager;
@@ -64,7 +78,6 @@ signals:
   void SongsReadded(const SongList& songs, bool unavailable = false);
   void SubdirsDiscovered(const SubdirectoryList& subdirs);
   void SubdirsMTimeUpdated(const SubdirectoryList& subdirs);
-  void CompilationsNeedUpdating();
 
   void ScanStarted(int task_id);
 
@@ -88,8 +101,22 @@ signals:
    public:
     ScanTransaction(LibraryWatcher* watcher, int dir, bool incremental,
                     bool ignores_mtime = false);
+    // Creates a transaction that scans on behalf of parent in a worker thread.
+    // It shares the parent's task and caches, and its results are merged into
+    // the parent with TakeResults() instead of being committed.
+    explicit ScanTransaction(ScanTransaction* parent);
     ~ScanTransaction();
 
+    // Emits the signals for the new, changed and deleted songs and subdirs
+    // found so far and clears the lists.
+    void CommitScanResults();
+
+    // Appends the results of a child transaction to this one and clears them
+    // from the child.
+    void TakeResults(ScanTransaction* child);
+    int pending_song_count() const;
+    bool has_parent() const { return parent_ != nullptr; }
+
     SongList FindSongsInSubdirectory(const QString& path);
     bool HasSeenSubdir(const QString& path);
     void SetKnownSubdirs(const SubdirectoryList& subdirs);
@@ -114,6 +141,12 @@ signals:
     ScanTransaction(const ScanTransaction&) {}
     ScanTransaction& operator=(const ScanTransaction&) { return *this; }
 
+    // Must be called with mutex_ held.
+    void IndexKnownSubdirs(const SubdirectoryList& subdirs);
+    void EnsureKnownSubdirs();
+
+    ScanTransaction* parent_;
+
     int task_id_;
     int progress_;
     int progress_max_;
@@ -130,10 +163,18 @@ signals:
 
     LibraryWatcher* watcher_;
 
-    SongList cached_songs_;
+    // Guards the progress and the caches below, which are shared with child
+    // transactions running in other threads.
+    QMutex mutex_;
+
+    // Songs in this directory according to the library, keyed by the path of
+    // the subdirectory that contains them.
+    QHash<QString, SongList> cached_songs_;
     bool cached_songs_dirty_;
 
     SubdirectoryList known_subdirs_;
+    QHash<QString, SubdirectoryList> known_subdirs_by_parent_;
+    QSet<QString> seen_subdirs_;
     bool known_subdirs_dirty_;
   };
 
@@ -151,6 +192,7 @@ signals:
   inline static QString NoExtensionPart(const QString& fileName);
   inline static QString ExtensionPart(const QString& fileName);
   inline static QString DirectoryPart(const QString& fileName);
+  inline static QString FileNamePart(const QString& fileName);
   QString PickBestImage(const QStringList& images);
   QString ImageForSong(const QString& path,
                        QMap<QString, QStringList>& album_art);
@@ -158,6 +200,16 @@ signals:
   uint GetMtimeForCue(const QString& cue_path);
   void PerformScan(bool incremental, bool ignore_mtimes);
 
+  // Scans each of the subdirs, either one after the other on this thread or,
+  // if parallel scanning is enabled, in scan_thread_pool_.  Results are
+  // merged back into t in the same order as the subdirs.  Subdirs found by a
+  // worker are scanned on that worker, one after the other.
+  void ScanSubdirectories(const SubdirectoryList& subdirs, ScanTransaction* t,
+                          bool force_noincremental = false);
+  void ScanSubdirectoriesInParallel(const SubdirectoryList& subdirs,
+                                    ScanTransaction* t,
+                                    bool force_noincremental);
+
   // Updates the sections of a cue associated and altered (according to mtime)
   // media file during a scan.
   void UpdateCueAssociatedSongs(const QString& file, const QString& path,
@@ -178,9 +230,12 @@ signals:
   // library.
   // It may result in a multiple files added to the library when the media file
   // has many sections (like a CUE related media file).
+  // read_song is the file's tags, if they've been read already.
   SongList ScanNewFile(const QString& file, const QString& path,
                        const QString& matching_cue,
-                       QSet<QString>* cues_processed);
+                       QSet<QString>* cues_processed,
+                       const Song* read_song = nullptr);
+  SongList LoadCue(const QString& matching_cue, const QString& path);
 
  private:
   LibraryBackend* backend_;
@@ -200,6 +255,11 @@ signals:
   bool stop_requested_;
   bool scan_on_startup_;
   bool monitor_;
+  bool parallel_scan_;
+
+  // Used for parallel scans.  Each subdirectory is one job, so threads that
+  // finish early simply pick up the next one.
+  QThreadPool scan_thread_pool_;
 
   QMap<int, Directory> watched_dirs_;
   QTimer* rescan_timer_;
@@ -210,6 +270,7 @@ signals:
   int total_watches_;
 
   CueParser* cue_parser_;
+  QMutex cue_parser_mutex_;
 
   static QStringList sValidImages;
 };
@@ -226,5 +287,8 @@ inline QString LibraryWatcher::ExtensionPart(const QString& fileName) {
 inline QString LibraryWatcher::DirectoryPart(const QString& fileName) {
   return fileName.section('/', 0, -2);
 }
+inline QString LibraryWatcher::FileNamePart(const QString& fileName) {
+  return fileName.section('/', -1);
+}
 
 #endif  // LIBRARYWATCHER_H
@@ -23,7 +23,12 @@
 
 SqlRow::SqlRow(const QSqlQuery& query) { Init(query); }
 
-SqlRow::SqlRow(const LibraryQuery& query) { Init(query); }
+SqlRow::SqlRow(const LibraryQuery& query) {
+  const int columns = query.ColumnCount();
+  for (int i = 0; i < columns; ++i) {
+    columns_ << query.Value(i);
+  }
+}
 
 void SqlRow::Init(const QSqlQuery& query) {
   int rows = query.record().count();
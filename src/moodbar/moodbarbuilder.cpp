@@ -20,6 +20,10 @@
 
 #include <cmath>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace {
 
 static const int sBarkBands[] = {
@@ -40,8 +44,7 @@ void MoodbarBuilder::Init(int bands, int rate_hz) {
   bands_ = bands;
   rate_hz_ = rate_hz;
 
-  barkband_table_.clear();
-  barkband_table_.reserve(bands + 1);
+  barkband_starts_.fill(bands + 1, sBarkBandCount + 1);
 
   int barkband = 0;
   for (int i = 0; i < bands + 1; ++i) {
@@ -50,29 +53,54 @@ void MoodbarBuilder::Init(int bands, int rate_hz) {
       barkband++;
     }
 
-    barkband_table_.append(barkband);
+    barkband_starts_[barkband] = qMin(barkband_starts_[barkband], i);
+  }
+
+  // Bark bands that no spectrum band falls into are empty ranges.
+  for (int i = sBarkBandCount - 1; i >= 0; --i) {
+    barkband_starts_[i] = qMin(barkband_starts_[i], barkband_starts_[i + 1]);
   }
 }
 
-void MoodbarBuilder::AddFrame(const double* magnitudes, int size) {
-  if (size > barkband_table_.length()) {
-    return;
+double MoodbarBuilder::Sum(const float* values, int count) {
+  int i = 0;
+  double ret = 0.0;
+
+#ifdef __SSE2__
+  // Accumulate in double precision, two lanes for each half of the floats.
+  __m128d lo = _mm_setzero_pd();
+  __m128d hi = _mm_setzero_pd();
+  for (; i + 4 <= count; i += 4) {
+    const __m128 v = _mm_loadu_ps(values + i);
+    lo = _mm_add_pd(lo, _mm_cvtps_pd(v));
+    hi = _mm_add_pd(hi, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
   }
 
-  // Calculate total magnitudes for different bark bands.
-  double bands[sBarkBandCount];
-  for (int i = 0; i < sBarkBandCount; ++i) {
-    bands[i] = 0.0;
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(lo, hi));
+  ret = lanes[0] + lanes[1];
+#endif
+
+  for (; i < count; ++i) {
+    ret += values[i];
   }
+  return ret;
+}
 
-  for (int i = 0; i < size; ++i) {
-    bands[barkband_table_[i]] += magnitudes[i];
+void MoodbarBuilder::AddFrame(const float* magnitudes, int size) {
+  if (size > bands_ + 1) {
+    return;
   }
 
-  // Now divide the bark bands into thirds and compute their total amplitudes.
+  // Calculate total magnitudes for the bark bands, then divide them into
+  // thirds and compute their total amplitudes.
   double rgb[] = {0, 0, 0};
   for (int i = 0; i < sBarkBandCount; ++i) {
-    rgb[(i * 3) / sBarkBandCount] += bands[i] * bands[i];
+    const int start = qMin(barkband_starts_[i], size);
+    const int end = qMin(barkband_starts_[i + 1], size);
+    const double band = Sum(magnitudes + start, end - start);
+
+    rgb[(i * 3) / sBarkBandCount] += band * band;
   }
 
   frames_.append(Rgb(sqrt(rgb[0]), sqrt(rgb[1]), sqrt(rgb[2])));
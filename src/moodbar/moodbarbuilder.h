@@ -20,13 +20,14 @@
 
 #include <QColor>
 #include <QList>
+#include <QVector>
 
 class MoodbarBuilder {
  public:
   MoodbarBuilder();
 
   void Init(int bands, int rate_hz);
-  void AddFrame(const double* magnitudes, int size);
+  void AddFrame(const float* magnitudes, int size);
   QByteArray Finish(int width);
 
  private:
@@ -39,8 +40,12 @@ class MoodbarBuilder {
 
   int BandFrequency(int band) const;
   static void Normalize(QList<Rgb>* vals, double Rgb::*member);
+  static double Sum(const float* values, int count);
 
-  QList<uint> barkband_table_;
+  // The first spectrum band in each bark band, plus one past the last band.
+  // Bark bands cover contiguous ranges of the spectrum, so each one can be
+  // summed in a single pass.
+  QVector<int> barkband_starts_;
   int bands_;
   int rate_hz_;
 
@@ -22,25 +22,42 @@
 #include <QCoreApplication>
 #include <QDir>
 #include <QFileInfo>
+#include <QFutureWatcher>
 #include <QNetworkDiskCache>
 #include <QTimer>
 #include <QThread>
 #include <QUrl>
+#include <QtConcurrentRun>
 
 #include "moodbarpipeline.h"
+#include "moodstore.h"
 #include "core/application.h"
 #include "core/closure.h"
 #include "core/logging.h"
 #include "core/qhash_qurl.h"
+#include "core/taskmanager.h"
+#include "core/timeconstants.h"
 #include "core/utilities.h"
+#include "library/librarybackend.h"
 
 MoodbarLoader::MoodbarLoader(Application* app, QObject* parent)
     : QObject(parent),
+      app_(app),
       cache_(new QNetworkDiskCache(this)),
-      thread_(new QThread(this)),
+      store_(new MoodStore(
+          Utilities::GetConfigPath(Utilities::Path_CacheRoot) + "/moods.db")),
+      next_thread_(0),
       kMaxActiveRequests(qMax(1, QThread::idealThreadCount() / 2)),
+      kMaxBatchRequests(qMax(1, QThread::idealThreadCount())),
+      batch_task_id_(-1),
+      batch_total_(0),
+      batch_done_(0),
+      batch_failed_(0),
+      batch_audio_nanosec_(0),
       save_alongside_originals_(false),
       disable_moodbar_calculation_(false) {
+  // Moodbars used to be kept in this cache.  It's still read from, but new
+  // data goes into the mood store.
   cache_->setCacheDirectory(
       Utilities::GetConfigPath(Utilities::Path_MoodbarCache));
   cache_->setMaximumCacheSize(60 * 1024 *
@@ -51,8 +68,12 @@ MoodbarLoader::MoodbarLoader(Application* app, QObject* parent)
 }
 
 MoodbarLoader::~MoodbarLoader() {
-  thread_->quit();
-  thread_->wait(1000);
+  for (QThread* thread : threads_) {
+    thread->quit();
+  }
+  for (QThread* thread : threads_) {
+    thread->wait(1000);
+  }
 }
 
 void MoodbarLoader::ReloadSettings() {
@@ -62,6 +83,16 @@ void MoodbarLoader::ReloadSettings() {
       s.value("save_alongside_originals", false).toBool();
 
   disable_moodbar_calculation_ = !s.value("calculate", true).toBool();
+
+  if (disable_moodbar_calculation_ && batch_task_id_ != -1) {
+    // Give up on the songs in the batch that haven't been started.
+    batch_total_ -= batch_queue_.count();
+    batch_queue_.clear();
+    if (active_batch_items_.isEmpty()) {
+      FinishBatch();
+    }
+  }
+
   MaybeTakeNextRequest();
 }
 
@@ -78,6 +109,13 @@ QStringList MoodbarLoader::MoodFilenames(const QString& song_filename) {
                        << dir_path + "/" + mood_filename;
 }
 
+bool MoodbarLoader::HasMoodFile(const QString& song_filename) {
+  for (const QString& possible_mood_file : MoodFilenames(song_filename)) {
+    if (QFile::exists(possible_mood_file)) return true;
+  }
+  return false;
+}
+
 MoodbarLoader::Result MoodbarLoader::Load(const QUrl& url, QByteArray* data,
                                           MoodbarPipeline** async_pipeline) {
   if (url.scheme() != "file") {
@@ -102,46 +140,100 @@ MoodbarLoader::Result MoodbarLoader::Load(const QUrl& url, QByteArray* data,
     }
   }
 
-  // Maybe it exists in the cache?
+  // Maybe it's in the store?
+  const quint64 fingerprint = MoodStore::Fingerprint(filename);
+  *data = store_->Get(fingerprint);
+  if (!data->isEmpty()) {
+    return Loaded;
+  }
+
+  // Or in the old cache, in which case move it to the store.
   std::unique_ptr<QIODevice> cache_device(cache_->data(url));
   if (cache_device) {
     qLog(Info) << "Loading cached moodbar data for" << filename;
     *data = cache_device->readAll();
+    cache_device.reset();
+
     if (!data->isEmpty()) {
+      store_->Put(fingerprint, *data);
+      cache_->remove(url);
       return Loaded;
     }
   }
 
-  if (!thread_->isRunning()) thread_->start(QThread::IdlePriority);
-
   // There was no existing file, analyze the audio file and create one.
+  MoodbarPipeline* pipeline = CreatePipeline(url);
+  queued_requests_ << url;
+
+  MaybeTakeNextRequest();
+
+  *async_pipeline = pipeline;
+  return WillLoadAsync;
+}
+
+MoodbarPipeline* MoodbarLoader::CreatePipeline(const QUrl& url) {
+  if (threads_.count() < kMaxBatchRequests) {
+    QThread* thread = new QThread(this);
+    thread->start(QThread::IdlePriority);
+    threads_ << thread;
+  }
+
   MoodbarPipeline* pipeline = new MoodbarPipeline(url);
-  pipeline->moveToThread(thread_);
+  pipeline->moveToThread(threads_[next_thread_++ % threads_.count()]);
   NewClosure(pipeline, SIGNAL(Finished(bool)), this,
              SLOT(RequestFinished(MoodbarPipeline*, QUrl)), pipeline, url);
 
   requests_[url] = pipeline;
-  queued_requests_ << url;
+  return pipeline;
+}
 
-  MaybeTakeNextRequest();
+void MoodbarLoader::StartRequest(const QUrl& url) {
+  active_requests_ << url;
 
-  *async_pipeline = pipeline;
-  return WillLoadAsync;
+  qLog(Info) << "Creating moodbar data for" << url.toLocalFile();
+  QMetaObject::invokeMethod(requests_[url], "Start", Qt::QueuedConnection);
 }
 
 void MoodbarLoader::MaybeTakeNextRequest() {
   Q_ASSERT(QThread::currentThread() == qApp->thread());
 
-  if (active_requests_.count() >= kMaxActiveRequests ||
-      queued_requests_.isEmpty() || disable_moodbar_calculation_) {
+  if (disable_moodbar_calculation_) {
     return;
   }
 
-  const QUrl url = queued_requests_.takeFirst();
-  active_requests_ << url;
+  // Songs that are being shown always go first.  The library batch is
+  // allowed to use every core while it runs.
+  const int max_requests =
+      batch_task_id_ == -1 ? kMaxActiveRequests : kMaxBatchRequests;
 
-  qLog(Info) << "Creating moodbar data for" << url.toLocalFile();
-  QMetaObject::invokeMethod(requests_[url], "Start", Qt::QueuedConnection);
+  while (active_requests_.count() < max_requests) {
+    if (!queued_requests_.isEmpty()) {
+      StartRequest(queued_requests_.takeFirst());
+      continue;
+    }
+
+    if (batch_queue_.isEmpty()) {
+      break;
+    }
+
+    const BatchItem item = batch_queue_.takeFirst();
+    active_batch_items_[item.url_] = item.length_nanosec_;
+
+    if (requests_.contains(item.url_)) {
+      // Load already asked for this one, so just wait for it to finish.
+      continue;
+    }
+
+    const QString filename = item.url_.toLocalFile();
+    if (HasMoodFile(filename) ||
+        store_->Contains(MoodStore::Fingerprint(filename))) {
+      BatchItemFinished(item.url_, true);
+      continue;
+    }
+
+    CreatePipeline(item.url_);
+    StartRequest(item.url_);
+  }
 }
 
 void MoodbarLoader::RequestFinished(MoodbarPipeline* request, const QUrl& url) {
@@ -151,15 +243,8 @@ void MoodbarLoader::RequestFinished(MoodbarPipeline* request, const QUrl& url) {
     qLog(Info) << "Moodbar data generated successfully for"
                << url.toLocalFile();
 
-    // Save the data in the cache
-    QNetworkCacheMetaData metadata;
-    metadata.setUrl(url);
-
-    QIODevice* cache_file = cache_->prepare(metadata);
-    if (cache_file) {
-      cache_file->write(request->data());
-      cache_->insert(cache_file);
-    }
+    // Save the data in the store
+    store_->Put(MoodStore::Fingerprint(url.toLocalFile()), request->data());
 
     // Save the data alongside the original as well if we're configured to.
     if (save_alongside_originals_) {
@@ -179,5 +264,109 @@ void MoodbarLoader::RequestFinished(MoodbarPipeline* request, const QUrl& url) {
 
   QTimer::singleShot(1000, request, SLOT(deleteLater()));
 
+  BatchItemFinished(url, request->success());
   MaybeTakeNextRequest();
 }
+
+void MoodbarLoader::CreateMoodbarsForLibrary() {
+  if (batch_task_id_ != -1) {
+    return;
+  }
+  if (disable_moodbar_calculation_) {
+    qLog(Info) << "Not creating moodbars, moodbar calculation is disabled";
+    return;
+  }
+
+  batch_task_id_ = app_->task_manager()->StartTask(tr("Creating moodbars"));
+
+  QFuture<QList<BatchItem>> future =
+      QtConcurrent::run(this, &MoodbarLoader::FindSongsWithoutMoodbars);
+  QFutureWatcher<QList<BatchItem>>* watcher =
+      new QFutureWatcher<QList<BatchItem>>(this);
+  watcher->setFuture(future);
+  NewClosure(watcher, SIGNAL(finished()), [=]() {
+    BatchLoaded(watcher->result());
+    watcher->deleteLater();
+  });
+}
+
+QList<MoodbarLoader::BatchItem> MoodbarLoader::FindSongsWithoutMoodbars()
+    const {
+  QList<BatchItem> ret;
+  QSet<QUrl> seen;
+
+  for (const Song& song : app_->library_backend()->GetAllSongs()) {
+    if (song.url().scheme() != "file" || seen.contains(song.url())) {
+      continue;
+    }
+    // Songs from a cue sheet share a file, which only needs doing once.
+    seen << song.url();
+
+    const QString filename = song.url().toLocalFile();
+    if (HasMoodFile(filename) ||
+        store_->Contains(MoodStore::Fingerprint(filename))) {
+      continue;
+    }
+
+    BatchItem item;
+    item.url_ = song.url();
+    item.length_nanosec_ = song.length_nanosec();
+    ret << item;
+  }
+
+  return ret;
+}
+
+void MoodbarLoader::BatchLoaded(const QList<BatchItem>& items) {
+  qLog(Info) << "Creating moodbars for" << items.count() << "songs";
+
+  batch_queue_ = items;
+  batch_total_ = items.count();
+  batch_done_ = 0;
+  batch_failed_ = 0;
+  batch_audio_nanosec_ = 0;
+  batch_timer_.start();
+
+  if (items.isEmpty()) {
+    FinishBatch();
+    return;
+  }
+
+  app_->task_manager()->SetTaskProgress(batch_task_id_, 0, batch_total_);
+  MaybeTakeNextRequest();
+}
+
+void MoodbarLoader::BatchItemFinished(const QUrl& url, bool success) {
+  QHash<QUrl, qint64>::iterator it = active_batch_items_.find(url);
+  if (it == active_batch_items_.end()) {
+    return;
+  }
+
+  if (success) {
+    batch_audio_nanosec_ += qMax(qint64(0), it.value());
+  } else {
+    batch_failed_++;
+  }
+  active_batch_items_.erase(it);
+
+  batch_done_++;
+  app_->task_manager()->SetTaskProgress(batch_task_id_, batch_done_,
+                                        batch_total_);
+
+  if (batch_queue_.isEmpty() && active_batch_items_.isEmpty()) {
+    FinishBatch();
+  }
+}
+
+void MoodbarLoader::FinishBatch() {
+  const double seconds = qMax(qint64(1), batch_timer_.elapsed()) / 1000.0;
+  const double audio_seconds = double(batch_audio_nanosec_) / kNsecPerSec;
+
+  qLog(Info) << "Created" << batch_done_ - batch_failed_ << "moodbars,"
+             << batch_failed_ << "failed, in" << seconds << "seconds -"
+             << batch_done_ / seconds << "songs per second,"
+             << audio_seconds / seconds << "times real time";
+
+  app_->task_manager()->SetTaskFinished(batch_task_id_);
+  batch_task_id_ = -1;
+}
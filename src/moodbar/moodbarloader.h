@@ -18,15 +18,20 @@
 #ifndef MOODBARLOADER_H
 #define MOODBARLOADER_H
 
+#include <memory>
+
+#include <QElapsedTimer>
+#include <QHash>
 #include <QMap>
 #include <QObject>
 #include <QSet>
+#include <QUrl>
 
 class QNetworkDiskCache;
-class QUrl;
 
 class Application;
 class MoodbarPipeline;
+class MoodStore;
 
 class MoodbarLoader : public QObject {
   Q_OBJECT
@@ -51,6 +56,12 @@ class MoodbarLoader : public QObject {
   Result Load(const QUrl& url, QByteArray* data,
               MoodbarPipeline** async_pipeline);
 
+ public slots:
+  // Creates moodbar data for every song in the library that doesn't have any
+  // yet, using more threads than Load does.  Songs requested by Load still go
+  // first.
+  void CreateMoodbarsForLibrary();
+
  private slots:
   void ReloadSettings();
 
@@ -58,18 +69,50 @@ class MoodbarLoader : public QObject {
   void MaybeTakeNextRequest();
 
  private:
+  struct BatchItem {
+    QUrl url_;
+    qint64 length_nanosec_;
+  };
+
   static QStringList MoodFilenames(const QString& song_filename);
+  static bool HasMoodFile(const QString& song_filename);
+
+  MoodbarPipeline* CreatePipeline(const QUrl& url);
+  void StartRequest(const QUrl& url);
+
+  // Runs in a background thread.
+  QList<BatchItem> FindSongsWithoutMoodbars() const;
+  void BatchLoaded(const QList<BatchItem>& items);
+  void BatchItemFinished(const QUrl& url, bool success);
+  void FinishBatch();
 
  private:
+  Application* app_;
   QNetworkDiskCache* cache_;
-  QThread* thread_;
+  std::unique_ptr<MoodStore> store_;
+
+  // Pipelines are spread across these so that starting and stopping one
+  // doesn't hold up the others.
+  QList<QThread*> threads_;
+  int next_thread_;
 
   const int kMaxActiveRequests;
+  const int kMaxBatchRequests;
 
   QMap<QUrl, MoodbarPipeline*> requests_;
   QList<QUrl> queued_requests_;
   QSet<QUrl> active_requests_;
 
+  // The library batch, if one is running.
+  int batch_task_id_;
+  QList<BatchItem> batch_queue_;
+  QHash<QUrl, qint64> active_batch_items_;
+  int batch_total_;
+  int batch_done_;
+  int batch_failed_;
+  qint64 batch_audio_nanosec_;
+  QElapsedTimer batch_timer_;
+
   bool save_alongside_originals_;
   bool disable_moodbar_calculation_;
 };
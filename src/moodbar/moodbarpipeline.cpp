@@ -107,8 +107,9 @@ void MoodbarPipeline::Start() {
   g_object_set(spectrum, "bands", kBands, nullptr);
 
   GstFastSpectrum* fast_spectrum = GST_FASTSPECTRUM(spectrum);
-  fast_spectrum->output_callback = [this](
-      double* magnitudes, int size) { builder_->AddFrame(magnitudes, size); };
+  fast_spectrum->output_callback = [this](const float* magnitudes, int size) {
+    builder_->AddFrame(magnitudes, size);
+  };
 
   // Connect signals
   CHECKED_GCONNECT(decodebin, "pad-added", &NewPadCallback, this);
@@ -0,0 +1,304 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "moodstore.h"
+
+#include <string.h>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMap>
+
+#include "core/logging.h"
+
+namespace {
+
+const quint32 kVersion = 1;
+
+// Don't bother rewriting the file to save less than this.
+const qint64 kMinCompactionBytes = 1024 * 1024;
+
+}  // namespace
+
+// The file starts with the magic and a version number, followed by records
+// of a 64 bit fingerprint, a 32 bit size and then the data, all in the
+// machine's byte order.
+const char MoodStore::kMagic[] = "CLEMMOOD";
+
+MoodStore::MoodStore(const QString& filename)
+    : filename_(filename),
+      file_(filename),
+      map_(nullptr),
+      map_size_(0),
+      file_size_(0),
+      dead_bytes_(0) {
+  QMutexLocker l(&mutex_);
+  if (!Open()) {
+    qLog(Warning) << "Couldn't open the mood store" << filename_ << ":"
+                  << file_.errorString();
+    return;
+  }
+
+  if (dead_bytes_ > kMinCompactionBytes && dead_bytes_ > file_size_ / 2) {
+    Compact();
+  }
+}
+
+MoodStore::~MoodStore() {
+  QMutexLocker l(&mutex_);
+  Close();
+}
+
+quint64 MoodStore::Fingerprint(const QString& filename) {
+  const QFileInfo info(filename);
+  if (!info.exists()) return 0;
+
+  const qint64 size = info.size();
+  const uint mtime = info.lastModified().toTime_t();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(info.absoluteFilePath().toUtf8());
+  hash.addData(reinterpret_cast<const char*>(&size), sizeof(size));
+  hash.addData(reinterpret_cast<const char*>(&mtime), sizeof(mtime));
+
+  quint64 ret = 0;
+  memcpy(&ret, hash.result().constData(), sizeof(ret));
+
+  // 0 means there's no file.
+  return ret ? ret : 1;
+}
+
+bool MoodStore::Open() {
+  QDir().mkpath(QFileInfo(filename_).path());
+  if (!file_.open(QIODevice::ReadWrite)) return false;
+
+  file_size_ = file_.size();
+
+  QByteArray header = file_.read(kHeaderSize);
+  quint32 version = 0;
+  if (header.size() == kHeaderSize) {
+    memcpy(&version, header.constData() + 8, sizeof(version));
+  }
+
+  if (!header.startsWith(QByteArray(kMagic, 8)) || version != kVersion) {
+    // This is either a new file or one we don't understand, so start again.
+    header = QByteArray(kMagic, 8);
+    header.append(reinterpret_cast<const char*>(&kVersion), sizeof(kVersion));
+    header.append(QByteArray(kHeaderSize - header.size(), '\0'));
+
+    if (!file_.resize(0) || !file_.seek(0) ||
+        file_.write(header) != kHeaderSize) {
+      file_.close();
+      return false;
+    }
+    file_.flush();
+    file_size_ = kHeaderSize;
+  }
+
+  Scan();
+  return true;
+}
+
+void MoodStore::Close() {
+  if (map_) {
+    file_.unmap(map_);
+    map_ = nullptr;
+    map_size_ = 0;
+  }
+  file_.close();
+  index_.clear();
+  file_size_ = 0;
+  dead_bytes_ = 0;
+}
+
+void MoodStore::Scan() {
+  index_.clear();
+  dead_bytes_ = 0;
+  Map();
+
+  qint64 offset = kHeaderSize;
+  char header[kRecordHeaderSize];
+  while (offset + kRecordHeaderSize <= file_size_) {
+    if (!Read(offset, kRecordHeaderSize, header)) break;
+
+    quint64 fingerprint = 0;
+    quint32 size = 0;
+    memcpy(&fingerprint, header, sizeof(fingerprint));
+    memcpy(&size, header + sizeof(fingerprint), sizeof(size));
+
+    const qint64 end = offset + kRecordHeaderSize + size;
+    if (end > file_size_) break;
+
+    QHash<quint64, Entry>::const_iterator it = index_.constFind(fingerprint);
+    if (it != index_.constEnd()) {
+      dead_bytes_ += kRecordHeaderSize + it->size_;
+    }
+
+    Entry entry;
+    entry.offset_ = offset + kRecordHeaderSize;
+    entry.size_ = size;
+    index_[fingerprint] = entry;
+
+    offset = end;
+  }
+
+  if (offset != file_size_) {
+    // The last record was only partly written.
+    qLog(Warning) << "Truncating the mood store" << filename_ << "from"
+                  << file_size_ << "to" << offset << "bytes";
+    if (map_) {
+      file_.unmap(map_);
+      map_ = nullptr;
+      map_size_ = 0;
+    }
+    file_.resize(offset);
+    file_size_ = offset;
+    Map();
+  }
+}
+
+bool MoodStore::Map() const {
+  if (map_) {
+    file_.unmap(map_);
+    map_ = nullptr;
+    map_size_ = 0;
+  }
+
+  map_ = file_.map(0, file_size_);
+  if (!map_) return false;
+
+  map_size_ = file_size_;
+  return true;
+}
+
+bool MoodStore::Read(qint64 offset, qint64 size, char* data) const {
+  if (offset + size > map_size_ && map_size_ < file_size_) {
+    Map();
+  }
+
+  if (map_ && offset + size <= map_size_) {
+    memcpy(data, map_ + offset, size);
+    return true;
+  }
+
+  // Mapping isn't supported everywhere, so fall back to reading the file.
+  return file_.seek(offset) && file_.read(data, size) == size;
+}
+
+void MoodStore::Compact() {
+  const QString new_filename = filename_ + ".new";
+
+  // Write the live records out in the order they appear in the old file.
+  QMap<qint64, quint64> fingerprints_by_offset;
+  for (QHash<quint64, Entry>::const_iterator it = index_.constBegin();
+       it != index_.constEnd(); ++it) {
+    fingerprints_by_offset[it->offset_] = it.key();
+  }
+
+  QFile new_file(new_filename);
+  if (!new_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qLog(Warning) << "Couldn't compact the mood store" << filename_ << ":"
+                  << new_file.errorString();
+    return;
+  }
+
+  QByteArray header(kHeaderSize, '\0');
+  bool ok = Read(0, kHeaderSize, header.data()) &&
+       new_file.write(header) == kHeaderSize;
+
+  for (QMap<qint64, quint64>::const_iterator it =
+           fingerprints_by_offset.constBegin();
+       ok && it != fingerprints_by_offset.constEnd(); ++it) {
+    const Entry& entry = index_[it.value()];
+    QByteArray record(kRecordHeaderSize + entry.size_, '\0');
+    ok = Read(entry.offset_ - kRecordHeaderSize, record.size(),
+              record.data()) &&
+         new_file.write(record) == record.size();
+  }
+  new_file.close();
+
+  if (!ok) {
+    qLog(Warning) << "Couldn't compact the mood store" << filename_;
+    QFile::remove(new_filename);
+    return;
+  }
+
+  const qint64 old_size = file_size_;
+  Close();
+  if (!QFile::remove(filename_) || !QFile::rename(new_filename, filename_)) {
+    qLog(Warning) << "Couldn't replace the mood store" << filename_;
+  }
+
+  if (Open()) {
+    qLog(Info) << "Compacted the mood store" << filename_ << "from" << old_size
+               << "to" << file_size_ << "bytes";
+  }
+}
+
+bool MoodStore::Contains(quint64 fingerprint) const {
+  QMutexLocker l(&mutex_);
+  return index_.contains(fingerprint);
+}
+
+QByteArray MoodStore::Get(quint64 fingerprint) const {
+  QMutexLocker l(&mutex_);
+
+  QHash<quint64, Entry>::const_iterator it = index_.constFind(fingerprint);
+  if (it == index_.constEnd()) return QByteArray();
+
+  QByteArray ret(it->size_, '\0');
+  if (!Read(it->offset_, it->size_, ret.data())) return QByteArray();
+  return ret;
+}
+
+bool MoodStore::Put(quint64 fingerprint, const QByteArray& data) {
+  QMutexLocker l(&mutex_);
+  if (!file_.isOpen()) return false;
+
+  const quint32 size = data.size();
+  char header[kRecordHeaderSize];
+  memcpy(header, &fingerprint, sizeof(fingerprint));
+  memcpy(header + sizeof(fingerprint), &size, sizeof(size));
+
+  if (!file_.seek(file_size_) ||
+      file_.write(header, kRecordHeaderSize) != kRecordHeaderSize ||
+      file_.write(data) != data.size() || !file_.flush()) {
+    qLog(Warning) << "Couldn't write to the mood store" << filename_ << ":"
+                  << file_.errorString();
+    file_.resize(file_size_);
+    return false;
+  }
+
+  QHash<quint64, Entry>::const_iterator it = index_.constFind(fingerprint);
+  if (it != index_.constEnd()) {
+    dead_bytes_ += kRecordHeaderSize + it->size_;
+  }
+
+  Entry entry;
+  entry.offset_ = file_size_ + kRecordHeaderSize;
+  entry.size_ = size;
+  index_[fingerprint] = entry;
+
+  file_size_ += kRecordHeaderSize + size;
+  return true;
+}
+
+int MoodStore::count() const {
+  QMutexLocker l(&mutex_);
+  return index_.count();
+}
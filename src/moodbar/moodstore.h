@@ -0,0 +1,90 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MOODBAR_MOODSTORE_H_
+#define MOODBAR_MOODSTORE_H_
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+// A single file holding the moodbar data for many songs, keyed by a
+// fingerprint of the song's file.  Records are appended to the end of the
+// file and read straight out of a memory mapping of it, so looking one up
+// doesn't need any I/O once the pages are resident.
+//
+// Replacing a record leaves the old one behind as dead space, which is
+// reclaimed by rewriting the file when it's next opened.  All methods are
+// thread-safe.
+class MoodStore {
+ public:
+  explicit MoodStore(const QString& filename);
+  ~MoodStore();
+
+  // Identifies a local file by its path, size and modification time, so the
+  // moodbar is recalculated if the file changes.  Returns 0 if the file
+  // doesn't exist.
+  static quint64 Fingerprint(const QString& filename);
+
+  bool Contains(quint64 fingerprint) const;
+
+  // Returns an empty QByteArray if there's no data for this fingerprint.
+  QByteArray Get(quint64 fingerprint) const;
+  bool Put(quint64 fingerprint, const QByteArray& data);
+
+  int count() const;
+
+ private:
+  Q_DISABLE_COPY(MoodStore)
+
+  struct Entry {
+    qint64 offset_;
+    quint32 size_;
+  };
+
+  static const char kMagic[];
+  static const int kHeaderSize = 16;
+  static const int kRecordHeaderSize = 12;
+
+  // The caller must hold mutex_.
+  bool Open();
+  void Close();
+  void Compact();
+
+  // Reads the records in the file into index_, and truncates anything after
+  // the last complete record.
+  void Scan();
+
+  // Maps the whole file again, to pick up records appended since it was last
+  // mapped.
+  bool Map() const;
+  bool Read(qint64 offset, qint64 size, char* data) const;
+
+  const QString filename_;
+
+  mutable QMutex mutex_;
+  mutable QFile file_;
+  mutable uchar* map_;
+  mutable qint64 map_size_;
+  qint64 file_size_;
+  qint64 dead_bytes_;
+
+  QHash<quint64, Entry> index_;
+};
+
+#endif  // MOODBAR_MOODSTORE_H_
@@ -61,10 +61,59 @@ void AcoustidClient::Start(int id, const QString& fingerprint,
   timeouts_->AddReply(reply);
 }
 
-void AcoustidClient::Cancel(int id) { delete requests_.take(id); }
+void AcoustidClient::StartBatch(const RequestList& requests) {
+  if (requests.isEmpty()) return;
+  if (requests.count() == 1) {
+    const Request& request = requests[0];
+    Start(request.id_, request.fingerprint_, request.duration_msec_);
+    return;
+  }
+
+  typedef QPair<QString, QString> Param;
+
+  QList<Param> parameters;
+  parameters << Param("format", "json") << Param("client", kClientId)
+             << Param("meta", "recordingids+sources");
+
+  QList<int> ids;
+  for (int i = 0; i < requests.count(); ++i) {
+    const Request& request = requests[i];
+    parameters << Param(QString("duration.%1").arg(i),
+                        QString::number(request.duration_msec_ / kMsecPerSec))
+               << Param(QString("fingerprint.%1").arg(i),
+                        request.fingerprint_);
+    ids << request.id_;
+  }
+
+  // All the fingerprints together are too long to go in the URL.
+  QUrl body;
+  body.setQueryItems(parameters);
+
+  QNetworkRequest req(QUrl(kUrl));
+  req.setHeader(QNetworkRequest::ContentTypeHeader,
+                "application/x-www-form-urlencoded");
+
+  QNetworkReply* reply = network_->post(req, body.encodedQuery());
+  NewClosure(reply, SIGNAL(finished()),
+             [this, reply, ids]() { BatchRequestFinished(reply, ids); });
+  for (int id : ids) {
+    requests_[id] = reply;
+  }
+
+  timeouts_->AddReply(reply);
+}
+
+void AcoustidClient::Cancel(int id) {
+  QNetworkReply* reply = requests_.take(id);
+
+  // Other fingerprints might still be waiting for a batch request.
+  if (!requests_.values().contains(reply)) {
+    delete reply;
+  }
+}
 
 void AcoustidClient::CancelAll() {
-  qDeleteAll(requests_.values());
+  qDeleteAll(requests_.values().toSet());
   requests_.clear();
 }
 
@@ -108,12 +157,54 @@ void AcoustidClient::RequestFinished(QNetworkReply* reply, int request_id) {
     return;
   }
 
+  emit Finished(request_id, ParseResults(result["results"].toList()));
+}
+
+void AcoustidClient::BatchRequestFinished(QNetworkReply* reply,
+                                          const QList<int>& ids) {
+  reply->deleteLater();
+
+  // Ignore the fingerprints whose requests were cancelled.
+  QList<int> pending_ids;
+  for (int id : ids) {
+    if (requests_.value(id) == reply) {
+      requests_.remove(id);
+      pending_ids << id;
+    }
+  }
+
+  QMap<int, QStringList> results;
+
+  QJson::Parser parser;
+  bool ok = false;
+  QVariantMap result;
+  if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() ==
+      200) {
+    result = parser.parse(reply, &ok).toMap();
+  }
+
+  if (ok && result["status"].toString() == "ok") {
+    // Each fingerprint's results are tagged with its position in the request.
+    for (const QVariant& v : result["fingerprints"].toList()) {
+      QVariantMap fingerprint = v.toMap();
+      const int index = fingerprint["index"].toInt();
+      if (index >= 0 && index < ids.count()) {
+        results[ids[index]] = ParseResults(fingerprint["results"].toList());
+      }
+    }
+  }
+
+  for (int id : pending_ids) {
+    emit Finished(id, results.value(id));
+  }
+}
+
+QStringList AcoustidClient::ParseResults(const QVariantList& results) {
   // Get the results:
   // -in a first step, gather ids and their corresponding number of sources
   // -then sort results by number of sources (the results are originally
   //  unsorted but results with more sources are likely to be more accurate)
   // -keep only the ids, as sources where useful only to sort the results
-  QVariantList results = result["results"].toList();
 
   // List of <id, nb of sources> pairs
   QList<IdSource> id_source_list;
@@ -133,10 +224,10 @@ void AcoustidClient::RequestFinished(QNetworkReply* reply, int request_id) {
 
   qStableSort(id_source_list);
 
-  QList<QString> id_list;
+  QStringList id_list;
   for (const IdSource& is : id_source_list) {
     id_list << is.id_;
   }
 
-  emit Finished(request_id, id_list);
+  return id_list;
 }
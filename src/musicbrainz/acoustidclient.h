@@ -18,8 +18,10 @@
 #ifndef ACOUSTIDCLIENT_H
 #define ACOUSTIDCLIENT_H
 
+#include <QList>
 #include <QMap>
 #include <QObject>
+#include <QStringList>
 
 class NetworkTimeouts;
 
@@ -40,6 +42,16 @@ class AcoustidClient : public QObject {
  public:
   AcoustidClient(QObject* parent = nullptr);
 
+  struct Request {
+    Request(int id, const QString& fingerprint, int duration_msec)
+        : id_(id), fingerprint_(fingerprint), duration_msec_(duration_msec) {}
+
+    int id_;
+    QString fingerprint_;
+    int duration_msec_;
+  };
+  typedef QList<Request> RequestList;
+
   // Network requests will be aborted after this interval.
   void SetTimeout(int msec);
 
@@ -47,6 +59,10 @@ class AcoustidClient : public QObject {
   // later with the same ID.
   void Start(int id, const QString& fingerprint, int duration_msec);
 
+  // Looks up several fingerprints in a single request.  Finished() is emitted
+  // once for each of them.
+  void StartBatch(const RequestList& requests);
+
   // Cancels the request with the given ID.  Finished() will never be emitted
   // for that ID.  Does nothing if there is no request with the given ID.
   void Cancel(int id);
@@ -62,6 +78,10 @@ signals:
   void RequestFinished(QNetworkReply* reply, int id);
 
  private:
+  void BatchRequestFinished(QNetworkReply* reply, const QList<int>& ids);
+  // Returns the recording IDs from a list of results, best first.
+  static QStringList ParseResults(const QVariantList& results);
+
   static const char* kClientId;
   static const char* kUrl;
   static const int kDefaultTimeout;
@@ -0,0 +1,69 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fingerprintcache.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSqlQuery>
+#include <QVariant>
+
+#include "core/database.h"
+
+FingerprintCache::FingerprintCache(Database* db) : db_(db) {}
+
+QString FingerprintCache::Load(const QString& filename) const {
+  QFileInfo info(filename);
+  if (!info.exists()) return QString();
+
+  Database::ReadLocker l(db_);
+  QSqlDatabase db(db_->ConnectForRead());
+
+  QSqlQuery q(db);
+  q.prepare(
+      "SELECT fingerprint FROM fingerprints"
+      " WHERE filename = :filename AND mtime = :mtime"
+      " AND filesize = :filesize");
+  q.bindValue(":filename", filename);
+  q.bindValue(":mtime", info.lastModified().toTime_t());
+  q.bindValue(":filesize", info.size());
+  q.exec();
+  if (db_->CheckErrors(q)) return QString();
+
+  if (!q.next()) return QString();
+  return q.value(0).toString();
+}
+
+void FingerprintCache::Save(const QString& filename,
+                            const QString& fingerprint) const {
+  QFileInfo info(filename);
+  if (!info.exists() || fingerprint.isEmpty()) return;
+
+  Database::WriteLocker l(db_);
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(db);
+  q.prepare(
+      "INSERT OR REPLACE INTO fingerprints"
+      " (filename, mtime, filesize, fingerprint)"
+      " VALUES (:filename, :mtime, :filesize, :fingerprint)");
+  q.bindValue(":filename", filename);
+  q.bindValue(":mtime", info.lastModified().toTime_t());
+  q.bindValue(":filesize", info.size());
+  q.bindValue(":fingerprint", fingerprint);
+  q.exec();
+  db_->CheckErrors(q);
+}
@@ -0,0 +1,42 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MUSICBRAINZ_FINGERPRINTCACHE_H_
+#define MUSICBRAINZ_FINGERPRINTCACHE_H_
+
+#include <QString>
+
+class Database;
+
+// Remembers the Chromaprint fingerprint of each file in the fingerprints
+// table, so a file only has to be decoded again if its size or modification
+// time changes.
+//
+// All methods are thread-safe.
+class FingerprintCache {
+ public:
+  explicit FingerprintCache(Database* db);
+
+  // Returns an empty string if the file's fingerprint isn't known, or the file
+  // has changed since it was made.
+  QString Load(const QString& filename) const;
+  void Save(const QString& filename, const QString& fingerprint) const;
+
+ private:
+  Database* db_;
+};
+
+#endif  // MUSICBRAINZ_FINGERPRINTCACHE_H_
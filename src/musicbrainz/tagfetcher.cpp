@@ -20,18 +20,56 @@
 #include "acoustidclient.h"
 #include "chromaprinter.h"
 #include "musicbrainzclient.h"
+#include "core/application.h"
 #include "core/timeconstants.h"
 
 #include <QFuture>
 #include <QFutureWatcher>
+#include <QTimer>
 #include <QUrl>
 #include <QtConcurrentMap>
 
-TagFetcher::TagFetcher(QObject* parent)
+const int TagFetcher::kLookupBatchSize = 10;
+const int TagFetcher::kLookupDelayMsec = 500;
+
+namespace {
+
+// Fingerprints songs in QtConcurrent's threads, decoding them only if they
+// haven't been fingerprinted before.
+struct GetFingerprint {
+  typedef QString result_type;
+
+  explicit GetFingerprint(const FingerprintCache& cache) : cache_(cache) {}
+
+  QString operator()(const Song& song) const {
+    const QString filename = song.url().toLocalFile();
+
+    QString fingerprint = cache_.Load(filename);
+    if (fingerprint.isEmpty()) {
+      fingerprint = Chromaprinter(filename).CreateFingerprint();
+      cache_.Save(filename, fingerprint);
+    }
+    return fingerprint;
+  }
+
+  // A copy, in case the TagFetcher is deleted while songs are still being
+  // fingerprinted.
+  FingerprintCache cache_;
+};
+
+}  // namespace
+
+TagFetcher::TagFetcher(Application* app, QObject* parent)
     : QObject(parent),
+      fingerprint_cache_(app->database()),
       fingerprint_watcher_(nullptr),
       acoustid_client_(new AcoustidClient(this)),
-      musicbrainz_client_(new MusicBrainzClient(this)) {
+      musicbrainz_client_(new MusicBrainzClient(this)),
+      lookup_timer_(new QTimer(this)) {
+  lookup_timer_->setSingleShot(true);
+  lookup_timer_->setInterval(kLookupDelayMsec);
+  connect(lookup_timer_, SIGNAL(timeout()), SLOT(StartLookups()));
+
   connect(acoustid_client_, SIGNAL(Finished(int, QStringList)),
           SLOT(PuidsFound(int, QStringList)));
   connect(musicbrainz_client_,
@@ -39,20 +77,19 @@ TagFetcher::TagFetcher(QObject* parent)
           SLOT(TagsFetched(int, MusicBrainzClient::ResultList)));
 }
 
-QString TagFetcher::GetFingerprint(const Song& song) {
-  return Chromaprinter(song.url().toLocalFile()).CreateFingerprint();
-}
-
 void TagFetcher::StartFetch(const SongList& songs) {
   Cancel();
 
   songs_ = songs;
 
-  QFuture<QString> future = QtConcurrent::mapped(songs_, GetFingerprint);
+  QFuture<QString> future =
+      QtConcurrent::mapped(songs_, GetFingerprint(fingerprint_cache_));
   fingerprint_watcher_ = new QFutureWatcher<QString>(this);
   fingerprint_watcher_->setFuture(future);
   connect(fingerprint_watcher_, SIGNAL(resultReadyAt(int)),
           SLOT(FingerprintFound(int)));
+  // Don't wait for a batch to fill up after the last song is fingerprinted
+  connect(fingerprint_watcher_, SIGNAL(finished()), SLOT(StartLookups()));
 
   for (const Song& song : songs) {
     emit Progress(song, tr("Fingerprinting song"));
@@ -67,6 +104,9 @@ void TagFetcher::Cancel() {
     fingerprint_watcher_ = nullptr;
   }
 
+  lookup_timer_->stop();
+  pending_lookups_.clear();
+
   acoustid_client_->CancelAll();
   musicbrainz_client_->CancelAll();
   songs_.clear();
@@ -88,8 +128,23 @@ void TagFetcher::FingerprintFound(int index) {
   }
 
   emit Progress(song, tr("Identifying song"));
-  acoustid_client_->Start(index, fingerprint,
-                          song.length_nanosec() / kNsecPerMsec);
+
+  // Songs are fingerprinted several at a time, so group the lookups too.
+  pending_lookups_ << AcoustidClient::Request(
+      index, fingerprint, song.length_nanosec() / kNsecPerMsec);
+  if (pending_lookups_.count() >= kLookupBatchSize) {
+    StartLookups();
+  } else if (!lookup_timer_->isActive()) {
+    lookup_timer_->start();
+  }
+}
+
+void TagFetcher::StartLookups() {
+  lookup_timer_->stop();
+  if (pending_lookups_.isEmpty()) return;
+
+  acoustid_client_->StartBatch(pending_lookups_);
+  pending_lookups_.clear();
 }
 
 void TagFetcher::PuidsFound(int index, const QStringList& puid_list) {
@@ -18,13 +18,17 @@
 #ifndef TAGFETCHER_H
 #define TAGFETCHER_H
 
+#include "acoustidclient.h"
+#include "fingerprintcache.h"
 #include "musicbrainzclient.h"
 #include "core/song.h"
 
 #include <QFutureWatcher>
 #include <QObject>
 
-class AcoustidClient;
+class Application;
+
+class QTimer;
 
 class TagFetcher : public QObject {
   Q_OBJECT
@@ -33,7 +37,7 @@ class TagFetcher : public QObject {
   // MusicBrainzClient.
 
  public:
-  TagFetcher(QObject* parent = nullptr);
+  TagFetcher(Application* app, QObject* parent = nullptr);
 
   void StartFetch(const SongList& songs);
 
@@ -47,16 +51,25 @@ signals:
 
  private slots:
   void FingerprintFound(int index);
+  void StartLookups();
   void PuidsFound(int index, const QStringList& puid_list);
   void TagsFetched(int index, const MusicBrainzClient::ResultList& result);
 
  private:
-  static QString GetFingerprint(const Song& song);
+  // Fingerprints are looked up in groups of this many.  A smaller group is
+  // sent if no more fingerprints are found within kLookupDelayMsec.
+  static const int kLookupBatchSize;
+  static const int kLookupDelayMsec;
+
+  FingerprintCache fingerprint_cache_;
 
   QFutureWatcher<QString>* fingerprint_watcher_;
   AcoustidClient* acoustid_client_;
   MusicBrainzClient* musicbrainz_client_;
 
+  AcoustidClient::RequestList pending_lookups_;
+  QTimer* lookup_timer_;
+
   SongList songs_;
 };
 
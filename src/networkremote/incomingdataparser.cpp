@@ -166,6 +166,12 @@ void IncomingDataParser::Parse(const pb::remote::Message& msg) {
     case pb::remote::GET_LIBRARY:
       emit SendLibrary(client);
       break;
+    case pb::remote::GET_LIBRARY_CHANGES:
+      emit SendLibraryChanges(
+          client,
+          QStringFromStdString(msg.request_library_changes().library_id()),
+          msg.request_library_changes().sync_token());
+      break;
     case pb::remote::RATE_SONG:
       RateSong(msg);
       break;
@@ -47,6 +47,8 @@ signals:
   void RemoveSongs(int id, const QList<int>& indices);
   void SeekTo(int seconds);
   void SendLibrary(RemoteClient* client);
+  void SendLibraryChanges(RemoteClient* client, const QString& library_id,
+                          qint64 sync_token);
   void RateCurrentSong(double);
 
   void DoGlobalSearch(QString, RemoteClient*);
@@ -30,6 +30,7 @@
 #include "core/database.h"
 
 const quint32 OutgoingDataCreator::kFileChunkSize = 100000;  // in Bytes
+const int OutgoingDataCreator::kLibraryChangesPerMessage = 500;
 
 OutgoingDataCreator::OutgoingDataCreator(Application* app)
     : app_(app),
@@ -579,7 +580,25 @@ void OutgoingDataCreator::SendLyrics(int id,
   results_.take(id);
 }
 
+qint64 OutgoingDataCreator::LibrarySyncToken(QString* library_id) {
+  Database::ReadLocker l(app_->database());
+  QSqlDatabase db(app_->database()->ConnectForRead());
+
+  QSqlQuery id_query("SELECT library_id FROM library_sync", db);
+  if (app_->database()->CheckErrors(id_query) || !id_query.next()) return 0;
+  *library_id = id_query.value(0).toString();
+
+  QSqlQuery q("SELECT MAX(version) FROM song_changes", db);
+  if (app_->database()->CheckErrors(q) || !q.next()) return 0;
+  return q.value(0).toLongLong();
+}
+
 void OutgoingDataCreator::SendLibrary(RemoteClient* client) {
+  // Changes made while the library is being copied will be sent again by the
+  // next GET_LIBRARY_CHANGES, which is harmless.
+  QString library_id;
+  const qint64 sync_token = LibrarySyncToken(&library_id);
+
   // Get a temporary file name
   QString temp_file_name = Utilities::GetTemporaryFileName();
 
@@ -589,9 +608,12 @@ void OutgoingDataCreator::SendLibrary(RemoteClient* client) {
 
   app_->database()->AttachDatabaseOnDbConnection("songs_export", adb, db);
 
-  // Copy the content of the song table to this temporary database
+  // Copy the content of the song table to this temporary database.  The
+  // ROWID isn't copied by itself, and the client needs it to apply the
+  // changes sent by GET_LIBRARY_CHANGES.
   QSqlQuery q(QString(
-                  "create table songs_export.songs as SELECT * FROM songs "
+                  "create table songs_export.songs as "
+                  "SELECT ROWID AS song_id, * FROM songs "
                   "where unavailable = 0;"),
               db);
 
@@ -629,6 +651,8 @@ void OutgoingDataCreator::SendLibrary(RemoteClient* client) {
     chunk->set_size(file.size());
     chunk->set_data(data.data(), data.size());
     chunk->set_file_hash(sha1.data(), sha1.size());
+    chunk->set_sync_token(sync_token);
+    chunk->set_library_id(DataCommaSizeFromQString(library_id));
 
     // Send data directly to the client
     client->SendData(&msg);
@@ -644,6 +668,97 @@ void OutgoingDataCreator::SendLibrary(RemoteClient* client) {
   file.remove();
 }
 
+void OutgoingDataCreator::SendLibraryChanges(RemoteClient* client,
+                                             const QString& library_id,
+                                             qint64 sync_token) {
+  QString current_library_id;
+  const qint64 current_token = LibrarySyncToken(&current_library_id);
+  if (current_library_id.isEmpty() || library_id != current_library_id ||
+      sync_token < 0 || sync_token > current_token) {
+    // The client has never had the library, or had it from a different
+    // database.
+    qLog(Debug) << "Unknown library sync token" << library_id << sync_token
+                << "- sending the whole library";
+    SendLibrary(client);
+    return;
+  }
+
+  SongList songs;
+  QList<int> deleted_ids;
+  // An up to date client still gets an empty reply with the token.
+  if (sync_token < current_token) {
+    Database::ReadLocker l(app_->database());
+    QSqlDatabase db(app_->database()->ConnectForRead());
+
+    QSqlQuery q(db);
+    q.prepare(QString(
+                  "SELECT ROWID, %1 FROM songs"
+                  " WHERE unavailable = 0 AND ROWID IN ("
+                  "  SELECT song_id FROM song_changes WHERE version > :token)")
+                  .arg(Song::kColumnSpec));
+    q.bindValue(":token", sync_token);
+    q.exec();
+    if (app_->database()->CheckErrors(q)) return;
+
+    while (q.next()) {
+      Song song;
+      song.InitFromQuery(q, true);
+      songs << song;
+    }
+
+    // Songs that were marked unavailable are gone as far as the client is
+    // concerned, since the full library doesn't include them either.
+    QSqlQuery deleted(db);
+    deleted.prepare(
+        "SELECT song_id FROM song_changes"
+        " WHERE version > :token AND song_id NOT IN ("
+        "  SELECT ROWID FROM songs WHERE unavailable = 0)");
+    deleted.bindValue(":token", sync_token);
+    deleted.exec();
+    if (app_->database()->CheckErrors(deleted)) return;
+
+    while (deleted.next()) {
+      deleted_ids << deleted.value(0).toInt();
+    }
+  }
+
+  qLog(Debug) << "Sending" << songs.count() << "changed and"
+              << deleted_ids.count() << "deleted songs since library version"
+              << sync_token;
+
+  // The deleted ids go in the first message, and the songs are split over as
+  // many as they need.  There's always at least one message, so the client
+  // gets the new token.
+  const int chunk_count =
+      qMax(1, (songs.count() + kLibraryChangesPerMessage - 1) /
+                  kLibraryChangesPerMessage);
+
+  for (int chunk_number = 1; chunk_number <= chunk_count; ++chunk_number) {
+    pb::remote::Message msg;
+    msg.set_type(pb::remote::LIBRARY_CHANGES);
+    pb::remote::ResponseLibraryChanges* changes =
+        msg.mutable_response_library_changes();
+    changes->set_chunk_number(chunk_number);
+    changes->set_chunk_count(chunk_count);
+    changes->set_sync_token(current_token);
+    changes->set_library_id(DataCommaSizeFromQString(current_library_id));
+
+    if (chunk_number == 1) {
+      for (int id : deleted_ids) {
+        changes->add_deleted_song_ids(id);
+      }
+    }
+
+    const int begin = (chunk_number - 1) * kLibraryChangesPerMessage;
+    const int end = qMin(songs.count(), begin + kLibraryChangesPerMessage);
+    for (int i = begin; i < end; ++i) {
+      CreateSong(songs[i], QImage(), i, changes->add_songs());
+    }
+
+    client->SendData(&msg);
+  }
+}
+
 void OutgoingDataCreator::EnableKittens(bool aww) { aww_ = aww; }
 
 void OutgoingDataCreator::SendKitten(const QImage& kitten) {
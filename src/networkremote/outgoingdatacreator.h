@@ -47,6 +47,7 @@ class OutgoingDataCreator : public QObject {
   ~OutgoingDataCreator();
 
   static const quint32 kFileChunkSize;
+  static const int kLibraryChangesPerMessage;
 
   void SetClients(QList<RemoteClient*>* clients);
 
@@ -78,6 +79,8 @@ class OutgoingDataCreator : public QObject {
   void GetLyrics();
   void SendLyrics(int id, const SongInfoFetcher::Result& result);
   void SendLibrary(RemoteClient* client);
+  void SendLibraryChanges(RemoteClient* client, const QString& library_id,
+                          qint64 sync_token);
   void EnableKittens(bool aww);
   void SendKitten(const QImage& kitten);
 
@@ -108,6 +111,9 @@ class OutgoingDataCreator : public QObject {
   void SendDataToClients(pb::remote::Message* msg);
   void SetEngineState(pb::remote::ResponseClementineInfo* msg);
   void CheckEnabledProviders();
+  // Returns the version of the latest change to the songs table, and sets
+  // library_id to the random id that tells this database apart from others.
+  qint64 LibrarySyncToken(QString* library_id);
   SongInfoProvider* ProviderByName(const QString& name) const;
 };
 
@@ -21,13 +21,35 @@
 #include "networkremote.h"
 
 #include <QDataStream>
+#include <QHostAddress>
 #include <QSettings>
 
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#endif
+
+const qint64 RemoteClient::kFileSliceSize = 256 * 1024;  // in Bytes
+
+namespace {
+
+double MebibytesPerSecond(qint64 bytes, qint64 msec) {
+  return bytes / (1024.0 * 1024.0) / (qMax(msec, qint64(1)) / 1000.0);
+}
+
+}  // namespace
+
 RemoteClient::RemoteClient(Application* app, QTcpSocket* client)
     : app_(app),
       downloader_(false),
       client_(client),
-      song_sender_(new SongSender(app, this)) {
+      song_sender_(new SongSender(app, this)),
+      transfer_data_(nullptr),
+      transfer_offset_(0),
+      files_sent_(0),
+      bytes_sent_(0),
+      transfer_msec_(0) {
   // Open the buffer
   buffer_.setData(QByteArray());
   buffer_.open(QIODevice::ReadWrite);
@@ -35,6 +57,9 @@ RemoteClient::RemoteClient(Application* app, QTcpSocket* client)
 
   // Connect to the slot IncomingData when receiving data
   connect(client, SIGNAL(readyRead()), this, SLOT(IncomingData()));
+  // Carry on sending a file once the socket has room again
+  connect(client, SIGNAL(bytesWritten(qint64)), this,
+          SLOT(ContinueFileTransfer()));
 
   // Check if we use auth code
   QSettings s;
@@ -51,6 +76,20 @@ RemoteClient::RemoteClient(Application* app, QTcpSocket* client)
 }
 
 RemoteClient::~RemoteClient() {
+  if (files_sent_ > 0) {
+    qLog(Info) << "Sent" << files_sent_ << "files," << bytes_sent_
+               << "bytes to" << client_->peerAddress().toString() << "at"
+               << MebibytesPerSecond(bytes_sent_, transfer_msec_) << "MiB/s";
+  }
+
+  if (transfer_.file) {
+    if (transfer_data_) transfer_.file->unmap(transfer_data_);
+    CloseFile(transfer_);
+  }
+  while (!send_queue_.isEmpty()) {
+    CloseFile(send_queue_.dequeue());
+  }
+
   client_->close();
   if (client_->state() == QAbstractSocket::ConnectedState)
     client_->waitForDisconnected(2000);
@@ -162,6 +201,16 @@ void RemoteClient::SendDataToClient(pb::remote::Message* msg) {
     // Serialize the message
     std::string data = msg->SerializeAsString();
 
+    if (transfer_.file) {
+      // A file is being sent, so this has to wait until it's finished
+      OutgoingData pending;
+      QDataStream s(&pending.frame, QIODevice::WriteOnly);
+      s << qint32(data.length());
+      s.writeRawData(data.data(), data.length());
+      send_queue_.enqueue(pending);
+      return;
+    }
+
     // write the length of the data first
     QDataStream s(client_);
     s << qint32(data.length());
@@ -187,4 +236,156 @@ void RemoteClient::SendData(pb::remote::Message* msg) {
   }
 }
 
+void RemoteClient::SendFile(pb::remote::Message* msg, QFile* file,
+                            bool remove_file) {
+  OutgoingData data;
+  data.file = file;
+  data.remove_file = remove_file;
+
+  if (!authenticated_ || client_->state() != QTcpSocket::ConnectedState) {
+    CloseFile(data);
+    return;
+  }
+
+  SendDataToClient(msg);
+  send_queue_.enqueue(data);
+
+  if (!transfer_.file) {
+    SendQueuedData();
+  }
+}
+
+void RemoteClient::SendQueuedData() {
+  while (!transfer_.file && !send_queue_.isEmpty()) {
+    OutgoingData data = send_queue_.dequeue();
+    if (!data.file) {
+      client_->write(data.frame);
+      continue;
+    }
+
+    StartFileTransfer(data);
+    if (PumpFileTransfer()) {
+      FinishFileTransfer();
+    }
+  }
+}
+
+void RemoteClient::StartFileTransfer(const OutgoingData& data) {
+  transfer_ = data;
+  transfer_offset_ = 0;
+  transfer_timer_.start();
+
+  // Fall back to reading the file if it can't be mapped (empty files can't be
+  // mapped either, but there's nothing to send then anyway).
+  transfer_data_ = transfer_.file->map(0, transfer_.file->size());
+}
+
+void RemoteClient::ContinueFileTransfer() {
+  if (!transfer_.file) return;
+
+  if (PumpFileTransfer()) {
+    FinishFileTransfer();
+    SendQueuedData();
+  }
+}
+
+bool RemoteClient::PumpFileTransfer() {
+  if (client_->state() != QTcpSocket::ConnectedState) {
+    // The client went away, so there's no point sending anything else.
+    return true;
+  }
+
+  // Let QTcpSocket write out what it already has first, so the file isn't
+  // interleaved with it.  It emits bytesWritten() as it goes.
+  if (client_->bytesToWrite() > 0) return false;
+
+  const qint64 size = transfer_.file->size();
+  while (transfer_offset_ < size) {
+    const qint64 length = qMin(kFileSliceSize, size - transfer_offset_);
+
+    if (!transfer_data_) {
+      QByteArray data = transfer_.file->read(length);
+      if (data.size() != length) {
+        qLog(Warning) << "Couldn't read" << transfer_.file->fileName();
+        // The client is expecting the rest of the file, and can't tell where
+        // the next message would start.
+        client_->abort();
+        return true;
+      }
+      client_->write(data);
+      transfer_offset_ += length;
+      return transfer_offset_ == size;
+    }
+
+    const char* data =
+        reinterpret_cast<const char*>(transfer_data_) + transfer_offset_;
+
+#ifdef MSG_NOSIGNAL
+    // Copy from the mapped file straight into the socket's buffer while it has
+    // room.  MSG_NOSIGNAL stops a client that has gone away from killing us
+    // with a SIGPIPE.
+    const ssize_t written = ::send(client_->socketDescriptor(), data, length,
+                                   MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (written > 0) {
+      transfer_offset_ += written;
+      continue;
+    }
+    if (written == -1 && errno == EINTR) continue;
+    if (written == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      qLog(Warning) << "Couldn't send" << transfer_.file->fileName() << ":"
+                    << strerror(errno);
+      client_->abort();
+      return true;
+    }
+#endif
+
+    // The socket is full.  Hand this slice to QTcpSocket, and carry on once
+    // it has been written out.
+    client_->write(data, length);
+    transfer_offset_ += length;
+    return transfer_offset_ == size;
+  }
+
+  return true;
+}
+
+void RemoteClient::FinishFileTransfer() {
+  const qint64 msec = transfer_timer_.elapsed();
+
+  if (transfer_offset_ == transfer_.file->size()) {
+    files_sent_++;
+    bytes_sent_ += transfer_offset_;
+    transfer_msec_ += msec;
+
+    qLog(Info) << "Sent" << transfer_.file->fileName() << "("
+               << transfer_offset_ << "bytes) to"
+               << client_->peerAddress().toString() << "in" << msec << "ms,"
+               << MebibytesPerSecond(transfer_offset_, msec) << "MiB/s";
+  }
+
+  if (transfer_data_) {
+    transfer_.file->unmap(transfer_data_);
+    transfer_data_ = nullptr;
+  }
+  CloseFile(transfer_);
+  transfer_ = OutgoingData();
+
+  if (client_->state() != QTcpSocket::ConnectedState) {
+    while (!send_queue_.isEmpty()) {
+      CloseFile(send_queue_.dequeue());
+    }
+  }
+}
+
+void RemoteClient::CloseFile(const OutgoingData& data) {
+  if (!data.file) return;
+
+  if (data.remove_file) {
+    data.file->remove();
+  } else {
+    data.file->close();
+  }
+  delete data.file;
+}
+
 QAbstractSocket::SocketState RemoteClient::State() { return client_->state(); }
@@ -4,6 +4,9 @@
 #include <QAbstractSocket>
 #include <QTcpSocket>
 #include <QBuffer>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QQueue>
 
 #include "songsender.h"
 
@@ -18,6 +21,12 @@ class RemoteClient : public QObject {
 
   // This method checks if client is authenticated before sending the data
   void SendData(pb::remote::Message* msg);
+  // Sends msg followed by the raw contents of file, which is streamed from a
+  // memory map straight into the socket instead of being copied into
+  // messages.  Anything sent while the file is going out is queued behind it.
+  // Takes ownership of the open file, and deletes it from disk afterwards if
+  // remove_file is true.
+  void SendFile(pb::remote::Message* msg, QFile* file, bool remove_file);
   QAbstractSocket::SocketState State();
   void setDownloader(bool downloader);
   bool isDownloader() { return downloader_; }
@@ -27,6 +36,7 @@ class RemoteClient : public QObject {
 
  private slots:
   void IncomingData();
+  void ContinueFileTransfer();
 
 signals:
   void Parse(const pb::remote::Message& msg);
@@ -37,6 +47,25 @@ signals:
   // Sends data to client without check if authenticated
   void SendDataToClient(pb::remote::Message* msg);
 
+  struct OutgoingData {
+    OutgoingData() : file(nullptr), remove_file(false) {}
+
+    // Either a serialized message with its length prefix, or a file.
+    QByteArray frame;
+    QFile* file;
+    bool remove_file;
+  };
+
+  void SendQueuedData();
+  void StartFileTransfer(const OutgoingData& data);
+  // Writes as much of the current file as the socket will take.  Returns true
+  // once it has all been sent.
+  bool PumpFileTransfer();
+  void FinishFileTransfer();
+  static void CloseFile(const OutgoingData& data);
+
+  static const qint64 kFileSliceSize;
+
   Application* app_;
 
   bool use_auth_code_;
@@ -50,6 +79,18 @@ signals:
   quint32 expected_length_;
   QBuffer buffer_;
   SongSender* song_sender_;
+
+  // Messages and files waiting for the current file transfer to finish.
+  QQueue<OutgoingData> send_queue_;
+  OutgoingData transfer_;
+  uchar* transfer_data_;
+  qint64 transfer_offset_;
+  QElapsedTimer transfer_timer_;
+
+  // Throughput of all the files sent to this client.
+  int files_sent_;
+  qint64 bytes_sent_;
+  qint64 transfer_msec_;
 };
 
 #endif  // REMOTECLIENT_H
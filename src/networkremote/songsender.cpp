@@ -32,7 +32,8 @@ const quint32 SongSender::kFileChunkSize = 100000;  // in Bytes
 SongSender::SongSender(Application* app, RemoteClient* client)
     : app_(app),
       client_(client),
-      transcoder_(new Transcoder(this)) {
+      transcoder_(new Transcoder(this)),
+      raw_file_data_(false) {
   QSettings s;
   s.beginGroup(NetworkRemote::kSettingsGroup);
 
@@ -49,6 +50,10 @@ SongSender::SongSender(Application* app, RemoteClient* client)
   }
   qLog(Debug) << "Transcoder preset" << transcoder_preset_.codec_mimetype_;
 
+  // Someone is waiting for these, so don't queue them behind organising or
+  // ripping.
+  transcoder_->set_priority(Transcoder::Priority_Interactive);
+
   connect(transcoder_, SIGNAL(JobComplete(QString, QString, bool)),
           SLOT(TranscodeJobComplete(QString, QString, bool)));
   connect(transcoder_, SIGNAL(AllJobsComplete()), SLOT(StartTransfer()));
@@ -64,6 +69,8 @@ SongSender::~SongSender() {
 }
 
 void SongSender::SendSongs(const pb::remote::RequestDownloadSongs& request) {
+  raw_file_data_ = request.raw_file_data();
+
   Song current_song;
   if (app_->player()->GetCurrentItem()) {
     current_song = app_->player()->GetCurrentItem()->Metadata();
@@ -240,15 +247,39 @@ void SongSender::SendSingleSong(DownloadItem download_item) {
   QByteArray sha1 = Utilities::Sha1File(file).toHex();
   qLog(Debug) << "sha1 for file" << local_file << "=" << sha1;
 
-  file.open(QIODevice::ReadOnly);
-
-  QByteArray data;
   pb::remote::Message msg;
   pb::remote::ResponseSongFileChunk* chunk =
       msg.mutable_response_song_file_chunk();
   msg.set_type(pb::remote::SONG_FILE_CHUNK);
 
-  QImage null_image;
+  if (raw_file_data_) {
+    // Send just the header, and let RemoteClient stream the file itself
+    // straight out of a memory map.
+    QFile* raw_file = new QFile(local_file);
+    if (!raw_file->open(QIODevice::ReadOnly)) {
+      qLog(Warning) << "Couldn't open" << local_file;
+      delete raw_file;
+      return;
+    }
+
+    chunk->set_chunk_count(1);
+    chunk->set_chunk_number(1);
+    chunk->set_file_count(download_item.song_count_);
+    chunk->set_file_number(download_item.song_no_);
+    chunk->set_size(raw_file->size());
+    chunk->set_file_hash(sha1.data(), sha1.size());
+    chunk->set_raw_data_follows(true);
+    CreateSongMetadata(download_item, is_transcoded, raw_file->size(),
+                       chunk->mutable_song_metadata());
+
+    // RemoteClient deletes the transcoded file once it has been sent
+    client_->SendFile(&msg, raw_file, is_transcoded);
+    return;
+  }
+
+  file.open(QIODevice::ReadOnly);
+
+  QByteArray data;
 
   // Calculate the number of chunks
   int chunk_count = qRound((file.size() / kFileChunkSize) + 0.5);
@@ -270,20 +301,8 @@ void SongSender::SendSingleSong(DownloadItem download_item) {
     // On the first chunk send the metadata, so the client knows
     // what file it receives.
     if (chunk_number == 1) {
-      int i = app_->playlist_manager()->active()->current_row();
-      pb::remote::SongMetadata* song_metadata =
-          msg.mutable_response_song_file_chunk()->mutable_song_metadata();
-      OutgoingDataCreator::CreateSong(download_item.song_, null_image, i,song_metadata);
-
-      // if the file was transcoded, we have to change the filename and filesize
-      if (is_transcoded) {
-        song_metadata->set_file_size(file.size());
-        QString basefilename = download_item.song_.basefilename();
-        QFileInfo info(basefilename);
-        basefilename.replace("." + info.suffix(),
-                             "." + transcoder_preset_.extension_);
-        song_metadata->set_filename(DataCommaSizeFromQString(basefilename));
-      }
+      CreateSongMetadata(download_item, is_transcoded, file.size(),
+                         chunk->mutable_song_metadata());
     }
 
     // Send data directly to the client
@@ -304,6 +323,24 @@ void SongSender::SendSingleSong(DownloadItem download_item) {
   }
 }
 
+void SongSender::CreateSongMetadata(const DownloadItem& download_item,
+                                    bool is_transcoded, qint64 file_size,
+                                    pb::remote::SongMetadata* song_metadata) {
+  int i = app_->playlist_manager()->active()->current_row();
+  OutgoingDataCreator::CreateSong(download_item.song_, QImage(), i,
+                                  song_metadata);
+
+  // if the file was transcoded, we have to change the filename and filesize
+  if (is_transcoded) {
+    song_metadata->set_file_size(file_size);
+    QString basefilename = download_item.song_.basefilename();
+    QFileInfo info(basefilename);
+    basefilename.replace("." + info.suffix(),
+                         "." + transcoder_preset_.extension_);
+    song_metadata->set_filename(DataCommaSizeFromQString(basefilename));
+  }
+}
+
 void SongSender::SendAlbum(const Song& song) {
   // No streams!
   if (song.url().scheme() != "file") return;
@@ -45,12 +45,17 @@ class SongSender : public QObject {
   TranscoderPreset transcoder_preset_;
   Transcoder* transcoder_;
   bool transcode_lossless_files_;
+  // Whether the client asked for files without chunking
+  bool raw_file_data_;
 
   QQueue<DownloadItem> download_queue_;
   QMap<QString, QString> transcoder_map_;
   int total_transcode_;
 
   void SendSingleSong(DownloadItem download_item);
+  void CreateSongMetadata(const DownloadItem& download_item,
+                          bool is_transcoded, qint64 file_size,
+                          pb::remote::SongMetadata* song_metadata);
   void SendAlbum(const Song& song);
   void SendPlaylist(int playlist_id);
   void SendUrls(const pb::remote::RequestDownloadSongs& request);
@@ -18,6 +18,7 @@
 #include "playlist.h"
 
 #include <algorithm>
+#include <cstring>
 #include <functional>
 #include <memory>
 #include <unordered_map>
@@ -31,6 +32,8 @@
 #include <QMimeData>
 #include <QMutableListIterator>
 #include <QSortFilterProxyModel>
+#include <QThread>
+#include <QThreadPool>
 #include <QUndoStack>
 #include <QtConcurrentRun>
 #include <QtDebug>
@@ -46,6 +49,7 @@
 #include "songplaylistitem.h"
 #include "core/application.h"
 #include "core/closure.h"
+#include "core/concurrentrun.h"
 #include "core/logging.h"
 #include "core/modelfuturewatcher.h"
 #include "core/qhash_qurl.h"
@@ -95,6 +99,9 @@ const char* Playlist::kWriteMetadata = "write_metadata";
 const int Playlist::kUndoStackSize = 20;
 const int Playlist::kUndoItemLimit = 500;
 
+const int Playlist::kRestoreFirstBatchSize = 100;
+const int Playlist::kRestoreBatchSize = 2000;
+
 Playlist::Playlist(PlaylistBackend* backend, TaskManager* task_manager,
                    LibraryBackend* library, int id, const QString& special_type,
                    bool favorite, QObject* parent)
@@ -115,6 +122,12 @@ Playlist::Playlist(PlaylistBackend* backend, TaskManager* task_manager,
       have_incremented_playcount_(false),
       playlist_sequence_(nullptr),
       ignore_sorting_(false),
+      is_restoring_(false),
+      save_after_restore_(false),
+      save_all_items_(false),
+      restored_batches_(0),
+      restored_items_(0),
+      restore_generation_(0),
       undo_stack_(new QUndoStack(this)),
       special_type_(special_type) {
   undo_stack_->setUndoLimit(kUndoStackSize);
@@ -124,8 +137,6 @@ Playlist::Playlist(PlaylistBackend* backend, TaskManager* task_manager,
   connect(this, SIGNAL(rowsRemoved(const QModelIndex&, int, int)),
           SIGNAL(PlaylistChanged()));
 
-  Restore();
-
   proxy_->setSourceModel(this);
   queue_->setSourceModel(this);
 
@@ -427,6 +438,7 @@ void Playlist::ItemReloadComplete() {
   watcher->deleteLater();
   const QPersistentModelIndex& index = watcher->index();
   if (index.isValid()) {
+    changed_items_ << item_at(index.row());
     emit dataChanged(index, index);
     emit EditingFinished(index);
   }
@@ -1384,6 +1396,218 @@ QString Playlist::abbreviated_column_name(Column column) {
   return "";
 }
 
+namespace {
+
+// Sorting fewer items than this isn't worth splitting between threads.
+const int kParallelSortThreshold = 20000;
+
+// Gets the text that CompareItems() compares for the column.  Returns false
+// if the column isn't compared as text.
+bool SortText(int column, const Song& song, QString* text) {
+  switch (column) {
+    case Playlist::Column_Title:
+      *text = song.title();
+      return true;
+    case Playlist::Column_Artist:
+      *text = song.artist();
+      return true;
+    case Playlist::Column_Album:
+      *text = song.album();
+      return true;
+    case Playlist::Column_Genre:
+      *text = song.genre();
+      return true;
+    case Playlist::Column_AlbumArtist:
+      *text = song.playlist_albumartist();
+      return true;
+    case Playlist::Column_Composer:
+      *text = song.composer();
+      return true;
+    case Playlist::Column_Performer:
+      *text = song.performer();
+      return true;
+    case Playlist::Column_Grouping:
+      *text = song.grouping();
+      return true;
+    case Playlist::Column_Comment:
+      *text = song.comment();
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Makes a key that orders the same way as localeAwareCompare() on the
+// lowercased text when compared with CompareCollationKeys().
+QByteArray CollationKey(const QString& text) {
+  const QString lower = text.toLower();
+
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+  // Here localeAwareCompare() is strcoll() on the local 8-bit encoding, with
+  // ties broken by comparing the UTF-16 code units.  The key is the
+  // strxfrm() of the 8-bit string, a separator, and then the code units in
+  // big-endian order so memcmp() gets both comparisons right.
+  const QByteArray local = lower.toLocal8Bit();
+  const int length = strxfrm(nullptr, local.constData(), 0);
+
+  QByteArray key(length + 1 + lower.length() * 2, Qt::Uninitialized);
+  strxfrm(key.data(), local.constData(), length + 1);
+
+  char* units = key.data() + length + 1;
+  for (int i = 0; i < lower.length(); ++i) {
+    const ushort unit = lower.at(i).unicode();
+    *units++ = char(unit >> 8);
+    *units++ = char(unit & 0xff);
+  }
+  return key;
+#else
+  // Other platforms collate with their own APIs, so just keep the lowercased
+  // text and compare it with localeAwareCompare() each time.
+  return QByteArray(reinterpret_cast<const char*>(lower.constData()),
+                    lower.length() * sizeof(QChar));
+#endif
+}
+
+int CompareCollationKeys(const QByteArray& a, const QByteArray& b) {
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+  const int ret =
+      memcmp(a.constData(), b.constData(), qMin(a.size(), b.size()));
+  if (ret != 0) return ret;
+  return a.size() - b.size();
+#else
+  return QString::localeAwareCompare(
+      QString::fromRawData(reinterpret_cast<const QChar*>(a.constData()),
+                           a.size() / sizeof(QChar)),
+      QString::fromRawData(reinterpret_cast<const QChar*>(b.constData()),
+                           b.size() / sizeof(QChar)));
+#endif
+}
+
+// Splits [0, count) into one range per core, or just one range if count is
+// small.  Range i is [bounds[i], bounds[i + 1]).
+QVector<int> ChunkBounds(int count) {
+  const int chunks = count < kParallelSortThreshold
+                         ? 1
+                         : qMax(1, QThread::idealThreadCount());
+
+  QVector<int> bounds;
+  for (int i = 0; i <= chunks; ++i) {
+    bounds << int(qint64(count) * i / chunks);
+  }
+  return bounds;
+}
+
+// Runs the jobs on the global thread pool and waits for them all to finish.
+void RunAndWait(const QList<std::function<void()>>& jobs) {
+  if (jobs.count() == 1) {
+    jobs[0]();
+    return;
+  }
+
+  QList<QFuture<void>> futures;
+  for (const std::function<void()>& job : jobs) {
+    futures << ConcurrentRun::Run<void>(QThreadPool::globalInstance(), job);
+  }
+  for (QFuture<void>& future : futures) {
+    future.waitForFinished();
+  }
+}
+
+// Sorts [begin, end) by a text column using collation keys cached on the
+// items, making keys only for items that don't have one for their current
+// text.  Large playlists are sorted with a parallel merge sort.  Returns
+// false if the column isn't a text column.
+bool SortItemsByCollationKey(int column, Qt::SortOrder order,
+                             PlaylistItemList::iterator begin,
+                             PlaylistItemList::iterator end) {
+  QString text;
+  if (!SortText(column, Song(), &text)) return false;
+
+  const int count = end - begin;
+  QVector<QByteArray> keys(count);
+  QByteArray* key_data = keys.data();
+
+  QVector<int> missing_rows;
+  QStringList missing_text;
+  for (int row = 0; row < count; ++row) {
+    SortText(column, begin[row]->Metadata(), &text);
+    if (!begin[row]->SortKey(column, text, &key_data[row])) {
+      missing_rows << row;
+      missing_text << text;
+    }
+  }
+
+  // Making keys is the expensive part of the first sort by a column.
+  QList<std::function<void()>> jobs;
+  const QVector<int> missing_bounds = ChunkBounds(missing_rows.count());
+  for (int i = 0; i < missing_bounds.count() - 1; ++i) {
+    const int first = missing_bounds[i];
+    const int last = missing_bounds[i + 1];
+    jobs << [&missing_rows, &missing_text, key_data, first, last]() {
+      for (int j = first; j < last; ++j) {
+        key_data[missing_rows[j]] = CollationKey(missing_text[j]);
+      }
+    };
+  }
+  RunAndWait(jobs);
+
+  for (int j = 0; j < missing_rows.count(); ++j) {
+    const int row = missing_rows[j];
+    begin[row]->SetSortKey(column, missing_text[j], keys[row]);
+  }
+
+  // Ties are broken by position, which keeps the sort stable however the
+  // comparisons are ordered, so each chunk can use an unstable sort.
+  const bool descending = order == Qt::DescendingOrder;
+  auto less_than = [key_data, descending](int a, int b) {
+    const int ret = descending ? CompareCollationKeys(key_data[b], key_data[a])
+                               : CompareCollationKeys(key_data[a], key_data[b]);
+    if (ret != 0) return ret < 0;
+    return a < b;
+  };
+
+  QVector<int> rows(count);
+  int* row_data = rows.data();
+  for (int row = 0; row < count; ++row) {
+    row_data[row] = row;
+  }
+
+  const QVector<int> bounds = ChunkBounds(count);
+  const int chunks = bounds.count() - 1;
+
+  jobs.clear();
+  for (int i = 0; i < chunks; ++i) {
+    int* first = row_data + bounds[i];
+    int* last = row_data + bounds[i + 1];
+    jobs << [first, last, less_than]() { std::sort(first, last, less_than); };
+  }
+  RunAndWait(jobs);
+
+  // Merge neighbouring chunks in pairs until there's only one left.
+  for (int width = 1; width < chunks; width *= 2) {
+    jobs.clear();
+    for (int i = 0; i + width < chunks; i += width * 2) {
+      int* first = row_data + bounds[i];
+      int* middle = row_data + bounds[i + width];
+      int* last = row_data + bounds[qMin(i + width * 2, chunks)];
+      jobs << [first, middle, last, less_than]() {
+        std::inplace_merge(first, middle, last, less_than);
+      };
+    }
+    RunAndWait(jobs);
+  }
+
+  PlaylistItemList sorted;
+  sorted.reserve(count);
+  for (int row : rows) {
+    sorted << begin[row];
+  }
+  std::copy(sorted.begin(), sorted.end(), begin);
+  return true;
+}
+
+}  // namespace
+
 void Playlist::sort(int column, Qt::SortOrder order) {
   if (ignore_sorting_) return;
 
@@ -1392,8 +1616,10 @@ void Playlist::sort(int column, Qt::SortOrder order) {
   if (dynamic_playlist_ && current_item_index_.isValid())
     begin += current_item_index_.row() + 1;
 
-  qStableSort(begin, new_items.end(),
-              std::bind(&Playlist::CompareItems, column, order, _1, _2));
+  if (!SortItemsByCollationKey(column, order, begin, new_items.end())) {
+    qStableSort(begin, new_items.end(),
+                std::bind(&Playlist::CompareItems, column, order, _1, _2));
+  }
 
   undo_stack_->push(
       new PlaylistUndoCommands::SortItems(this, column, order, new_items));
@@ -1438,15 +1664,28 @@ void Playlist::SetCurrentIsPaused(bool paused) {
                 index(current_item_index_.row(), ColumnCount - 1));
 }
 
-void Playlist::Save() const {
+void Playlist::Save() {
   if (!backend_ || is_loading_) return;
 
+  // Saving a partly restored playlist would lose the rest of its items.
+  if (is_restoring_) {
+    save_after_restore_ = true;
+    return;
+  }
+
   backend_->SavePlaylistAsync(id_, items_, last_played_row(),
-                              dynamic_playlist_);
+                              dynamic_playlist_, changed_items_,
+                              save_all_items_);
+  changed_items_.clear();
+  save_all_items_ = false;
+}
+
+void Playlist::MarkItemsChanged(const PlaylistItemList& items) {
+  changed_items_ << items;
 }
 
 namespace {
-typedef QFutureWatcher<QList<PlaylistItemPtr>> PlaylistItemFutureWatcher;
+typedef QFutureWatcher<PlaylistBackend::ItemBatch> ItemBatchFutureWatcher;
 }
 
 void Playlist::Restore() {
@@ -1456,19 +1695,36 @@ void Playlist::Restore() {
   virtual_items_.clear();
   library_items_by_id_.clear();
 
-  QFuture<QList<PlaylistItemPtr>> future =
-      QtConcurrent::run(backend_, &PlaylistBackend::GetPlaylistItems, id_);
-  PlaylistItemFutureWatcher* watcher = new PlaylistItemFutureWatcher(this);
+  is_restoring_ = true;
+  restored_batches_ = 0;
+  restored_items_ = 0;
+  ++restore_generation_;
+  last_restored_index_ = QPersistentModelIndex();
+  restore_timer_.start();
+  LoadItemBatch(PlaylistBackend::kFirstPosition, kRestoreFirstBatchSize);
+}
+
+void Playlist::LoadItemBatch(qint64 after_position, int limit) {
+  QFuture<PlaylistBackend::ItemBatch> future =
+      QtConcurrent::run(backend_, &PlaylistBackend::GetPlaylistItemBatch, id_,
+                        after_position, limit);
+  ItemBatchFutureWatcher* watcher = new ItemBatchFutureWatcher(this);
+  watcher->setProperty("restore_generation", restore_generation_);
   watcher->setFuture(future);
-  connect(watcher, SIGNAL(finished()), SLOT(ItemsLoaded()));
+  connect(watcher, SIGNAL(finished()), SLOT(ItemBatchLoaded()));
 }
 
-void Playlist::ItemsLoaded() {
-  PlaylistItemFutureWatcher* watcher =
-      static_cast<PlaylistItemFutureWatcher*>(sender());
+void Playlist::ItemBatchLoaded() {
+  ItemBatchFutureWatcher* watcher =
+      static_cast<ItemBatchFutureWatcher*>(sender());
   watcher->deleteLater();
 
-  PlaylistItemList items = watcher->future().result();
+  if (watcher->property("restore_generation").toInt() != restore_generation_) {
+    return;
+  }
+
+  const PlaylistBackend::ItemBatch batch = watcher->future().result();
+  PlaylistItemList items = batch.items;
 
   // backend returns empty elements for library items which it couldn't
   // match (because they got deleted); we don't need those
@@ -1476,15 +1732,50 @@ void Playlist::ItemsLoaded() {
   while (it.hasNext()) {
     PlaylistItemPtr item = it.next();
 
-    if (item->IsLocalLibraryItem() && item->Metadata().url().isEmpty()) {
+    if (!item ||
+        (item->IsLocalLibraryItem() && item->Metadata().url().isEmpty())) {
       it.remove();
     }
   }
 
+  // Restored items go in after the ones restored before them, without an
+  // undo step.  If the user has removed the last of those there's nowhere
+  // better than the end.
+  int pos = 0;
+  if (restored_items_ > 0) {
+    pos = last_restored_index_.isValid() ? last_restored_index_.row() + 1 : -1;
+  }
+
   is_loading_ = true;
-  InsertItems(items, 0);
+  InsertItemsWithoutUndo(items, pos);
   is_loading_ = false;
 
+  if (!items.isEmpty()) {
+    const int last = pos == -1 ? items_.count() - 1 : pos + items.count() - 1;
+    last_restored_index_ = QPersistentModelIndex(index(last, 0));
+    restored_items_ += items.count();
+  }
+
+  if (restored_batches_++ == 0) {
+    qLog(Debug) << "Restored first" << items_.count() << "items of playlist"
+                << id_ << "in" << restore_timer_.elapsed() << "ms";
+  }
+
+  if (batch.has_more) {
+    LoadItemBatch(batch.last_position, kRestoreBatchSize);
+  } else {
+    FinishRestore();
+  }
+}
+
+void Playlist::FinishRestore() {
+  is_restoring_ = false;
+  last_restored_index_ = QPersistentModelIndex();
+
+  qLog(Debug) << "Restored" << items_.count() << "items of playlist" << id_
+              << "in" << restored_batches_ << "batches,"
+              << restore_timer_.elapsed() << "ms";
+
   PlaylistBackend::Playlist p = backend_->GetPlaylist(id_);
 
   // the newly loaded list of items might be shorter than it was before so
@@ -1522,6 +1813,11 @@ void Playlist::ItemsLoaded() {
   if (s.value("greyoutdeleted", false).toBool()) {
     QtConcurrent::run(this, &Playlist::InvalidateDeletedSongs);
   }
+
+  if (save_after_restore_) {
+    save_after_restore_ = false;
+    Save();
+  }
 }
 
 static bool DescendingIntLessThan(int a, int b) { return a > b; }
@@ -1719,7 +2015,25 @@ void Playlist::UpdateScrobblePoint() {
   have_incremented_playcount_ = false;
 }
 
+void Playlist::AbandonRestore() {
+  if (!is_restoring_) return;
+
+  qLog(Debug) << "Abandoning the restore of playlist" << id_ << "after"
+              << restored_batches_ << "batches";
+
+  ++restore_generation_;
+  is_restoring_ = false;
+  save_after_restore_ = false;
+  save_all_items_ = true;
+  last_restored_index_ = QPersistentModelIndex();
+
+  emit RestoreFinished();
+}
+
 void Playlist::Clear() {
+  // The rest of the old items shouldn't reappear in the cleared playlist.
+  AbandonRestore();
+
   const int count = items_.count();
 
   if (count > kUndoItemLimit) {
@@ -1796,6 +2110,7 @@ void Playlist::ReloadItems(const QList<int>& rows) {
     PlaylistItemPtr item = item_at(row);
 
     item->Reload();
+    changed_items_ << item;
 
     if (row == current_row()) {
       InformOfCurrentSongChange();
@@ -2018,6 +2333,7 @@ void Playlist::QueueLayoutChanged() {
 void Playlist::ItemChanged(PlaylistItemPtr item) {
   for (int row = 0; row < items_.count(); ++row) {
     if (items_[row] == item) {
+      item->ClearSortKeys();
       emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
       return;
     }
@@ -19,6 +19,7 @@
 #define PLAYLIST_H
 
 #include <QAbstractItemModel>
+#include <QElapsedTimer>
 #include <QList>
 
 #include "playlistitem.h"
@@ -160,6 +161,11 @@ class Playlist : public QAbstractListModel {
   static const int kUndoStackSize;
   static const int kUndoItemLimit;
 
+  // The first batch of a restored playlist is small, so there's something
+  // to show quickly.  The rest is loaded in larger batches.
+  static const int kRestoreFirstBatchSize;
+  static const int kRestoreBatchSize;
+
   static bool CompareItems(int column, Qt::SortOrder order, PlaylistItemPtr a,
                            PlaylistItemPtr b);
 
@@ -171,8 +177,16 @@ class Playlist : public QAbstractListModel {
                                const QVariant& value);
 
   // Persistence
-  void Save() const;
+  void Save();
+  // Loads the playlist's items from the database in the background, a batch
+  // at a time.  RestoreFinished() is emitted when they've all been added, or
+  // when the restore is abandoned because the playlist was cleared.
   void Restore();
+  bool is_restoring() const { return is_restoring_; }
+  // Makes the next Save() write these items again.  Call this after changing
+  // an item's metadata in place, since only inserted, removed and moved
+  // items are noticed otherwise.
+  void MarkItemsChanged(const PlaylistItemList& items);
 
   // Accessors
   QSortFilterProxyModel* proxy() const;
@@ -357,6 +371,10 @@ signals:
   bool FilterContainsVirtualIndex(int i) const;
   void TurnOnDynamicPlaylist(smart_playlists::GeneratorPtr gen);
 
+  void LoadItemBatch(qint64 after_position, int limit);
+  void FinishRestore();
+  void AbandonRestore();
+
   void InsertInternetItems(const InternetModel* model,
                            const QModelIndexList& items, int pos, bool play_now,
                            bool enqueue);
@@ -390,7 +408,7 @@ signals:
   void SongSaveComplete(TagReaderReply* reply,
                         const QPersistentModelIndex& index);
   void ItemReloadComplete();
-  void ItemsLoaded();
+  void ItemBatchLoaded();
   void SongInsertVetoListenerDestroyed();
 
  private:
@@ -431,6 +449,26 @@ signals:
   // Hack to stop QTreeView::setModel sorting the playlist
   bool ignore_sorting_;
 
+  // Items whose metadata has changed since the last save.
+  PlaylistItemList changed_items_;
+
+  // Saves are held back until all the items have been restored.
+  bool is_restoring_;
+  bool save_after_restore_;
+  // Set when a restore is abandoned, since the rows that weren't loaded yet
+  // are only removed by writing the whole playlist again.
+  bool save_all_items_;
+  int restored_batches_;
+  int restored_items_;
+  QElapsedTimer restore_timer_;
+
+  // Bumped when a restore is started or abandoned, so batches still loading
+  // for an earlier one are dropped.
+  int restore_generation_;
+  // The last restored item.  The playlist can be edited while it's being
+  // restored, so later batches go after this rather than at the end.
+  QPersistentModelIndex last_restored_index_;
+
   QUndoStack* undo_stack_;
 
   smart_playlists::GeneratorPtr dynamic_playlist_;
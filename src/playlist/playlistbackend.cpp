@@ -17,13 +17,16 @@
 
 #include "playlistbackend.h"
 
+#include <limits>
 #include <memory>
 #include <functional>
 
 #include <QFile>
 #include <QHash>
 #include <QMutexLocker>
+#include <QSet>
 #include <QSqlQuery>
+#include <QVector>
 #include <QtDebug>
 
 #include "core/application.h"
@@ -44,6 +47,109 @@ using smart_playlists::GeneratorPtr;
 
 const int PlaylistBackend::kSongTableJoins = 4;
 
+const qint64 PlaylistBackend::kFirstPosition =
+    std::numeric_limits<qint64>::min();
+const qint64 PlaylistBackend::kPositionStep = 1 << 16;
+const int PlaylistBackend::kCompactionInterval = 50;
+
+namespace {
+
+QString InsertItemSql() {
+  return "INSERT INTO playlist_items"
+         " (playlist, position, type, library_id, radio_service, " +
+         Song::kColumnSpec +
+         ")"
+         " VALUES (:playlist, :position, :type, :library_id, :radio_service, " +
+         Song::kBindSpec + ")";
+}
+
+// Finds the longest list of items, in playlist order, whose stored positions
+// are already increasing.  Those items can keep the positions they have.
+QVector<bool> ItemsInOrder(const QVector<bool>& kept,
+                           const QVector<qint64>& positions) {
+  const int count = kept.count();
+
+  // tails[n] is the item that ends the best increasing list of length n + 1
+  // found so far.
+  QVector<int> tails;
+  QVector<int> previous(count, -1);
+  for (int i = 0; i < count; ++i) {
+    if (!kept[i]) continue;
+
+    int low = 0;
+    int high = tails.count();
+    while (low < high) {
+      const int mid = (low + high) / 2;
+      if (positions[tails[mid]] < positions[i]) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+
+    if (low > 0) previous[i] = tails[low - 1];
+    if (low == tails.count()) {
+      tails << i;
+    } else {
+      tails[low] = i;
+    }
+  }
+
+  QVector<bool> ret(count, false);
+  for (int i = tails.isEmpty() ? -1 : tails.last(); i != -1; i = previous[i]) {
+    ret[i] = true;
+  }
+  return ret;
+}
+
+// Gives a position to every item that isn't anchored, spacing each run of
+// them evenly between the anchored items either side.  Returns false if there
+// isn't room between two anchors.
+bool FillPositions(const QVector<bool>& anchored, qint64 step,
+                   QVector<qint64>* positions) {
+  const int count = positions->count();
+
+  bool has_previous = false;
+  qint64 previous = 0;
+  int run_start = 0;
+  for (int i = 0; i <= count; ++i) {
+    if (i < count && !anchored[i]) continue;
+
+    const int run = i - run_start;
+    if (run > 0) {
+      qint64 low, high;
+      if (has_previous && i < count) {
+        low = previous;
+        high = (*positions)[i];
+      } else if (has_previous) {
+        low = previous;
+        high = previous + (run + 1) * step;
+      } else if (i < count) {
+        high = (*positions)[i];
+        low = high - (run + 1) * step;
+      } else {
+        low = -step;
+        high = run * step;
+      }
+
+      const qint64 gap = (high - low) / (run + 1);
+      if (gap < 1) return false;
+      for (int j = 0; j < run; ++j) {
+        (*positions)[run_start + j] = low + gap * (j + 1);
+      }
+    }
+
+    if (i < count) {
+      has_previous = true;
+      previous = (*positions)[i];
+    }
+    run_start = i + 1;
+  }
+  return true;
+}
+
+}  // namespace
+
 PlaylistBackend::PlaylistBackend(Application* app, QObject* parent)
     : QObject(parent), app_(app), db_(app_->database()) {}
 
@@ -137,7 +243,9 @@ PlaylistBackend::Playlist PlaylistBackend::GetPlaylist(int id) {
   return p;
 }
 
-QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
+QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist,
+                                           qint64 after_position,
+                                           int limit) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
@@ -152,7 +260,7 @@ QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
                   "       p.ROWID, " +
                   Song::JoinSpec("p") +
                   ","
-                  "       p.type, p.radio_service"
+                  "       p.type, p.radio_service, p.position"
                   " FROM playlist_items AS p"
                   " LEFT JOIN songs"
                   "    ON p.library_id = songs.ROWID"
@@ -160,31 +268,75 @@ QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
                   "    ON p.library_id = magnatune_songs.ROWID"
                   " LEFT JOIN jamendo.songs AS jamendo_songs"
                   "    ON p.library_id = jamendo_songs.ROWID"
-                  " WHERE p.playlist = :playlist";
+                  " WHERE p.playlist = :playlist"
+                  "   AND p.position > :after_position"
+                  " ORDER BY p.position"
+                  " LIMIT :limit";
   QSqlQuery q(db);
   // Forward iterations only may be faster
   q.setForwardOnly(true);
   q.prepare(query);
   q.bindValue(":playlist", playlist);
+  q.bindValue(":after_position", after_position);
+  q.bindValue(":limit", limit);
   q.exec();
 
   return q;
 }
 
 QList<PlaylistItemPtr> PlaylistBackend::GetPlaylistItems(int playlist) {
-  QSqlQuery q = GetPlaylistRows(playlist);
+  return GetPlaylistItemBatch(playlist, kFirstPosition, -1).items;
+}
+
+PlaylistBackend::ItemBatch PlaylistBackend::GetPlaylistItemBatch(
+    int playlist, qint64 after_position, int limit) {
+  ItemBatch batch;
+  batch.last_position = after_position;
+
+  QSqlQuery q = GetPlaylistRows(playlist, after_position, limit);
   // Note that as this only accesses the query, not the db, we don't need the
   // mutex.
-  if (db_->CheckErrors(q)) return QList<PlaylistItemPtr>();
+  if (db_->CheckErrors(q)) return batch;
+
+  // p.ROWID comes after the other song tables, and p.position is last
+  const int rowid_column =
+      (Song::kColumns.count() + 1) * (kSongTableJoins - 1);
+  const int position_column =
+      (Song::kColumns.count() + 1) * kSongTableJoins + 2;
 
   // it's probable that we'll have a few songs associated with the
   // same CUE so we're caching results of parsing CUEs
   std::shared_ptr<NewSongFromQueryState> state_ptr(new NewSongFromQueryState());
-  QList<PlaylistItemPtr> playlistitems;
+  SavedPlaylist saved;
   while (q.next()) {
-    playlistitems << NewPlaylistItemFromQuery(SqlRow(q), state_ptr);
+    SqlRow row(q);
+    PlaylistItemPtr item = NewPlaylistItemFromQuery(row, state_ptr);
+    batch.items << item;
+
+    // Remember which row each item came from so the next save doesn't have
+    // to write them all again.  Items with CUE data might have been changed
+    // while they were loaded, so their rows get replaced instead.
+    const qint64 rowid = row.value(rowid_column).toLongLong();
+    batch.last_position = row.value(position_column).toLongLong();
+    if (item && !item->Metadata().has_cue()) {
+      saved.items.insert(item.get(),
+                         SavedItem(item, rowid, batch.last_position));
+    } else {
+      saved.stale_rows << rowid;
+    }
+  }
+  batch.has_more = limit != -1 && batch.items.count() == limit;
+
+  // The first batch replaces anything remembered from before.
+  QMutexLocker l(&saved_playlists_mutex_);
+  if (after_position == kFirstPosition) {
+    saved_playlists_[playlist] = saved;
+  } else {
+    SavedPlaylist& existing = saved_playlists_[playlist];
+    existing.items.unite(saved.items);
+    existing.stale_rows << saved.stale_rows;
   }
-  return playlistitems;
+  return batch;
 }
 
 QList<Song> PlaylistBackend::GetPlaylistSongs(int playlist) {
@@ -279,29 +431,25 @@ PlaylistItemPtr PlaylistBackend::RestoreCueData(
 
 void PlaylistBackend::SavePlaylistAsync(int playlist,
                                         const PlaylistItemList& items,
-                                        int last_played, GeneratorPtr dynamic) {
+                                        int last_played, GeneratorPtr dynamic,
+                                        const PlaylistItemList& changed_items,
+                                        bool write_all) {
   metaObject()->invokeMethod(
       this, "SavePlaylist", Qt::QueuedConnection, Q_ARG(int, playlist),
       Q_ARG(PlaylistItemList, items), Q_ARG(int, last_played),
-      Q_ARG(smart_playlists::GeneratorPtr, dynamic));
+      Q_ARG(smart_playlists::GeneratorPtr, dynamic),
+      Q_ARG(PlaylistItemList, changed_items), Q_ARG(bool, write_all));
 }
 
 void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList& items,
-                                   int last_played, GeneratorPtr dynamic) {
+                                   int last_played, GeneratorPtr dynamic,
+                                   const PlaylistItemList& changed_items,
+                                   bool write_all) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
   qLog(Debug) << "Saving playlist" << playlist;
 
-  QSqlQuery clear("DELETE FROM playlist_items WHERE playlist = :playlist", db);
-  QSqlQuery insert(
-      "INSERT INTO playlist_items"
-      " (playlist, type, library_id, radio_service, " +
-          Song::kColumnSpec +
-          ")"
-          " VALUES (:playlist, :type, :library_id, :radio_service, " +
-          Song::kBindSpec + ")",
-      db);
   QSqlQuery update(
       "UPDATE playlists SET "
       "   last_played=:last_played,"
@@ -311,20 +459,46 @@ void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList& items,
       " WHERE ROWID=:playlist",
       db);
 
-  ScopedTransaction transaction(&db);
-
-  // Clear the existing items in the playlist
-  clear.bindValue(":playlist", playlist);
-  clear.exec();
-  if (db_->CheckErrors(clear)) return;
+  // The saved state is taken out while the rows are written, so if anything
+  // fails the next save writes the whole playlist again.
+  bool have_saved = false;
+  SavedPlaylist saved;
+  {
+    QMutexLocker saved_l(&saved_playlists_mutex_);
+    if (saved_playlists_.contains(playlist)) {
+      have_saved = true;
+      saved = saved_playlists_.take(playlist);
+    }
+  }
 
-  // Save the new ones
+  // Rows are matched to items by address, so an item that's in the playlist
+  // twice can't be tracked.
+  QSet<const PlaylistItem*> unique_items;
   for (PlaylistItemPtr item : items) {
-    insert.bindValue(":playlist", playlist);
-    item->BindToQuery(&insert);
+    unique_items.insert(item.get());
+  }
+  const bool trackable = unique_items.count() == items.count();
+
+  ScopedTransaction transaction(&db);
 
-    insert.exec();
-    db_->CheckErrors(insert);
+  if (write_all || !have_saved || !trackable) {
+    if (!WriteAllItems(db, playlist, items, &saved)) return;
+  } else {
+    // Every so often make sure nothing else has changed the stored rows, and
+    // spread the positions out again.
+    const bool compact =
+        ++saved.saves_since_compaction >= kCompactionInterval;
+    bool matches = true;
+    if (compact && !CheckStoredRows(db, playlist, saved, &matches)) return;
+
+    if (!matches) {
+      qLog(Warning) << "Stored rows for playlist" << playlist
+                    << "are out of date, writing it again";
+      if (!WriteAllItems(db, playlist, items, &saved)) return;
+    } else if (!WriteItemChanges(db, playlist, items, changed_items, compact,
+                                 &saved)) {
+      return;
+    }
   }
 
   // Update the last played track number
@@ -343,6 +517,154 @@ void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList& items,
   if (db_->CheckErrors(update)) return;
 
   transaction.Commit();
+
+  if (trackable) {
+    QMutexLocker saved_l(&saved_playlists_mutex_);
+    saved_playlists_[playlist] = saved;
+  }
+}
+
+bool PlaylistBackend::WriteAllItems(QSqlDatabase& db, int playlist,
+                                    const PlaylistItemList& items,
+                                    SavedPlaylist* saved) {
+  QSqlQuery clear("DELETE FROM playlist_items WHERE playlist = :playlist", db);
+  QSqlQuery insert(InsertItemSql(), db);
+
+  // Clear the existing items in the playlist
+  clear.bindValue(":playlist", playlist);
+  clear.exec();
+  if (db_->CheckErrors(clear)) return false;
+
+  // Save the new ones
+  *saved = SavedPlaylist();
+  for (int i = 0; i < items.count(); ++i) {
+    InsertItem(&insert, playlist, items[i], i * kPositionStep, saved);
+  }
+  return true;
+}
+
+bool PlaylistBackend::WriteItemChanges(QSqlDatabase& db, int playlist,
+                                       const PlaylistItemList& items,
+                                       const PlaylistItemList& changed_items,
+                                       bool compact, SavedPlaylist* saved) {
+  QSet<const PlaylistItem*> changed;
+  for (PlaylistItemPtr item : changed_items) {
+    changed.insert(item.get());
+  }
+
+  // Find the items whose rows can be kept.  Whatever is left over in
+  // old_items afterwards was removed from the playlist or has changed.
+  const int count = items.count();
+  QHash<const PlaylistItem*, SavedItem> old_items = saved->items;
+  QVector<bool> kept(count, false);
+  QVector<qint64> rowids(count, -1);
+  QVector<qint64> old_positions(count, 0);
+  for (int i = 0; i < count; ++i) {
+    const PlaylistItem* item = items[i].get();
+    if (changed.contains(item)) continue;
+
+    QHash<const PlaylistItem*, SavedItem>::iterator it = old_items.find(item);
+    if (it == old_items.end()) continue;
+
+    kept[i] = true;
+    rowids[i] = it->rowid;
+    old_positions[i] = it->position;
+    old_items.erase(it);
+  }
+
+  // Items that are still in order keep their positions, and everything else
+  // is slotted in between them.  If there's no room the whole playlist is
+  // renumbered.
+  QVector<qint64> positions(old_positions);
+  if (compact ||
+      !FillPositions(ItemsInOrder(kept, old_positions), kPositionStep,
+                     &positions)) {
+    compact = true;
+    FillPositions(QVector<bool>(count, false), kPositionStep, &positions);
+  }
+
+  QSqlQuery remove("DELETE FROM playlist_items WHERE ROWID = :rowid", db);
+  QSqlQuery move(
+      "UPDATE playlist_items SET position = :position WHERE ROWID = :rowid",
+      db);
+  QSqlQuery insert(InsertItemSql(), db);
+
+  QList<qint64> removed_rows = saved->stale_rows;
+  for (const SavedItem& old_item : old_items) {
+    removed_rows << old_item.rowid;
+  }
+  for (qint64 rowid : removed_rows) {
+    remove.bindValue(":rowid", rowid);
+    remove.exec();
+    if (db_->CheckErrors(remove)) return false;
+  }
+
+  SavedPlaylist new_saved;
+  new_saved.saves_since_compaction =
+      compact ? 0 : saved->saves_since_compaction;
+
+  int moved = 0;
+  for (int i = 0; i < count; ++i) {
+    if (!kept[i]) {
+      InsertItem(&insert, playlist, items[i], positions[i], &new_saved);
+      continue;
+    }
+
+    if (positions[i] != old_positions[i]) {
+      move.bindValue(":position", positions[i]);
+      move.bindValue(":rowid", rowids[i]);
+      move.exec();
+      if (db_->CheckErrors(move)) return false;
+      ++moved;
+    }
+    new_saved.items.insert(items[i].get(),
+                           SavedItem(items[i], rowids[i], positions[i]));
+  }
+
+  qLog(Debug) << "Playlist" << playlist << "removed" << removed_rows.count()
+              << "inserted" << kept.count(false) << "moved" << moved
+              << (compact ? "(compacted)" : "");
+
+  *saved = new_saved;
+  return true;
+}
+
+bool PlaylistBackend::CheckStoredRows(QSqlDatabase& db, int playlist,
+                                      const SavedPlaylist& saved,
+                                      bool* matches) {
+  QSqlQuery q("SELECT ROWID FROM playlist_items WHERE playlist = :playlist",
+              db);
+  q.bindValue(":playlist", playlist);
+  q.exec();
+  if (db_->CheckErrors(q)) return false;
+
+  QSet<qint64> stored;
+  while (q.next()) {
+    stored.insert(q.value(0).toLongLong());
+  }
+
+  QSet<qint64> expected = saved.stale_rows.toSet();
+  for (const SavedItem& item : saved.items) {
+    expected.insert(item.rowid);
+  }
+
+  *matches = stored == expected;
+  return true;
+}
+
+void PlaylistBackend::InsertItem(QSqlQuery* insert, int playlist,
+                                 PlaylistItemPtr item, qint64 position,
+                                 SavedPlaylist* saved) {
+  insert->bindValue(":playlist", playlist);
+  insert->bindValue(":position", position);
+  item->BindToQuery(insert);
+
+  insert->exec();
+  if (db_->CheckErrors(*insert)) return;
+
+  saved->items.insert(
+      item.get(),
+      SavedItem(item, insert->lastInsertId().toLongLong(), position));
 }
 
 int PlaylistBackend::CreatePlaylist(const QString& name,
@@ -380,6 +702,9 @@ void PlaylistBackend::RemovePlaylist(int id) {
   if (db_->CheckErrors(delete_items)) return;
 
   transaction.Commit();
+
+  QMutexLocker saved_l(&saved_playlists_mutex_);
+  saved_playlists_.remove(id);
 }
 
 void PlaylistBackend::RenamePlaylist(int id, const QString& new_name) {
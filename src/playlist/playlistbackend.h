@@ -20,6 +20,7 @@
 
 #include <QHash>
 #include <QList>
+#include <QMap>
 #include <QMutex>
 #include <QObject>
 
@@ -28,6 +29,8 @@
 
 class Application;
 class Database;
+class QSqlDatabase;
+class QSqlQuery;
 
 class PlaylistBackend : public QObject {
   Q_OBJECT
@@ -55,21 +58,50 @@ class PlaylistBackend : public QObject {
 
   static const int kSongTableJoins;
 
+  // Gap left between the positions of neighbouring items when a playlist is
+  // written in full, so items can be inserted between them later.
+  static const qint64 kPositionStep;
+  // A playlist is compacted after this many incremental saves.
+  static const int kCompactionInterval;
+
   PlaylistList GetAllPlaylists();
   PlaylistList GetAllOpenPlaylists();
   PlaylistList GetAllFavoritePlaylists();
   PlaylistBackend::Playlist GetPlaylist(int id);
 
+  // Part of a playlist's items, for loading a large playlist a piece at a
+  // time.  Pass last_position to the next call to get the items after these.
+  struct ItemBatch {
+    ItemBatch() : last_position(0), has_more(false) {}
+
+    PlaylistItemList items;
+    qint64 last_position;
+    bool has_more;
+  };
+
+  // Position to pass to GetPlaylistItemBatch() to start from the beginning.
+  static const qint64 kFirstPosition;
+
   QList<PlaylistItemPtr> GetPlaylistItems(int playlist);
+  // Returns up to limit items from after the given position.
+  ItemBatch GetPlaylistItemBatch(int playlist, qint64 after_position,
+                                 int limit);
   QList<Song> GetPlaylistSongs(int playlist);
 
   void SetPlaylistOrder(const QList<int>& ids);
   void SetPlaylistUiPath(int id, const QString& path);
 
   int CreatePlaylist(const QString& name, const QString& special_type);
+  // changed_items are items in the playlist whose metadata has changed since
+  // the last save, and must be written again even if they haven't moved.
+  // write_all replaces every row stored for the playlist, including ones that
+  // were never loaded.
   void SavePlaylistAsync(int playlist, const PlaylistItemList& items,
                          int last_played,
-                         smart_playlists::GeneratorPtr dynamic);
+                         smart_playlists::GeneratorPtr dynamic,
+                         const PlaylistItemList& changed_items =
+                             PlaylistItemList(),
+                         bool write_all = false);
   void RenamePlaylist(int id, const QString& new_name);
   void FavoritePlaylist(int id, bool is_favorite);
   void RemovePlaylist(int id);
@@ -78,15 +110,42 @@ class PlaylistBackend : public QObject {
 
  public slots:
   void SavePlaylist(int playlist, const PlaylistItemList& items,
-                    int last_played, smart_playlists::GeneratorPtr dynamic);
+                    int last_played, smart_playlists::GeneratorPtr dynamic,
+                    const PlaylistItemList& changed_items, bool write_all);
 
  private:
+  // A row in playlist_items that was written for an item.  Keeping a
+  // reference to the item stops its address being reused by a new one.
+  struct SavedItem {
+    SavedItem() : rowid(-1), position(0) {}
+    SavedItem(PlaylistItemPtr _item, qint64 _rowid, qint64 _position)
+        : item(_item), rowid(_rowid), position(_position) {}
+
+    PlaylistItemPtr item;
+    qint64 rowid;
+    qint64 position;
+  };
+
+  // What is stored in playlist_items for a playlist, as of its last save.
+  // The next save compares the playlist against this and only writes the
+  // rows that were inserted, removed, moved or changed.
+  struct SavedPlaylist {
+    SavedPlaylist() : saves_since_compaction(0) {}
+
+    QHash<const PlaylistItem*, SavedItem> items;
+    // Rows that don't belong to any item and should be deleted.
+    QList<qint64> stale_rows;
+    int saves_since_compaction;
+  };
+
   struct NewSongFromQueryState {
     QHash<QString, SongList> cached_cues_;
     QMutex mutex_;
   };
 
-  QSqlQuery GetPlaylistRows(int playlist);
+  QSqlQuery GetPlaylistRows(int playlist,
+                            qint64 after_position = kFirstPosition,
+                            int limit = -1);
 
   Song NewSongFromQuery(const SqlRow& row,
                         std::shared_ptr<NewSongFromQueryState> state);
@@ -102,8 +161,23 @@ class PlaylistBackend : public QObject {
   };
   PlaylistList GetPlaylists(GetPlaylistsFlags flags);
 
+  // These are called with the database mutex held, inside a transaction.
+  bool WriteAllItems(QSqlDatabase& db, int playlist,
+                     const PlaylistItemList& items, SavedPlaylist* saved);
+  bool WriteItemChanges(QSqlDatabase& db, int playlist,
+                        const PlaylistItemList& items,
+                        const PlaylistItemList& changed_items, bool compact,
+                        SavedPlaylist* saved);
+  bool CheckStoredRows(QSqlDatabase& db, int playlist,
+                       const SavedPlaylist& saved, bool* matches);
+  void InsertItem(QSqlQuery* insert, int playlist, PlaylistItemPtr item,
+                  qint64 position, SavedPlaylist* saved);
+
   Application* app_;
   Database* db_;
+
+  QMutex saved_playlists_mutex_;
+  QMap<int, SavedPlaylist> saved_playlists_;
 };
 
 #endif  // PLAYLISTBACKEND_H
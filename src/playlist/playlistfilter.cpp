@@ -22,8 +22,7 @@
 
 PlaylistFilter::PlaylistFilter(QObject* parent)
     : QSortFilterProxyModel(parent),
-      filter_tree_(new NopFilter),
-      query_hash_(0) {
+      filter_tree_(new NopFilter) {
   setDynamicSortFilter(true);
 
   column_names_["title"] = Playlist::Column_Title;
@@ -59,19 +58,77 @@ void PlaylistFilter::sort(int column, Qt::SortOrder order) {
   sourceModel()->sort(column, order);
 }
 
+void PlaylistFilter::setSourceModel(QAbstractItemModel* source_model) {
+  if (sourceModel()) {
+    disconnect(sourceModel(), 0, this, SLOT(ClearMatchCache()));
+  }
+
+  // These are connected before QSortFilterProxyModel connects its own
+  // handlers, so the cache is cleared before any rows get filtered again.
+  connect(source_model, SIGNAL(dataChanged(QModelIndex, QModelIndex)),
+          SLOT(ClearMatchCache()));
+  connect(source_model, SIGNAL(rowsInserted(QModelIndex, int, int)),
+          SLOT(ClearMatchCache()));
+  connect(source_model, SIGNAL(rowsRemoved(QModelIndex, int, int)),
+          SLOT(ClearMatchCache()));
+  connect(source_model,
+          SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)),
+          SLOT(ClearMatchCache()));
+  connect(source_model, SIGNAL(layoutChanged()), SLOT(ClearMatchCache()));
+  connect(source_model, SIGNAL(modelReset()), SLOT(ClearMatchCache()));
+
+  ClearMatchCache();
+  QSortFilterProxyModel::setSourceModel(source_model);
+}
+
+void PlaylistFilter::ClearMatchCache() { matches_.clear(); }
+
+bool PlaylistFilter::IsRefinement(const QString& previous,
+                                  const QString& query) {
+  if (!query.startsWith(previous)) return false;
+
+  // Operators, quotes and column prefixes can make a longer query match more
+  // ("-a" -> "-ab", "year:2" -> "year:20"), so only plain words count.
+  for (const QChar& c : query) {
+    if (QString(":-()\"<>=!").contains(c)) return false;
+  }
+  for (const QString& word :
+       query.split(QRegExp("\\s+"), QString::SkipEmptyParts)) {
+    if (word == "AND" || word == "OR") return false;
+  }
+  return true;
+}
+
 bool PlaylistFilter::filterAcceptsRow(int row,
                                       const QModelIndex& parent) const {
   QString filter = filterRegExp().pattern();
 
-  uint hash = qHash(filter);
-  if (hash != query_hash_) {
+  if (filter != query_) {
+    if (!IsRefinement(query_, filter)) {
+      matches_.fill(-1);
+    }
+
     // Parse the query
     FilterParser p(filter, column_names_, numerical_columns_);
     filter_tree_.reset(p.parse());
 
-    query_hash_ = hash;
+    query_ = filter;
   }
 
+  if (row < matches_.count() && matches_[row] == 0) return false;
+
   // Test the row
-  return filter_tree_->accept(row, parent, sourceModel());
+  const Playlist* playlist = static_cast<const Playlist*>(sourceModel());
+  const bool ret = filter_tree_->accept(playlist->item_at(row)->Metadata());
+
+  if (row >= matches_.count()) {
+    const int old_count = matches_.count();
+    matches_.resize(qMax(row + 1, playlist->rowCount()));
+    for (int i = old_count; i < matches_.count(); ++i) {
+      matches_[i] = -1;
+    }
+  }
+  matches_[row] = ret ? 1 : 0;
+
+  return ret;
 }
@@ -20,6 +20,7 @@
 
 #include <QScopedPointer>
 #include <QSortFilterProxyModel>
+#include <QVector>
 
 #include "playlist.h"
 
@@ -37,14 +38,30 @@ class PlaylistFilter : public QSortFilterProxyModel {
   // QAbstractItemModel
   void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
 
+  // QAbstractProxyModel
+  void setSourceModel(QAbstractItemModel* source_model);
+
   // QSortFilterProxyModel
   // public so Playlist::NextVirtualIndex and friends can get at it
   bool filterAcceptsRow(int source_row, const QModelIndex& source_parent) const;
 
+  // Returns true if anything matching query is certain to also match
+  // previous, for example when the user has typed more of a word.
+  static bool IsRefinement(const QString& previous, const QString& query);
+
+ private slots:
+  void ClearMatchCache();
+
  private:
   // Mutable because they're modified from filterAcceptsRow() const
   mutable QScopedPointer<FilterTree> filter_tree_;
-  mutable uint query_hash_;
+  mutable QString query_;
+
+  // Whether each source row matched the last query it was tested against, or
+  // -1 if it hasn't been tested since the playlist changed.  While the query
+  // is only being refined, rows that failed can't start matching, so they
+  // aren't tested again.
+  mutable QVector<qint8> matches_;
 
   QMap<QString, int> column_names_;
   QSet<int> numerical_columns_;
@@ -18,13 +18,106 @@
 #include "playlistfilterparser.h"
 #include "playlist.h"
 #include "core/logging.h"
+#include "core/song.h"
+
+#include <QVariant>
+
+namespace {
+
+// Returns the text Playlist::data() would show for this column.
+QString ColumnText(int column, const Song& song) {
+  switch (column) {
+    case Playlist::Column_Title:
+      return song.PrettyTitle();
+    case Playlist::Column_Artist:
+      return song.artist();
+    case Playlist::Column_Album:
+      return song.album();
+    case Playlist::Column_Length:
+      return QString::number(song.length_nanosec());
+    case Playlist::Column_Track:
+      return QString::number(song.track());
+    case Playlist::Column_Disc:
+      return QString::number(song.disc());
+    case Playlist::Column_Year:
+      return QString::number(song.year());
+    case Playlist::Column_Genre:
+      return song.genre();
+    case Playlist::Column_AlbumArtist:
+      return song.playlist_albumartist();
+    case Playlist::Column_Composer:
+      return song.composer();
+    case Playlist::Column_Performer:
+      return song.performer();
+    case Playlist::Column_Grouping:
+      return song.grouping();
+    case Playlist::Column_Rating:
+      return QVariant(song.rating()).toString();
+    case Playlist::Column_Score:
+      return QString::number(song.score());
+    case Playlist::Column_BPM:
+      return QVariant(song.bpm()).toString();
+    case Playlist::Column_Bitrate:
+      return QString::number(song.bitrate());
+    case Playlist::Column_Filename:
+      return song.url().toString();
+    case Playlist::Column_Comment:
+      return song.comment().simplified();
+    default:
+      qLog(Error) << "Unsupported filter column" << column;
+      return QString();
+  }
+}
+
+// Returns the value numeric comparisons see for this column.  This is the
+// column's text converted with QString::toInt(), except that the length is
+// in seconds rather than nanoseconds and the rating is out of 10.
+qint64 ColumnNumber(int column, const Song& song) {
+  switch (column) {
+    case Playlist::Column_Length: {
+      // The length is displayed in nanoseconds but we only care about
+      // seconds, so the last 9 digits are dropped if there are more than 9
+      // characters.
+      const qint64 length = song.length_nanosec();
+      if (length >= 1000000000ll || length <= -100000000ll) {
+        return length / 1000000000ll;
+      }
+      return length;
+    }
+    case Playlist::Column_Track:
+      return song.track();
+    case Playlist::Column_Disc:
+      return song.disc();
+    case Playlist::Column_Year:
+      return song.year();
+    case Playlist::Column_Score:
+      return song.score();
+    case Playlist::Column_Bitrate:
+      return song.bitrate();
+    case Playlist::Column_Rating:
+      return static_cast<int>(song.rating() * 10.0 + 0.5);
+    case Playlist::Column_BPM: {
+      // toInt() on a fractional number fails and gives 0.
+      const float bpm = song.bpm();
+      return bpm == static_cast<int>(bpm) ? static_cast<int>(bpm) : 0;
+    }
+    default:
+      return ColumnText(column, song).toInt();
+  }
+}
 
-#include <QAbstractItemModel>
+}  // namespace
 
 class SearchTermComparator {
  public:
   virtual ~SearchTermComparator() {}
   virtual bool Matches(const QString& element) const = 0;
+
+  // Numeric columns are compared through this, which saves formatting the
+  // number unless the comparator really wants a string.
+  virtual bool Matches(qint64 element) const {
+    return Matches(QString::number(element));
+  }
 };
 
 // "compares" by checking if the field contains the search term
@@ -32,8 +125,9 @@ class DefaultComparator : public SearchTermComparator {
  public:
   explicit DefaultComparator(const QString& value) : search_term_(value) {}
   virtual bool Matches(const QString& element) const {
-    return element.contains(search_term_);
+    return element.contains(search_term_, Qt::CaseInsensitive);
   }
+  using SearchTermComparator::Matches;
 
  private:
   QString search_term_;
@@ -43,8 +137,9 @@ class EqComparator : public SearchTermComparator {
  public:
   explicit EqComparator(const QString& value) : search_term_(value) {}
   virtual bool Matches(const QString& element) const {
-    return search_term_ == element;
+    return search_term_ == element.toLower();
   }
+  using SearchTermComparator::Matches;
 
  private:
   QString search_term_;
@@ -54,8 +149,9 @@ class NeComparator : public SearchTermComparator {
  public:
   explicit NeComparator(const QString& value) : search_term_(value) {}
   virtual bool Matches(const QString& element) const {
-    return search_term_ != element;
+    return search_term_ != element.toLower();
   }
+  using SearchTermComparator::Matches;
 
  private:
   QString search_term_;
@@ -65,8 +161,9 @@ class LexicalGtComparator : public SearchTermComparator {
  public:
   explicit LexicalGtComparator(const QString& value) : search_term_(value) {}
   virtual bool Matches(const QString& element) const {
-    return element > search_term_;
+    return element.toLower() > search_term_;
   }
+  using SearchTermComparator::Matches;
 
  private:
   QString search_term_;
@@ -76,8 +173,9 @@ class LexicalGeComparator : public SearchTermComparator {
  public:
   explicit LexicalGeComparator(const QString& value) : search_term_(value) {}
   virtual bool Matches(const QString& element) const {
-    return element >= search_term_;
+    return element.toLower() >= search_term_;
   }
+  using SearchTermComparator::Matches;
 
  private:
   QString search_term_;
@@ -87,8 +185,9 @@ class LexicalLtComparator : public SearchTermComparator {
  public:
   explicit LexicalLtComparator(const QString& value) : search_term_(value) {}
   virtual bool Matches(const QString& element) const {
-    return element < search_term_;
+    return element.toLower() < search_term_;
   }
+  using SearchTermComparator::Matches;
 
  private:
   QString search_term_;
@@ -98,19 +197,37 @@ class LexicalLeComparator : public SearchTermComparator {
  public:
   explicit LexicalLeComparator(const QString& value) : search_term_(value) {}
   virtual bool Matches(const QString& element) const {
-    return element <= search_term_;
+    return element.toLower() <= search_term_;
   }
+  using SearchTermComparator::Matches;
 
  private:
   QString search_term_;
 };
 
+class IntEqComparator : public SearchTermComparator {
+ public:
+  explicit IntEqComparator(int value) : search_term_(value) {}
+  virtual bool Matches(const QString& element) const {
+    return element == QString::number(search_term_);
+  }
+  virtual bool Matches(qint64 element) const {
+    return element == search_term_;
+  }
+
+ private:
+  int search_term_;
+};
+
 class GtComparator : public SearchTermComparator {
  public:
   explicit GtComparator(int value) : search_term_(value) {}
   virtual bool Matches(const QString& element) const {
     return element.toInt() > search_term_;
   }
+  virtual bool Matches(qint64 element) const {
+    return element > search_term_;
+  }
 
  private:
   int search_term_;
@@ -122,6 +239,9 @@ class GeComparator : public SearchTermComparator {
   virtual bool Matches(const QString& element) const {
     return element.toInt() >= search_term_;
   }
+  virtual bool Matches(qint64 element) const {
+    return element >= search_term_;
+  }
 
  private:
   int search_term_;
@@ -133,6 +253,9 @@ class LtComparator : public SearchTermComparator {
   virtual bool Matches(const QString& element) const {
     return element.toInt() < search_term_;
   }
+  virtual bool Matches(qint64 element) const {
+    return element < search_term_;
+  }
 
  private:
   int search_term_;
@@ -144,55 +267,32 @@ class LeComparator : public SearchTermComparator {
   virtual bool Matches(const QString& element) const {
     return element.toInt() <= search_term_;
   }
-
- private:
-  int search_term_;
-};
-
-// The length field of the playlist (entries) contains a
-// song's running time in nano seconds. However, We don't
-// really care about nano seconds, just seconds. Thus, with
-// this decorator we drop the last 9 digits, if that many
-// are present.
-class DropTailComparatorDecorator : public SearchTermComparator {
- public:
-  explicit DropTailComparatorDecorator(SearchTermComparator* cmp) : cmp_(cmp) {}
-
-  virtual bool Matches(const QString& element) const {
-    if (element.length() > 9)
-      return cmp_->Matches(element.left(element.length() - 9));
-    else
-      return cmp_->Matches(element);
-  }
-
- private:
-  QScopedPointer<SearchTermComparator> cmp_;
-};
-
-class RatingComparatorDecorator : public SearchTermComparator {
- public:
-  explicit RatingComparatorDecorator(SearchTermComparator* cmp) : cmp_(cmp) {}
-  virtual bool Matches(const QString& element) const {
-    return cmp_->Matches(
-        QString::number(static_cast<int>(element.toDouble() * 10.0 + 0.5)));
+  virtual bool Matches(qint64 element) const {
+    return element <= search_term_;
   }
 
  private:
-  QScopedPointer<SearchTermComparator> cmp_;
+  int search_term_;
 };
 
 // filter that applies a SearchTermComparator to all fields of a playlist entry
 class FilterTerm : public FilterTree {
  public:
-  explicit FilterTerm(SearchTermComparator* comparator,
-                      const QList<int>& columns)
-      : cmp_(comparator), columns_(columns) {}
+  // If text_only is set the comparator can't match anything a number is
+  // formatted as, so the numerical columns are skipped.
+  FilterTerm(SearchTermComparator* comparator, const QList<int>& columns,
+             const QSet<int>& numerical_columns, bool text_only)
+      : cmp_(comparator) {
+    for (int column : columns) {
+      if (!text_only || !numerical_columns.contains(column)) {
+        columns_ << column;
+      }
+    }
+  }
 
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
+  virtual bool accept(const Song& song) const {
     for (int i : columns_) {
-      QModelIndex idx(model->index(row, i, parent));
-      if (cmp_->Matches(idx.data().toString().toLower())) return true;
+      if (cmp_->Matches(ColumnText(i, song))) return true;
     }
     return false;
   }
@@ -207,18 +307,18 @@ class FilterTerm : public FilterTree {
 // playlist entry
 class FilterColumnTerm : public FilterTree {
  public:
-  FilterColumnTerm(int column, SearchTermComparator* comparator)
-      : col(column), cmp_(comparator) {}
+  FilterColumnTerm(int column, bool numerical, SearchTermComparator* comparator)
+      : col(column), numerical_(numerical), cmp_(comparator) {}
 
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
-    QModelIndex idx(model->index(row, col, parent));
-    return cmp_->Matches(idx.data().toString().toLower());
+  virtual bool accept(const Song& song) const {
+    if (numerical_) return cmp_->Matches(ColumnNumber(col, song));
+    return cmp_->Matches(ColumnText(col, song));
   }
   virtual FilterType type() { return Column; }
 
  private:
   int col;
+  bool numerical_;
   QScopedPointer<SearchTermComparator> cmp_;
 };
 
@@ -226,10 +326,7 @@ class NotFilter : public FilterTree {
  public:
   explicit NotFilter(const FilterTree* inv) : child_(inv) {}
 
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
-    return !child_->accept(row, parent, model);
-  }
+  virtual bool accept(const Song& song) const { return !child_->accept(song); }
   virtual FilterType type() { return Not; }
 
  private:
@@ -240,10 +337,9 @@ class OrFilter : public FilterTree {
  public:
   ~OrFilter() { qDeleteAll(children_); }
   virtual void add(FilterTree* child) { children_.append(child); }
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
+  virtual bool accept(const Song& song) const {
     for (FilterTree* child : children_) {
-      if (child->accept(row, parent, model)) return true;
+      if (child->accept(song)) return true;
     }
     return false;
   }
@@ -257,10 +353,9 @@ class AndFilter : public FilterTree {
  public:
   virtual ~AndFilter() { qDeleteAll(children_); }
   virtual void add(FilterTree* child) { children_.append(child); }
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
+  virtual bool accept(const Song& song) const {
     for (FilterTree* child : children_) {
-      if (!child->accept(row, parent, model)) return false;
+      if (!child->accept(song)) return false;
     }
     return true;
   }
@@ -449,15 +544,17 @@ FilterTree* FilterParser::createSearchTermTreeNode(
   if (search.isEmpty() && prefix != "=") {
     return new NopFilter;
   }
+  const bool numerical_column = !col.isEmpty() && columns_.contains(col) &&
+                                numerical_columns_.contains(columns_[col]);
+
   // here comes a mess :/
   // well, not that much of a mess, but so many options -_-
   SearchTermComparator* cmp = nullptr;
   if (prefix == "!=" || prefix == "<>") {
     cmp = new NeComparator(search);
-  } else if (!col.isEmpty() && columns_.contains(col) &&
-             numerical_columns_.contains(columns_[col])) {
+  } else if (numerical_column) {
     // the length column contains the time in seconds (nano seconds, actually -
-    //  the "nano" part is handled by the DropTailComparatorDecorator,  though).
+    //  the "nano" part is handled by ColumnNumber(),  though).
     int search_value;
     if (columns_[col] == Playlist::Column_Length) {
       search_value = parseTime(search);
@@ -476,8 +573,8 @@ FilterTree* FilterParser::createSearchTermTreeNode(
     } else if (prefix == "<=") {
       cmp = new LeComparator(search_value);
     } else {
-      // convert back because for time/rating
-      cmp = new EqComparator(QString::number(search_value));
+      // compare the numbers because of time/rating
+      cmp = new IntEqComparator(search_value);
     }
   } else {
     if (prefix == "=") {
@@ -495,14 +592,21 @@ FilterTree* FilterParser::createSearchTermTreeNode(
     }
   }
   if (columns_.contains(col)) {
-    if (columns_[col] == Playlist::Column_Length) {
-      cmp = new DropTailComparatorDecorator(cmp);
-    } else if (columns_[col] == Playlist::Column_Rating) {
-      cmp = new RatingComparatorDecorator(cmp);
-    }
-    return new FilterColumnTerm(columns_[col], cmp);
+    return new FilterColumnTerm(columns_[col], numerical_column, cmp);
   } else {
-    return new FilterTerm(cmp, columns_.values());
+    // A formatted number only contains digits and these characters, so
+    // containment or equality tests with anything else can only match text.
+    bool text_only = false;
+    if (prefix.isEmpty() || prefix == "=") {
+      for (const QChar& c : search) {
+        if (!c.isDigit() && !QString(".-+einfa").contains(c)) {
+          text_only = true;
+          break;
+        }
+      }
+    }
+    return new FilterTerm(cmp, columns_.values(), numerical_columns_,
+                          text_only);
   }
 }
 
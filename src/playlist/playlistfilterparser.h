@@ -19,18 +19,17 @@
 #define PLAYLISTFILTERPARSER_H
 
 #include <QMap>
-#include <QModelIndex>
 #include <QSet>
 #include <QString>
 
-class QAbstractItemModel;
+class Song;
 
-// structure for filter parse tree
+// structure for filter parse tree.  Leaves read the song's fields directly
+// rather than going through the playlist model.
 class FilterTree {
  public:
   virtual ~FilterTree() {}
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const = 0;
+  virtual bool accept(const Song& song) const = 0;
   enum FilterType { Nop = 0, Or, And, Not, Column, Term };
   virtual FilterType type() = 0;
 };
@@ -38,10 +37,7 @@ class FilterTree {
 // trivial filter that accepts *anything*
 class NopFilter : public FilterTree {
  public:
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
-    return true;
-  }
+  virtual bool accept(const Song& song) const { return true; }
   virtual FilterType type() { return Nop; }
 };
 
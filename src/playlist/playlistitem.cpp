@@ -68,9 +68,28 @@ void PlaylistItem::BindToQuery(QSqlQuery* query) const {
 void PlaylistItem::SetTemporaryMetadata(const Song& metadata) {
   temp_metadata_ = metadata;
   temp_metadata_.set_filetype(Song::Type_Stream);
+  ClearSortKeys();
 }
 
-void PlaylistItem::ClearTemporaryMetadata() { temp_metadata_ = Song(); }
+void PlaylistItem::ClearTemporaryMetadata() {
+  temp_metadata_ = Song();
+  ClearSortKeys();
+}
+
+bool PlaylistItem::SortKey(int column, const QString& text,
+                           QByteArray* key) const {
+  QMap<int, CachedSortKey>::const_iterator it = sort_keys_.constFind(column);
+  if (it == sort_keys_.constEnd() || it->text_ != text) return false;
+  *key = it->key_;
+  return true;
+}
+
+void PlaylistItem::SetSortKey(int column, const QString& text,
+                              const QByteArray& key) {
+  CachedSortKey& cached = sort_keys_[column];
+  cached.text_ = text;
+  cached.key_ = key;
+}
 
 static void ReloadPlaylistItem(PlaylistItemPtr item) { item->Reload(); }
 
@@ -20,6 +20,7 @@
 
 #include <memory>
 
+#include <QByteArray>
 #include <QMap>
 #include <QMetaType>
 #include <QStandardItem>
@@ -71,6 +72,13 @@ class PlaylistItem : public std::enable_shared_from_this<PlaylistItem> {
   void ClearTemporaryMetadata();
   bool HasTemporaryMetadata() const { return temp_metadata_.is_valid(); }
 
+  // Collation keys used by Playlist::sort(), cached per column.  A key is
+  // only returned if it was made from the same text, so a stale one is never
+  // used even if the metadata changes without ClearSortKeys() being called.
+  bool SortKey(int column, const QString& text, QByteArray* key) const;
+  void SetSortKey(int column, const QString& text, const QByteArray& key);
+  void ClearSortKeys() { sort_keys_.clear(); }
+
   // Background colors.
   void SetBackgroundColor(short priority, const QColor& color);
   bool HasBackgroundColor(short priority) const;
@@ -110,6 +118,13 @@ class PlaylistItem : public std::enable_shared_from_this<PlaylistItem> {
 
   QMap<short, QColor> background_colors_;
   QMap<short, QColor> foreground_colors_;
+
+ private:
+  struct CachedSortKey {
+    QString text_;
+    QByteArray key_;
+  };
+  QMap<int, CachedSortKey> sort_keys_;
 };
 typedef std::shared_ptr<PlaylistItem> PlaylistItemPtr;
 typedef QList<PlaylistItemPtr> PlaylistItemList;
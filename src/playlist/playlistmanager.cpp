@@ -81,14 +81,31 @@ void PlaylistManager::Init(LibraryBackend* library_backend,
   for (const PlaylistBackend::Playlist& p :
        playlist_backend->GetAllOpenPlaylists()) {
     AddPlaylist(p.id, p.name, p.special_type, p.ui_path, p.favorite);
+    pending_restores_ << p.id;
   }
 
+  // Load the items of the playlists that are shown and playing first, and
+  // then the others one at a time in the background.
+  restore_timer_.start();
+  if (pending_restores_.contains(current_)) RestorePlaylist(current_);
+  if (pending_restores_.contains(active_)) RestorePlaylist(active_);
+  if (restoring_.isEmpty()) RestoreNextPlaylist();
+
   // If no playlist exists then make a new one
   if (playlists_.isEmpty()) New(tr("Playlist"));
 
   emit PlaylistManagerInitialized();
 }
 
+Playlist* PlaylistManager::playlist(int id) const {
+  // Whoever asked for the playlist might change it, and saving it before its
+  // items have been loaded would delete them.
+  if (pending_restores_.contains(id)) {
+    const_cast<PlaylistManager*>(this)->RestorePlaylist(id);
+  }
+  return playlists_[id].p;
+}
+
 QList<Playlist*> PlaylistManager::GetAllPlaylists() const {
   QList<Playlist*> result;
 
@@ -300,6 +317,10 @@ bool PlaylistManager::Close(int id) {
   Data data = playlists_.take(id);
   emit PlaylistClosed(id);
 
+  // Don't let a playlist that was still being loaded hold up the others.
+  pending_restores_.removeAll(id);
+  if (restoring_.remove(id) && restoring_.isEmpty()) RestoreNextPlaylist();
+
   if (!data.p->is_favorite()) {
     playlist_backend_->RemovePlaylist(id);
     emit PlaylistDeleted(id);
@@ -324,6 +345,8 @@ void PlaylistManager::OneOfPlaylistsChanged() {
 
 void PlaylistManager::SetCurrentPlaylist(int id) {
   Q_ASSERT(playlists_.contains(id));
+  if (pending_restores_.contains(id)) RestorePlaylist(id);
+
   current_ = id;
   emit CurrentChanged(current());
   UpdateSummaryText();
@@ -331,6 +354,7 @@ void PlaylistManager::SetCurrentPlaylist(int id) {
 
 void PlaylistManager::SetActivePlaylist(int id) {
   Q_ASSERT(playlists_.contains(id));
+  if (pending_restores_.contains(id)) RestorePlaylist(id);
 
   // Kinda a hack: unset the current item from the old active playlist before
   // setting the new one
@@ -467,14 +491,14 @@ void PlaylistManager::InsertUrls(int id, const QList<QUrl>& urls, int pos,
                                  bool play_now, bool enqueue) {
   Q_ASSERT(playlists_.contains(id));
 
-  playlists_[id].p->InsertUrls(urls, pos, play_now, enqueue);
+  playlist(id)->InsertUrls(urls, pos, play_now, enqueue);
 }
 
 void PlaylistManager::RemoveItemsWithoutUndo(int id,
                                              const QList<int>& indices) {
   Q_ASSERT(playlists_.contains(id));
 
-  playlists_[id].p->RemoveItemsWithoutUndo(indices);
+  playlist(id)->RemoveItemsWithoutUndo(indices);
 }
 
 void PlaylistManager::InvalidateDeletedSongs() {
@@ -533,6 +557,7 @@ void PlaylistManager::Open(int id) {
   }
 
   AddPlaylist(p.id, p.name, p.special_type, p.ui_path, p.favorite);
+  RestorePlaylist(p.id);
 }
 
 void PlaylistManager::SetCurrentOrOpen(int id) {
@@ -541,3 +566,35 @@ void PlaylistManager::SetCurrentOrOpen(int id) {
 }
 
 bool PlaylistManager::IsPlaylistOpen(int id) { return playlists_.contains(id); }
+
+void PlaylistManager::RestorePlaylist(int id) {
+  pending_restores_.removeAll(id);
+  restoring_.insert(id);
+
+  Playlist* playlist = playlists_[id].p;
+  connect(playlist, SIGNAL(RestoreFinished()), SLOT(PlaylistRestored()));
+  playlist->Restore();
+}
+
+void PlaylistManager::RestoreNextPlaylist() {
+  if (!pending_restores_.isEmpty()) {
+    RestorePlaylist(pending_restores_.first());
+  } else if (restore_timer_.isValid()) {
+    qLog(Info) << "Restored all playlists in" << restore_timer_.elapsed()
+               << "ms";
+    restore_timer_.invalidate();
+  }
+}
+
+void PlaylistManager::PlaylistRestored() {
+  Playlist* playlist = qobject_cast<Playlist*>(sender());
+  if (!playlist) return;
+
+  disconnect(playlist, SIGNAL(RestoreFinished()), this,
+             SLOT(PlaylistRestored()));
+  restoring_.remove(playlist->id());
+
+  // Wait for every playlist that's loading to finish before starting the
+  // next one, so they don't compete with each other.
+  if (restoring_.isEmpty()) RestoreNextPlaylist();
+}
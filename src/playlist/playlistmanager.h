@@ -19,9 +19,11 @@
 #define PLAYLISTMANAGER_H
 
 #include <QColor>
+#include <QElapsedTimer>
 #include <QItemSelection>
 #include <QMap>
 #include <QObject>
+#include <QSet>
 #include <QSettings>
 
 #include "core/song.h"
@@ -143,7 +145,7 @@ class PlaylistManager : public PlaylistManagerInterface {
   int current_id() const { return current_; }
   int active_id() const { return active_; }
 
-  Playlist* playlist(int id) const { return playlists_[id].p; }
+  Playlist* playlist(int id) const;
   Playlist* current() const { return playlist(current_id()); }
   Playlist* active() const { return playlist(active_id()); }
 
@@ -235,12 +237,16 @@ class PlaylistManager : public PlaylistManagerInterface {
   void ItemsLoadedForSavePlaylist(QFutureWatcher<SongList>* watcher,
                                   const QString& filename,
                                   Playlist::Path path_type);
+  void PlaylistRestored();
 
  private:
   Playlist* AddPlaylist(int id, const QString& name,
                         const QString& special_type, const QString& ui_path,
                         bool favorite);
 
+  void RestorePlaylist(int id);
+  void RestoreNextPlaylist();
+
  private:
   struct Data {
     Data(Playlist* _p = nullptr, const QString& _name = QString())
@@ -262,6 +268,12 @@ class PlaylistManager : public PlaylistManagerInterface {
 
   int current_;
   int active_;
+
+  // Playlists that were open at startup but haven't been loaded yet, in tab
+  // order, and the ones being loaded now.
+  QList<int> pending_restores_;
+  QSet<int> restoring_;
+  QElapsedTimer restore_timer_;
 };
 
 #endif  // PLAYLISTMANAGER_H
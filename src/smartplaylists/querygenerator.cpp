@@ -18,15 +18,60 @@
 #include "querygenerator.h"
 #include "library/librarybackend.h"
 
+#include <cmath>
+
+#include <QMap>
 #include <QtDebug>
 
 namespace smart_playlists {
 
-QueryGenerator::QueryGenerator() : dynamic_(false), current_pos_(0) {}
+namespace {
+
+// The column a random search is weighted by, or an empty string if every
+// song is equally likely.
+QString WeightColumn(Search::SortType sort_type) {
+  switch (sort_type) {
+    case Search::Sort_RandomByRating:
+      return "rating";
+    case Search::Sort_RandomByPlayCount:
+      return "playcount";
+    default:
+      return QString();
+  }
+}
+
+// How likely a song is to be picked, given the value of its WeightColumn.
+// A five star song is five times as likely as a song with no stars, and an
+// unrated song counts as two and a half stars.  Play counts count less the
+// higher they get, so a few favourites don't crowd out everything else.
+double Weight(Search::SortType sort_type, double value) {
+  switch (sort_type) {
+    case Search::Sort_RandomByRating:
+      return 1.0 + 4.0 * (value < 0 ? 0.5 : value);
+    case Search::Sort_RandomByPlayCount:
+      return 1.0 + std::sqrt(qMax(0.0, value));
+    default:
+      return 1.0;
+  }
+}
+
+}  // namespace
+
+QueryGenerator::QueryGenerator()
+    : dynamic_(false),
+      current_pos_(0),
+      watching_library_(false),
+      candidates_valid_(false),
+      loading_candidates_(false) {}
 
 QueryGenerator::QueryGenerator(const QString& name, const Search& search,
                                bool dynamic)
-    : search_(search), dynamic_(dynamic), current_pos_(0) {
+    : search_(search),
+      dynamic_(dynamic),
+      current_pos_(0),
+      watching_library_(false),
+      candidates_valid_(false),
+      loading_candidates_(false) {
   set_name(name);
 }
 
@@ -34,12 +79,14 @@ void QueryGenerator::Load(const Search& search) {
   search_ = search;
   dynamic_ = false;
   current_pos_ = 0;
+  InvalidateCandidates();
 }
 
 void QueryGenerator::Load(const QByteArray& data) {
   QDataStream s(data);
   s >> search_;
   s >> dynamic_;
+  InvalidateCandidates();
 }
 
 QByteArray QueryGenerator::Save() const {
@@ -59,17 +106,20 @@ PlaylistItemList QueryGenerator::Generate() {
 
 PlaylistItemList QueryGenerator::GenerateMore(int count) {
   Search search_copy = search_;
-  search_copy.id_not_in_ = previous_ids_;
   if (count) {
     search_copy.limit_ = count;
   }
 
-  if (search_copy.sort_type_ != Search::Sort_Random) {
+  SongList songs;
+  if (search_copy.is_random()) {
+    songs = SampleSongs(search_copy.limit_);
+  } else {
+    search_copy.id_not_in_ = previous_ids_;
     search_copy.first_item_ = current_pos_;
     current_pos_ += search_copy.limit_;
+    songs = backend_->FindSongs(search_copy);
   }
 
-  SongList songs = backend_->FindSongs(search_copy);
   PlaylistItemList items;
   for (const Song& song : songs) {
     items << PlaylistItemPtr(PlaylistItem::NewFromSongsTable(
@@ -82,4 +132,95 @@ PlaylistItemList QueryGenerator::GenerateMore(int count) {
   return items;
 }
 
+SongList QueryGenerator::SampleSongs(int count) {
+  const QString weight_column = WeightColumn(search_.sort_type_);
+
+  QMutexLocker l(&mutex_);
+  if (!watching_library_) {
+    watching_library_ = true;
+    connect(backend_, SIGNAL(SongsDiscovered(SongList)),
+            SLOT(LibraryChanged()), Qt::DirectConnection);
+    connect(backend_, SIGNAL(SongsDeleted(SongList)), SLOT(LibraryChanged()),
+            Qt::DirectConnection);
+    connect(backend_, SIGNAL(DatabaseReset()), SLOT(LibraryChanged()),
+            Qt::DirectConnection);
+    connect(backend_, SIGNAL(SongsStatisticsChanged(SongList)),
+            SLOT(StatisticsChanged(SongList)), Qt::DirectConnection);
+    connect(backend_, SIGNAL(SongsRatingChanged(SongList)),
+            SLOT(StatisticsChanged(SongList)), Qt::DirectConnection);
+  }
+
+  // Searches like "added in the last week" match different songs as time
+  // goes by, so they can't be cached.
+  if (!candidates_valid_ || search_.is_time_dependent()) {
+    candidates_valid_ = true;
+    loading_candidates_ = true;
+    l.unlock();
+
+    QVector<double> values;
+    const QVector<int> ids =
+        backend_->FindSongIds(search_, weight_column, &values);
+
+    QVector<double> weights;
+    if (!weight_column.isEmpty()) {
+      weights.reserve(values.count());
+      for (double value : values) {
+        weights << Weight(search_.sort_type_, value);
+      }
+    }
+
+    l.relock();
+    loading_candidates_ = false;
+    sampler_.Reset(ids, weights);
+  }
+
+  const QList<int> ids = sampler_.Sample(count, previous_ids_.toSet());
+  l.unlock();
+
+  // GetSongsById doesn't return the songs in the order they were picked, and
+  // puts all the IDs in the query, so ask for a few at a time.
+  QMap<int, Song> songs_by_id;
+  for (int i = 0; i < ids.count();
+       i += LibraryBackend::kMaxBoundValuesPerQuery) {
+    for (const Song& song : backend_->GetSongsById(
+             ids.mid(i, LibraryBackend::kMaxBoundValuesPerQuery))) {
+      songs_by_id[song.id()] = song;
+    }
+  }
+
+  SongList ret;
+  for (int id : ids) {
+    if (songs_by_id.contains(id)) ret << songs_by_id[id];
+  }
+  return ret;
+}
+
+void QueryGenerator::InvalidateCandidates() {
+  QMutexLocker l(&mutex_);
+  candidates_valid_ = false;
+}
+
+void QueryGenerator::LibraryChanged() { InvalidateCandidates(); }
+
+void QueryGenerator::StatisticsChanged(const SongList& songs) {
+  QMutexLocker l(&mutex_);
+  if (!candidates_valid_) return;
+
+  // Weights that change while the candidates are being loaded might be lost,
+  // as might songs that start or stop matching the search.
+  if (loading_candidates_ || search_.uses_statistics()) {
+    candidates_valid_ = false;
+    return;
+  }
+
+  if (WeightColumn(search_.sort_type_).isEmpty()) return;
+
+  for (const Song& song : songs) {
+    const double value = search_.sort_type_ == Search::Sort_RandomByRating
+                             ? song.rating()
+                             : song.playcount();
+    sampler_.SetWeight(song.id(), Weight(search_.sort_type_, value));
+  }
+}
+
 }  // namespace
@@ -19,11 +19,16 @@
 #define QUERYPLAYLISTGENERATOR_H
 
 #include "generator.h"
+#include "randomsampler.h"
 #include "search.h"
 
+#include <QMutex>
+
 namespace smart_playlists {
 
 class QueryGenerator : public Generator {
+  Q_OBJECT
+
  public:
   QueryGenerator();
   QueryGenerator(const QString& name, const Search& search,
@@ -43,12 +48,32 @@ class QueryGenerator : public Generator {
   Search search() const { return search_; }
   int GetDynamicFuture() { return search_.limit_; }
 
+ private slots:
+  void LibraryChanged();
+  void StatisticsChanged(const SongList& songs);
+
+ private:
+  // Picks songs for a random search from the songs that match it.  Those are
+  // only loaded from the library the first time, and again after the library
+  // changes, so a dynamic playlist can be extended without sorting the whole
+  // library each time.
+  SongList SampleSongs(int count);
+  void InvalidateCandidates();
+
  private:
   Search search_;
   bool dynamic_;
 
   QList<int> previous_ids_;
   int current_pos_;
+
+  // The library emits its signals from another thread, so these are guarded
+  // by mutex_.  It's never held while the database is being read.
+  QMutex mutex_;
+  bool watching_library_;
+  bool candidates_valid_;
+  bool loading_candidates_;
+  RandomSampler sampler_;
 };
 
 }  // namespace
@@ -150,6 +150,8 @@ int QueryWizardPlugin::CreatePages(QWizard* wizard, int finish_page_id) {
   connect(sort_ui_->order, SIGNAL(currentIndexChanged(int)),
           SLOT(UpdateSortPreview()));
   connect(sort_ui_->random, SIGNAL(toggled(bool)), SLOT(UpdateSortPreview()));
+  connect(sort_ui_->random_weighting, SIGNAL(currentIndexChanged(int)),
+          SLOT(UpdateSortPreview()));
 
   // Configure the page text
   search_page_->setTitle(tr("Search terms"));
@@ -185,8 +187,19 @@ void QueryWizardPlugin::SetGenerator(GeneratorPtr g) {
   }
 
   // Sort order
-  if (search.sort_type_ == Search::Sort_Random) {
+  if (search.is_random()) {
     sort_ui_->random->setChecked(true);
+    switch (search.sort_type_) {
+      case Search::Sort_RandomByRating:
+        sort_ui_->random_weighting->setCurrentIndex(1);
+        break;
+      case Search::Sort_RandomByPlayCount:
+        sort_ui_->random_weighting->setCurrentIndex(2);
+        break;
+      default:
+        sort_ui_->random_weighting->setCurrentIndex(0);
+        break;
+    }
   } else {
     sort_ui_->field->setChecked(true);
     sort_ui_->order->setCurrentIndex(
@@ -280,7 +293,17 @@ Search QueryWizardPlugin::MakeSearch() const {
 
   // Sort order
   if (sort_ui_->random->isChecked()) {
-    ret.sort_type_ = Search::Sort_Random;
+    switch (sort_ui_->random_weighting->currentIndex()) {
+      case 1:
+        ret.sort_type_ = Search::Sort_RandomByRating;
+        break;
+      case 2:
+        ret.sort_type_ = Search::Sort_RandomByPlayCount;
+        break;
+      default:
+        ret.sort_type_ = Search::Sort_Random;
+        break;
+    }
   } else {
     const bool ascending = sort_ui_->order->currentIndex() == 0;
     ret.sort_type_ = ascending ? Search::Sort_FieldAsc : Search::Sort_FieldDesc;
@@ -0,0 +1,140 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "randomsampler.h"
+
+namespace smart_playlists {
+
+const int RandomSampler::kMaxMisses = 100;
+
+RandomSampler::RandomSampler()
+    : positive_(0), random_(std::random_device()()) {}
+
+void RandomSampler::Reset(const QVector<int>& ids,
+                          const QVector<double>& weights) {
+  Q_ASSERT(weights.isEmpty() || weights.count() == ids.count());
+
+  const int n = ids.count();
+  ids_ = ids;
+  rows_.clear();
+  rows_.reserve(n);
+  weights_.fill(1.0, n);
+  tree_.fill(0.0, n + 1);
+  positive_ = 0;
+
+  for (int row = 0; row < n; ++row) {
+    rows_[ids[row]] = row;
+    if (!weights.isEmpty()) weights_[row] = qMax(0.0, weights[row]);
+    if (weights_[row] > 0) ++positive_;
+  }
+
+  // Build the tree in linear time by passing each node's sum up to its
+  // parent.
+  for (int i = 1; i <= n; ++i) {
+    tree_[i] += weights_[i - 1];
+    const int parent = i + (i & -i);
+    if (parent <= n) tree_[parent] += tree_[i];
+  }
+}
+
+void RandomSampler::Clear() { Reset(QVector<int>()); }
+
+void RandomSampler::SetWeight(int id, double weight) {
+  QHash<int, int>::const_iterator it = rows_.constFind(id);
+  if (it == rows_.constEnd()) return;
+
+  const int row = it.value();
+  weight = qMax(0.0, weight);
+  if (weights_[row] > 0) --positive_;
+  if (weight > 0) ++positive_;
+
+  Add(row, weight - weights_[row]);
+  weights_[row] = weight;
+}
+
+QList<int> RandomSampler::Sample(int count, const QSet<int>& exclude) {
+  QList<int> ret;
+
+  // Take the excluded songs out of the tree while picking, and each song as
+  // it's picked, then put them all back afterwards.
+  QSet<int> removed_rows;
+  int available = positive_;
+  auto remove = [&](int row) {
+    if (weights_[row] > 0) --available;
+    Add(row, -weights_[row]);
+    removed_rows.insert(row);
+  };
+
+  for (int id : exclude) {
+    QHash<int, int>::const_iterator it = rows_.constFind(id);
+    if (it != rows_.constEnd()) remove(it.value());
+  }
+
+  int misses = 0;
+  while (available > 0 && (count == -1 || ret.count() < count)) {
+    std::uniform_real_distribution<double> distribution(0.0, Total());
+    const int row = Find(distribution(random_));
+
+    // Rounding errors can land on a song that's already been taken out.
+    if (removed_rows.contains(row) || weights_[row] <= 0) {
+      if (++misses > kMaxMisses) break;
+      continue;
+    }
+
+    ret << ids_[row];
+    remove(row);
+  }
+
+  for (int row : removed_rows) {
+    Add(row, weights_[row]);
+  }
+  return ret;
+}
+
+void RandomSampler::Add(int row, double delta) {
+  const int n = ids_.count();
+  for (int i = row + 1; i <= n; i += i & -i) {
+    tree_[i] += delta;
+  }
+}
+
+double RandomSampler::Total() const {
+  double ret = 0.0;
+  for (int i = ids_.count(); i > 0; i -= i & -i) {
+    ret += tree_[i];
+  }
+  return ret;
+}
+
+int RandomSampler::Find(double value) const {
+  const int n = ids_.count();
+
+  int step = 1;
+  while (step * 2 <= n) step *= 2;
+
+  // Walk down the tree, skipping over every node whose weight is all below
+  // value.  pos ends up as the number of rows before the one we want.
+  int pos = 0;
+  for (; step > 0; step /= 2) {
+    if (pos + step <= n && tree_[pos + step] <= value) {
+      pos += step;
+      value -= tree_[pos];
+    }
+  }
+  return qMin(pos, n - 1);
+}
+
+}  // namespace
@@ -0,0 +1,81 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SMARTPLAYLISTRANDOMSAMPLER_H
+#define SMARTPLAYLISTRANDOMSAMPLER_H
+
+#include <random>
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QVector>
+
+namespace smart_playlists {
+
+// Picks songs at random from a fixed set of candidates, optionally giving
+// some songs a better chance than others.  The weights are kept in a Fenwick
+// tree, so picking a song or changing its weight takes O(log n) time however
+// many candidates there are.
+class RandomSampler {
+ public:
+  RandomSampler();
+
+  // Replaces the candidates.  If weights is empty every song is equally
+  // likely to be picked, otherwise it has one weight for each ID.
+  void Reset(const QVector<int>& ids,
+             const QVector<double>& weights = QVector<double>());
+  void Clear();
+
+  int count() const { return ids_.count(); }
+  bool contains(int id) const { return rows_.contains(id); }
+
+  // Changes how likely a song is to be picked.  Does nothing if the song isn't
+  // a candidate.
+  void SetWeight(int id, double weight);
+
+  // Returns up to count different songs picked at random, none of which are
+  // in exclude.  If count is -1 every song that isn't excluded is returned, in
+  // a random order.
+  QList<int> Sample(int count, const QSet<int>& exclude);
+
+ private:
+  // How many times Sample() will try again if it picks a song it's already
+  // taken out, before giving up.
+  static const int kMaxMisses;
+
+  void Add(int row, double delta);
+  double Total() const;
+  // Returns the row whose share of the total weight contains value.
+  int Find(double value) const;
+
+  QVector<int> ids_;
+  QHash<int, int> rows_;
+
+  // The weight of each row, and the Fenwick tree of their sums.  tree_[i]
+  // holds the sum of the weights of the rows in (i - (i & -i), i], so it has
+  // one more entry than there are rows.
+  QVector<double> weights_;
+  QVector<double> tree_;
+  // The number of rows with a weight above zero.
+  int positive_;
+
+  std::mt19937 random_;
+};
+
+}  // namespace
+
+#endif  // SMARTPLAYLISTRANDOMSAMPLER_H
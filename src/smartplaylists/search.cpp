@@ -43,10 +43,7 @@ void Search::Reset() {
   first_item_ = 0;
 }
 
-QString Search::ToSql(const QString& songs_table) const {
-  QString sql = "SELECT ROWID," + Song::kColumnSpec + " FROM " + songs_table;
-
-  // Add search terms
+QStringList Search::TermWhereClauses() const {
   QStringList where_clauses;
   QStringList term_where_clauses;
   for (const SearchTerm& term : terms_) {
@@ -58,6 +55,20 @@ QString Search::ToSql(const QString& songs_table) const {
     where_clauses << "(" + term_where_clauses.join(boolean_op) + ")";
   }
 
+  // We never want to include songs that have been deleted, but are still kept
+  // in the database in case the directory containing them has just been
+  // unmounted.
+  where_clauses << "unavailable = 0";
+
+  return where_clauses;
+}
+
+QString Search::ToSql(const QString& songs_table) const {
+  QString sql = "SELECT ROWID," + Song::kColumnSpec + " FROM " + songs_table;
+
+  // Add search terms
+  QStringList where_clauses = TermWhereClauses();
+
   // Restrict the IDs of songs if we're making a dynamic playlist
   if (!id_not_in_.isEmpty()) {
     QString numbers;
@@ -67,17 +78,13 @@ QString Search::ToSql(const QString& songs_table) const {
     where_clauses << "(ROWID NOT IN (" + numbers + "))";
   }
 
-  // We never want to include songs that have been deleted, but are still kept
-  // in the database in case the directory containing them has just been
-  // unmounted.
-  where_clauses << "unavailable = 0";
-
   if (!where_clauses.isEmpty()) {
     sql += " WHERE " + where_clauses.join(" AND ");
   }
 
-  // Add sort by
-  if (sort_type_ == Sort_Random) {
+  // Add sort by.  SQLite can't weight the random order, so that's left to
+  // QueryGenerator.
+  if (is_random()) {
     sql += " ORDER BY random()";
   } else {
     sql += " ORDER BY " + SearchTerm::FieldColumnName(sort_field_) +
@@ -95,11 +102,59 @@ QString Search::ToSql(const QString& songs_table) const {
   return sql;
 }
 
+QString Search::ToCandidatesSql(const QString& songs_table,
+                                const QString& columns) const {
+  QString sql = "SELECT " + columns + " FROM " + songs_table + " WHERE " +
+                TermWhereClauses().join(" AND ");
+  qLog(Debug) << sql;
+
+  return sql;
+}
+
 bool Search::is_valid() const {
   if (search_type_ == Type_All) return true;
   return !terms_.isEmpty();
 }
 
+bool Search::is_random() const {
+  return sort_type_ == Sort_Random || sort_type_ == Sort_RandomByRating ||
+         sort_type_ == Sort_RandomByPlayCount;
+}
+
+bool Search::uses_statistics() const {
+  if (search_type_ == Type_All) return false;
+
+  for (const SearchTerm& term : terms_) {
+    switch (term.field_) {
+      case SearchTerm::Field_Rating:
+      case SearchTerm::Field_Score:
+      case SearchTerm::Field_PlayCount:
+      case SearchTerm::Field_SkipCount:
+      case SearchTerm::Field_LastPlayed:
+        return true;
+      default:
+        break;
+    }
+  }
+  return false;
+}
+
+bool Search::is_time_dependent() const {
+  if (search_type_ == Type_All) return false;
+
+  for (const SearchTerm& term : terms_) {
+    switch (term.operator_) {
+      case SearchTerm::Op_NumericDate:
+      case SearchTerm::Op_NumericDateNot:
+      case SearchTerm::Op_RelativeDate:
+        return true;
+      default:
+        break;
+    }
+  }
+  return false;
+}
+
 bool Search::operator==(const Search& other) const {
   return search_type_ == other.search_type_ && terms_ == other.terms_ &&
          sort_type_ == other.sort_type_ && sort_field_ == other.sort_field_ &&
@@ -21,6 +21,8 @@
 #include "generator.h"
 #include "searchterm.h"
 
+#include <QStringList>
+
 namespace smart_playlists {
 
 class Search {
@@ -31,13 +33,27 @@ class Search {
   enum SearchType { Type_And = 0, Type_Or, Type_All, };
 
   // These values are persisted, so add to the end of the enum only
-  enum SortType { Sort_Random = 0, Sort_FieldAsc, Sort_FieldDesc, };
+  enum SortType {
+    Sort_Random = 0,
+    Sort_FieldAsc,
+    Sort_FieldDesc,
+
+    // Random, but songs with a higher rating or play count are more likely
+    // to be picked.
+    Sort_RandomByRating,
+    Sort_RandomByPlayCount,
+  };
 
   Search();
   Search(SearchType type, TermList terms, SortType sort_type,
          SearchTerm::Field sort_field, int limit = Generator::kDefaultLimit);
 
   bool is_valid() const;
+  bool is_random() const;
+  // True if the songs that match can change when songs' statistics change,
+  // or as time passes, without the library itself changing.
+  bool uses_statistics() const;
+  bool is_time_dependent() const;
   bool operator==(const Search& other) const;
   bool operator!=(const Search& other) const { return !(*this == other); }
 
@@ -53,6 +69,13 @@ class Search {
 
   void Reset();
   QString ToSql(const QString& songs_table) const;
+  // Selects the given columns of every song that matches, ignoring the sort
+  // order, limit and id_not_in_.
+  QString ToCandidatesSql(const QString& songs_table,
+                          const QString& columns) const;
+
+ private:
+  QStringList TermWhereClauses() const;
 };
 
 }  // namespace
@@ -28,7 +28,9 @@
 
 #include "core/logging.h"
 #include "core/signalchecker.h"
+#include "core/timeconstants.h"
 #include "core/utilities.h"
+#include "transcoder/transcoderscheduler.h"
 
 using std::shared_ptr;
 
@@ -196,7 +198,8 @@ void Transcoder::JobState::PostFinished(bool success) {
 
 Transcoder::Transcoder(QObject* parent, const QString& settings_postfix)
     : QObject(parent),
-      max_threads_(QThread::idealThreadCount()),
+      max_threads_(TranscoderScheduler::Instance()->max_jobs()),
+      priority_(Priority_Batch),
       settings_postfix_(settings_postfix) {
   if (JobFinishedEvent::sEventType == -1)
     JobFinishedEvent::sEventType = QEvent::registerEventType();
@@ -213,6 +216,8 @@ Transcoder::Transcoder(QObject* parent, const QString& settings_postfix)
   }
 }
 
+Transcoder::~Transcoder() { Cancel(); }
+
 QList<TranscoderPreset> Transcoder::GetAllPresets() {
   QList<TranscoderPreset> ret;
   ret << PresetForFileType(Song::Type_Flac);
@@ -301,6 +306,7 @@ void Transcoder::AddJob(const QString& input, const TranscoderPreset& preset,
     }
   }
 
+  job.queued_timer.start();
   queued_jobs_ << job;
 }
 
@@ -309,6 +315,7 @@ void Transcoder::AddTemporaryJob(const QString &input, const TranscoderPreset &p
   job.input = input;
   job.output = Utilities::GetTemporaryFileName();
   job.preset = preset;
+  job.queued_timer.start();
 
   queued_jobs_ << job;
 }
@@ -324,6 +331,17 @@ void Transcoder::Start() {
   }
 }
 
+void Transcoder::StartQueuedJobs() {
+  // Don't emit AllJobsComplete() again if our jobs have already finished.
+  while (!queued_jobs_.isEmpty()) {
+    StartJobStatus status = MaybeStartNextJob();
+    if (status == AllThreadsBusy || status == NoMoreJobs) break;
+  }
+
+  // The scheduler might have handed us more threads than we could use.
+  TranscoderScheduler::Instance()->ReleaseUnused(this);
+}
+
 Transcoder::StartJobStatus Transcoder::MaybeStartNextJob() {
   if (current_jobs_.count() >= max_threads()) return AllThreadsBusy;
   if (queued_jobs_.isEmpty()) {
@@ -334,11 +352,18 @@ Transcoder::StartJobStatus Transcoder::MaybeStartNextJob() {
     return NoMoreJobs;
   }
 
+  // Other transcoders share the same threads.  If they're all busy the
+  // scheduler calls StartQueuedJobs() when one is free.
+  if (!TranscoderScheduler::Instance()->Acquire(this, priority_)) {
+    return AllThreadsBusy;
+  }
+
   Job job = queued_jobs_.takeFirst();
   if (StartJob(job)) {
     return StartedSuccessfully;
   }
 
+  TranscoderScheduler::Instance()->Release();
   emit JobComplete(job.input, job.output, false);
   return FailedToStart;
 }
@@ -393,6 +418,7 @@ void Transcoder::JobState::ReportError(GstMessage* msg) {
 
 bool Transcoder::StartJob(const Job& job) {
   shared_ptr<JobState> state(new JobState(job, this));
+  state->queue_latency_msec_ = job.queued_timer.elapsed();
 
   emit LogLine(tr("Starting %1").arg(QDir::toNativeSeparators(job.input)));
 
@@ -448,6 +474,7 @@ bool Transcoder::StartJob(const Job& job) {
                            BusCallbackSync, state.get(), nullptr);
 
   // Start the pipeline
+  state->run_timer_.start();
   gst_element_set_state(state->pipeline_, GST_STATE_PLAYING);
 
   // GStreamer now transcodes in another thread, so we can return now and do
@@ -484,6 +511,10 @@ bool Transcoder::event(QEvent* e) {
     QString input = (*it)->job_.input;
     QString output = (*it)->job_.output;
 
+    if (finished_event->success_) {
+      LogJobStatistics(it->get());
+    }
+
     // Remove event handlers from the gstreamer pipeline so they don't get
     // called after the pipeline is shutting down
     gst_bus_set_sync_handler(
@@ -492,6 +523,7 @@ bool Transcoder::event(QEvent* e) {
 
     // Remove it from the list - this will also destroy the GStreamer pipeline
     current_jobs_.erase(it);
+    TranscoderScheduler::Instance()->Release();
 
     // Emit the finished signal
     emit JobComplete(input, output, finished_event->success_);
@@ -505,9 +537,25 @@ bool Transcoder::event(QEvent* e) {
   return QObject::event(e);
 }
 
+void Transcoder::LogJobStatistics(const JobState* state) {
+  const qint64 msec = state->run_timer_.elapsed();
+
+  gint64 duration = 0;
+  gst_element_query_duration(state->pipeline_, GST_FORMAT_TIME, &duration);
+
+  // How many seconds of audio were transcoded per second.
+  const double realtime_factor =
+      double(duration) / kNsecPerMsec / qMax(msec, qint64(1));
+
+  qLog(Info) << "Transcoded" << state->job_.input << "in" << msec
+             << "ms after waiting" << state->queue_latency_msec_
+             << "ms in the queue," << realtime_factor << "x realtime";
+}
+
 void Transcoder::Cancel() {
   // Remove all pending jobs
   queued_jobs_.clear();
+  TranscoderScheduler::Instance()->Remove(this);
 
   // Stop the running ones
   JobStateList::iterator it = current_jobs_.begin();
@@ -529,6 +577,7 @@ void Transcoder::Cancel() {
 
     // Remove the job, this destroys the GStreamer pipeline too
     it = current_jobs_.erase(it);
+    TranscoderScheduler::Instance()->Release();
   }
 }
 
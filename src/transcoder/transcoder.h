@@ -22,6 +22,7 @@
 
 #include <gst/gst.h>
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QStringList>
 #include <QEvent>
@@ -47,7 +48,16 @@ class Transcoder : public QObject {
   Q_OBJECT
 
  public:
+  // Jobs from interactive transcoders get free threads before batch ones.
+  enum Priority {
+    Priority_Interactive = 0,
+    Priority_Batch,
+
+    PriorityCount
+  };
+
   Transcoder(QObject* parent = nullptr, const QString& settings_postfix = "");
+  ~Transcoder();
 
   static TranscoderPreset PresetForFileType(Song::FileType type);
   static QList<TranscoderPreset> GetAllPresets();
@@ -56,6 +66,9 @@ class Transcoder : public QObject {
   int max_threads() const { return max_threads_; }
   void set_max_threads(int count) { max_threads_ = count; }
 
+  Priority priority() const { return priority_; }
+  void set_priority(Priority priority) { priority_ = priority; }
+
   void AddJob(const QString& input, const TranscoderPreset& preset,
               const QString& output = QString());
   void AddTemporaryJob(const QString& input, const TranscoderPreset& preset);
@@ -75,12 +88,19 @@ signals:
  protected:
   bool event(QEvent* e);
 
+ private slots:
+  // Called by the TranscoderScheduler when a thread is free.
+  void StartQueuedJobs();
+
  private:
   // The description of a file to transcode - lives in the main thread.
   struct Job {
     QString input;
     QString output;
     TranscoderPreset preset;
+
+    // Started when the job is queued.
+    QElapsedTimer queued_timer;
   };
 
   // State held by a job and shared across gstreamer callbacks - lives in the
@@ -90,7 +110,8 @@ signals:
         : job_(job),
           parent_(parent),
           pipeline_(nullptr),
-          convert_element_(nullptr) {}
+          convert_element_(nullptr),
+          queue_latency_msec_(0) {}
     ~JobState();
 
     void PostFinished(bool success);
@@ -100,6 +121,9 @@ signals:
     Transcoder* parent_;
     GstElement* pipeline_;
     GstElement* convert_element_;
+
+    qint64 queue_latency_msec_;
+    QElapsedTimer run_timer_;
   };
 
   // Event passed from a GStreamer callback to the Transcoder when a job
@@ -122,6 +146,7 @@ signals:
 
   StartJobStatus MaybeStartNextJob();
   bool StartJob(const Job& job);
+  void LogJobStatistics(const JobState* state);
 
   GstElement* CreateElement(const QString& factory_name,
                             GstElement* bin = nullptr,
@@ -139,6 +164,7 @@ signals:
   typedef QList<std::shared_ptr<JobState>> JobStateList;
 
   int max_threads_;
+  Priority priority_;
   QList<Job> queued_jobs_;
   JobStateList current_jobs_;
   QString settings_postfix_;
@@ -0,0 +1,92 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "transcoderscheduler.h"
+
+#include <QThread>
+
+#include "core/logging.h"
+
+TranscoderScheduler* TranscoderScheduler::Instance() {
+  static TranscoderScheduler sInstance;
+  return &sInstance;
+}
+
+TranscoderScheduler::TranscoderScheduler()
+    : max_jobs_(qMax(1, QThread::idealThreadCount())), running_jobs_(0) {
+  qLog(Debug) << "Running up to" << max_jobs_ << "transcode jobs at once";
+}
+
+bool TranscoderScheduler::Acquire(Transcoder* transcoder,
+                                  Transcoder::Priority priority) {
+  QMutexLocker l(&mutex_);
+
+  QMap<Transcoder*, int>::iterator it = granted_.find(transcoder);
+  if (it != granted_.end()) {
+    if (--it.value() == 0) granted_.erase(it);
+    return true;
+  }
+
+  if (running_jobs_ < max_jobs_) {
+    running_jobs_++;
+    return true;
+  }
+
+  if (!waiting_[priority].contains(transcoder)) {
+    waiting_[priority] << transcoder;
+  }
+  return false;
+}
+
+void TranscoderScheduler::Release() {
+  QMutexLocker l(&mutex_);
+  ReleaseLocked();
+}
+
+void TranscoderScheduler::ReleaseUnused(Transcoder* transcoder) {
+  QMutexLocker l(&mutex_);
+
+  for (int i = granted_.take(transcoder); i > 0; --i) {
+    ReleaseLocked();
+  }
+}
+
+void TranscoderScheduler::Remove(Transcoder* transcoder) {
+  QMutexLocker l(&mutex_);
+
+  for (int i = 0; i < Transcoder::PriorityCount; ++i) {
+    waiting_[i].removeAll(transcoder);
+  }
+  for (int i = granted_.take(transcoder); i > 0; --i) {
+    ReleaseLocked();
+  }
+}
+
+void TranscoderScheduler::ReleaseLocked() {
+  for (int i = 0; i < Transcoder::PriorityCount; ++i) {
+    if (waiting_[i].isEmpty()) continue;
+
+    // Hand the slot straight to the waiting transcoder, so nothing else can
+    // take it before the transcoder's thread gets round to starting a job.
+    Transcoder* transcoder = waiting_[i].takeFirst();
+    granted_[transcoder]++;
+    QMetaObject::invokeMethod(transcoder, "StartQueuedJobs",
+                              Qt::QueuedConnection);
+    return;
+  }
+
+  running_jobs_--;
+}
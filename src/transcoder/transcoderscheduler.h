@@ -0,0 +1,66 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRANSCODERSCHEDULER_H
+#define TRANSCODERSCHEDULER_H
+
+#include <QList>
+#include <QMap>
+#include <QMutex>
+
+#include "transcoder.h"
+
+// Shares a fixed number of job slots, one per core, between every Transcoder
+// in the process - Organise, the Ripper, the transcode dialog and the network
+// remote all feed jobs into their own Transcoder.
+//
+// A Transcoder calls Acquire() before starting each job and Release() when it
+// finishes.  If no slot is free it's put on a waiting list, and when a slot
+// comes free it's handed to the first waiting Transcoder with the highest
+// priority, whose StartQueuedJobs() slot is then called from its own thread.
+// Transcoders with the same priority take turns.
+class TranscoderScheduler {
+ public:
+  static TranscoderScheduler* Instance();
+
+  int max_jobs() const { return max_jobs_; }
+
+  // Returns true if the transcoder can start a job now.
+  bool Acquire(Transcoder* transcoder, Transcoder::Priority priority);
+  // Called when a job finishes or fails to start.
+  void Release();
+  // Gives back any slots that were handed to the transcoder but not used.
+  void ReleaseUnused(Transcoder* transcoder);
+  // Forgets about the transcoder, eg. when it's cancelled or destroyed.
+  void Remove(Transcoder* transcoder);
+
+ private:
+  TranscoderScheduler();
+
+  // The caller must hold mutex_.
+  void ReleaseLocked();
+
+  QMutex mutex_;
+  const int max_jobs_;
+  int running_jobs_;
+
+  // Indexed by Transcoder::Priority.
+  QList<Transcoder*> waiting_[Transcoder::PriorityCount];
+  // Slots that have been handed to a Transcoder that hasn't started a job yet.
+  QMap<Transcoder*, int> granted_;
+};
+
+#endif  // TRANSCODERSCHEDULER_H
@@ -47,6 +47,7 @@
 #include <QMessageBox>
 #include <QPainter>
 #include <QProgressBar>
+#include <QScrollBar>
 #include <QSettings>
 #include <QShortcut>
 #include <QTimer>
@@ -178,6 +179,8 @@ void AlbumCoverManager::Init() {
           SLOT(ArtistChanged(QListWidgetItem*)));
   connect(ui_->filter, SIGNAL(textChanged(QString)), SLOT(UpdateFilter()));
   connect(filter_group, SIGNAL(triggered(QAction*)), SLOT(UpdateFilter()));
+  connect(ui_->albums->verticalScrollBar(), SIGNAL(valueChanged(int)),
+          SLOT(PrioritiseVisibleCovers()));
   connect(ui_->view, SIGNAL(clicked()), ui_->view, SLOT(showMenu()));
   connect(ui_->fetch, SIGNAL(clicked()), SLOT(FetchAlbumCovers()));
   connect(ui_->export_covers, SIGNAL(clicked()), SLOT(ExportCovers()));
@@ -346,6 +349,9 @@ void AlbumCoverManager::ArtistChanged(QListWidgetItem* current) {
   }
 
   UpdateFilter();
+
+  // Wait for the view to lay out the new items first.
+  QTimer::singleShot(0, this, SLOT(PrioritiseVisibleCovers()));
 }
 
 void AlbumCoverManager::CoverImageLoaded(quint64 id, const QImage& image) {
@@ -391,6 +397,25 @@ void AlbumCoverManager::UpdateFilter() {
   ui_->without_cover->setText(QString::number(without_cover));
 }
 
+void AlbumCoverManager::PrioritiseVisibleCovers() {
+  const QRect visible_rect = ui_->albums->viewport()->rect();
+
+  QList<quint64> ids;
+  for (QMap<quint64, QListWidgetItem*>::const_iterator it =
+           cover_loading_tasks_.constBegin();
+       it != cover_loading_tasks_.constEnd(); ++it) {
+    QListWidgetItem* item = it.value();
+    if (!item->isHidden() &&
+        ui_->albums->visualItemRect(item).intersects(visible_rect)) {
+      ids << it.key();
+    }
+  }
+
+  if (!ids.isEmpty()) {
+    app_->album_cover_loader()->PrioritiseTasks(ids);
+  }
+}
+
 bool AlbumCoverManager::ShouldHide(const QListWidgetItem& item,
                                    const QString& filter,
                                    HideCovers hide) const {
@@ -80,6 +80,7 @@ signals:
   void ArtistChanged(QListWidgetItem* current);
   void CoverImageLoaded(quint64 id, const QImage& image);
   void UpdateFilter();
+  void PrioritiseVisibleCovers();
   void FetchAlbumCovers();
   void ExportCovers();
   void AlbumCoverFetched(quint64 id, const QImage& image,
@@ -56,10 +56,12 @@ EditTagDialog::EditTagDialog(Application* app, QWidget* parent)
       album_cover_choice_controller_(new AlbumCoverChoiceController(this)),
       loading_(false),
       ignore_edits_(false),
-      tag_fetcher_(new TagFetcher(this)),
+      tag_fetcher_(new TagFetcher(app, this)),
       cover_art_id_(0),
       cover_art_is_set_(false),
       results_dialog_(new TrackSelectionDialog(this)) {
+  // The original is kept to be shown full size.
+  cover_options_.load_original_image_ = true;
   cover_options_.default_output_image_ =
       AlbumCoverLoader::ScaleAndPad(cover_options_, QImage(":nocover.png"));
 
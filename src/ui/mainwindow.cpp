@@ -31,7 +31,6 @@
 #include <QSettings>
 #include <QShortcut>
 #include <QSignalMapper>
-#include <QSortFilterProxyModel>
 #include <QStatusBar>
 #include <QtDebug>
 #include <QTimer>
@@ -80,6 +79,7 @@
 #include "library/library.h"
 #include "library/librarybackend.h"
 #include "library/librarydirectorymodel.h"
+#include "library/libraryfilterproxymodel.h"
 #include "library/libraryfilterwidget.h"
 #include "library/libraryviewcontainer.h"
 #include "musicbrainz/tagfetcher.h"
@@ -143,6 +143,7 @@
 
 #ifdef HAVE_MOODBAR
 #include "moodbar/moodbarcontroller.h"
+#include "moodbar/moodbarloader.h"
 #include "moodbar/moodbarproxystyle.h"
 #endif
 
@@ -189,7 +190,7 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
       playlist_menu_(new QMenu(this)),
       playlist_add_to_another_(nullptr),
       playlistitem_actions_separator_(nullptr),
-      library_sort_model_(new QSortFilterProxyModel(this)),
+      library_sort_model_(new LibraryFilterProxyModel(this)),
       track_position_timer_(new QTimer(this)),
       track_slider_timer_(new QTimer(this)),
       was_maximized_(false),
@@ -270,7 +271,7 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
 
   // Models
   qLog(Debug) << "Creating models";
-  library_sort_model_->setSourceModel(app_->library()->model());
+  library_sort_model_->SetLibraryModel(app_->library()->model());
   library_sort_model_->setSortRole(LibraryModel::Role_SortText);
   library_sort_model_->setDynamicSortFilter(true);
   library_sort_model_->setSortLocaleAware(true);
@@ -552,6 +553,8 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
           library_view_->view(), SLOT(SaveFocus()));
   connect(app_->library_model(), SIGNAL(modelReset()), library_view_->view(),
           SLOT(RestoreFocus()));
+  connect(app_->library_model(), SIGNAL(FilterChanged()),
+          library_view_->view(), SLOT(AutoExpand()));
 
   connect(app_->task_manager(), SIGNAL(PauseLibraryWatchers()), app_->library(),
           SLOT(PauseWatcher()));
@@ -819,6 +822,10 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
   connect(app_->moodbar_controller(),
           SIGNAL(CurrentMoodbarDataChanged(QByteArray)),
           ui_->track_slider->moodbar_style(), SLOT(SetMoodbarData(QByteArray)));
+  connect(ui_->action_create_moodbars, SIGNAL(triggered()),
+          app_->moodbar_loader(), SLOT(CreateMoodbarsForLibrary()));
+#else
+  ui_->action_create_moodbars->setVisible(false);
 #endif
 
   // Now playing widget
@@ -1735,7 +1742,9 @@ void MainWindow::EditTagDialogAccepted() {
   // This is really lame but we don't know what rows have changed
   ui_->playlist->view()->update();
 
-  app_->playlist_manager()->current()->Save();
+  Playlist* playlist = app_->playlist_manager()->current();
+  playlist->MarkItemsChanged(edit_tag_dialog_->playlist_items());
+  playlist->Save();
 }
 
 void MainWindow::RenumberTracks() {
@@ -2535,7 +2544,7 @@ void MainWindow::Exit() {
 void MainWindow::AutoCompleteTags() {
   // Create the tag fetching stuff if it hasn't been already
   if (!tag_fetcher_) {
-    tag_fetcher_.reset(new TagFetcher);
+    tag_fetcher_.reset(new TagFetcher(app_));
     track_selection_dialog_.reset(new TrackSelectionDialog);
     track_selection_dialog_->set_save_on_close(true);
 
@@ -54,6 +54,7 @@ class GlobalSearchView;
 class GlobalShortcuts;
 class GroupByDialog;
 class Library;
+class LibraryFilterProxyModel;
 class LibraryViewContainer;
 class MimeData;
 class MultiLoadingIndicator;
@@ -82,7 +83,6 @@ class WiimotedevShortcuts;
 class Windows7ThumbBar;
 class Ui_MainWindow;
 
-class QSortFilterProxyModel;
 
 class MainWindow : public QMainWindow, public PlatformInterface {
   Q_OBJECT
@@ -349,7 +349,7 @@ signals:
   QAction* playlistitem_actions_separator_;
   QModelIndex playlist_menu_index_;
 
-  QSortFilterProxyModel* library_sort_model_;
+  LibraryFilterProxyModel* library_sort_model_;
 
   QTimer* track_position_timer_;
   QTimer* track_slider_timer_;
@@ -141,6 +141,8 @@ void ProjectMVisualisation::drawBackground(QPainter* p, const QRectF&) {
     InitProjectM();
   }
 
+  AddQueuedBuffers();
+
   projectm_->projectM_resetGL(sceneRect().width(), sceneRect().height());
   projectm_->renderFrame();
 
@@ -165,18 +167,19 @@ void ProjectMVisualisation::SetDuration(int seconds) {
   Save();
 }
 
-void ProjectMVisualisation::ConsumeBuffer(GstBuffer* buffer, int) {
-  GstMapInfo map;
-  gst_buffer_map(buffer, &map, GST_MAP_READ);
-  const int samples_per_channel = map.size / sizeof(short) / 2;
-  const short* data = reinterpret_cast<short*>(map.data);
+void ProjectMVisualisation::AddQueuedBuffers() {
+  // Feed projectM everything that was played since the last frame.
+  while (GstBuffer* buffer = buffers()->Pop(nullptr)) {
+    GstMapInfo map;
+    gst_buffer_map(buffer, &map, GST_MAP_READ);
+    const int samples_per_channel = map.size / sizeof(short) / 2;
+    const short* data = reinterpret_cast<short*>(map.data);
 
-  if (projectm_) {
     projectm_->pcm()->addPCM16Data(data, samples_per_channel);
-  }
 
-  gst_buffer_unmap(buffer, &map);
-  gst_buffer_unref(buffer);
+    gst_buffer_unmap(buffer, &map);
+    gst_buffer_unref(buffer);
+  }
 }
 
 void ProjectMVisualisation::SetSelected(const QStringList& paths,
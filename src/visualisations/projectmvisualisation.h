@@ -46,9 +46,6 @@ class ProjectMVisualisation : public QGraphicsScene, public BufferConsumer {
   Mode mode() const { return mode_; }
   int duration() const { return duration_; }
 
-  // BufferConsumer
-  void ConsumeBuffer(GstBuffer* buffer, int);
-
  public slots:
   void SetTextureSize(int size);
   void SetDuration(int seconds);
@@ -71,6 +68,7 @@ class ProjectMVisualisation : public QGraphicsScene, public BufferConsumer {
   void InitProjectM();
   void Load();
   void Save();
+  void AddQueuedBuffers();
 
   int IndexOfPreset(const QString& path) const;
 
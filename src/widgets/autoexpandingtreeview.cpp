@@ -39,7 +39,10 @@ AutoExpandingTreeView::AutoExpandingTreeView(QWidget* parent)
 
 void AutoExpandingTreeView::reset() {
   QTreeView::reset();
+  AutoExpand();
+}
 
+void AutoExpandingTreeView::AutoExpand() {
   // Expand nodes in the tree until we have about 50 rows visible in the view
   if (auto_open_ && expand_on_reset_) {
     RecursivelyExpand(rootIndex());
@@ -34,6 +34,8 @@ class AutoExpandingTreeView : public QTreeView {
 
  public slots:
   void RecursivelyExpand(const QModelIndex& index);
+  // Expands nodes the same way as when the model is reset.
+  void AutoExpand();
   void UpAndFocus();
   void DownAndFocus();
 
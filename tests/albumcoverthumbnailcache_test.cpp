@@ -0,0 +1,134 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "covers/albumcoverthumbnailcache.h"
+
+#include "gtest/gtest.h"
+
+#include "test_utils.h"
+
+#include <utime.h>
+
+#include <QDateTime>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+
+namespace {
+
+class AlbumCoverThumbnailCacheTest : public ::testing::Test {
+ protected:
+  AlbumCoverThumbnailCacheTest() : cache_(directory_.path()) {}
+
+  virtual void SetUp() {
+    ASSERT_TRUE(source_.isOpen());
+
+    thumbnail_ = QImage(120, 120, QImage::Format_ARGB32);
+    thumbnail_.fill(0xff336699);
+  }
+
+  TemporaryDirectory directory_;
+  AlbumCoverThumbnailCache cache_;
+  PlaceholderFile source_;
+  QImage thumbnail_;
+  AlbumCoverLoaderOptions options_;
+};
+
+TEST_F(AlbumCoverThumbnailCacheTest, LoadsSavedThumbnail) {
+  EXPECT_TRUE(cache_.Load(source_.fileName(), options_).isNull());
+
+  cache_.Save(source_.fileName(), options_, thumbnail_);
+  const QImage loaded = cache_.Load(source_.fileName(), options_);
+  ASSERT_FALSE(loaded.isNull());
+  EXPECT_EQ(thumbnail_.size(), loaded.size());
+  EXPECT_EQ(thumbnail_.pixel(10, 10), loaded.pixel(10, 10));
+}
+
+TEST_F(AlbumCoverThumbnailCacheTest, KeyedByOptions) {
+  cache_.Save(source_.fileName(), options_, thumbnail_);
+
+  AlbumCoverLoaderOptions other = options_;
+  other.desired_height_ = 32;
+  EXPECT_TRUE(cache_.Load(source_.fileName(), other).isNull());
+}
+
+TEST_F(AlbumCoverThumbnailCacheTest, InvalidatedWhenSourceChanges) {
+  cache_.Save(source_.fileName(), options_, thumbnail_);
+
+  source_.write(" but longer now");
+  source_.flush();
+  EXPECT_TRUE(cache_.Load(source_.fileName(), options_).isNull());
+}
+
+TEST_F(AlbumCoverThumbnailCacheTest, IgnoresMissingSources) {
+  cache_.Save("/no/such/file.jpg", options_, thumbnail_);
+  EXPECT_TRUE(cache_.Load("/no/such/file.jpg", options_).isNull());
+}
+
+TEST_F(AlbumCoverThumbnailCacheTest, Prune) {
+  cache_.Save(source_.fileName(), options_, thumbnail_);
+
+  cache_.Prune(AlbumCoverThumbnailCache::kMaxSize);
+  EXPECT_FALSE(cache_.Load(source_.fileName(), options_).isNull());
+
+  cache_.Prune(0);
+  EXPECT_TRUE(cache_.Load(source_.fileName(), options_).isNull());
+}
+
+TEST_F(AlbumCoverThumbnailCacheTest, PrunesLeastRecentlyUsed) {
+  PlaceholderFile other_source;
+  ASSERT_TRUE(other_source.isOpen());
+
+  cache_.Save(source_.fileName(), options_, thumbnail_);
+  cache_.Save(other_source.fileName(), options_, thumbnail_);
+
+  // Make both thumbnails look like they were last used two days ago.
+  const time_t two_days_ago = QDateTime::currentDateTime().toTime_t() -
+                              2 * 24 * 60 * 60;
+  struct utimbuf times;
+  times.actime = two_days_ago;
+  times.modtime = two_days_ago;
+
+  qint64 largest_size = 0;
+  QDirIterator it(directory_.path(), QStringList() << "*.png", QDir::Files,
+                  QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    it.next();
+    ASSERT_EQ(0, utime(QFile::encodeName(it.filePath()).constData(), &times));
+    largest_size = qMax(largest_size, it.fileInfo().size());
+  }
+
+  // Loading one of them makes the other the least recently used.
+  EXPECT_FALSE(cache_.Load(source_.fileName(), options_).isNull());
+
+  cache_.Prune(largest_size);
+  EXPECT_FALSE(cache_.Load(source_.fileName(), options_).isNull());
+  EXPECT_TRUE(cache_.Load(other_source.fileName(), options_).isNull());
+}
+
+TEST_F(AlbumCoverThumbnailCacheTest, OnlyScaledImagesAreCacheable) {
+  EXPECT_TRUE(AlbumCoverThumbnailCache::IsCacheable(options_));
+
+  AlbumCoverLoaderOptions unscaled;
+  unscaled.scale_output_image_ = false;
+  EXPECT_FALSE(AlbumCoverThumbnailCache::IsCacheable(unscaled));
+
+  AlbumCoverLoaderOptions original;
+  original.load_original_image_ = true;
+  EXPECT_FALSE(AlbumCoverThumbnailCache::IsCacheable(original));
+}
+
+}  // namespace
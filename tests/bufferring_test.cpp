@@ -0,0 +1,124 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "engines/bufferring.h"
+
+#include <QList>
+
+#include <gst/gst.h>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+class BufferRingTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() { gst_init(nullptr, nullptr); }
+
+  void TearDown() {
+    for (GstBuffer* buffer : buffers_) gst_buffer_unref(buffer);
+  }
+
+  // Returns a buffer owned by the test.
+  GstBuffer* NewBuffer() {
+    GstBuffer* buffer = gst_buffer_new();
+    buffers_ << buffer;
+    return buffer;
+  }
+
+  static int RefCount(GstBuffer* buffer) {
+    return GST_MINI_OBJECT_REFCOUNT_VALUE(buffer);
+  }
+
+  QList<GstBuffer*> buffers_;
+};
+
+TEST_F(BufferRingTest, Empty) {
+  BufferRing ring(4);
+  EXPECT_EQ(nullptr, ring.Pop(nullptr));
+  EXPECT_EQ(0, ring.overruns());
+}
+
+TEST_F(BufferRingTest, WrapsAround) {
+  BufferRing ring(4);
+
+  // Go round the ring several times, never letting it fill up.
+  for (int i = 0; i < 20; i += 3) {
+    for (int j = i; j < i + 3; ++j) {
+      ASSERT_TRUE(ring.Push(NewBuffer(), j));
+    }
+    for (int j = i; j < i + 3; ++j) {
+      int pipeline_id = -1;
+      GstBuffer* buffer = ring.Pop(&pipeline_id);
+      ASSERT_EQ(buffers_[j], buffer);
+      EXPECT_EQ(j, pipeline_id);
+      gst_buffer_unref(buffer);
+    }
+    EXPECT_EQ(nullptr, ring.Pop(nullptr));
+  }
+
+  EXPECT_EQ(0, ring.overruns());
+}
+
+TEST_F(BufferRingTest, OverwritesOldest) {
+  BufferRing ring(4);
+
+  for (int i = 0; i < 7; ++i) {
+    ASSERT_TRUE(ring.Push(NewBuffer(), i));
+  }
+  EXPECT_EQ(3, ring.overruns());
+
+  // The ring let go of the buffers it threw away.
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(1, RefCount(buffers_[i]));
+  }
+
+  for (int i = 3; i < 7; ++i) {
+    int pipeline_id = -1;
+    GstBuffer* buffer = ring.Pop(&pipeline_id);
+    ASSERT_EQ(buffers_[i], buffer);
+    EXPECT_EQ(i, pipeline_id);
+    gst_buffer_unref(buffer);
+  }
+  EXPECT_EQ(nullptr, ring.Pop(nullptr));
+  EXPECT_EQ(3, ring.overruns());
+}
+
+TEST_F(BufferRingTest, RoundsCapacityUpToPowerOfTwo) {
+  BufferRing ring(3);
+
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(ring.Push(NewBuffer(), i));
+  }
+  EXPECT_EQ(0, ring.overruns());
+
+  ring.Push(NewBuffer(), 4);
+  EXPECT_EQ(1, ring.overruns());
+}
+
+TEST_F(BufferRingTest, ClearUnrefsBuffers) {
+  BufferRing ring(4);
+  ring.Push(NewBuffer(), 0);
+  ring.Push(NewBuffer(), 0);
+  EXPECT_EQ(2, RefCount(buffers_[0]));
+
+  ring.Clear();
+  EXPECT_EQ(1, RefCount(buffers_[0]));
+  EXPECT_EQ(1, RefCount(buffers_[1]));
+  EXPECT_EQ(nullptr, ring.Pop(nullptr));
+}
+
+}  // namespace
@@ -0,0 +1,95 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "library/directorysnapshot.h"
+
+#include "gtest/gtest.h"
+
+#include "test_utils.h"
+
+#include <QFileInfo>
+
+namespace {
+
+DirectorySnapshot::Stat MakeStat(quint64 inode, qint64 size,
+                                 qint64 mtime_nsec) {
+  DirectorySnapshot::Stat stat;
+  stat.inode = inode;
+  stat.size = size;
+  stat.mtime_nsec = mtime_nsec;
+  return stat;
+}
+
+TEST(DirectorySnapshotTest, IsUnchanged) {
+  DirectorySnapshot snapshot;
+  snapshot.Insert("song.mp3", MakeStat(1, 100, 1000));
+
+  EXPECT_TRUE(snapshot.IsUnchanged("song.mp3", MakeStat(1, 100, 1000)));
+  EXPECT_FALSE(snapshot.IsUnchanged("song.mp3", MakeStat(2, 100, 1000)));
+  EXPECT_FALSE(snapshot.IsUnchanged("song.mp3", MakeStat(1, 101, 1000)));
+  EXPECT_FALSE(snapshot.IsUnchanged("song.mp3", MakeStat(1, 100, 1001)));
+  EXPECT_FALSE(snapshot.IsUnchanged("other.mp3", MakeStat(1, 100, 1000)));
+}
+
+TEST(DirectorySnapshotTest, SerializeRoundTrip) {
+  DirectorySnapshot snapshot;
+  snapshot.Insert("song.mp3", MakeStat(1, 100, 1000));
+  snapshot.Insert(QString::fromUtf8("s\xc3\xa9ance.ogg"),
+                  MakeStat(2, 200, 2000));
+
+  DirectorySnapshot copy =
+      DirectorySnapshot::Deserialize(snapshot.Serialize());
+  EXPECT_EQ(2, copy.count());
+  EXPECT_TRUE(copy.IsUnchanged("song.mp3", MakeStat(1, 100, 1000)));
+  EXPECT_TRUE(copy.IsUnchanged(QString::fromUtf8("s\xc3\xa9ance.ogg"),
+                               MakeStat(2, 200, 2000)));
+}
+
+TEST(DirectorySnapshotTest, IgnoresBadData) {
+  EXPECT_TRUE(DirectorySnapshot::Deserialize(QByteArray()).is_empty());
+
+  DirectorySnapshot snapshot;
+  snapshot.Insert("song.mp3", MakeStat(1, 100, 1000));
+  QByteArray data = snapshot.Serialize();
+  data.chop(4);
+  EXPECT_TRUE(DirectorySnapshot::Deserialize(data).is_empty());
+
+  // A count far bigger than the data that follows it.
+  QByteArray huge_count = snapshot.Serialize();
+  huge_count[1] = '\xff';
+  EXPECT_TRUE(DirectorySnapshot::Deserialize(huge_count).is_empty());
+}
+
+TEST(DirectorySnapshotTest, List) {
+  PlaceholderFile file;
+  ASSERT_TRUE(file.isOpen());
+
+  const QFileInfo info(file.fileName());
+  bool found = false;
+  for (const DirectorySnapshot::Child& child :
+       DirectorySnapshot::List(info.absolutePath())) {
+    if (child.path != info.absoluteFilePath()) continue;
+
+    found = true;
+    EXPECT_FALSE(child.is_dir);
+    EXPECT_EQ(qint64(qstrlen(kPlaceholderContents)), child.stat.size);
+    EXPECT_EQ(info.lastModified().toTime_t(),
+              child.stat.mtime_nsec / 1000000000ll);
+  }
+  EXPECT_TRUE(found);
+}
+
+}  // namespace
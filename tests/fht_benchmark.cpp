@@ -0,0 +1,91 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <stdlib.h>
+
+#include <vector>
+
+#include <QElapsedTimer>
+
+#include "analyzers/fht.h"
+#include "core/logging.h"
+
+namespace {
+
+const int kIterations = 20000;
+
+const char* KernelName(FHT::Kernel kernel) {
+  switch (kernel) {
+    case FHT::KernelScalar:
+      return "scalar";
+    case FHT::KernelSSE2:
+      return "SSE2";
+    case FHT::KernelAVX2:
+      return "AVX2";
+  }
+  return "unknown";
+}
+
+// Runs func on a copy of some random data kIterations times and returns the
+// average time per call in nanoseconds.
+template <typename F>
+qint64 TimePerCall(int size, F func) {
+  std::vector<float> input(size);
+  for (int i = 0; i < size; ++i) {
+    input[i] = static_cast<float>(rand()) / RAND_MAX * 2 - 1;
+  }
+  std::vector<float> data(size);
+  std::vector<float> out(size);
+
+  QElapsedTimer timer;
+  timer.start();
+  for (int i = 0; i < kIterations; ++i) {
+    data = input;
+    func(&data[0], &out[0]);
+  }
+  return timer.nsecsElapsed() / kIterations;
+}
+
+TEST(FHTBenchmark, Kernels) {
+  const FHT::Kernel kernels[] = {FHT::KernelScalar, FHT::KernelSSE2,
+                                 FHT::KernelAVX2};
+
+  // Analyzer::Base::resizeExponent clamps the exponent to 3..9.
+  for (int exp = 3; exp <= 9; ++exp) {
+    for (FHT::Kernel kernel : kernels) {
+      if (!FHT::kernelSupported(kernel)) continue;
+
+      FHT fht(exp, kernel);
+      const qint64 transform = TimePerCall(
+          fht.size(), [&fht](float* p, float*) { fht.transform(p); });
+      const qint64 spectrum = TimePerCall(
+          fht.size(), [&fht](float* p, float*) { fht.spectrum(p); });
+      const qint64 log_spectrum =
+          TimePerCall(fht.size(), [&fht](float* p, float* out) {
+            fht.logSpectrum(out, p);
+          });
+
+      qLog(Info) << "size" << fht.size() << KernelName(kernel) << ":"
+                 << transform << "ns per transform," << spectrum
+                 << "ns per spectrum," << log_spectrum
+                 << "ns per logSpectrum";
+    }
+  }
+}
+
+}  // namespace
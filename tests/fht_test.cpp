@@ -0,0 +1,120 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "analyzers/fht.h"
+
+#include "gtest/gtest.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <vector>
+
+namespace {
+
+class FHTTest : public ::testing::Test {
+ protected:
+  static std::vector<float> RandomData(int size) {
+    std::vector<float> ret(size);
+    for (int i = 0; i < size; ++i) {
+      ret[i] = static_cast<float>(rand()) / RAND_MAX * 2 - 1;
+    }
+    return ret;
+  }
+
+  static std::vector<FHT::Kernel> SimdKernels() {
+    std::vector<FHT::Kernel> ret;
+    if (FHT::kernelSupported(FHT::KernelSSE2)) ret.push_back(FHT::KernelSSE2);
+    if (FHT::kernelSupported(FHT::KernelAVX2)) ret.push_back(FHT::KernelAVX2);
+    return ret;
+  }
+
+  static void ExpectEqual(const std::vector<float>& expected,
+                          const std::vector<float>& actual, int count) {
+    for (int i = 0; i < count; ++i) {
+      EXPECT_FLOAT_EQ(expected[i], actual[i]) << "at index " << i;
+    }
+  }
+};
+
+TEST_F(FHTTest, ScalarMatchesDiscreteHartleyTransform) {
+  for (int exp = 3; exp <= 9; ++exp) {
+    SCOPED_TRACE(exp);
+    FHT fht(exp, FHT::KernelScalar);
+    const int size = fht.size();
+
+    const std::vector<float> input = RandomData(size);
+    std::vector<float> output = input;
+    fht.transform(&output[0]);
+
+    for (int k = 0; k < size; ++k) {
+      double expected = 0;
+      for (int i = 0; i < size; ++i) {
+        const double t = 2 * M_PI * i * k / size;
+        expected += input[i] * (cos(t) + sin(t));
+      }
+      EXPECT_NEAR(expected, output[k], 1e-4);
+    }
+  }
+}
+
+TEST_F(FHTTest, SimdKernelsMatchScalar) {
+  for (FHT::Kernel kernel : SimdKernels()) {
+    for (int exp = 3; exp <= 9; ++exp) {
+      SCOPED_TRACE(::testing::Message() << "kernel " << kernel << ", exp "
+                                        << exp);
+      FHT scalar(exp, FHT::KernelScalar);
+      FHT simd(exp, kernel);
+      ASSERT_EQ(kernel, simd.kernel());
+      const int size = scalar.size();
+
+      const std::vector<float> input = RandomData(size);
+
+      std::vector<float> expected = input;
+      std::vector<float> actual = input;
+      scalar.transform(&expected[0]);
+      simd.transform(&actual[0]);
+      ExpectEqual(expected, actual, size);
+
+      expected = actual = input;
+      scalar.power(&expected[0]);
+      simd.power(&actual[0]);
+      ExpectEqual(expected, actual, size / 2);
+
+      expected = actual = input;
+      scalar.spectrum(&expected[0]);
+      simd.spectrum(&actual[0]);
+      scalar.scale(&expected[0], 1.0 / 20);
+      simd.scale(&actual[0], 1.0 / 20);
+      ExpectEqual(expected, actual, size / 2);
+
+      std::vector<float> expected_log(size);
+      std::vector<float> actual_log(size);
+      expected = actual = input;
+      scalar.logSpectrum(&expected_log[0], &expected[0]);
+      simd.logSpectrum(&actual_log[0], &actual[0]);
+      ExpectEqual(expected_log, actual_log, size / 2);
+
+      const std::vector<float> fresh = RandomData(size);
+      expected = actual = input;
+      scalar.ewma(&expected[0], const_cast<float*>(&fresh[0]), 0.75);
+      simd.ewma(&actual[0], const_cast<float*>(&fresh[0]), 0.75);
+      ExpectEqual(expected, actual, size / 2);
+    }
+  }
+}
+
+}  // namespace
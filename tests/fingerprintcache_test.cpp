@@ -0,0 +1,67 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "musicbrainz/fingerprintcache.h"
+
+#include "gtest/gtest.h"
+
+#include <memory>
+
+#include "core/database.h"
+#include "test_utils.h"
+
+namespace {
+
+class FingerprintCacheTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    database_.reset(new MemoryDatabase(nullptr));
+    cache_.reset(new FingerprintCache(database_.get()));
+
+    ASSERT_TRUE(file_.isOpen());
+  }
+
+  std::unique_ptr<Database> database_;
+  std::unique_ptr<FingerprintCache> cache_;
+  PlaceholderFile file_;
+};
+
+TEST_F(FingerprintCacheTest, Empty) {
+  EXPECT_TRUE(cache_->Load(file_.fileName()).isEmpty());
+}
+
+TEST_F(FingerprintCacheTest, SaveAndLoad) {
+  cache_->Save(file_.fileName(), "AQAAAA");
+  EXPECT_EQ("AQAAAA", cache_->Load(file_.fileName()));
+
+  cache_->Save(file_.fileName(), "AQAAAB");
+  EXPECT_EQ("AQAAAB", cache_->Load(file_.fileName()));
+}
+
+TEST_F(FingerprintCacheTest, FileChanged) {
+  cache_->Save(file_.fileName(), "AQAAAA");
+
+  file_.write(" with some more data");
+  file_.flush();
+  EXPECT_TRUE(cache_->Load(file_.fileName()).isEmpty());
+}
+
+TEST_F(FingerprintCacheTest, MissingFile) {
+  cache_->Save("/nonexistent/song.mp3", "AQAAAA");
+  EXPECT_TRUE(cache_->Load("/nonexistent/song.mp3").isEmpty());
+}
+
+}  // namespace
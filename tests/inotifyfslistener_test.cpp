@@ -0,0 +1,78 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/inotifyfslistener.h"
+
+#include "gtest/gtest.h"
+
+#include "test_utils.h"
+
+#include <QEventLoop>
+#include <QSignalSpy>
+#include <QTimer>
+
+namespace {
+
+class InotifyFSListenerTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() { listener_.Init(); }
+
+  virtual void TearDown() { listener_.Clear(); }
+
+  // Runs the event loop until PathChanged is emitted or msec have passed.
+  void Wait(int msec) {
+    QEventLoop loop;
+    QObject::connect(&listener_, SIGNAL(PathChanged(const QString&)), &loop,
+                     SLOT(quit()));
+    QTimer::singleShot(msec, &loop, SLOT(quit()));
+    loop.exec();
+  }
+
+  TemporaryDirectory dir_;
+  InotifyFSListener listener_;
+};
+
+TEST_F(InotifyFSListenerTest, CoalescesEvents) {
+  listener_.AddPath(dir_.path());
+  EXPECT_EQ(1, listener_.watch_count());
+  EXPECT_EQ(0, listener_.polled_count());
+
+  QSignalSpy spy(&listener_, SIGNAL(PathChanged(const QString&)));
+  ASSERT_FALSE(dir_.WriteFile("1.mp3").isEmpty());
+  ASSERT_FALSE(dir_.WriteFile("2.mp3").isEmpty());
+  ASSERT_FALSE(dir_.WriteFile("3.mp3").isEmpty());
+  Wait(5000);
+
+  ASSERT_EQ(1, spy.count());
+  EXPECT_EQ(dir_.path(), spy[0][0].toString());
+  EXPECT_EQ(0, listener_.queued_event_count());
+}
+
+TEST_F(InotifyFSListenerTest, RemovePath) {
+  listener_.AddPath(dir_.path());
+  listener_.AddPath(dir_.path());
+  EXPECT_EQ(1, listener_.watch_count());
+
+  listener_.RemovePath(dir_.path());
+  EXPECT_EQ(0, listener_.watch_count());
+
+  QSignalSpy spy(&listener_, SIGNAL(PathChanged(const QString&)));
+  ASSERT_FALSE(dir_.WriteFile("1.mp3").isEmpty());
+  Wait(1000);
+  EXPECT_EQ(0, spy.count());
+}
+
+}  // namespace
@@ -0,0 +1,139 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <memory>
+
+#include "gtest/gtest.h"
+
+#include <QElapsedTimer>
+#include <QSqlQuery>
+#include <QVariant>
+
+#include "core/database.h"
+#include "core/logging.h"
+#include "core/song.h"
+#include "core/timeconstants.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+
+namespace {
+
+const int kSongCount = 100000;
+const int kBaselineSongCount = 5000;
+
+class LibraryBackendBenchmark : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    database_.reset(new MemoryDatabase(nullptr));
+    backend_.reset(new LibraryBackend);
+    backend_->Init(database_.get(), Library::kSongsTable, Library::kDirsTable,
+                   Library::kSubdirsTable, Library::kFtsTable);
+    backend_->AddDirectory("/tmp");
+  }
+
+  static SongList MakeSongs(int count) {
+    SongList ret;
+    for (int i = 0; i < count; ++i) {
+      Song song;
+      song.Init(QString("Title %1").arg(i), QString("Artist %1").arg(i / 100),
+                QString("Album %1").arg(i / 10), 180 * kNsecPerSec);
+      song.set_track(i % 10 + 1);
+      song.set_year(1970 + i % 50);
+      song.set_genre(QString("Genre %1").arg(i % 20));
+      song.set_directory_id(1);
+      song.set_url(QUrl::fromLocalFile(QString("/tmp/music/%1.mp3").arg(i)));
+      song.set_mtime(1);
+      song.set_ctime(1);
+      song.set_filesize(1);
+      ret << song;
+    }
+    return ret;
+  }
+
+  int CountRows(const QString& table) {
+    QSqlQuery q(QString("SELECT COUNT(*) FROM %1").arg(table),
+                database_->Connect());
+    if (!q.next()) return -1;
+    return q.value(0).toInt();
+  }
+
+  static void Report(const char* name, int songs, qint64 msec) {
+    qLog(Info) << name << ":" << songs << "songs in" << msec << "ms ="
+               << (msec ? songs * 1000 / msec : songs) << "songs/s";
+  }
+
+  std::unique_ptr<Database> database_;
+  std::unique_ptr<LibraryBackend> backend_;
+};
+
+TEST_F(LibraryBackendBenchmark, AddOneSongAtATime) {
+  // A baseline: one statement and one FTS insert per song, like
+  // AddOrUpdateSongs used to do.
+  const SongList songs = MakeSongs(kBaselineSongCount);
+
+  QElapsedTimer timer;
+  timer.start();
+  for (const Song& song : songs) {
+    backend_->AddOrUpdateSongs(SongList() << song);
+  }
+  Report("One song at a time", songs.count(), timer.elapsed());
+
+  EXPECT_EQ(kBaselineSongCount, CountRows(Library::kSongsTable));
+  EXPECT_EQ(kBaselineSongCount, CountRows(Library::kFtsTable));
+}
+
+TEST_F(LibraryBackendBenchmark, AddSongs) {
+  const SongList songs = MakeSongs(kSongCount);
+
+  QElapsedTimer timer;
+  timer.start();
+  backend_->AddOrUpdateSongs(songs);
+  Report("Bulk insert", songs.count(), timer.elapsed());
+
+  EXPECT_EQ(kSongCount, CountRows(Library::kSongsTable));
+  EXPECT_EQ(kSongCount, CountRows(Library::kFtsTable));
+
+  // The IDs we gave the songs must match the ones in the database
+  Song song = backend_->GetSongById(kSongCount);
+  EXPECT_EQ(QString("Title %1").arg(kSongCount - 1), song.title());
+}
+
+TEST_F(LibraryBackendBenchmark, UpdateSongs) {
+  backend_->AddOrUpdateSongs(MakeSongs(kSongCount));
+
+  SongList songs = backend_->GetAllSongs();
+  ASSERT_EQ(kSongCount, songs.count());
+  for (int i = 0; i < songs.count(); ++i) {
+    songs[i].set_title(QString("Renamed %1").arg(songs[i].id()));
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  backend_->AddOrUpdateSongs(songs);
+  Report("Bulk update", songs.count(), timer.elapsed());
+
+  EXPECT_EQ(kSongCount, CountRows(Library::kSongsTable));
+  EXPECT_EQ(kSongCount, CountRows(Library::kFtsTable));
+
+  // The FTS index must have been updated too
+  QSqlQuery q(QString("SELECT COUNT(*) FROM %1 WHERE ftstitle MATCH 'renamed'")
+                  .arg(Library::kFtsTable),
+              database_->Connect());
+  ASSERT_TRUE(q.next());
+  EXPECT_EQ(kSongCount, q.value(0).toInt());
+}
+
+}  // namespace
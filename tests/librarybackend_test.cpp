@@ -331,4 +331,109 @@ TEST_F(SingleSong, MarkSongsUnavailable) {
   EXPECT_EQ(0, albums.size());
 }
 
+class Compilations : public LibraryBackendTest {
+ protected:
+  virtual void SetUp() {
+    LibraryBackendTest::SetUp();
+    backend_->set_detect_compilations(true);
+
+    // Add a directory - this will get ID 1
+    backend_->AddDirectory("/tmp");
+  }
+
+  // Adds a song from Album by artist, in the given directory.
+  void AddSong(const QString& filename, const QString& artist) {
+    Song song = MakeDummySong(1);
+    song.set_title(filename);
+    song.set_artist(artist);
+    song.set_album("Album");
+    song.set_url(QUrl::fromLocalFile(filename));
+    backend_->AddOrUpdateSongs(SongList() << song);
+  }
+
+  static SongList SongsFrom(const QSignalSpy& spy, int i) {
+    return *(reinterpret_cast<const SongList*>(spy[i][0].data()));
+  }
+};
+
+TEST_F(Compilations, SecondArtistMakesCompilation) {
+  AddSong("/tmp/album/1.mp3", "Artist 1");
+  EXPECT_FALSE(backend_->GetSongById(1).sampler());
+  EXPECT_TRUE(backend_->GetCompilationSongs("Album").isEmpty());
+
+  QSignalSpy added_spy(backend_.get(), SIGNAL(SongsDiscovered(SongList)));
+  QSignalSpy deleted_spy(backend_.get(), SIGNAL(SongsDeleted(SongList)));
+
+  AddSong("/tmp/album/2.mp3", "Artist 2");
+
+  EXPECT_TRUE(backend_->GetSongById(1).sampler());
+  EXPECT_TRUE(backend_->GetSongById(2).sampler());
+  EXPECT_EQ(2, backend_->GetCompilationSongs("Album").count());
+
+  // The new song is reported first, then both songs are replaced by their
+  // compilation versions.
+  ASSERT_EQ(2, added_spy.count());
+  ASSERT_EQ(1, deleted_spy.count());
+  EXPECT_EQ(2, SongsFrom(deleted_spy, 0).count());
+
+  SongList changed = SongsFrom(added_spy, 1);
+  ASSERT_EQ(2, changed.count());
+  for (const Song& song : changed) {
+    EXPECT_TRUE(song.sampler());
+  }
+}
+
+TEST_F(Compilations, SameArtistInDifferentDirectories) {
+  AddSong("/tmp/one/1.mp3", "Artist 1");
+  AddSong("/tmp/two/2.mp3", "Artist 2");
+
+  EXPECT_FALSE(backend_->GetSongById(1).sampler());
+  EXPECT_FALSE(backend_->GetSongById(2).sampler());
+}
+
+TEST_F(Compilations, DeletingSongRevertsCompilation) {
+  AddSong("/tmp/album/1.mp3", "Artist 1");
+  AddSong("/tmp/album/2.mp3", "Artist 2");
+  ASSERT_TRUE(backend_->GetSongById(1).sampler());
+
+  backend_->DeleteSongs(SongList() << backend_->GetSongById(2));
+
+  EXPECT_FALSE(backend_->GetSongById(1).sampler());
+  EXPECT_TRUE(backend_->GetCompilationSongs("Album").isEmpty());
+}
+
+TEST_F(Compilations, UnavailableSongRevertsCompilation) {
+  AddSong("/tmp/album/1.mp3", "Artist 1");
+  AddSong("/tmp/album/2.mp3", "Artist 2");
+  ASSERT_TRUE(backend_->GetSongById(1).sampler());
+
+  backend_->MarkSongsUnavailable(SongList() << backend_->GetSongById(2));
+
+  EXPECT_FALSE(backend_->GetSongById(1).sampler());
+  EXPECT_TRUE(backend_->GetCompilationSongs("Album").isEmpty());
+}
+
+TEST_F(Compilations, RevertedSongsAreReportedWithoutSampler) {
+  AddSong("/tmp/album/1.mp3", "Artist 1");
+  AddSong("/tmp/album/2.mp3", "Artist 2");
+
+  QSignalSpy added_spy(backend_.get(), SIGNAL(SongsDiscovered(SongList)));
+  QSignalSpy deleted_spy(backend_.get(), SIGNAL(SongsDeleted(SongList)));
+
+  backend_->DeleteSongs(SongList() << backend_->GetSongById(2));
+
+  // The deleted song, then the old version of the song that's left.
+  ASSERT_EQ(2, deleted_spy.count());
+  SongList old_songs = SongsFrom(deleted_spy, 1);
+  ASSERT_EQ(1, old_songs.count());
+  EXPECT_EQ(1, old_songs[0].id());
+  EXPECT_TRUE(old_songs[0].sampler());
+
+  ASSERT_EQ(1, added_spy.count());
+  SongList new_songs = SongsFrom(added_spy, 0);
+  ASSERT_EQ(1, new_songs.count());
+  EXPECT_EQ(1, new_songs[0].id());
+  EXPECT_FALSE(new_songs[0].sampler());
+}
+
 } // namespace
@@ -26,6 +26,7 @@
 #include "library/library.h"
 
 #include <QtDebug>
+#include <QMimeData>
 #include <QThread>
 #include <QSignalSpy>
 #include <QSortFilterProxyModel>
@@ -304,4 +305,29 @@ TEST_F(LibraryModelTest, RemoveEmptyArtists) {
   ASSERT_EQ(0, model_->rowCount(QModelIndex()));
 }
 
+TEST_F(LibraryModelTest, ChildSongsSkipFilteredSongs) {
+  AddSong("Apple", "Artist", "Album", 123);
+  AddSong("Banana", "Artist", "Album", 123);
+  backend_->SetSongCacheEnabled(true);
+  model_->Init(false);
+
+  QModelIndex artist_index = model_->index(0, 0, QModelIndex());
+  EXPECT_EQ(2, model_->GetChildSongs(artist_index).count());
+
+  // The filter hides the other song without taking it out of the tree.
+  model_->SetFilterText("apple");
+  ASSERT_TRUE(model_->IsVisible(artist_index));
+
+  SongList songs = model_->GetChildSongs(artist_index);
+  ASSERT_EQ(1, songs.count());
+  EXPECT_EQ("Apple", songs[0].title());
+
+  std::unique_ptr<QMimeData> data(
+      model_->mimeData(QModelIndexList() << artist_index));
+  EXPECT_EQ(1, data->urls().count());
+
+  model_->SetFilterText(QString());
+  EXPECT_EQ(2, model_->GetChildSongs(artist_index).count());
+}
+
 } // namespace
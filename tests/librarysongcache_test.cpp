@@ -0,0 +1,291 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "library/libraryquery.h"
+#include "library/librarysongcache.h"
+
+#include "gtest/gtest.h"
+
+#include "test_utils.h"
+
+#include <QStringList>
+#include <QVector>
+
+namespace {
+
+class LibrarySongCacheTest : public ::testing::Test {
+ protected:
+  static Song MakeSong(int id, const QString& artist, const QString& album,
+                       const QString& title, bool compilation = false) {
+    Song song;
+    song.Init(title, artist, album, 100);
+    song.set_id(id);
+    song.set_compilation(compilation);
+    song.set_url(QUrl::fromLocalFile("/music/" + title));
+    return song;
+  }
+
+  static QStringList FirstColumn(LibraryQuery* query) {
+    QStringList ret;
+    while (query->Next()) {
+      ret << query->Value(0).toString();
+    }
+    return ret;
+  }
+
+  LibrarySongCache cache_;
+};
+
+TEST_F(LibrarySongCacheTest, RefusesQueriesUntilReset) {
+  LibraryQuery query;
+  query.SetColumnSpec("DISTINCT artist");
+  EXPECT_FALSE(cache_.Execute(&query));
+
+  cache_.Reset(SongList());
+  EXPECT_TRUE(cache_.Execute(&query));
+  EXPECT_FALSE(query.Next());
+}
+
+TEST_F(LibrarySongCacheTest, DistinctArtists) {
+  cache_.Reset(SongList() << MakeSong(1, "Artist 1", "Album 1", "Title 1")
+                          << MakeSong(2, "Artist 1", "Album 2", "Title 2")
+                          << MakeSong(3, "Artist 2", "Album 3", "Title 3")
+                          << MakeSong(4, "Various", "Album 4", "Title 4",
+                                      true));
+
+  LibraryQuery query;
+  query.SetColumnSpec("DISTINCT artist");
+  query.SetOrderBy("artist");
+  query.AddCompilationRequirement(false);
+  ASSERT_TRUE(cache_.Execute(&query));
+
+  EXPECT_EQ(QStringList() << "Artist 1"
+                          << "Artist 2",
+            FirstColumn(&query));
+}
+
+TEST_F(LibrarySongCacheTest, FiltersByColumn) {
+  cache_.Reset(SongList() << MakeSong(1, "Artist 1", "Album B", "Title 1")
+                          << MakeSong(2, "Artist 1", "Album A", "Title 2")
+                          << MakeSong(3, "Artist 2", "Album C", "Title 3"));
+
+  LibraryQuery query;
+  query.SetColumnSpec("album, artist");
+  query.SetOrderBy("album");
+  query.AddWhere("artist", "Artist 1");
+  ASSERT_TRUE(cache_.Execute(&query));
+
+  ASSERT_TRUE(query.Next());
+  EXPECT_EQ("Album A", query.Value(0).toString());
+  EXPECT_EQ("Artist 1", query.Value(1).toString());
+  ASSERT_TRUE(query.Next());
+  EXPECT_EQ("Album B", query.Value(0).toString());
+  EXPECT_FALSE(query.Next());
+
+  LibraryQuery missing;
+  missing.SetColumnSpec("album");
+  missing.AddWhere("artist", "Nobody");
+  ASSERT_TRUE(cache_.Execute(&missing));
+  EXPECT_FALSE(missing.Next());
+}
+
+TEST_F(LibrarySongCacheTest, FollowsUpdates) {
+  cache_.Reset(SongList() << MakeSong(1, "Artist 1", "Album 1", "Title 1")
+                          << MakeSong(2, "Artist 2", "Album 2", "Title 2"));
+
+  cache_.AddOrUpdateSongs(SongList()
+                          << MakeSong(1, "Artist 3", "Album 1", "Title 1")
+                          << MakeSong(3, "Artist 4", "Album 3", "Title 3"));
+  cache_.RemoveSongs(SongList() << MakeSong(2, "", "", ""));
+
+  Song unavailable = MakeSong(4, "Artist 5", "Album 4", "Title 4");
+  unavailable.set_unavailable(true);
+  cache_.AddOrUpdateSongs(SongList() << unavailable);
+
+  EXPECT_EQ(2, cache_.song_count());
+
+  LibraryQuery query;
+  query.SetColumnSpec("DISTINCT artist");
+  query.SetOrderBy("artist");
+  ASSERT_TRUE(cache_.Execute(&query));
+  EXPECT_EQ(QStringList() << "Artist 3"
+                          << "Artist 4",
+            FirstColumn(&query));
+}
+
+TEST_F(LibrarySongCacheTest, LoadKeepsChangesMadeDuringIt) {
+  cache_.Reset(SongList() << MakeSong(1, "Artist 1", "Album 1", "Title 1"));
+
+  const int load_id = cache_.BeginLoad();
+  EXPECT_FALSE(cache_.is_ready());
+
+  // These were committed after the rows below were read.
+  cache_.AddOrUpdateSongs(SongList()
+                          << MakeSong(2, "Artist 3", "Album 2", "Title 2"));
+  cache_.RemoveSongs(SongList() << MakeSong(3, "", "", ""));
+
+  cache_.LoadSong(load_id, MakeSong(1, "Artist 1", "Album 1", "Title 1"));
+  cache_.LoadSong(load_id, MakeSong(2, "Artist 2", "Album 2", "Title 2"));
+  cache_.LoadSong(load_id, MakeSong(3, "Artist 4", "Album 3", "Title 3"));
+  cache_.EndLoad(load_id);
+  ASSERT_TRUE(cache_.is_ready());
+
+  LibraryQuery query;
+  query.SetColumnSpec("DISTINCT artist");
+  query.SetOrderBy("artist");
+  ASSERT_TRUE(cache_.Execute(&query));
+  EXPECT_EQ(QStringList() << "Artist 1"
+                          << "Artist 3",
+            FirstColumn(&query));
+
+  // A load that has been superseded does nothing.
+  const int stale_id = cache_.BeginLoad();
+  const int current_id = cache_.BeginLoad();
+  cache_.LoadSong(stale_id, MakeSong(4, "Artist 5", "Album 4", "Title 4"));
+  cache_.EndLoad(stale_id);
+  EXPECT_FALSE(cache_.is_ready());
+  cache_.EndLoad(current_id);
+  EXPECT_EQ(0, cache_.song_count());
+}
+
+TEST_F(LibrarySongCacheTest, RefusesQueriesItCantAnswer) {
+  cache_.Reset(SongList() << MakeSong(1, "Artist 1", "Album 1", "Title 1"));
+
+  QueryOptions options;
+  options.set_filter("Artist");
+  LibraryQuery fts(options);
+  fts.SetColumnSpec("DISTINCT artist");
+  EXPECT_FALSE(cache_.Execute(&fts));
+
+  LibraryQuery songs;
+  songs.SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
+  EXPECT_FALSE(cache_.Execute(&songs));
+
+  LibraryQuery unavailable;
+  unavailable.SetColumnSpec("artist");
+  unavailable.SetIncludeUnavailable(true);
+  EXPECT_FALSE(cache_.Execute(&unavailable));
+}
+
+TEST_F(LibrarySongCacheTest, FindsSongsByWordPrefix) {
+  cache_.Reset(SongList() << MakeSong(1, "The Beatles", "Help!", "Yesterday")
+                          << MakeSong(2, "Beat Happening", "Jamboree",
+                                      "Indian Summer")
+                          << MakeSong(3, QString::fromUtf8("Bj\xc3\xb6rk"),
+                                      "Debut", "Human"));
+
+  QueryOptions options;
+  QVector<int> ids;
+
+  options.set_filter("beat");
+  ASSERT_TRUE(cache_.FindSongs(options, nullptr, &ids));
+  EXPECT_EQ(QVector<int>() << 1 << 2, ids);
+
+  // Words have to start with the text, not just contain it.
+  options.set_filter("eat");
+  ASSERT_TRUE(cache_.FindSongs(options, nullptr, &ids));
+  EXPECT_TRUE(ids.isEmpty());
+
+  // Every word has to match somewhere, and accents are ignored.
+  options.set_filter("bjork hum");
+  ASSERT_TRUE(cache_.FindSongs(options, nullptr, &ids));
+  EXPECT_EQ(QVector<int>() << 3, ids);
+
+  options.set_filter("title:beat");
+  ASSERT_TRUE(cache_.FindSongs(options, nullptr, &ids));
+  EXPECT_TRUE(ids.isEmpty());
+
+  options.set_filter("artist:beat");
+  QVector<int> within = QVector<int>() << 2 << 3;
+  ASSERT_TRUE(cache_.FindSongs(options, &within, &ids));
+  EXPECT_EQ(QVector<int>() << 2, ids);
+
+  // FTS would treat this as a phrase.
+  options.set_filter("ac/dc");
+  EXPECT_FALSE(cache_.FindSongs(options, nullptr, &ids));
+}
+
+TEST_F(LibrarySongCacheTest, FindsBestSongsFirst) {
+  cache_.Reset(SongList() << MakeSong(1, "Beatles Tribute", "Covers", "Help")
+                          << MakeSong(2, "Someone", "Beat", "Other")
+                          << MakeSong(3, "Someone", "Other", "Beat It")
+                          << MakeSong(4, "Someone", "Other", "Beatnik")
+                          << MakeSong(5, "Someone", "Other", "Nothing"));
+
+  QueryOptions options;
+  options.set_filter("beat");
+  QVector<int> ids;
+  bool more = false;
+
+  // A whole word in the title beats one in the album, which beats the start
+  // of a word in the title or artist.
+  ASSERT_TRUE(cache_.FindBestSongs(options, 10, &ids, &more));
+  EXPECT_EQ(QVector<int>() << 3 << 2 << 4 << 1, ids);
+  EXPECT_FALSE(more);
+
+  ASSERT_TRUE(cache_.FindBestSongs(options, 2, &ids, &more));
+  EXPECT_EQ(QVector<int>() << 3 << 2, ids);
+  EXPECT_TRUE(more);
+
+  options.set_filter("ac/dc");
+  EXPECT_FALSE(cache_.FindBestSongs(options, 10, &ids, &more));
+}
+
+TEST_F(LibrarySongCacheTest, IsRefinement) {
+  QueryOptions previous;
+  QueryOptions next;
+
+  previous.set_filter("beat");
+  next.set_filter("beatl");
+  EXPECT_TRUE(LibrarySongCache::IsRefinement(previous, next));
+  EXPECT_FALSE(LibrarySongCache::IsRefinement(next, previous));
+
+  next.set_filter("beat help");
+  EXPECT_TRUE(LibrarySongCache::IsRefinement(previous, next));
+
+  // A column filter isn't the same as the word it started as.
+  previous.set_filter("artist");
+  next.set_filter("artist:b");
+  EXPECT_FALSE(LibrarySongCache::IsRefinement(previous, next));
+
+  previous.set_filter("beat");
+  next.set_filter("beat");
+  next.set_max_age(60);
+  EXPECT_TRUE(LibrarySongCache::IsRefinement(previous, next));
+  EXPECT_FALSE(LibrarySongCache::IsRefinement(next, previous));
+}
+
+TEST_F(LibrarySongCacheTest, DistinctSongs) {
+  cache_.Reset(SongList() << MakeSong(1, "Artist 1", "Album 1", "Title 1")
+                          << MakeSong(2, "Artist 1", "Album 1", "Title 2")
+                          << MakeSong(3, "Artist 1", "Album 2", "Title 3")
+                          << MakeSong(4, "Various", "Album 3", "Title 4",
+                                      true));
+
+  SongList songs = cache_.DistinctSongs(
+      QStringList() << "artist"
+                    << "album"
+                    << "effective_compilation",
+      QVector<int>() << 1 << 2 << 4);
+  ASSERT_EQ(2, songs.count());
+  EXPECT_EQ("Artist 1", songs[0].artist());
+  EXPECT_EQ("Album 1", songs[0].album());
+  EXPECT_FALSE(songs[0].is_compilation());
+  EXPECT_EQ("Album 3", songs[1].album());
+  EXPECT_TRUE(songs[1].is_compilation());
+}
+
+}  // namespace
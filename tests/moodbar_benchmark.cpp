@@ -0,0 +1,99 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <gst/gst.h>
+
+#include <QElapsedTimer>
+
+#include "core/logging.h"
+#include "gst/moodbar/gstfastspectrum.h"
+#include "gst/moodbar/plugin.h"
+#include "moodbar/moodbarbuilder.h"
+
+namespace {
+
+const int kSampleRate = 44100;
+const int kSamplesPerBuffer = 4410;
+const int kDurationSeconds = 10 * 60;
+const int kBands = 128;
+
+class MoodbarBenchmark : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    gst_init(nullptr, nullptr);
+    gstfastspectrum_register_static();
+  }
+};
+
+TEST_F(MoodbarBenchmark, TenMinutesOfPinkNoise) {
+  const QString description =
+      QString(
+          "audiotestsrc wave=pink-noise num-buffers=%1 samplesperbuffer=%2 ! "
+          "audio/x-raw,format=S16LE,rate=%3,channels=1 ! "
+          "fastspectrum name=spectrum bands=%4 ! fakesink sync=false")
+          .arg(kDurationSeconds * kSampleRate / kSamplesPerBuffer)
+          .arg(kSamplesPerBuffer)
+          .arg(kSampleRate)
+          .arg(kBands);
+
+  GError* error = nullptr;
+  GstElement* pipeline =
+      gst_parse_launch(description.toUtf8().constData(), &error);
+  ASSERT_TRUE(pipeline);
+  ASSERT_FALSE(error);
+
+  MoodbarBuilder builder;
+  builder.Init(kBands, kSampleRate);
+
+  int frames = 0;
+  GstElement* spectrum = gst_bin_get_by_name(GST_BIN(pipeline), "spectrum");
+  GST_FASTSPECTRUM(spectrum)->output_callback = [&](const float* magnitudes,
+                                                    int size) {
+    builder.AddFrame(magnitudes, size);
+    frames++;
+  };
+  gst_object_unref(spectrum);
+
+  QElapsedTimer timer;
+  timer.start();
+
+  gst_element_set_state(pipeline, GST_STATE_PLAYING);
+  GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
+  GstMessage* message = gst_bus_timed_pop_filtered(
+      bus, GST_CLOCK_TIME_NONE,
+      GstMessageType(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  const bool eos = GST_MESSAGE_TYPE(message) == GST_MESSAGE_EOS;
+  gst_message_unref(message);
+  gst_object_unref(bus);
+
+  const QByteArray moodbar = builder.Finish(1000);
+  const qint64 msec = qMax(timer.elapsed(), qint64(1));
+
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(pipeline);
+
+  qLog(Info) << frames << "frames in" << msec << "ms:"
+             << frames * 1000 / msec << "frames per second,"
+             << kDurationSeconds * 1000 / msec << "times real time";
+
+  EXPECT_TRUE(eos);
+  EXPECT_GT(frames, 0);
+  EXPECT_EQ(3000, moodbar.size());
+}
+
+}  // namespace
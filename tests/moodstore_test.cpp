@@ -0,0 +1,138 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "moodbar/moodstore.h"
+
+#include "gtest/gtest.h"
+
+#include "test_utils.h"
+
+#include <QFile>
+#include <QFileInfo>
+
+namespace {
+
+// Matches the sizes in moodstore.h.
+const int kHeaderSize = 16;
+const int kRecordHeaderSize = 12;
+
+class MoodStoreTest : public ::testing::Test {
+ protected:
+  MoodStoreTest() : filename_(directory_.FilePath("moods.db")) {}
+
+  qint64 FileSize() const { return QFileInfo(filename_).size(); }
+
+  TemporaryDirectory directory_;
+  QString filename_;
+};
+
+TEST_F(MoodStoreTest, RoundTrip) {
+  {
+    MoodStore store(filename_);
+    EXPECT_EQ(0, store.count());
+    EXPECT_FALSE(store.Contains(1));
+    EXPECT_TRUE(store.Get(1).isEmpty());
+
+    ASSERT_TRUE(store.Put(1, "first"));
+    ASSERT_TRUE(store.Put(2, "second"));
+    EXPECT_EQ("first", store.Get(1));
+    EXPECT_EQ("second", store.Get(2));
+
+    // The newest record wins.
+    ASSERT_TRUE(store.Put(1, "replaced"));
+    EXPECT_EQ("replaced", store.Get(1));
+    EXPECT_EQ(2, store.count());
+  }
+
+  MoodStore store(filename_);
+  EXPECT_EQ(2, store.count());
+  EXPECT_TRUE(store.Contains(1));
+  EXPECT_EQ("replaced", store.Get(1));
+  EXPECT_EQ("second", store.Get(2));
+  EXPECT_FALSE(store.Contains(3));
+}
+
+TEST_F(MoodStoreTest, IgnoresOtherFiles) {
+  QFile file(filename_);
+  ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+  file.write(QByteArray(100, 'x'));
+  file.close();
+
+  MoodStore store(filename_);
+  EXPECT_EQ(0, store.count());
+  EXPECT_EQ(kHeaderSize, FileSize());
+
+  ASSERT_TRUE(store.Put(1, "data"));
+  EXPECT_EQ("data", store.Get(1));
+}
+
+TEST_F(MoodStoreTest, CompactsDeadRecords) {
+  const QByteArray old_data(1024 * 1024, 'a');
+  const QByteArray new_data(1024 * 1024, 'b');
+  const qint64 compacted_size =
+      kHeaderSize + 2 * kRecordHeaderSize + new_data.size() + 5;
+
+  {
+    MoodStore store(filename_);
+    ASSERT_TRUE(store.Put(1, "small"));
+    ASSERT_TRUE(store.Put(2, old_data));
+    ASSERT_TRUE(store.Put(2, old_data));
+    ASSERT_TRUE(store.Put(2, new_data));
+  }
+  EXPECT_LT(compacted_size, FileSize());
+
+  // The old records are only thrown away when the file is next opened.
+  {
+    MoodStore store(filename_);
+    EXPECT_EQ(compacted_size, FileSize());
+    EXPECT_EQ(2, store.count());
+    EXPECT_EQ("small", store.Get(1));
+    EXPECT_EQ(new_data, store.Get(2));
+  }
+  EXPECT_FALSE(QFile::exists(filename_ + ".new"));
+}
+
+TEST_F(MoodStoreTest, TruncatesPartialRecords) {
+  qint64 complete_size = 0;
+  {
+    MoodStore store(filename_);
+    ASSERT_TRUE(store.Put(1, "complete"));
+    complete_size = FileSize();
+    ASSERT_TRUE(store.Put(2, "cut short"));
+  }
+
+  // Lose the end of the last record, as if writing it was interrupted.
+  ASSERT_TRUE(QFile::resize(filename_, FileSize() - 4));
+
+  {
+    MoodStore store(filename_);
+    EXPECT_EQ(complete_size, FileSize());
+    EXPECT_EQ(1, store.count());
+    EXPECT_EQ("complete", store.Get(1));
+    EXPECT_FALSE(store.Contains(2));
+
+    // New records go after the last complete one.
+    ASSERT_TRUE(store.Put(2, "written again"));
+  }
+
+  // A record header on its own is thrown away too.
+  ASSERT_TRUE(QFile::resize(filename_, complete_size + kRecordHeaderSize / 2));
+  MoodStore store(filename_);
+  EXPECT_EQ(complete_size, FileSize());
+  EXPECT_EQ(1, store.count());
+}
+
+}  // namespace
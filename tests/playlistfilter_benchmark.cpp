@@ -0,0 +1,129 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <QElapsedTimer>
+#include <QSortFilterProxyModel>
+#include <QStringList>
+
+#include "mock_settingsprovider.h"
+#include "core/logging.h"
+#include "core/song.h"
+#include "core/timeconstants.h"
+#include "playlist/playlist.h"
+#include "playlist/playlistsequence.h"
+
+namespace {
+
+const int kSongCount = 50000;
+
+class PlaylistFilterBenchmark : public ::testing::Test {
+ protected:
+  PlaylistFilterBenchmark()
+      : playlist_(nullptr, nullptr, nullptr, 1),
+        sequence_(nullptr, new DummySettingsProvider) {}
+
+  virtual void SetUp() {
+    playlist_.set_sequence(&sequence_);
+
+    static const char* kGenres[] = {"Rock", "Jazz", "Pop", "Classical",
+                                    "Electronic"};
+
+    SongList songs;
+    for (int i = 0; i < kSongCount; ++i) {
+      Song song;
+      song.Init(QString("Title %1").arg(i), QString("Artist %1").arg(i / 100),
+                QString("Album %1").arg(i / 10),
+                (120 + i % 300) * kNsecPerSec);
+      song.set_track(i % 10 + 1);
+      song.set_year(1960 + i % 60);
+      song.set_genre(kGenres[i % 5]);
+      song.set_rating((i % 11) / 10.0);
+      song.set_url(QUrl::fromLocalFile(QString("/music/%1.mp3").arg(i)));
+      songs << song;
+    }
+    playlist_.InsertSongs(songs);
+  }
+
+  QSortFilterProxyModel* proxy() { return playlist_.proxy(); }
+
+  // Returns the number of rows matching query.
+  int Filter(const QString& query) {
+    proxy()->setFilterFixedString(query);
+    return proxy()->rowCount();
+  }
+
+  static void Report(const QString& name, int rows, qint64 msec) {
+    qLog(Info) << name << ":" << rows << "rows in" << msec << "ms";
+  }
+
+  Playlist playlist_;
+  PlaylistSequence sequence_;
+};
+
+TEST_F(PlaylistFilterBenchmark, TypicalQueries) {
+  const QStringList queries = QStringList() << "title 123"
+                                            << "artist:\"artist 42\""
+                                            << "year:>2000"
+                                            << "length:<3:00"
+                                            << "-genre:rock"
+                                            << "jazz OR pop"
+                                            << "rating:>=4"
+                                            << "genre:rock year:1990";
+
+  for (const QString& query : queries) {
+    // Go through an empty filter each time so nothing is refined.
+    Filter(QString());
+
+    QElapsedTimer timer;
+    timer.start();
+    const int rows = Filter(query);
+    Report(query, rows, timer.elapsed());
+  }
+
+  Filter(QString());
+  EXPECT_EQ(kSongCount, proxy()->rowCount());
+  EXPECT_EQ(kSongCount / 5, Filter("genre:=jazz"));
+}
+
+TEST_F(PlaylistFilterBenchmark, Typing) {
+  const QString query = "artist 12";
+
+  // Typing the query one character at a time can re-test only the rows that
+  // matched the previous keystroke.
+  QElapsedTimer timer;
+  timer.start();
+  int rows = 0;
+  for (int i = 1; i <= query.length(); ++i) {
+    rows = Filter(query.left(i));
+  }
+  Report("Typing \"" + query + "\"", rows, timer.elapsed());
+
+  // The same keystrokes, but filtering every row each time.
+  timer.start();
+  int full_rows = 0;
+  for (int i = 1; i <= query.length(); ++i) {
+    Filter(QString());
+    full_rows = Filter(query.left(i));
+  }
+  Report("Typing \"" + query + "\" without refinement", full_rows,
+         timer.elapsed());
+
+  EXPECT_EQ(full_rows, rows);
+}
+
+}  // namespace
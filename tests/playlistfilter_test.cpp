@@ -0,0 +1,35 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "playlist/playlistfilter.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(PlaylistFilterTest, IsRefinement) {
+  EXPECT_TRUE(PlaylistFilter::IsRefinement("", "a"));
+  EXPECT_TRUE(PlaylistFilter::IsRefinement("beat", "beatles"));
+  EXPECT_TRUE(PlaylistFilter::IsRefinement("beatles", "beatles help"));
+
+  EXPECT_FALSE(PlaylistFilter::IsRefinement("beatles", "beat"));
+  EXPECT_FALSE(PlaylistFilter::IsRefinement("-a", "-ab"));
+  EXPECT_FALSE(PlaylistFilter::IsRefinement("year:2", "year:20"));
+  EXPECT_FALSE(PlaylistFilter::IsRefinement("a", "a OR b"));
+  EXPECT_FALSE(PlaylistFilter::IsRefinement("a AN", "a AND b"));
+}
+
+}  // namespace
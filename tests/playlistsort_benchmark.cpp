@@ -0,0 +1,112 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <functional>
+
+#include <QElapsedTimer>
+
+#include "mock_settingsprovider.h"
+#include "core/logging.h"
+#include "core/song.h"
+#include "core/timeconstants.h"
+#include "playlist/playlist.h"
+#include "playlist/playlistsequence.h"
+
+namespace {
+
+const int kSongCount = 100000;
+
+class PlaylistSortBenchmark : public ::testing::Test {
+ protected:
+  PlaylistSortBenchmark()
+      : playlist_(nullptr, nullptr, nullptr, 1),
+        sequence_(nullptr, new DummySettingsProvider) {}
+
+  virtual void SetUp() {
+    playlist_.set_sequence(&sequence_);
+
+    // Spread the artists out so the playlist starts unsorted, and vary the
+    // case so equal keys come from different strings.
+    SongList songs;
+    for (int i = 0; i < kSongCount; ++i) {
+      const int artist = (i * 7919) % 1000;
+      Song song;
+      song.Init(QString("Title %1").arg(i),
+                QString(i % 2 ? "Artist %1" : "ARTIST %1").arg(artist),
+                QString("Album %1").arg(i / 10), 180 * kNsecPerSec);
+      song.set_url(QUrl::fromLocalFile(QString("/music/%1.mp3").arg(i)));
+      songs << song;
+    }
+    playlist_.InsertSongs(songs);
+  }
+
+  // Sorts the playlist and returns how long it took.
+  qint64 Sort(Playlist::Column column, Qt::SortOrder order) {
+    QElapsedTimer timer;
+    timer.start();
+    playlist_.sort(column, order);
+    return timer.elapsed();
+  }
+
+  // Checks that the playlist is in the order CompareItems() gives, and that
+  // equal items kept their previous order.
+  void ExpectSorted(Playlist::Column column, Qt::SortOrder order,
+                    const PlaylistItemList& before) {
+    PlaylistItemList expected(before);
+    qStableSort(expected.begin(), expected.end(),
+                std::bind(&Playlist::CompareItems, column, order,
+                          std::placeholders::_1, std::placeholders::_2));
+
+    for (int i = 0; i < expected.count(); ++i) {
+      ASSERT_EQ(expected[i], playlist_.item_at(i)) << "row " << i;
+    }
+  }
+
+  PlaylistItemList Items() const {
+    PlaylistItemList ret;
+    for (int i = 0; i < playlist_.rowCount(); ++i) {
+      ret << playlist_.item_at(i);
+    }
+    return ret;
+  }
+
+  Playlist playlist_;
+  PlaylistSequence sequence_;
+};
+
+TEST_F(PlaylistSortBenchmark, SortByArtist) {
+  PlaylistItemList before = Items();
+  qLog(Info) << "First sort by artist:"
+             << Sort(Playlist::Column_Artist, Qt::AscendingOrder) << "ms";
+  ExpectSorted(Playlist::Column_Artist, Qt::AscendingOrder, before);
+
+  // The second sort reuses the keys cached on the items.
+  before = Items();
+  qLog(Info) << "Re-sort by artist:"
+             << Sort(Playlist::Column_Artist, Qt::DescendingOrder) << "ms";
+  ExpectSorted(Playlist::Column_Artist, Qt::DescendingOrder, before);
+}
+
+TEST_F(PlaylistSortBenchmark, SortByNumericColumn) {
+  const PlaylistItemList before = Items();
+  qLog(Info) << "Sort by length:"
+             << Sort(Playlist::Column_Length, Qt::AscendingOrder) << "ms";
+  ExpectSorted(Playlist::Column_Length, Qt::AscendingOrder, before);
+}
+
+}  // namespace
@@ -0,0 +1,86 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "smartplaylists/randomsampler.h"
+
+#include "gtest/gtest.h"
+
+#include "test_utils.h"
+
+using smart_playlists::RandomSampler;
+
+namespace {
+
+class RandomSamplerTest : public ::testing::Test {
+ protected:
+  static QVector<int> Ids(int count) {
+    QVector<int> ret;
+    for (int i = 0; i < count; ++i) ret << i + 100;
+    return ret;
+  }
+
+  RandomSampler sampler_;
+};
+
+TEST_F(RandomSamplerTest, Empty) {
+  EXPECT_TRUE(sampler_.Sample(10, QSet<int>()).isEmpty());
+  EXPECT_TRUE(sampler_.Sample(-1, QSet<int>()).isEmpty());
+}
+
+TEST_F(RandomSamplerTest, NeverRepeats) {
+  sampler_.Reset(Ids(50));
+
+  const QList<int> ids = sampler_.Sample(20, QSet<int>());
+  EXPECT_EQ(20, ids.count());
+  EXPECT_EQ(20, ids.toSet().count());
+
+  const QList<int> all = sampler_.Sample(-1, QSet<int>());
+  EXPECT_EQ(Ids(50).toList().toSet(), all.toSet());
+  EXPECT_EQ(50, all.count());
+}
+
+TEST_F(RandomSamplerTest, SkipsExcludedSongs) {
+  sampler_.Reset(Ids(5));
+
+  const QSet<int> exclude = QSet<int>() << 100 << 102 << 104 << 999;
+  const QList<int> ids = sampler_.Sample(10, exclude);
+  EXPECT_EQ(QSet<int>() << 101 << 103, ids.toSet());
+  EXPECT_EQ(2, ids.count());
+
+  // The excluded songs can still be picked next time.
+  EXPECT_EQ(5, sampler_.Sample(10, QSet<int>()).count());
+}
+
+TEST_F(RandomSamplerTest, FollowsWeights) {
+  sampler_.Reset(Ids(3), QVector<double>() << 1.0 << 0.0 << 9.0);
+
+  // A song with no weight is never picked.
+  EXPECT_EQ(2, sampler_.Sample(-1, QSet<int>()).count());
+
+  int heavy = 0;
+  for (int i = 0; i < 1000; ++i) {
+    if (sampler_.Sample(1, QSet<int>()).first() == 102) ++heavy;
+  }
+  EXPECT_GT(heavy, 800);
+
+  sampler_.SetWeight(100, 0.0);
+  sampler_.SetWeight(101, 1.0);
+  sampler_.SetWeight(999, 1.0);
+  EXPECT_EQ(QSet<int>() << 101 << 102,
+            sampler_.Sample(-1, QSet<int>()).toSet());
+}
+
+}  // namespace
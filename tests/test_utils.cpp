@@ -18,9 +18,12 @@
 #include "test_utils.h"
 
 #include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QNetworkRequest>
 #include <QString>
 #include <QUrl>
+#include <QUuid>
 
 std::ostream& operator<<(std::ostream& stream, const QString& str) {
   stream << str.toStdString();
@@ -66,6 +69,51 @@ TemporaryResource::TemporaryResource(const QString& filename) {
   reset();
 }
 
+const char* kPlaceholderContents = "not really a song";
+
+PlaceholderFile::PlaceholderFile() {
+  if (open()) {
+    write(kPlaceholderContents);
+    flush();
+  }
+}
+
+TemporaryDirectory::TemporaryDirectory()
+    : path_(QDir::temp().filePath("clementine_test-" +
+                                  QUuid::createUuid().toString().mid(1, 36))) {
+  QDir().mkpath(path_);
+}
+
+TemporaryDirectory::~TemporaryDirectory() { Remove(path_); }
+
+QString TemporaryDirectory::FilePath(const QString& name) const {
+  return path_ + "/" + name;
+}
+
+QString TemporaryDirectory::WriteFile(const QString& name,
+                                      const QByteArray& contents) const {
+  QFile file(FilePath(name));
+  if (!file.open(QIODevice::WriteOnly) ||
+      file.write(contents) != contents.size()) {
+    return QString();
+  }
+  return file.fileName();
+}
+
+void TemporaryDirectory::Remove(const QString& path) {
+  QDir dir(path);
+  for (const QFileInfo& info :
+       dir.entryInfoList(QDir::AllEntries | QDir::Hidden |
+                         QDir::NoDotAndDotDot)) {
+    if (info.isDir() && !info.isSymLink()) {
+      Remove(info.filePath());
+    } else {
+      QFile::remove(info.filePath());
+    }
+  }
+  QDir().rmdir(path);
+}
+
 TestQObject::TestQObject(QObject* parent)
   : QObject(parent),
     invoked_(0) {
@@ -20,12 +20,13 @@
 
 #include <iostream>
 
+#include <QByteArray>
 #include <QMetaType>
 #include <QModelIndex>
+#include <QString>
 #include <QTemporaryFile>
 
 class QNetworkRequest;
-class QString;
 class QUrl;
 class QVariant;
 
@@ -62,6 +63,39 @@ public:
   TemporaryResource(const QString& filename);
 };
 
+// The contents of the files written by PlaceholderFile and
+// TemporaryDirectory, for tests that only need a file to exist.
+extern const char* kPlaceholderContents;
+
+// A temporary file that's already open and holds kPlaceholderContents.
+class PlaceholderFile : public QTemporaryFile {
+ public:
+  PlaceholderFile();
+};
+
+// A new directory under QDir::tempPath() that's removed, along with
+// everything in it, when this is destroyed.
+class TemporaryDirectory {
+ public:
+  TemporaryDirectory();
+  ~TemporaryDirectory();
+
+  const QString& path() const { return path_; }
+  QString FilePath(const QString& name) const;
+
+  // Writes a file into the directory and returns its path, or an empty string
+  // if it couldn't be written.
+  QString WriteFile(const QString& name,
+                    const QByteArray& contents = kPlaceholderContents) const;
+
+ private:
+  Q_DISABLE_COPY(TemporaryDirectory)
+
+  static void Remove(const QString& path);
+
+  QString path_;
+};
+
 class TestQObject : public QObject {
   Q_OBJECT
  public: